@@ -0,0 +1,70 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cmath>
+#include <algorithm>
+
+// Axis aligned box plus a bounding sphere (xyz centre, w radius)
+struct Bounds
+{
+	glm::vec3 aabbMin;
+	glm::vec3 aabbMax;
+	glm::vec4 sphere;
+};
+
+// Grow a box/sphere around count points. The sphere is centred on the box,
+// with the radius to the furthest point, which is tighter than the half
+// diagonal.
+Bounds ComputeBounds(const glm::vec3 *points, size_t count, size_t stride)
+{
+	Bounds bounds;
+	bounds.aabbMin = glm::vec3(0.0f);
+	bounds.aabbMax = glm::vec3(0.0f);
+	bounds.sphere = glm::vec4(0.0f);
+	if (count == 0) return bounds;
+
+	const char *base = (const char *)points;
+	bounds.aabbMin = bounds.aabbMax = *points;
+	for (size_t i = 1; i < count; i++)
+	{
+		const glm::vec3 &p = *(const glm::vec3 *)(base + i * stride);
+		bounds.aabbMin = glm::min(bounds.aabbMin, p);
+		bounds.aabbMax = glm::max(bounds.aabbMax, p);
+	}
+
+	glm::vec3 center = (bounds.aabbMin + bounds.aabbMax) * 0.5f;
+	float radiusSq = 0.0f;
+	for (size_t i = 0; i < count; i++)
+	{
+		glm::vec3 d = *(const glm::vec3 *)(base + i * stride) - center;
+		radiusSq = std::max(radiusSq, glm::dot(d, d));
+	}
+	bounds.sphere = glm::vec4(center, sqrt(radiusSq));
+	return bounds;
+}
+
+// Bounds of bounds after an affine transform. The box is the box around the
+// transformed box (Arvo), the sphere radius scales with the largest axis.
+Bounds TransformBounds(const Bounds &bounds, const glm::mat4 &m)
+{
+	Bounds result;
+	glm::vec3 center = (bounds.aabbMin + bounds.aabbMax) * 0.5f;
+	glm::vec3 extent = (bounds.aabbMax - bounds.aabbMin) * 0.5f;
+	glm::vec3 newCenter = glm::vec3(m * glm::vec4(center, 1.0f));
+	glm::vec3 newExtent;
+	for (int row = 0; row < 3; row++)
+	{
+		newExtent[row] = fabs(m[0][row]) * extent.x + fabs(m[1][row]) * extent.y
+			+ fabs(m[2][row]) * extent.z;
+	}
+	result.aabbMin = newCenter - newExtent;
+	result.aabbMax = newCenter + newExtent;
+
+	float scale = std::max(glm::length(glm::vec3(m[0])),
+						   std::max(glm::length(glm::vec3(m[1])),
+									glm::length(glm::vec3(m[2]))));
+	glm::vec3 sphereCenter
+		= glm::vec3(m * glm::vec4(glm::vec3(bounds.sphere), 1.0f));
+	result.sphere = glm::vec4(sphereCenter, bounds.sphere.w * scale);
+	return result;
+}
\ No newline at end of file
@@ -0,0 +1,664 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <iostream>
+#include <algorithm>
+#include <cfloat>
+#include <cassert>
+
+#include "threadpool.h"
+#include "bounds.h"
+#include "model.h"
+#include "types.h"
+
+// 32 byte node. Interior nodes (count == 0) store the index of their left
+// child in leftFirst, the right child is always leftFirst + 1. Leaves store
+// the first entry of their range in the sorted primitive index array.
+struct BVHNode
+{
+	glm::vec3 aabbMin;
+	u32 leftFirst;
+	glm::vec3 aabbMax;
+	u32 count;
+
+	bool IsLeaf() const { return count > 0; }
+};
+static_assert(sizeof(BVHNode) == 32, "BVHNode should be 32 bytes");
+
+struct Ray
+{
+	Ray(const glm::vec3 &o, const glm::vec3 &d, float maxT = FLT_MAX)
+		: origin(o), dir(d), invDir(1.0f / d), tMax(maxT)
+	{
+	}
+	glm::vec3 origin;
+	glm::vec3 dir;
+	glm::vec3 invDir;
+	float tMax;
+};
+
+// Binned SAH bounding volume hierarchy over arbitrary primitive boxes. Large
+// subtrees are built in parallel on a ThreadPool. When primitives move but
+// the topology is still good, Refit() updates the boxes without rebuilding.
+class BVH
+{
+public:
+	// primMin/primMax are the primitive boxes, pool may be null
+	void Build(const std::vector<glm::vec3> &primMin,
+			   const std::vector<glm::vec3> &primMax, ThreadPool *pool);
+	// Recompute node bounds bottom up from new primitive boxes
+	void Refit(const std::vector<glm::vec3> &primMin,
+			   const std::vector<glm::vec3> &primMax);
+	// Scene objects, one primitive per world space Bounds
+	void Build(const std::vector<Bounds> &objects, ThreadPool *pool);
+	void Refit(const std::vector<Bounds> &objects);
+
+	// Walk the nodes the ray hits, nearest first. intersect(prim, ray) tests
+	// one primitive and shortens ray.tMax on a hit. Returns true on any hit.
+	template <class Intersector>
+	bool Intersect(Ray &ray, Intersector intersect) const;
+
+	// Call visit(prim) for every primitive whose leaf box overlaps the box
+	template <class Visitor>
+	void QueryBox(const glm::vec3 &boxMin, const glm::vec3 &boxMax,
+				  Visitor visit) const;
+
+	const std::vector<BVHNode> &Nodes() const { return m_nodes; }
+	const std::vector<u32> &PrimIndices() const { return m_primIndices; }
+	u32 NodeCount() const { return m_nodesUsed; }
+
+private:
+	static const u32 BIN_COUNT = 16;
+	static const u32 MAX_LEAF_SIZE = 4;
+	// deeper nodes stay leaves, however many primitives they hold, so the
+	// traversal stacks can't overflow on degenerate input such as many
+	// coincident centroids
+	static const u32 MAX_DEPTH = 63;
+	// a far child per level when intersecting, both children of the deepest
+	// interior node when querying
+	static const u32 STACK_SIZE = MAX_DEPTH + 1;
+	// subtrees with more primitives than this go to the thread pool
+	static const u32 PARALLEL_THRESHOLD = 4096;
+
+	void Subdivide(u32 nodeIndex, u32 depth, ThreadPool *pool);
+	void UpdateNodeBounds(BVHNode &node) const;
+	float FindBestSplit(const BVHNode &node, int &axis, float &splitPos) const;
+
+	std::vector<BVHNode> m_nodes;
+	std::vector<u32> m_primIndices;
+	std::atomic<u32> m_nodesUsed;
+	// build input, only valid during Build/Refit
+	const glm::vec3 *m_primMin = nullptr;
+	const glm::vec3 *m_primMax = nullptr;
+	std::vector<glm::vec3> m_centroids;
+};
+
+inline float SurfaceArea(const glm::vec3 &extent)
+{
+	return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+}
+
+// Slab test, returns the entry distance or FLT_MAX on a miss
+inline float IntersectAABB(const Ray &ray, const glm::vec3 &bmin,
+						   const glm::vec3 &bmax)
+{
+	glm::vec3 t1 = (bmin - ray.origin) * ray.invDir;
+	glm::vec3 t2 = (bmax - ray.origin) * ray.invDir;
+	glm::vec3 tNear = glm::min(t1, t2);
+	glm::vec3 tFar = glm::max(t1, t2);
+	float tmin = std::max(std::max(tNear.x, tNear.y), tNear.z);
+	float tmax = std::min(std::min(tFar.x, tFar.y), tFar.z);
+	if (tmax >= tmin && tmin < ray.tMax && tmax > 0.0f) return tmin;
+	return FLT_MAX;
+}
+
+void BVH::Build(const std::vector<glm::vec3> &primMin,
+				const std::vector<glm::vec3> &primMax, ThreadPool *pool)
+{
+	u32 n = (u32)primMin.size();
+	m_primMin = primMin.data();
+	m_primMax = primMax.data();
+	m_nodes.assign(n > 0 ? 2 * n - 1 : 1, BVHNode());
+	m_primIndices.resize(n);
+	m_centroids.resize(n);
+	for (u32 i = 0; i < n; i++)
+	{
+		m_primIndices[i] = i;
+		m_centroids[i] = (primMin[i] + primMax[i]) * 0.5f;
+	}
+
+	BVHNode &root = m_nodes[0];
+	root.leftFirst = 0;
+	root.count = n;
+	m_nodesUsed = 1;
+	if (n == 0)
+	{
+		root.aabbMin = root.aabbMax = glm::vec3(0.0f);
+		return;
+	}
+	UpdateNodeBounds(root);
+	Subdivide(0, 0, pool);
+	if (pool) pool->Wait();
+
+	m_nodes.resize(m_nodesUsed);
+	m_centroids.clear();
+	m_centroids.shrink_to_fit();
+	m_primMin = m_primMax = nullptr;
+}
+
+void BVH::UpdateNodeBounds(BVHNode &node) const
+{
+	node.aabbMin = glm::vec3(FLT_MAX);
+	node.aabbMax = glm::vec3(-FLT_MAX);
+	for (u32 i = 0; i < node.count; i++)
+	{
+		u32 prim = m_primIndices[node.leftFirst + i];
+		node.aabbMin = glm::min(node.aabbMin, m_primMin[prim]);
+		node.aabbMax = glm::max(node.aabbMax, m_primMax[prim]);
+	}
+}
+
+float BVH::FindBestSplit(const BVHNode &node, int &axis,
+						 float &splitPos) const
+{
+	struct Bin
+	{
+		glm::vec3 bmin = glm::vec3(FLT_MAX);
+		glm::vec3 bmax = glm::vec3(-FLT_MAX);
+		u32 count = 0;
+	};
+
+	float bestCost = FLT_MAX;
+	for (int a = 0; a < 3; a++)
+	{
+		// bin on centroid bounds, not node bounds, so no bin is wasted
+		float cmin = FLT_MAX, cmax = -FLT_MAX;
+		for (u32 i = 0; i < node.count; i++)
+		{
+			float c = m_centroids[m_primIndices[node.leftFirst + i]][a];
+			cmin = std::min(cmin, c);
+			cmax = std::max(cmax, c);
+		}
+		if (cmin == cmax) continue;
+
+		Bin bins[BIN_COUNT];
+		float scale = BIN_COUNT / (cmax - cmin);
+		for (u32 i = 0; i < node.count; i++)
+		{
+			u32 prim = m_primIndices[node.leftFirst + i];
+			u32 b = std::min(BIN_COUNT - 1,
+							 (u32)((m_centroids[prim][a] - cmin) * scale));
+			bins[b].count++;
+			bins[b].bmin = glm::min(bins[b].bmin, m_primMin[prim]);
+			bins[b].bmax = glm::max(bins[b].bmax, m_primMax[prim]);
+		}
+
+		// sweep from both sides to get the cost of each of the planes
+		float leftArea[BIN_COUNT - 1], rightArea[BIN_COUNT - 1];
+		u32 leftCount[BIN_COUNT - 1], rightCount[BIN_COUNT - 1];
+		glm::vec3 lmin(FLT_MAX), lmax(-FLT_MAX), rmin(FLT_MAX), rmax(-FLT_MAX);
+		u32 lsum = 0, rsum = 0;
+		for (u32 i = 0; i < BIN_COUNT - 1; i++)
+		{
+			lsum += bins[i].count;
+			leftCount[i] = lsum;
+			lmin = glm::min(lmin, bins[i].bmin);
+			lmax = glm::max(lmax, bins[i].bmax);
+			leftArea[i] = lsum ? SurfaceArea(lmax - lmin) : 0.0f;
+
+			u32 r = BIN_COUNT - 1 - i;
+			rsum += bins[r].count;
+			rightCount[r - 1] = rsum;
+			rmin = glm::min(rmin, bins[r].bmin);
+			rmax = glm::max(rmax, bins[r].bmax);
+			rightArea[r - 1] = rsum ? SurfaceArea(rmax - rmin) : 0.0f;
+		}
+		float binWidth = (cmax - cmin) / BIN_COUNT;
+		for (u32 i = 0; i < BIN_COUNT - 1; i++)
+		{
+			float cost
+				= leftCount[i] * leftArea[i] + rightCount[i] * rightArea[i];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				axis = a;
+				splitPos = cmin + binWidth * (i + 1);
+			}
+		}
+	}
+	return bestCost;
+}
+
+void BVH::Subdivide(u32 nodeIndex, u32 depth, ThreadPool *pool)
+{
+	BVHNode &node = m_nodes[nodeIndex];
+	if (node.count <= MAX_LEAF_SIZE || depth >= MAX_DEPTH) return;
+
+	int axis = 0;
+	float splitPos = 0.0f;
+	float splitCost = FindBestSplit(node, axis, splitPos);
+	float leafCost = node.count * SurfaceArea(node.aabbMax - node.aabbMin);
+	if (splitCost >= leafCost) return;
+
+	// partition the index range in place
+	int i = node.leftFirst;
+	int j = i + node.count - 1;
+	while (i <= j)
+	{
+		if (m_centroids[m_primIndices[i]][axis] < splitPos)
+			i++;
+		else
+			std::swap(m_primIndices[i], m_primIndices[j--]);
+	}
+	u32 leftCount = i - node.leftFirst;
+	if (leftCount == 0 || leftCount == node.count) return;
+
+	u32 leftIndex = m_nodesUsed.fetch_add(2);
+	BVHNode &left = m_nodes[leftIndex];
+	BVHNode &right = m_nodes[leftIndex + 1];
+	left.leftFirst = node.leftFirst;
+	left.count = leftCount;
+	right.leftFirst = i;
+	right.count = node.count - leftCount;
+	node.leftFirst = leftIndex;
+	node.count = 0;
+	UpdateNodeBounds(left);
+	UpdateNodeBounds(right);
+
+	if (pool && left.count > PARALLEL_THRESHOLD)
+	{
+		pool->Submit([this, leftIndex, depth, pool] {
+			Subdivide(leftIndex, depth + 1, pool);
+		});
+	}
+	else
+	{
+		Subdivide(leftIndex, depth + 1, pool);
+	}
+	Subdivide(leftIndex + 1, depth + 1, pool);
+}
+
+void BVH::Refit(const std::vector<glm::vec3> &primMin,
+				const std::vector<glm::vec3> &primMax)
+{
+	m_primMin = primMin.data();
+	m_primMax = primMax.data();
+	// children are always allocated after their parent, so walking the
+	// nodes backwards visits children first
+	for (int n = (int)m_nodesUsed - 1; n >= 0; n--)
+	{
+		BVHNode &node = m_nodes[n];
+		if (node.IsLeaf())
+		{
+			UpdateNodeBounds(node);
+		}
+		else
+		{
+			const BVHNode &left = m_nodes[node.leftFirst];
+			const BVHNode &right = m_nodes[node.leftFirst + 1];
+			node.aabbMin = glm::min(left.aabbMin, right.aabbMin);
+			node.aabbMax = glm::max(left.aabbMax, right.aabbMax);
+		}
+	}
+	m_primMin = m_primMax = nullptr;
+}
+
+inline void SplitBounds(const std::vector<Bounds> &objects,
+						std::vector<glm::vec3> &boxMin,
+						std::vector<glm::vec3> &boxMax)
+{
+	boxMin.resize(objects.size());
+	boxMax.resize(objects.size());
+	for (size_t i = 0; i < objects.size(); i++)
+	{
+		boxMin[i] = objects[i].aabbMin;
+		boxMax[i] = objects[i].aabbMax;
+	}
+}
+
+void BVH::Build(const std::vector<Bounds> &objects, ThreadPool *pool)
+{
+	std::vector<glm::vec3> boxMin, boxMax;
+	SplitBounds(objects, boxMin, boxMax);
+	Build(boxMin, boxMax, pool);
+}
+
+void BVH::Refit(const std::vector<Bounds> &objects)
+{
+	std::vector<glm::vec3> boxMin, boxMax;
+	SplitBounds(objects, boxMin, boxMax);
+	Refit(boxMin, boxMax);
+}
+
+template <class Intersector>
+bool BVH::Intersect(Ray &ray, Intersector intersect) const
+{
+	if (m_primIndices.empty()) return false;
+	if (IntersectAABB(ray, m_nodes[0].aabbMin, m_nodes[0].aabbMax) == FLT_MAX)
+		return false;
+
+	bool hit = false;
+	u32 stack[STACK_SIZE];
+	u32 stackSize = 0;
+	u32 nodeIndex = 0;
+	for (;;)
+	{
+		const BVHNode &node = m_nodes[nodeIndex];
+		if (node.IsLeaf())
+		{
+			for (u32 i = 0; i < node.count; i++)
+			{
+				hit |= intersect(m_primIndices[node.leftFirst + i], ray);
+			}
+			if (stackSize == 0) break;
+			nodeIndex = stack[--stackSize];
+			continue;
+		}
+
+		// descend into the nearer child, push the further one
+		u32 near = node.leftFirst, far = node.leftFirst + 1;
+		float dNear = IntersectAABB(ray, m_nodes[near].aabbMin,
+									m_nodes[near].aabbMax);
+		float dFar = IntersectAABB(ray, m_nodes[far].aabbMin,
+								   m_nodes[far].aabbMax);
+		if (dNear > dFar)
+		{
+			std::swap(near, far);
+			std::swap(dNear, dFar);
+		}
+		if (dNear == FLT_MAX)
+		{
+			if (stackSize == 0) break;
+			nodeIndex = stack[--stackSize];
+		}
+		else
+		{
+			nodeIndex = near;
+			if (dFar != FLT_MAX)
+			{
+				assert(stackSize < STACK_SIZE);
+				stack[stackSize++] = far;
+			}
+		}
+	}
+	return hit;
+}
+
+template <class Visitor>
+void BVH::QueryBox(const glm::vec3 &boxMin, const glm::vec3 &boxMax,
+				   Visitor visit) const
+{
+	if (m_primIndices.empty()) return;
+	u32 stack[STACK_SIZE];
+	u32 stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		const BVHNode &node = m_nodes[stack[--stackSize]];
+		if (glm::any(glm::lessThan(node.aabbMax, boxMin))
+			|| glm::any(glm::greaterThan(node.aabbMin, boxMax)))
+			continue;
+		if (node.IsLeaf())
+		{
+			for (u32 i = 0; i < node.count; i++)
+			{
+				visit(m_primIndices[node.leftFirst + i]);
+			}
+		}
+		else
+		{
+			assert(stackSize + 2 <= STACK_SIZE);
+			stack[stackSize++] = node.leftFirst;
+			stack[stackSize++] = node.leftFirst + 1;
+		}
+	}
+}
+
+// Triangle soup with a BVH for closest-hit ray queries
+class TriangleBVH
+{
+public:
+	struct Hit
+	{
+		float t = FLT_MAX;
+		u32 triangle = 0;
+		float u = 0.0f, v = 0.0f;
+	};
+
+	// indices are triangle lists into positions
+	void Build(const std::vector<glm::vec3> &positions,
+			   const std::vector<u32> &indices, ThreadPool *pool);
+	// All triangles of the model's meshes, in object space
+	void Build(const Model &model, ThreadPool *pool);
+	// positions moved, same topology
+	void Refit(const std::vector<glm::vec3> &positions);
+	bool Intersect(const Ray &ray, Hit &hit) const;
+
+	u32 TriangleCount() const { return (u32)m_indices.size() / 3; }
+	const BVH &Tree() const { return m_bvh; }
+
+private:
+	void ComputeTriangleBounds();
+
+	BVH m_bvh;
+	std::vector<glm::vec3> m_positions;
+	std::vector<u32> m_indices;
+	std::vector<glm::vec3> m_triMin, m_triMax;
+};
+
+// Concatenate the positions and indices of all of a model's meshes
+void GatherTriangles(const Model &model, std::vector<glm::vec3> &positions,
+					 std::vector<u32> &indices)
+{
+	positions.clear();
+	indices.clear();
+	for (const Mesh &mesh : model.GetMeshes())
+	{
+		u32 base = (u32)positions.size();
+		for (const Vertex &vertex : mesh.m_vertices)
+		{
+			positions.push_back(vertex.Position);
+		}
+		for (u32 index : mesh.m_indices)
+		{
+			indices.push_back(base + index);
+		}
+	}
+}
+
+void TriangleBVH::ComputeTriangleBounds()
+{
+	u32 n = TriangleCount();
+	m_triMin.resize(n);
+	m_triMax.resize(n);
+	for (u32 t = 0; t < n; t++)
+	{
+		const glm::vec3 &a = m_positions[m_indices[t * 3]];
+		const glm::vec3 &b = m_positions[m_indices[t * 3 + 1]];
+		const glm::vec3 &c = m_positions[m_indices[t * 3 + 2]];
+		m_triMin[t] = glm::min(a, glm::min(b, c));
+		m_triMax[t] = glm::max(a, glm::max(b, c));
+	}
+}
+
+void TriangleBVH::Build(const std::vector<glm::vec3> &positions,
+						const std::vector<u32> &indices, ThreadPool *pool)
+{
+	m_positions = positions;
+	m_indices = indices;
+	ComputeTriangleBounds();
+	m_bvh.Build(m_triMin, m_triMax, pool);
+}
+
+void TriangleBVH::Build(const Model &model, ThreadPool *pool)
+{
+	std::vector<glm::vec3> positions;
+	std::vector<u32> indices;
+	GatherTriangles(model, positions, indices);
+	Build(positions, indices, pool);
+}
+
+void TriangleBVH::Refit(const std::vector<glm::vec3> &positions)
+{
+	m_positions = positions;
+	ComputeTriangleBounds();
+	m_bvh.Refit(m_triMin, m_triMax);
+}
+
+bool TriangleBVH::Intersect(const Ray &ray, Hit &hit) const
+{
+	Ray r = ray;
+	return m_bvh.Intersect(r, [&](u32 tri, Ray &r) {
+		// Moller-Trumbore
+		const glm::vec3 &v0 = m_positions[m_indices[tri * 3]];
+		glm::vec3 e1 = m_positions[m_indices[tri * 3 + 1]] - v0;
+		glm::vec3 e2 = m_positions[m_indices[tri * 3 + 2]] - v0;
+		glm::vec3 p = glm::cross(r.dir, e2);
+		float det = glm::dot(e1, p);
+		if (fabs(det) < 1e-8f) return false;
+		float invDet = 1.0f / det;
+		glm::vec3 s = r.origin - v0;
+		float u = glm::dot(s, p) * invDet;
+		if (u < 0.0f || u > 1.0f) return false;
+		glm::vec3 q = glm::cross(s, e1);
+		float v = glm::dot(r.dir, q) * invDet;
+		if (v < 0.0f || u + v > 1.0f) return false;
+		float t = glm::dot(e2, q) * invDet;
+		if (t <= 1e-5f || t >= r.tMax) return false;
+		r.tMax = t;
+		hit.t = t;
+		hit.triangle = tri;
+		hit.u = u;
+		hit.v = v;
+		return true;
+	});
+}
+
+// Build time (single threaded and on pool) and closest-hit throughput for a
+// triangle soup. Results go to stdout.
+void BenchmarkTriangleBVH(const char *name,
+						  const std::vector<glm::vec3> &positions,
+						  const std::vector<u32> &indices, ThreadPool &pool)
+{
+	using Clock = std::chrono::high_resolution_clock;
+	TriangleBVH bvh;
+
+	Clock::time_point start = Clock::now();
+	bvh.Build(positions, indices, nullptr);
+	double serialMs
+		= std::chrono::duration<double, std::milli>(Clock::now() - start)
+			  .count();
+	start = Clock::now();
+	bvh.Build(positions, indices, &pool);
+	double parallelMs
+		= std::chrono::duration<double, std::milli>(Clock::now() - start)
+			  .count();
+
+	// rays from a sphere around the mesh towards random points inside it
+	const BVHNode &root = bvh.Tree().Nodes()[0];
+	glm::vec3 center = (root.aabbMin + root.aabbMax) * 0.5f;
+	float radius = glm::length(root.aabbMax - root.aabbMin);
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	const u32 rayCount = 200000;
+	std::vector<Ray> rays;
+	rays.reserve(rayCount);
+	for (u32 i = 0; i < rayCount; i++)
+	{
+		glm::vec3 dir(unit(rng), unit(rng), unit(rng));
+		glm::vec3 origin = center + glm::normalize(dir) * radius;
+		glm::vec3 target = center
+			+ glm::vec3(unit(rng), unit(rng), unit(rng)) * radius * 0.25f;
+		rays.push_back(Ray(origin, glm::normalize(target - origin)));
+	}
+	u32 hits = 0;
+	start = Clock::now();
+	for (const Ray &ray : rays)
+	{
+		TriangleBVH::Hit hit;
+		hits += bvh.Intersect(ray, hit) ? 1 : 0;
+	}
+	double traceMs
+		= std::chrono::duration<double, std::milli>(Clock::now() - start)
+			  .count();
+
+	std::cout << name << ": " << bvh.TriangleCount() << " triangles, "
+			  << bvh.Tree().NodeCount() << " nodes, build " << serialMs
+			  << " ms (1 thread), " << parallelMs << " ms ("
+			  << pool.Concurrency() << " threads), "
+			  << rayCount / traceMs / 1000.0 << " Mrays/s, " << hits
+			  << " hits" << std::endl;
+}
+
+// Synthetic test mesh: a jittered heightfield grid of about triangleCount
+// triangles
+void MakeBenchmarkMesh(u32 triangleCount, std::vector<glm::vec3> &positions,
+					   std::vector<u32> &indices)
+{
+	u32 side = (u32)sqrt(triangleCount / 2.0) + 1;
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<float> height(-0.5f, 0.5f);
+	positions.clear();
+	indices.clear();
+	for (u32 z = 0; z <= side; z++)
+	{
+		for (u32 x = 0; x <= side; x++)
+		{
+			positions.push_back(glm::vec3((float)x, height(rng), (float)z)
+								* (100.0f / side));
+		}
+	}
+	for (u32 z = 0; z < side; z++)
+	{
+		for (u32 x = 0; x < side; x++)
+		{
+			u32 i = z * (side + 1) + x;
+			indices.insert(indices.end(), { i, i + 1, i + side + 1 });
+			indices.insert(indices.end(),
+						   { i + 1, i + side + 2, i + side + 1 });
+		}
+	}
+}
+
+// Triangle BVHs for the model and a synthetic million triangle mesh, and a
+// scene BVH over 100k object boxes. Results go to stdout.
+void BenchmarkBVH(const Model &model, ThreadPool &pool)
+{
+	std::vector<glm::vec3> positions;
+	std::vector<u32> indices;
+	GatherTriangles(model, positions, indices);
+	BenchmarkTriangleBVH("model", positions, indices, pool);
+	MakeBenchmarkMesh(1000000, positions, indices);
+	BenchmarkTriangleBVH("synthetic", positions, indices, pool);
+
+	using Clock = std::chrono::high_resolution_clock;
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+	std::uniform_real_distribution<float> size(0.5f, 5.0f);
+	std::vector<Bounds> objects(100000);
+	for (Bounds &bounds : objects)
+	{
+		glm::vec3 center(position(rng), position(rng), position(rng));
+		glm::vec3 extent(size(rng), size(rng), size(rng));
+		bounds.aabbMin = center - extent;
+		bounds.aabbMax = center + extent;
+		bounds.sphere = glm::vec4(center, glm::length(extent));
+	}
+	BVH scene;
+	Clock::time_point start = Clock::now();
+	scene.Build(objects, &pool);
+	double buildMs
+		= std::chrono::duration<double, std::milli>(Clock::now() - start)
+			  .count();
+	start = Clock::now();
+	scene.Refit(objects);
+	double refitMs
+		= std::chrono::duration<double, std::milli>(Clock::now() - start)
+			  .count();
+	std::cout << "scene: " << objects.size() << " objects, build " << buildMs
+			  << " ms, refit " << refitMs << " ms" << std::endl;
+}
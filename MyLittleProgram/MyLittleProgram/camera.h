@@ -70,6 +70,15 @@ public:
         return glm::lookAt(wPosition, wPosition + Front, Up);
     }
 
+    // Places the camera directly, for scripted paths rather than input
+    void SetPose(glm::vec3 position, float yaw, float pitch)
+    {
+        wPosition = position;
+        Yaw = yaw;
+        Pitch = pitch;
+        updateCameraVectors();
+    }
+
     // Processes input received from any keyboard-like input system. Accepts input parameter in the form of camera defined ENUM (to abstract it from windowing systems)
     void ProcessKeyboard(Camera_Movement direction, float deltaTime)
     {
@@ -0,0 +1,284 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <vector>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+#include "camera.h"
+#include "types.h"
+
+// "CPTH", then the version, so old files are refused rather than misread
+const u32 CAMERA_PATH_MAGIC = 0x48545043;
+const u32 CAMERA_PATH_VERSION = 1;
+// ten floats and the movement bits
+const u32 CAMERA_FRAME_BYTES = 10 * sizeof(float) + sizeof(u8);
+
+// One frame of a recorded camera path
+struct CameraFrame
+{
+	// the camera after this frame's input
+	glm::vec3 position = glm::vec3(0.0f);
+	float yaw = 0.0f;
+	float pitch = 0.0f;
+	float zoom = 0.0f;
+	// the input, with the frame time it was applied with
+	float deltaTime = 0.0f;
+	u8 moves = 0; // bit per Camera_Movement
+	glm::vec2 mouse = glm::vec2(0.0f);
+	float scroll = 0.0f;
+};
+
+// Captures a Camera and the input driving it, a frame at a time. Feed it the
+// input as the front end applies it to the camera, then EndFrame once the
+// frame's input is in.
+//
+// The file is a header (magic, version, frame count), the camera at Begin,
+// then 41 bytes a frame: position, yaw, pitch, zoom, frame time, mouse
+// offset and scroll as floats, then the movement bits. Everything is in host
+// byte order, so paths only replay on machines of the same endianness.
+class CameraRecorder
+{
+public:
+	CameraRecorder() : m_recording(false) {}
+
+	// Drops any earlier recording
+	void Begin(const Camera &camera);
+	void End() { m_recording = false; }
+	bool IsRecording() const { return m_recording; }
+
+	void AddMove(Camera_Movement direction);
+	void AddMouse(float xoffset, float yoffset);
+	void AddScroll(float yoffset);
+	void EndFrame(const Camera &camera, float deltaTime);
+
+	u32 FrameCount() const { return (u32)m_frames.size(); }
+	bool Save(const char *path) const;
+
+private:
+	bool m_recording;
+	CameraFrame m_start;
+	CameraFrame m_pending;
+	std::vector<CameraFrame> m_frames;
+};
+
+enum CameraReplayMode
+{
+	// Set the recorded camera each frame, exactly as it was
+	CAMERA_REPLAY_STATE,
+	// Drive ProcessKeyboard/ProcessMouseMovement with the recorded input and
+	// frame times instead, which follows changes to the camera code. Mouse
+	// events within a frame were summed, so the pitch clamp can make it
+	// drift from the recording.
+	CAMERA_REPLAY_INPUT
+};
+
+// Plays a recorded path back one recorded frame per rendered frame, whatever
+// the frame actually took, so every replay renders the same frames. The
+// recorded frame time is there for anything else that advances with time.
+class CameraReplayer
+{
+public:
+	CameraReplayer() : m_next(0) {}
+
+	bool Load(const char *path);
+	u32 FrameCount() const { return (u32)m_frames.size(); }
+
+	// Put the camera where the recording began and rewind
+	void Start(Camera &camera);
+	// Apply the next frame, false once there are none left
+	bool Step(Camera &camera, CameraReplayMode mode = CAMERA_REPLAY_STATE);
+	bool Finished() const { return m_next >= m_frames.size(); }
+	// Frame time of the frame the last Step applied
+	float DeltaTime() const;
+
+private:
+	CameraFrame m_start;
+	std::vector<CameraFrame> m_frames;
+	u32 m_next;
+};
+
+// Scripted path: at t in [0, 1) of the way round a circle of radius at
+// height above centre, looking at centre
+void PlaceOnOrbit(Camera &camera, const glm::vec3 &centre, float radius,
+				  float height, float t)
+{
+	const float angle = 2.0f * glm::pi<float>() * t;
+	const glm::vec3 position = centre
+		+ glm::vec3(radius * std::cos(angle), height,
+					radius * std::sin(angle));
+	const glm::vec3 front = glm::normalize(centre - position);
+	camera.SetPose(position, glm::degrees(std::atan2(front.z, front.x)),
+				   glm::degrees(std::asin(front.y)));
+}
+
+CameraFrame CameraState(const Camera &camera)
+{
+	CameraFrame frame;
+	frame.position = camera.wPosition;
+	frame.yaw = camera.Yaw;
+	frame.pitch = camera.Pitch;
+	frame.zoom = camera.Zoom;
+	return frame;
+}
+
+void CameraRecorder::Begin(const Camera &camera)
+{
+	m_frames.clear();
+	m_start = CameraState(camera);
+	m_pending = CameraFrame();
+	m_recording = true;
+}
+
+void CameraRecorder::AddMove(Camera_Movement direction)
+{
+	if (m_recording) m_pending.moves |= 1 << direction;
+}
+
+void CameraRecorder::AddMouse(float xoffset, float yoffset)
+{
+	if (m_recording) m_pending.mouse += glm::vec2(xoffset, yoffset);
+}
+
+void CameraRecorder::AddScroll(float yoffset)
+{
+	if (m_recording) m_pending.scroll += yoffset;
+}
+
+void CameraRecorder::EndFrame(const Camera &camera, float deltaTime)
+{
+	if (!m_recording) return;
+	CameraFrame frame = CameraState(camera);
+	frame.deltaTime = deltaTime;
+	frame.moves = m_pending.moves;
+	frame.mouse = m_pending.mouse;
+	frame.scroll = m_pending.scroll;
+	m_frames.push_back(frame);
+	m_pending = CameraFrame();
+}
+
+void WriteCameraFrame(std::ofstream &out, const CameraFrame &frame)
+{
+	const float values[] = { frame.position.x, frame.position.y,
+							 frame.position.z, frame.yaw, frame.pitch,
+							 frame.zoom, frame.deltaTime, frame.mouse.x,
+							 frame.mouse.y, frame.scroll };
+	out.write((const char *)values, sizeof(values));
+	out.write((const char *)&frame.moves, sizeof(frame.moves));
+}
+
+bool ReadCameraFrame(std::ifstream &in, CameraFrame &frame)
+{
+	float values[10];
+	in.read((char *)values, sizeof(values));
+	in.read((char *)&frame.moves, sizeof(frame.moves));
+	frame.position = glm::vec3(values[0], values[1], values[2]);
+	frame.yaw = values[3];
+	frame.pitch = values[4];
+	frame.zoom = values[5];
+	frame.deltaTime = values[6];
+	frame.mouse = glm::vec2(values[7], values[8]);
+	frame.scroll = values[9];
+	return (bool)in;
+}
+
+bool CameraRecorder::Save(const char *path) const
+{
+	std::ofstream out(path, std::ios::binary);
+	if (!out)
+	{
+		std::cout << "ERROR::CAMERA_PATH::CANNOT_WRITE " << path << std::endl;
+		return false;
+	}
+	const u32 header[] = { CAMERA_PATH_MAGIC, CAMERA_PATH_VERSION,
+						   (u32)m_frames.size() };
+	out.write((const char *)header, sizeof(header));
+	WriteCameraFrame(out, m_start);
+	for (const CameraFrame &frame : m_frames)
+	{
+		WriteCameraFrame(out, frame);
+	}
+	return (bool)out;
+}
+
+bool CameraReplayer::Load(const char *path)
+{
+	m_frames.clear();
+	m_next = 0;
+	std::ifstream in(path, std::ios::binary);
+	u32 header[3] = {};
+	in.read((char *)header, sizeof(header));
+	if (!in || header[0] != CAMERA_PATH_MAGIC
+		|| header[1] != CAMERA_PATH_VERSION)
+	{
+		std::cout << "ERROR::CAMERA_PATH::CANNOT_READ " << path << std::endl;
+		return false;
+	}
+	// the frame count has to fit in what's left of the file, so a corrupt
+	// header can't ask for a huge allocation
+	const std::streamoff start = in.tellg();
+	in.seekg(0, std::ios::end);
+	const std::streamoff remaining = in.tellg() - start;
+	in.seekg(start);
+	if (remaining < ((std::streamoff)header[2] + 1) * CAMERA_FRAME_BYTES)
+	{
+		std::cout << "ERROR::CAMERA_PATH::TRUNCATED " << path << std::endl;
+		return false;
+	}
+	bool ok = ReadCameraFrame(in, m_start);
+	m_frames.resize(header[2]);
+	for (CameraFrame &frame : m_frames)
+	{
+		ok = ok && ReadCameraFrame(in, frame);
+	}
+	if (!ok)
+	{
+		std::cout << "ERROR::CAMERA_PATH::TRUNCATED " << path << std::endl;
+		m_frames.clear();
+		return false;
+	}
+	return true;
+}
+
+void CameraReplayer::Start(Camera &camera)
+{
+	camera.SetPose(m_start.position, m_start.yaw, m_start.pitch);
+	camera.Zoom = m_start.zoom;
+	m_next = 0;
+}
+
+bool CameraReplayer::Step(Camera &camera, CameraReplayMode mode)
+{
+	if (Finished()) return false;
+	const CameraFrame &frame = m_frames[m_next++];
+	if (mode == CAMERA_REPLAY_STATE)
+	{
+		camera.SetPose(frame.position, frame.yaw, frame.pitch);
+		camera.Zoom = frame.zoom;
+		return true;
+	}
+	// in the order the window front end applies them: the mouse events come
+	// in with the previous frame's poll, then processInput's keys
+	if (frame.mouse != glm::vec2())
+	{
+		camera.ProcessMouseMovement(frame.mouse.x, frame.mouse.y);
+	}
+	if (frame.scroll != 0.0f) camera.ProcessMouseScroll(frame.scroll);
+	const Camera_Movement keyOrder[] = { FORWARD, BACKWARD, LEFT, RIGHT,
+										 DOWN, UP };
+	for (Camera_Movement direction : keyOrder)
+	{
+		if (frame.moves & (1 << direction))
+		{
+			camera.ProcessKeyboard(direction, frame.deltaTime);
+		}
+	}
+	return true;
+}
+
+float CameraReplayer::DeltaTime() const
+{
+	return m_next > 0 ? m_frames[m_next - 1].deltaTime : 0.0f;
+}
@@ -0,0 +1,548 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <iostream>
+#include <cmath>
+#include <emmintrin.h>
+
+#include "shader.h"
+#include "lights.h"
+#include "deferred.h"
+#include "types.h"
+
+// Froxel grid, tiles across the screen and exponential depth slices, as in
+// clusteredLights.fs
+const u32 CLUSTER_X = 16;
+const u32 CLUSTER_Y = 9;
+const u32 CLUSTER_Z = 24;
+const u32 CLUSTER_COUNT = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+// Lights kept per cluster, any more are dropped
+const u32 CLUSTER_MAX_LIGHTS = 256;
+// Light indices are 16 bit
+const u32 CLUSTER_MAX_TOTAL_LIGHTS = 65536;
+// RGBA32F texels of light data per light
+const u32 CLUSTER_TEXELS_PER_LIGHT = 4;
+
+static_assert((CLUSTER_X * CLUSTER_Y) % 4 == 0,
+			  "a slice is tested four clusters at a time");
+
+// Clustered forward lighting. The view frustum is split into a grid of
+// froxels, each light is assigned on the CPU to the froxels its bounding
+// sphere touches, and the fragment shader only walks the lights of the
+// froxel it falls in. Unlike deferred shading this keeps the materials and
+// MSAA of forward rendering, and the cost goes with the lights actually
+// reaching each fragment rather than with the total.
+//
+// Froxel boxes are kept in view space, structure-of-arrays, so a light is
+// tested against four froxels of a slice at a time. Lights only visit the
+// slices their depth range covers.
+//
+// Three texture buffers go to the shader: the light data (view space), the
+// light index lists of all clusters back to back, and an offset/count pair
+// per cluster into them.
+class ClusteredLights
+{
+public:
+	ClusteredLights();
+	~ClusteredLights();
+	ClusteredLights(const ClusteredLights &) = delete;
+	ClusteredLights &operator=(const ClusteredLights &) = delete;
+
+	// Rebuild the froxels, when the projection or the viewport changes
+	void SetProjection(const glm::mat4 &projection, float zNear, float zFar,
+					   u32 width, u32 height);
+	// Assign the lights to clusters and upload the result
+	void Build(const glm::mat4 &view, const std::vector<PointLight> &points,
+			   const std::vector<SpotLight> &spots);
+	// Build without SIMD, for reference
+	void BuildScalar(const glm::mat4 &view,
+					 const std::vector<PointLight> &points,
+					 const std::vector<SpotLight> &spots);
+	// Bind the buffers to texture units firstUnit to firstUnit + 2 and set
+	// clusteredLights.fs's uniforms
+	void Bind(Shader &shader, u32 firstUnit) const;
+
+	// lights in range of the view this frame
+	u32 LightCount() const { return (u32)m_bounds.size(); }
+	// light/cluster pairs this frame, and pairs lost to full clusters
+	u32 IndexCount() const { return (u32)m_indices.size(); }
+	u32 Dropped() const { return m_dropped; }
+
+private:
+	void GatherLights(const glm::mat4 &view,
+					  const std::vector<PointLight> &points,
+					  const std::vector<SpotLight> &spots);
+	void AddLight(const glm::vec4 &bounds, const glm::vec3 &position,
+				  const glm::vec3 &direction, const glm::vec3 &colour,
+				  float cosInner, float cosOuter, float constant, float linear,
+				  float quadratic, float range);
+	void SliceRange(const glm::vec4 &sphere, u32 &first, u32 &last) const;
+	void AddToCluster(u32 cluster, u16 light);
+	void Assign();
+	void AssignScalar();
+	void Upload();
+
+	// view space froxel boxes, cluster = x + CLUSTER_X * (y + CLUSTER_Y * z)
+	std::vector<float> m_minX, m_minY, m_minZ;
+	std::vector<float> m_maxX, m_maxY, m_maxZ;
+	float m_zNear, m_zFar;
+	// slice = log(depth) * m_zScale + m_zBias
+	float m_zScale, m_zBias;
+	glm::vec2 m_tileScale;
+
+	// this frame's lights, view space bounding spheres and shader data
+	std::vector<glm::vec4> m_bounds;
+	std::vector<glm::vec4> m_lightData;
+	// fixed size per cluster lists, compacted into m_indices
+	std::vector<u16> m_lists;
+	std::vector<u32> m_counts;
+	std::vector<u16> m_indices;
+	std::vector<u32> m_grid;
+	u32 m_dropped;
+
+	u32 m_lightBuffer, m_indexBuffer, m_gridBuffer;
+	TXO m_lightTexture, m_indexTexture, m_gridTexture;
+};
+
+ClusteredLights::ClusteredLights()
+	: m_minX(CLUSTER_COUNT)
+	, m_minY(CLUSTER_COUNT)
+	, m_minZ(CLUSTER_COUNT)
+	, m_maxX(CLUSTER_COUNT)
+	, m_maxY(CLUSTER_COUNT)
+	, m_maxZ(CLUSTER_COUNT)
+	, m_zNear(0.1f)
+	, m_zFar(100.0f)
+	, m_zScale(0.0f)
+	, m_zBias(0.0f)
+	, m_tileScale(0.0f)
+	, m_lists(CLUSTER_COUNT * CLUSTER_MAX_LIGHTS)
+	, m_counts(CLUSTER_COUNT)
+	, m_grid(CLUSTER_COUNT * 2)
+	, m_dropped(0)
+{
+	glGenBuffers(1, &m_lightBuffer);
+	glGenBuffers(1, &m_indexBuffer);
+	glGenBuffers(1, &m_gridBuffer);
+	glGenTextures(1, &m_lightTexture);
+	glGenTextures(1, &m_indexTexture);
+	glGenTextures(1, &m_gridTexture);
+	// the textures stay attached when the buffers are respecified
+	const u32 buffers[] = { m_lightBuffer, m_indexBuffer, m_gridBuffer };
+	const TXO textures[] = { m_lightTexture, m_indexTexture, m_gridTexture };
+	const GLenum formats[] = { GL_RGBA32F, GL_R16UI, GL_RG32UI };
+	for (u32 i = 0; i < 3; i++)
+	{
+		glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+		glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+		glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+		glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]);
+	}
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+ClusteredLights::~ClusteredLights()
+{
+	glDeleteTextures(1, &m_lightTexture);
+	glDeleteTextures(1, &m_indexTexture);
+	glDeleteTextures(1, &m_gridTexture);
+	glDeleteBuffers(1, &m_lightBuffer);
+	glDeleteBuffers(1, &m_indexBuffer);
+	glDeleteBuffers(1, &m_gridBuffer);
+}
+
+void ClusteredLights::SetProjection(const glm::mat4 &projection, float zNear,
+									float zFar, u32 width, u32 height)
+{
+	m_zNear = zNear;
+	m_zFar = zFar;
+	const float logRange = std::log(zFar / zNear);
+	m_zScale = CLUSTER_Z / logRange;
+	m_zBias = -std::log(zNear) * m_zScale;
+	m_tileScale = glm::vec2((float)CLUSTER_X / std::max(width, 1u),
+							(float)CLUSTER_Y / std::max(height, 1u));
+
+	// directions through the tile corners, scaled to one unit deep
+	const glm::mat4 invProjection = glm::inverse(projection);
+	std::vector<glm::vec3> corners((CLUSTER_X + 1) * (CLUSTER_Y + 1));
+	for (u32 y = 0; y <= CLUSTER_Y; y++)
+	{
+		for (u32 x = 0; x <= CLUSTER_X; x++)
+		{
+			glm::vec4 p = invProjection
+				* glm::vec4(-1.0f + 2.0f * x / CLUSTER_X,
+							-1.0f + 2.0f * y / CLUSTER_Y, -1.0f, 1.0f);
+			glm::vec3 v = glm::vec3(p) / p.w;
+			corners[y * (CLUSTER_X + 1) + x] = v / -v.z;
+		}
+	}
+	for (u32 z = 0; z < CLUSTER_Z; z++)
+	{
+		const float nearDepth
+			= zNear * std::pow(zFar / zNear, (float)z / CLUSTER_Z);
+		const float farDepth
+			= zNear * std::pow(zFar / zNear, (float)(z + 1) / CLUSTER_Z);
+		for (u32 y = 0; y < CLUSTER_Y; y++)
+		{
+			for (u32 x = 0; x < CLUSTER_X; x++)
+			{
+				glm::vec3 boxMin(1.0e30f), boxMax(-1.0e30f);
+				for (u32 c = 0; c < 4; c++)
+				{
+					const glm::vec3 &dir
+						= corners[(y + c / 2) * (CLUSTER_X + 1) + x + c % 2];
+					for (float depth : { nearDepth, farDepth })
+					{
+						boxMin = glm::min(boxMin, dir * depth);
+						boxMax = glm::max(boxMax, dir * depth);
+					}
+				}
+				const u32 cluster = x + CLUSTER_X * (y + CLUSTER_Y * z);
+				m_minX[cluster] = boxMin.x;
+				m_minY[cluster] = boxMin.y;
+				m_minZ[cluster] = boxMin.z;
+				m_maxX[cluster] = boxMax.x;
+				m_maxY[cluster] = boxMax.y;
+				m_maxZ[cluster] = boxMax.z;
+			}
+		}
+	}
+}
+
+void ClusteredLights::AddLight(const glm::vec4 &bounds,
+							   const glm::vec3 &position,
+							   const glm::vec3 &direction,
+							   const glm::vec3 &colour, float cosInner,
+							   float cosOuter, float constant, float linear,
+							   float quadratic, float range)
+{
+	// nothing to light outside the depth range
+	if (-bounds.z + bounds.w < m_zNear || -bounds.z - bounds.w > m_zFar)
+		return;
+	if (m_bounds.size() == CLUSTER_MAX_TOTAL_LIGHTS)
+	{
+		m_dropped++;
+		return;
+	}
+	m_bounds.push_back(bounds);
+	m_lightData.push_back(glm::vec4(position, range));
+	m_lightData.push_back(glm::vec4(colour, cosInner));
+	m_lightData.push_back(glm::vec4(constant, linear, quadratic, cosOuter));
+	m_lightData.push_back(glm::vec4(direction, 0.0f));
+}
+
+void ClusteredLights::GatherLights(const glm::mat4 &view,
+								   const std::vector<PointLight> &points,
+								   const std::vector<SpotLight> &spots)
+{
+	m_bounds.clear();
+	m_lightData.clear();
+	m_dropped = 0;
+	for (const PointLight &light : points)
+	{
+		const glm::vec3 position = glm::vec3(view
+											 * glm::vec4(light.position, 1.0f));
+		const float radius = PointLightRadius(light);
+		// a point light is a spot light whose cone never cuts it off
+		AddLight(glm::vec4(position, radius), position,
+				 glm::vec3(0.0f, 0.0f, -1.0f), light.colour, -1.0f, -2.0f,
+				 light.constant, light.linear, light.quadratic, radius);
+	}
+	for (const SpotLight &light : spots)
+	{
+		const glm::vec4 sphere = SpotLightBounds(light);
+		const glm::vec3 centre = glm::vec3(view * glm::vec4(glm::vec3(sphere),
+															1.0f));
+		AddLight(glm::vec4(centre, sphere.w),
+				 glm::vec3(view * glm::vec4(light.position, 1.0f)),
+				 glm::normalize(glm::mat3(view) * light.direction),
+				 light.colour, light.innerCutOff, light.outerCutOff,
+				 light.constant, light.linear, light.quadratic,
+				 AttenuationRadius(light.colour, light.constant, light.linear,
+								   light.quadratic));
+	}
+}
+
+void ClusteredLights::SliceRange(const glm::vec4 &sphere, u32 &first,
+								 u32 &last) const
+{
+	const float nearDepth = std::max(-sphere.z - sphere.w, m_zNear);
+	const float farDepth = std::min(-sphere.z + sphere.w, m_zFar);
+	const float maxSlice = (float)(CLUSTER_Z - 1);
+	first = (u32)std::min(
+		std::max(std::log(nearDepth) * m_zScale + m_zBias, 0.0f), maxSlice);
+	last = (u32)std::min(
+		std::max(std::log(farDepth) * m_zScale + m_zBias, 0.0f), maxSlice);
+}
+
+void ClusteredLights::AddToCluster(u32 cluster, u16 light)
+{
+	u32 &count = m_counts[cluster];
+	if (count < CLUSTER_MAX_LIGHTS)
+	{
+		m_lists[cluster * CLUSTER_MAX_LIGHTS + count++] = light;
+	}
+	else
+	{
+		m_dropped++;
+	}
+}
+
+void ClusteredLights::Assign()
+{
+	std::fill(m_counts.begin(), m_counts.end(), 0u);
+	const u32 sliceSize = CLUSTER_X * CLUSTER_Y;
+	const __m128 zero = _mm_setzero_ps();
+	for (u32 light = 0; light < (u32)m_bounds.size(); light++)
+	{
+		const glm::vec4 &sphere = m_bounds[light];
+		u32 firstSlice, lastSlice;
+		SliceRange(sphere, firstSlice, lastSlice);
+		const __m128 cx = _mm_set1_ps(sphere.x);
+		const __m128 cy = _mm_set1_ps(sphere.y);
+		const __m128 cz = _mm_set1_ps(sphere.z);
+		const __m128 r2 = _mm_set1_ps(sphere.w * sphere.w);
+		for (u32 i = firstSlice * sliceSize; i < (lastSlice + 1) * sliceSize;
+			 i += 4)
+		{
+			// squared distance from the centre to the box, per axis the
+			// distance outside [min, max] or zero
+			__m128 dx = _mm_max_ps(
+				_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&m_minX[i]), cx),
+						   _mm_sub_ps(cx, _mm_loadu_ps(&m_maxX[i]))),
+				zero);
+			__m128 dy = _mm_max_ps(
+				_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&m_minY[i]), cy),
+						   _mm_sub_ps(cy, _mm_loadu_ps(&m_maxY[i]))),
+				zero);
+			__m128 dz = _mm_max_ps(
+				_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&m_minZ[i]), cz),
+						   _mm_sub_ps(cz, _mm_loadu_ps(&m_maxZ[i]))),
+				zero);
+			__m128 d2 = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)),
+				_mm_mul_ps(dz, dz));
+			int mask = _mm_movemask_ps(_mm_cmple_ps(d2, r2));
+			for (u32 lane = 0; mask != 0; lane++, mask >>= 1)
+			{
+				if (mask & 1) AddToCluster(i + lane, (u16)light);
+			}
+		}
+	}
+}
+
+void ClusteredLights::AssignScalar()
+{
+	std::fill(m_counts.begin(), m_counts.end(), 0u);
+	const u32 sliceSize = CLUSTER_X * CLUSTER_Y;
+	for (u32 light = 0; light < (u32)m_bounds.size(); light++)
+	{
+		const glm::vec4 &s = m_bounds[light];
+		u32 firstSlice, lastSlice;
+		SliceRange(s, firstSlice, lastSlice);
+		for (u32 i = firstSlice * sliceSize; i < (lastSlice + 1) * sliceSize;
+			 i++)
+		{
+			float dx = std::max(std::max(m_minX[i] - s.x, s.x - m_maxX[i]),
+								0.0f);
+			float dy = std::max(std::max(m_minY[i] - s.y, s.y - m_maxY[i]),
+								0.0f);
+			float dz = std::max(std::max(m_minZ[i] - s.z, s.z - m_maxZ[i]),
+								0.0f);
+			if (dx * dx + dy * dy + dz * dz <= s.w * s.w)
+			{
+				AddToCluster(i, (u16)light);
+			}
+		}
+	}
+}
+
+void ClusteredLights::Upload()
+{
+	m_indices.clear();
+	for (u32 cluster = 0; cluster < CLUSTER_COUNT; cluster++)
+	{
+		const u16 *list = &m_lists[cluster * CLUSTER_MAX_LIGHTS];
+		m_grid[cluster * 2] = (u32)m_indices.size();
+		m_grid[cluster * 2 + 1] = m_counts[cluster];
+		m_indices.insert(m_indices.end(), list, list + m_counts[cluster]);
+	}
+
+	// orphaned every frame, the old contents may still be in use. Buffers
+	// are never left empty, a texture over no storage is incomplete.
+	auto upload = [](u32 buffer, const void *data, size_t size) {
+		static const u32 zeros[4] = {};
+		glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+		if (size == 0)
+			glBufferData(GL_TEXTURE_BUFFER, sizeof(zeros), zeros,
+						 GL_STREAM_DRAW);
+		else
+			glBufferData(GL_TEXTURE_BUFFER, size, data, GL_STREAM_DRAW);
+	};
+	upload(m_lightBuffer, m_lightData.data(),
+		   m_lightData.size() * sizeof(glm::vec4));
+	upload(m_indexBuffer, m_indices.data(), m_indices.size() * sizeof(u16));
+	upload(m_gridBuffer, m_grid.data(), m_grid.size() * sizeof(u32));
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void ClusteredLights::Build(const glm::mat4 &view,
+							const std::vector<PointLight> &points,
+							const std::vector<SpotLight> &spots)
+{
+	GatherLights(view, points, spots);
+	Assign();
+	Upload();
+}
+
+void ClusteredLights::BuildScalar(const glm::mat4 &view,
+								  const std::vector<PointLight> &points,
+								  const std::vector<SpotLight> &spots)
+{
+	GatherLights(view, points, spots);
+	AssignScalar();
+	Upload();
+}
+
+void ClusteredLights::Bind(Shader &shader, u32 firstUnit) const
+{
+	const TXO textures[] = { m_lightTexture, m_indexTexture, m_gridTexture };
+	for (u32 i = 0; i < 3; i++)
+	{
+		glActiveTexture(GL_TEXTURE0 + firstUnit + i);
+		glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+	}
+	glActiveTexture(GL_TEXTURE0);
+	shader.use();
+	shader.setInt("lightData", firstUnit);
+	shader.setInt("lightIndices", firstUnit + 1);
+	shader.setInt("lightGrid", firstUnit + 2);
+	shader.setInt("lightCount", (int)m_bounds.size());
+	shader.setFloat("zScale", m_zScale);
+	shader.setFloat("zBias", m_zBias);
+	shader.setVec2("tileScale", m_tileScale);
+}
+
+// Every light for every fragment against clustered lighting of
+// LightingBenchmarkScene, 256 to 4096 lights (a quarter of them spot lights),
+// with the CPU time of building the clusters scalar and with SIMD. Results
+// go to stdout.
+void BenchmarkClustered(u32 width, u32 height, u32 layerCount = 8)
+{
+	using Clock = std::chrono::high_resolution_clock;
+	const u32 lightCounts[] = { 256, 1024, 4096 };
+	const u32 buildIterations = 20;
+
+	LightingBenchmarkScene scene(width, height, layerCount);
+	const glm::mat4 &view = scene.View();
+	Shader shader("shaders/deferredGeometry.vs", "shaders/clusteredLights.fs");
+	scene.Prepare(shader);
+	shader.setVec3("dirLight.vDirection",
+				   glm::mat3(view) * glm::vec3(-0.2f, -1.0f, -0.3f));
+	shader.setVec3("dirLight.ambient", glm::vec3(0.05f));
+	shader.setVec3("dirLight.diffuse", glm::vec3(0.2f));
+	shader.setVec3("dirLight.specular", glm::vec3(0.2f));
+	ClusteredLights clusters;
+	// same near and far as the scene's projection
+	clusters.SetProjection(scene.Projection(), 0.1f, 100.0f, width, height);
+
+	u32 fbo, colour, depth;
+	glGenFramebuffers(1, &fbo);
+	glGenTextures(1, &colour);
+	glBindTexture(GL_TEXTURE_2D, colour);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R11F_G11F_B10F, width, height, 0, GL_RGB,
+				 GL_FLOAT, NULL);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glGenRenderbuffers(1, &depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+						   colour, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+							  GL_RENDERBUFFER, depth);
+	u32 timer;
+	glGenQueries(1, &timer);
+
+	std::mt19937 rng(42);
+	std::cout << "lights\tbrute force (ms)\tclustered (ms)\tbuild scalar (ms)"
+			  << "\tbuild SIMD (ms)\tper cluster" << std::endl;
+	for (u32 lightCount : lightCounts)
+	{
+		// dimmer lights with a shorter reach, so more of them still makes a
+		// sensible scene
+		std::vector<PointLight> points = scene.MakeLights(lightCount, rng);
+		std::vector<SpotLight> spots;
+		for (PointLight &light : points)
+		{
+			light.linear = 0.7f;
+			light.quadratic = 2.8f;
+		}
+		for (u32 i = 0; i < lightCount / 4; i++)
+		{
+			const PointLight &light = points.back();
+			SpotLight spot;
+			spot.position = light.position + glm::vec3(0.0f, 1.0f, 0.0f);
+			spot.direction = glm::vec3(0.0f, -1.0f, 0.2f);
+			spot.colour = light.colour;
+			spot.linear = light.linear;
+			spot.quadratic = light.quadratic;
+			spots.push_back(spot);
+			points.pop_back();
+		}
+
+		Clock::time_point start = Clock::now();
+		for (u32 i = 0; i < buildIterations; i++)
+		{
+			clusters.BuildScalar(view, points, spots);
+		}
+		double scalarMs
+			= std::chrono::duration<double, std::milli>(Clock::now() - start)
+				  .count()
+			/ buildIterations;
+		start = Clock::now();
+		for (u32 i = 0; i < buildIterations; i++)
+		{
+			clusters.Build(view, points, spots);
+		}
+		double simdMs
+			= std::chrono::duration<double, std::milli>(Clock::now() - start)
+				  .count()
+			/ buildIterations;
+
+		auto drawWith = [&](bool bruteForce) {
+			return TimeGpuFrames(timer, [&]() {
+				glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+				glViewport(0, 0, width, height);
+				glEnable(GL_DEPTH_TEST);
+				glDepthFunc(GL_LESS);
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				clusters.Bind(shader, 2);
+				shader.setBool("bruteForce", bruteForce);
+				scene.Draw(shader);
+			});
+		};
+		double bruteMs = drawWith(true);
+		double clusteredMs = drawWith(false);
+		std::cout << lightCount << "\t" << bruteMs << "\t\t\t" << clusteredMs
+				  << "\t\t" << scalarMs << "\t\t\t" << simdMs << "\t\t"
+				  << (float)clusters.IndexCount() / CLUSTER_COUNT;
+		if (clusters.Dropped())
+			std::cout << " (" << clusters.Dropped() << " dropped)";
+		std::cout << std::endl;
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteQueries(1, &timer);
+	glDeleteFramebuffers(1, &fbo);
+	glDeleteTextures(1, &colour);
+	glDeleteRenderbuffers(1, &depth);
+	glDeleteProgram(shader.m_programId);
+}
@@ -0,0 +1,302 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <iostream>
+#include <cmath>
+
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "frustum.h"
+#include "bounds.h"
+#include "types.h"
+
+// Objects tested per SIMD iteration, 8 with AVX and 4 with SSE. The arrays
+// are padded for the wider one.
+const u32 CULL_SIMD_WIDTH = 8;
+
+// The 8-wide loop is compiled for AVX whatever the build targets, and only
+// called when the CPU has it. MSVC allows AVX intrinsics without /arch.
+#if defined(_MSC_VER)
+#define CULL_TARGET_AVX
+#else
+#define CULL_TARGET_AVX __attribute__((target("avx")))
+#endif
+
+// Whether the CPU and OS support AVX, checked once
+bool CpuHasAvx()
+{
+#if defined(_MSC_VER)
+	static const bool hasAvx = [] {
+		int info[4];
+		__cpuid(info, 1);
+		// AVX, and OSXSAVE so the OS can be asked whether it saves YMM state
+		const bool cpu = (info[2] & (1 << 28)) && (info[2] & (1 << 27));
+		return cpu && (_xgetbv(0) & 6) == 6;
+	}();
+#else
+	static const bool hasAvx = __builtin_cpu_supports("avx");
+#endif
+	return hasAvx;
+}
+
+// Scene-level frustum culling. World space boxes are kept as centre/extent in
+// structure-of-arrays form so one iteration tests SimdWidth() objects
+// against a plane with a handful of vector instructions.
+class CullingSystem
+{
+public:
+	CullingSystem() : m_count(0) {}
+
+	u32 Add(const Bounds &worldBounds);
+	void Set(u32 object, const Bounds &worldBounds);
+	void Clear();
+	u32 Count() const { return m_count; }
+
+	// Fill visible with the indices of the objects that intersect frustum
+	void Cull(const Frustum &frustum, std::vector<u32> &visible) const;
+	// Plain one-object-at-a-time version of Cull, for reference
+	void CullScalar(const Frustum &frustum, std::vector<u32> &visible) const;
+	// Objects Cull tests per iteration on this CPU
+	static u32 SimdWidth() { return CpuHasAvx() ? 8 : 4; }
+
+private:
+	CULL_TARGET_AVX void CullAvx(const Frustum &frustum,
+								 std::vector<u32> &visible) const;
+	void CullSse(const Frustum &frustum, std::vector<u32> &visible) const;
+
+	// arrays are padded to a multiple of CULL_SIMD_WIDTH
+	std::vector<float> m_centerX, m_centerY, m_centerZ;
+	std::vector<float> m_extentX, m_extentY, m_extentZ;
+	u32 m_count;
+};
+
+u32 CullingSystem::Add(const Bounds &worldBounds)
+{
+	u32 object = m_count++;
+	u32 padded = (m_count + CULL_SIMD_WIDTH - 1) / CULL_SIMD_WIDTH
+		* CULL_SIMD_WIDTH;
+	if (padded > m_centerX.size())
+	{
+		m_centerX.resize(padded, 0.0f);
+		m_centerY.resize(padded, 0.0f);
+		m_centerZ.resize(padded, 0.0f);
+		m_extentX.resize(padded, 0.0f);
+		m_extentY.resize(padded, 0.0f);
+		m_extentZ.resize(padded, 0.0f);
+	}
+	Set(object, worldBounds);
+	return object;
+}
+
+void CullingSystem::Set(u32 object, const Bounds &worldBounds)
+{
+	glm::vec3 center = (worldBounds.aabbMin + worldBounds.aabbMax) * 0.5f;
+	glm::vec3 extent = (worldBounds.aabbMax - worldBounds.aabbMin) * 0.5f;
+	m_centerX[object] = center.x;
+	m_centerY[object] = center.y;
+	m_centerZ[object] = center.z;
+	m_extentX[object] = extent.x;
+	m_extentY[object] = extent.y;
+	m_extentZ[object] = extent.z;
+}
+
+void CullingSystem::Clear()
+{
+	m_count = 0;
+	m_centerX.clear();
+	m_centerY.clear();
+	m_centerZ.clear();
+	m_extentX.clear();
+	m_extentY.clear();
+	m_extentZ.clear();
+}
+
+void CullingSystem::Cull(const Frustum &frustum,
+						 std::vector<u32> &visible) const
+{
+	visible.clear();
+	if (CpuHasAvx())
+		CullAvx(frustum, visible);
+	else
+		CullSse(frustum, visible);
+}
+
+// A box is outside a plane when its centre is further behind it than the
+// box's projected radius: dot(n, c) + d < -dot(|n|, e)
+CULL_TARGET_AVX void CullingSystem::CullAvx(const Frustum &frustum,
+											std::vector<u32> &visible) const
+{
+	__m256 nx[6], ny[6], nz[6], nd[6], ax[6], ay[6], az[6];
+	const __m256 signMask = _mm256_set1_ps(-0.0f);
+	for (int p = 0; p < 6; p++)
+	{
+		const glm::vec4 &plane = frustum.planes[p];
+		nx[p] = _mm256_set1_ps(plane.x);
+		ny[p] = _mm256_set1_ps(plane.y);
+		nz[p] = _mm256_set1_ps(plane.z);
+		nd[p] = _mm256_set1_ps(plane.w);
+		ax[p] = _mm256_andnot_ps(signMask, nx[p]);
+		ay[p] = _mm256_andnot_ps(signMask, ny[p]);
+		az[p] = _mm256_andnot_ps(signMask, nz[p]);
+	}
+	const __m256 zero = _mm256_setzero_ps();
+	for (u32 i = 0; i < m_count; i += 8)
+	{
+		__m256 cx = _mm256_loadu_ps(&m_centerX[i]);
+		__m256 cy = _mm256_loadu_ps(&m_centerY[i]);
+		__m256 cz = _mm256_loadu_ps(&m_centerZ[i]);
+		__m256 ex = _mm256_loadu_ps(&m_extentX[i]);
+		__m256 ey = _mm256_loadu_ps(&m_extentY[i]);
+		__m256 ez = _mm256_loadu_ps(&m_extentZ[i]);
+
+		__m256 outside = zero;
+		for (int p = 0; p < 6; p++)
+		{
+			__m256 dist = _mm256_add_ps(
+				_mm256_add_ps(_mm256_mul_ps(nx[p], cx), _mm256_mul_ps(ny[p], cy)),
+				_mm256_add_ps(_mm256_mul_ps(nz[p], cz), nd[p]));
+			__m256 radius = _mm256_add_ps(
+				_mm256_add_ps(_mm256_mul_ps(ax[p], ex), _mm256_mul_ps(ay[p], ey)),
+				_mm256_mul_ps(az[p], ez));
+			outside = _mm256_or_ps(
+				outside, _mm256_cmp_ps(_mm256_add_ps(dist, radius), zero,
+									   _CMP_LT_OQ));
+		}
+		int mask = ~_mm256_movemask_ps(outside) & 0xFF;
+		// append survivors, skipping the padding past m_count
+		for (u32 lane = 0; mask != 0; lane++, mask >>= 1)
+		{
+			if ((mask & 1) && i + lane < m_count) visible.push_back(i + lane);
+		}
+	}
+}
+
+void CullingSystem::CullSse(const Frustum &frustum,
+							std::vector<u32> &visible) const
+{
+	__m128 nx[6], ny[6], nz[6], nd[6], ax[6], ay[6], az[6];
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	for (int p = 0; p < 6; p++)
+	{
+		const glm::vec4 &plane = frustum.planes[p];
+		nx[p] = _mm_set1_ps(plane.x);
+		ny[p] = _mm_set1_ps(plane.y);
+		nz[p] = _mm_set1_ps(plane.z);
+		nd[p] = _mm_set1_ps(plane.w);
+		ax[p] = _mm_andnot_ps(signMask, nx[p]);
+		ay[p] = _mm_andnot_ps(signMask, ny[p]);
+		az[p] = _mm_andnot_ps(signMask, nz[p]);
+	}
+	const __m128 zero = _mm_setzero_ps();
+	for (u32 i = 0; i < m_count; i += 4)
+	{
+		__m128 cx = _mm_loadu_ps(&m_centerX[i]);
+		__m128 cy = _mm_loadu_ps(&m_centerY[i]);
+		__m128 cz = _mm_loadu_ps(&m_centerZ[i]);
+		__m128 ex = _mm_loadu_ps(&m_extentX[i]);
+		__m128 ey = _mm_loadu_ps(&m_extentY[i]);
+		__m128 ez = _mm_loadu_ps(&m_extentZ[i]);
+
+		__m128 outside = zero;
+		for (int p = 0; p < 6; p++)
+		{
+			__m128 dist = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(nx[p], cx), _mm_mul_ps(ny[p], cy)),
+				_mm_add_ps(_mm_mul_ps(nz[p], cz), nd[p]));
+			__m128 radius = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(ax[p], ex), _mm_mul_ps(ay[p], ey)),
+				_mm_mul_ps(az[p], ez));
+			outside = _mm_or_ps(outside,
+								_mm_cmplt_ps(_mm_add_ps(dist, radius), zero));
+		}
+		int mask = ~_mm_movemask_ps(outside) & 0xF;
+		// append survivors, skipping the padding past m_count
+		for (u32 lane = 0; mask != 0; lane++, mask >>= 1)
+		{
+			if ((mask & 1) && i + lane < m_count) visible.push_back(i + lane);
+		}
+	}
+}
+
+void CullingSystem::CullScalar(const Frustum &frustum,
+							   std::vector<u32> &visible) const
+{
+	visible.clear();
+	for (u32 i = 0; i < m_count; i++)
+	{
+		bool inside = true;
+		for (const glm::vec4 &plane : frustum.planes)
+		{
+			float dist = plane.x * m_centerX[i] + plane.y * m_centerY[i]
+				+ plane.z * m_centerZ[i] + plane.w;
+			float radius = fabs(plane.x) * m_extentX[i]
+				+ fabs(plane.y) * m_extentY[i] + fabs(plane.z) * m_extentZ[i];
+			if (dist + radius < 0.0f)
+			{
+				inside = false;
+				break;
+			}
+		}
+		if (inside) visible.push_back(i);
+	}
+}
+
+// Time scalar and SIMD culling of objectCount random boxes. Results go to
+// stdout.
+void BenchmarkCulling(u32 objectCount = 100000)
+{
+	using Clock = std::chrono::high_resolution_clock;
+	const u32 iterations = 100;
+
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+	std::uniform_real_distribution<float> size(0.5f, 5.0f);
+	CullingSystem culling;
+	for (u32 i = 0; i < objectCount; i++)
+	{
+		Bounds bounds;
+		glm::vec3 center(position(rng), position(rng), position(rng));
+		glm::vec3 extent(size(rng), size(rng), size(rng));
+		bounds.aabbMin = center - extent;
+		bounds.aabbMax = center + extent;
+		bounds.sphere = glm::vec4(center, glm::length(extent));
+		culling.Add(bounds);
+	}
+	glm::mat4 viewProj
+		= glm::perspective(glm::radians(55.0f), 16.0f / 9.0f, 0.1f, 400.0f)
+		* glm::lookAt(glm::vec3(0.0f), glm::vec3(1.0f, 0.2f, -1.0f),
+					  glm::vec3(0.0f, 1.0f, 0.0f));
+	Frustum frustum = ExtractFrustum(viewProj);
+
+	std::vector<u32> visibleScalar, visibleSimd;
+	Clock::time_point start = Clock::now();
+	for (u32 i = 0; i < iterations; i++)
+	{
+		culling.CullScalar(frustum, visibleScalar);
+	}
+	double scalarMs
+		= std::chrono::duration<double, std::milli>(Clock::now() - start)
+			  .count()
+		/ iterations;
+	start = Clock::now();
+	for (u32 i = 0; i < iterations; i++)
+	{
+		culling.Cull(frustum, visibleSimd);
+	}
+	double simdMs
+		= std::chrono::duration<double, std::milli>(Clock::now() - start)
+			  .count()
+		/ iterations;
+
+	std::cout << "culling " << objectCount << " objects: scalar " << scalarMs
+			  << " ms, " << CullingSystem::SimdWidth() << "-wide SIMD " << simdMs
+			  << " ms, visible " << visibleSimd.size() << " (scalar "
+			  << visibleScalar.size() << ")" << std::endl;
+}
@@ -0,0 +1,653 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <random>
+#include <iostream>
+
+#include "shader.h"
+#include "mesh.h"
+#include "lights.h"
+#include "ringbuffer.h"
+#include "renderqueue.h"
+#include "bvh.h"
+#include "types.h"
+
+// Times the unit octahedron is split to make the light volume sphere
+const u32 DEFERRED_SPHERE_SUBDIVISIONS = 2;
+// Point lights the forward path of the benchmark can take, as in
+// forwardLights.fs
+const u32 MAX_FORWARD_LIGHTS = 256;
+
+// Deferred shading. Opaque geometry is drawn once into a G-buffer, then each
+// light only shades the pixels inside its volume, so the lighting cost goes
+// with the lit pixels rather than overdraw times lights.
+//
+// G-buffer, 8 bytes a pixel plus depth:
+//   0  RGBA8     albedo, specular intensity
+//   1  RGB10_A2  octahedral view space normal, shininess / 256
+//      D24S8     depth, view space positions are rebuilt from it
+// Light accumulation is R11F_G11F_B10F, half the size of RGBA16F.
+//
+// Point lights are drawn as instanced spheres with front faces culled and
+// a GEQUAL depth test against a copy of the G-buffer depth: a pixel is lit
+// if its surface is in front of the back of the volume, which also works
+// with the camera inside it. Pixels in front of the volume are rejected in
+// the shader by distance.
+class DeferredRenderer
+{
+public:
+	DeferredRenderer();
+	~DeferredRenderer();
+	DeferredRenderer(const DeferredRenderer &) = delete;
+	DeferredRenderer &operator=(const DeferredRenderer &) = delete;
+
+	void Resize(u32 width, u32 height);
+
+	// Bind and clear the G-buffer. Draw the opaque geometry after this with
+	// a shader writing gbuffer.fs's outputs, e.g. deferredGeometry.vs +
+	// gbuffer.fs.
+	void BeginGeometry();
+	// Light the G-buffer: ambient and the directional light over everything
+	// that was drawn, then each point light over its volume. Changes the
+	// framebuffer binding, viewport, program and depth, blend and cull state,
+	// leaving depth test on and blending and face culling off.
+	void Light(const DirectionalLight &sun, const std::vector<PointLight> &lights,
+			   const glm::mat4 &view, const glm::mat4 &projection,
+			   VAO emptyVAO);
+
+	// The lit result, and a framebuffer with it and the scene depth to draw
+	// forward passes (sky, translucent) on top
+	TXO Output() const { return m_lightTexture; }
+	u32 OutputFramebuffer() const { return m_lightFramebuffer; }
+	u32 Width() const { return m_width; }
+	u32 Height() const { return m_height; }
+
+private:
+	void CreateSphere();
+	void FreeTargets();
+
+	std::unique_ptr<Shader> m_directionalShader;
+	std::unique_ptr<Shader> m_pointShader;
+	u32 m_gBuffer;
+	TXO m_albedoSpec;
+	TXO m_normalShininess;
+	TXO m_depth;
+	u32 m_lightFramebuffer;
+	TXO m_lightTexture;
+	u32 m_lightDepth;
+	u32 m_width, m_height;
+	// light volumes
+	VAO m_sphereVAO;
+	VBO m_sphereVBO;
+	EBO m_sphereEBO;
+	VBO m_instanceVBO;
+	u32 m_sphereIndexCount;
+	std::vector<float> m_instanceData;
+};
+
+DeferredRenderer::DeferredRenderer()
+	: m_albedoSpec(0)
+	, m_normalShininess(0)
+	, m_depth(0)
+	, m_lightTexture(0)
+	, m_lightDepth(0)
+	, m_width(0)
+	, m_height(0)
+{
+	m_directionalShader.reset(new Shader("shaders/fullScreenTriangle.vs",
+										 "shaders/deferredDirectional.fs"));
+	m_pointShader.reset(new Shader("shaders/deferredLightVolume.vs",
+								   "shaders/deferredPointLight.fs"));
+	for (Shader *shader : { m_directionalShader.get(), m_pointShader.get() })
+	{
+		shader->use();
+		shader->setInt("gAlbedoSpec", 0);
+		shader->setInt("gNormalShininess", 1);
+		shader->setInt("gDepth", 2);
+	}
+	glGenFramebuffers(1, &m_gBuffer);
+	glGenFramebuffers(1, &m_lightFramebuffer);
+	CreateSphere();
+}
+
+DeferredRenderer::~DeferredRenderer()
+{
+	FreeTargets();
+	glDeleteFramebuffers(1, &m_gBuffer);
+	glDeleteFramebuffers(1, &m_lightFramebuffer);
+	glDeleteVertexArrays(1, &m_sphereVAO);
+	glDeleteBuffers(1, &m_sphereVBO);
+	glDeleteBuffers(1, &m_sphereEBO);
+	glDeleteBuffers(1, &m_instanceVBO);
+	glDeleteProgram(m_directionalShader->m_programId);
+	glDeleteProgram(m_pointShader->m_programId);
+}
+
+void DeferredRenderer::CreateSphere()
+{
+	// subdivided octahedron, pushed out onto the unit sphere
+	std::vector<glm::vec3> positions = {
+		glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0),
+		glm::vec3(0, -1, 0), glm::vec3(0, 0, 1), glm::vec3(0, 0, -1)
+	};
+	std::vector<u32> indices = { 0, 2, 4, 2, 1, 4, 1, 3, 4, 3, 0, 4,
+								 2, 0, 5, 1, 2, 5, 3, 1, 5, 0, 3, 5 };
+	for (u32 level = 0; level < DEFERRED_SPHERE_SUBDIVISIONS; level++)
+	{
+		std::vector<u32> split;
+		for (size_t t = 0; t < indices.size(); t += 3)
+		{
+			u32 corner[3] = { indices[t], indices[t + 1], indices[t + 2] };
+			u32 mid[3];
+			for (u32 e = 0; e < 3; e++)
+			{
+				// shared edges get duplicate vertices, it doesn't matter for
+				// a volume
+				mid[e] = (u32)positions.size();
+				positions.push_back(glm::normalize(
+					positions[corner[e]] + positions[corner[(e + 1) % 3]]));
+			}
+			split.insert(split.end(), { corner[0], mid[0], mid[2] });
+			split.insert(split.end(), { mid[0], corner[1], mid[1] });
+			split.insert(split.end(), { mid[2], mid[1], corner[2] });
+			split.insert(split.end(), { mid[0], mid[1], mid[2] });
+		}
+		indices.swap(split);
+	}
+	// the faces cut inside the sphere, scale it out until the closest face
+	// touches it
+	float closest = 1.0f;
+	for (size_t t = 0; t < indices.size(); t += 3)
+	{
+		const glm::vec3 &a = positions[indices[t]];
+		glm::vec3 n = glm::normalize(glm::cross(positions[indices[t + 1]] - a,
+												positions[indices[t + 2]] - a));
+		closest = std::min(closest, std::abs(glm::dot(n, a)));
+	}
+	for (glm::vec3 &p : positions)
+	{
+		p /= closest;
+	}
+	m_sphereIndexCount = (u32)indices.size();
+
+	glGenVertexArrays(1, &m_sphereVAO);
+	glGenBuffers(1, &m_sphereVBO);
+	glGenBuffers(1, &m_sphereEBO);
+	glGenBuffers(1, &m_instanceVBO);
+	glBindVertexArray(m_sphereVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, m_sphereVBO);
+	glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3),
+				 positions.data(), GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3),
+						  (void *)0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_sphereEBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(u32),
+				 indices.data(), GL_STATIC_DRAW);
+	// per light: position and radius, colour, attenuation
+	const GLsizei stride = 10 * sizeof(float);
+	glBindBuffer(GL_ARRAY_BUFFER, m_instanceVBO);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, stride, (void *)0);
+	glVertexAttribDivisor(1, 1);
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride,
+						  (void *)(4 * sizeof(float)));
+	glVertexAttribDivisor(2, 1);
+	glEnableVertexAttribArray(3);
+	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, stride,
+						  (void *)(7 * sizeof(float)));
+	glVertexAttribDivisor(3, 1);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void DeferredRenderer::FreeTargets()
+{
+	glDeleteTextures(1, &m_albedoSpec);
+	glDeleteTextures(1, &m_normalShininess);
+	glDeleteTextures(1, &m_depth);
+	glDeleteTextures(1, &m_lightTexture);
+	glDeleteRenderbuffers(1, &m_lightDepth);
+	m_albedoSpec = m_normalShininess = m_depth = m_lightTexture = 0;
+	m_lightDepth = 0;
+}
+
+void DeferredRenderer::Resize(u32 width, u32 height)
+{
+	if (width == m_width && height == m_height) return;
+	FreeTargets();
+	m_width = width;
+	m_height = height;
+
+	auto makeTexture = [width, height](GLenum internalFormat, GLenum format,
+									   GLenum type) {
+		TXO texture;
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0,
+					 format, type, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		return texture;
+	};
+	m_albedoSpec = makeTexture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+	m_normalShininess = makeTexture(GL_RGB10_A2, GL_RGBA,
+									GL_UNSIGNED_INT_2_10_10_10_REV);
+	m_depth = makeTexture(GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL,
+						  GL_UNSIGNED_INT_24_8);
+	m_lightTexture = makeTexture(GL_R11F_G11F_B10F, GL_RGB, GL_FLOAT);
+	// the light buffer is composited, filter it like the other targets
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_gBuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+						   m_albedoSpec, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D,
+						   m_normalShininess, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+						   GL_TEXTURE_2D, m_depth, 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "ERROR::DEFERRED::GBUFFER_NOT_COMPLETE" << std::endl;
+	}
+
+	// the light volumes test against a copy of the depth, the G-buffer depth
+	// is sampled at the same time
+	glGenRenderbuffers(1, &m_lightDepth);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_lightDepth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_lightFramebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+						   m_lightTexture, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+							  GL_RENDERBUFFER, m_lightDepth);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "ERROR::DEFERRED::LIGHT_BUFFER_NOT_COMPLETE" << std::endl;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void DeferredRenderer::BeginGeometry()
+{
+	const GLenum targets[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glBindFramebuffer(GL_FRAMEBUFFER, m_gBuffer);
+	glDrawBuffers(2, targets);
+	glViewport(0, 0, m_width, m_height);
+	glDisable(GL_BLEND);
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_LESS);
+	glDepthMask(GL_TRUE);
+	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+}
+
+void DeferredRenderer::Light(const DirectionalLight &sun,
+							 const std::vector<PointLight> &lights,
+							 const glm::mat4 &view,
+							 const glm::mat4 &projection, VAO emptyVAO)
+{
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_gBuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_lightFramebuffer);
+	glBlitFramebuffer(0, 0, m_width, m_height, 0, 0, m_width, m_height,
+					  GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_lightFramebuffer);
+	glViewport(0, 0, m_width, m_height);
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, m_albedoSpec);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, m_normalShininess);
+	glActiveTexture(GL_TEXTURE2);
+	glBindTexture(GL_TEXTURE_2D, m_depth);
+	glActiveTexture(GL_TEXTURE0);
+	const glm::mat4 invProjection = glm::inverse(projection);
+
+	// ambient and directional, writes every pixel that has geometry
+	glDisable(GL_DEPTH_TEST);
+	glDepthMask(GL_FALSE);
+	glDisable(GL_CULL_FACE);
+	glDisable(GL_BLEND);
+	m_directionalShader->use();
+	m_directionalShader->setMat4("invProjection", invProjection);
+	m_directionalShader->setVec3("dirLight.vDirection",
+								 glm::mat3(view) * sun.direction);
+	m_directionalShader->setVec3("dirLight.ambient", sun.ambient);
+	m_directionalShader->setVec3("dirLight.diffuse", sun.diffuse);
+	m_directionalShader->setVec3("dirLight.specular", sun.specular);
+	glBindVertexArray(emptyVAO);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+
+	// point lights, added on top
+	if (!lights.empty())
+	{
+		m_instanceData.clear();
+		for (const PointLight &light : lights)
+		{
+			m_instanceData.insert(m_instanceData.end(),
+				{ light.position.x, light.position.y, light.position.z,
+				  PointLightRadius(light), light.colour.r, light.colour.g,
+				  light.colour.b, light.constant, light.linear,
+				  light.quadratic });
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, m_instanceVBO);
+		// orphaned every frame, the old contents may still be in use
+		glBufferData(GL_ARRAY_BUFFER, m_instanceData.size() * sizeof(float),
+					 m_instanceData.data(), GL_STREAM_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_ONE, GL_ONE);
+		glEnable(GL_CULL_FACE);
+		glCullFace(GL_FRONT);
+		glEnable(GL_DEPTH_TEST);
+		glDepthFunc(GL_GEQUAL);
+		m_pointShader->use();
+		m_pointShader->setMat4("view", view);
+		m_pointShader->setMat4("projection", projection);
+		m_pointShader->setMat4("invProjection", invProjection);
+		glBindVertexArray(m_sphereVAO);
+		glDrawElementsInstanced(GL_TRIANGLES, m_sphereIndexCount,
+								GL_UNSIGNED_INT, (void *)0,
+								(GLsizei)lights.size());
+	}
+
+	glBindVertexArray(0);
+	glDisable(GL_BLEND);
+	glCullFace(GL_BACK);
+	glDisable(GL_CULL_FACE);
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_LESS);
+	glDepthMask(GL_TRUE);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+// Scene for the lighting benchmarks: layers of terrain drawn back to front,
+// so every pixel has layerCount fragments, seen from above with the lights
+// scattered just over the top layer. Drawn with deferredGeometry.vs.
+class LightingBenchmarkScene
+{
+public:
+	LightingBenchmarkScene(u32 width, u32 height, u32 layerCount);
+	~LightingBenchmarkScene();
+	LightingBenchmarkScene(const LightingBenchmarkScene &) = delete;
+	LightingBenchmarkScene &operator=(const LightingBenchmarkScene &) = delete;
+
+	// Set up a shader using deferredGeometry.vs for Draw
+	void Prepare(Shader &shader) const;
+	void Draw(Shader &shader);
+	std::vector<PointLight> MakeLights(u32 count, std::mt19937 &rng) const;
+
+	const glm::mat4 &View() const { return m_view; }
+	const glm::mat4 &Projection() const { return m_projection; }
+
+private:
+	static Mesh MakeTerrain(TXO texture);
+
+	u32 m_layerCount;
+	TXO m_white;
+	Mesh m_terrain;
+	u32 m_alignment;
+	RingBuffer m_perDraw;
+	glm::mat4 m_view;
+	glm::mat4 m_projection;
+};
+
+TXO MakeWhiteTexture()
+{
+	TXO white;
+	glGenTextures(1, &white);
+	glBindTexture(GL_TEXTURE_2D, white);
+	const u8 texel[] = { 255, 255, 255, 255 };
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA,
+				 GL_UNSIGNED_BYTE, texel);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return white;
+}
+
+LightingBenchmarkScene::LightingBenchmarkScene(u32 width, u32 height,
+											   u32 layerCount)
+	: m_layerCount(layerCount)
+	, m_white(MakeWhiteTexture())
+	, m_terrain(MakeTerrain(m_white))
+	, m_alignment(UniformBufferAlignment())
+	, m_perDraw(GL_UNIFORM_BUFFER,
+				layerCount * (sizeof(PerDrawConstants) + m_alignment))
+{
+	// looking straight down on the middle of the terrain, it fills the view
+	m_view = glm::lookAt(glm::vec3(50.0f, 40.0f, 50.0f),
+						 glm::vec3(50.0f, 0.0f, 50.0f),
+						 glm::vec3(0.0f, 0.0f, -1.0f));
+	m_projection = glm::perspective(glm::radians(60.0f),
+									(float)width / (float)height, 0.1f,
+									100.0f);
+}
+
+LightingBenchmarkScene::~LightingBenchmarkScene()
+{
+	glDeleteTextures(1, &m_white);
+}
+
+Mesh LightingBenchmarkScene::MakeTerrain(TXO texture)
+{
+	// terrain with smooth normals
+	std::vector<glm::vec3> positions;
+	std::vector<u32> indices;
+	MakeBenchmarkMesh(20000, positions, indices);
+	std::vector<Vertex> vertices(positions.size());
+	for (size_t i = 0; i < positions.size(); i++)
+	{
+		vertices[i].Position = positions[i];
+		vertices[i].TexCoords = glm::vec2(positions[i].x, positions[i].z);
+	}
+	for (size_t t = 0; t < indices.size(); t += 3)
+	{
+		const glm::vec3 &a = positions[indices[t]];
+		glm::vec3 n = glm::cross(positions[indices[t + 2]] - a,
+								 positions[indices[t + 1]] - a);
+		for (u32 c = 0; c < 3; c++)
+		{
+			vertices[indices[t + c]].Normal += n;
+		}
+	}
+	for (Vertex &v : vertices)
+	{
+		v.Normal = glm::normalize(v.Normal);
+	}
+	return Mesh(vertices, indices,
+				{ { texture, Texture::Type::Diffuse, "" },
+				  { texture, Texture::Type::Specular, "" } });
+}
+
+void LightingBenchmarkScene::Prepare(Shader &shader) const
+{
+	shader.use();
+	shader.bindUniformBlock("PerDraw", PER_DRAW_UBO_BINDING);
+	shader.setFloat("material.shininess", 32.0f);
+}
+
+void LightingBenchmarkScene::Draw(Shader &shader)
+{
+	// layers from the bottom up, the worst order for overdraw
+	m_perDraw.BeginFrame();
+	const PerDrawCamera camera = MakePerDrawCamera(m_view, m_projection);
+	std::vector<u32> offsets(m_layerCount);
+	for (u32 i = 0; i < m_layerCount; i++)
+	{
+		glm::mat4 model
+			= glm::translate(glm::mat4(), glm::vec3(0.0f, (float)i, 0.0f));
+		ComputePerDraw(camera, model,
+					   (PerDrawConstants *)m_perDraw.Allocate(
+						   sizeof(PerDrawConstants), m_alignment, offsets[i]));
+	}
+	m_perDraw.Flush();
+	shader.use();
+	for (u32 i = 0; i < m_layerCount; i++)
+	{
+		glBindBufferRange(GL_UNIFORM_BUFFER, PER_DRAW_UBO_BINDING,
+						  m_perDraw.Buffer(), offsets[i],
+						  sizeof(PerDrawConstants));
+		m_terrain.Draw(shader);
+	}
+	m_perDraw.EndFrame();
+}
+
+std::vector<PointLight> LightingBenchmarkScene::MakeLights(
+	u32 count, std::mt19937 &rng) const
+{
+	std::uniform_real_distribution<float> across(10.0f, 90.0f);
+	std::uniform_real_distribution<float> above(1.0f, 3.0f);
+	std::uniform_real_distribution<float> brightness(0.2f, 1.0f);
+	std::vector<PointLight> lights(count);
+	for (PointLight &light : lights)
+	{
+		light.position = glm::vec3(across(rng), m_layerCount - 1 + above(rng),
+								   across(rng));
+		light.colour
+			= glm::vec3(brightness(rng), brightness(rng), brightness(rng));
+	}
+	return lights;
+}
+
+// Average GPU time of frame() in ms, after a few warm up runs
+double TimeGpuFrames(u32 timer, const std::function<void()> &frame)
+{
+	const u32 warmupFrames = 3;
+	const u32 timedFrames = 10;
+	GLuint64 total = 0;
+	for (u32 f = 0; f < warmupFrames + timedFrames; f++)
+	{
+		glBeginQuery(GL_TIME_ELAPSED, timer);
+		frame();
+		glEndQuery(GL_TIME_ELAPSED);
+		GLuint64 ns = 0;
+		glGetQueryObjectui64v(timer, GL_QUERY_RESULT, &ns);
+		if (f >= warmupFrames) total += ns;
+	}
+	return total / 1.0e6 / timedFrames;
+}
+
+// Forward (every light for every fragment, forwardLights.fs) against
+// deferred shading of LightingBenchmarkScene with 16 to 256 point lights.
+// GPU times at width x height go to stdout.
+void BenchmarkDeferred(u32 width, u32 height, u32 layerCount = 8)
+{
+	const u32 lightCounts[] = { 16, 64, 256 };
+
+	LightingBenchmarkScene scene(width, height, layerCount);
+	const glm::mat4 &view = scene.View();
+	Shader gBufferShader("shaders/deferredGeometry.vs", "shaders/gbuffer.fs");
+	Shader forwardShader("shaders/deferredGeometry.vs",
+						 "shaders/forwardLights.fs");
+	scene.Prepare(gBufferShader);
+	scene.Prepare(forwardShader);
+	DirectionalLight sun;
+	sun.direction = glm::vec3(-0.2f, -1.0f, -0.3f);
+	sun.ambient = glm::vec3(0.05f);
+	sun.diffuse = glm::vec3(0.2f);
+	sun.specular = glm::vec3(0.2f);
+	forwardShader.setVec3("dirLight.vDirection",
+						  glm::mat3(view) * sun.direction);
+	forwardShader.setVec3("dirLight.ambient", sun.ambient);
+	forwardShader.setVec3("dirLight.diffuse", sun.diffuse);
+	forwardShader.setVec3("dirLight.specular", sun.specular);
+	const u32 forwardLightsBinding = 1;
+	forwardShader.bindUniformBlock("ForwardLights", forwardLightsBinding);
+	u32 forwardLightsUBO;
+	glGenBuffers(1, &forwardLightsUBO);
+	glBindBuffer(GL_UNIFORM_BUFFER, forwardLightsUBO);
+	glBufferData(GL_UNIFORM_BUFFER, MAX_FORWARD_LIGHTS * 3 * sizeof(glm::vec4),
+				 NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	// forward target, same formats as the deferred output
+	DeferredRenderer deferred;
+	deferred.Resize(width, height);
+	u32 forwardFBO, forwardColour, forwardDepth;
+	glGenFramebuffers(1, &forwardFBO);
+	glGenTextures(1, &forwardColour);
+	glBindTexture(GL_TEXTURE_2D, forwardColour);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R11F_G11F_B10F, width, height, 0, GL_RGB,
+				 GL_FLOAT, NULL);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glGenRenderbuffers(1, &forwardDepth);
+	glBindRenderbuffer(GL_RENDERBUFFER, forwardDepth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, forwardFBO);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+						   forwardColour, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+							  GL_RENDERBUFFER, forwardDepth);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	VAO emptyVAO;
+	glGenVertexArrays(1, &emptyVAO);
+	u32 timer;
+	glGenQueries(1, &timer);
+
+	std::mt19937 rng(99);
+	std::cout << "lights\tforward (ms)\tdeferred (ms)" << std::endl;
+	for (u32 lightCount : lightCounts)
+	{
+		std::vector<PointLight> lights = scene.MakeLights(lightCount, rng);
+		std::vector<glm::vec4> forwardLights(MAX_FORWARD_LIGHTS * 3);
+		for (u32 i = 0; i < lightCount; i++)
+		{
+			const PointLight &light = lights[i];
+			forwardLights[i] = view * glm::vec4(light.position, 1.0f);
+			forwardLights[MAX_FORWARD_LIGHTS + i]
+				= glm::vec4(light.colour, 0.0f);
+			forwardLights[MAX_FORWARD_LIGHTS * 2 + i] = glm::vec4(
+				light.constant, light.linear, light.quadratic, 0.0f);
+		}
+		glBindBuffer(GL_UNIFORM_BUFFER, forwardLightsUBO);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0,
+						forwardLights.size() * sizeof(glm::vec4),
+						forwardLights.data());
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+		double forwardMs = TimeGpuFrames(timer, [&]() {
+			glBindFramebuffer(GL_FRAMEBUFFER, forwardFBO);
+			glViewport(0, 0, width, height);
+			glEnable(GL_DEPTH_TEST);
+			glDepthFunc(GL_LESS);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			forwardShader.use();
+			forwardShader.setInt("lightCount", lightCount);
+			glBindBufferBase(GL_UNIFORM_BUFFER, forwardLightsBinding,
+							 forwardLightsUBO);
+			scene.Draw(forwardShader);
+		});
+		double deferredMs = TimeGpuFrames(timer, [&]() {
+			deferred.BeginGeometry();
+			scene.Draw(gBufferShader);
+			deferred.Light(sun, lights, view, scene.Projection(), emptyVAO);
+		});
+		std::cout << lightCount << "\t" << forwardMs << "\t\t" << deferredMs
+				  << std::endl;
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteQueries(1, &timer);
+	glDeleteVertexArrays(1, &emptyVAO);
+	glDeleteFramebuffers(1, &forwardFBO);
+	glDeleteTextures(1, &forwardColour);
+	glDeleteRenderbuffers(1, &forwardDepth);
+	glDeleteBuffers(1, &forwardLightsUBO);
+	glDeleteProgram(gBufferShader.m_programId);
+	glDeleteProgram(forwardShader.m_programId);
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <cmath>
+
+#include "types.h"
+
+// Render scale limits, per axis
+const float DYNRES_MIN_SCALE = 0.5f;
+const float DYNRES_MAX_SCALE = 1.0f;
+// Frames of timestamp queries in flight, results are read this many frames
+// late so the CPU never waits for them
+const u32 DYNRES_QUERY_FRAMES = 4;
+// Only scale up when the GPU time is below this fraction of the budget, so
+// the scale doesn't flip between two values
+const float DYNRES_HEADROOM = 0.85f;
+// Largest change to the scale per adjustment
+const float DYNRES_MAX_STEP_DOWN = 0.1f;
+const float DYNRES_MAX_STEP_UP = 0.02f;
+// Rendered sizes are rounded to multiples of this
+const u32 DYNRES_SIZE_ALIGN = 8;
+
+// Picks the offscreen render resolution from the GPU time of the frame.
+//
+// Timestamps are written before and after the scaled work (scene and post
+// processing), so the measured time follows the fill rate. Timestamps are
+// used rather than a GL_TIME_ELAPSED query because those can't nest and the
+// post chain already times its passes with them.
+//
+// The time is smoothed and the scale moved by the square root of budget over
+// time, since the cost goes with the area. It drops quickly when over budget
+// and creeps back up when there's headroom. After each change it waits for
+// the results of frames rendered at the new scale.
+class DynamicResolution
+{
+public:
+	explicit DynamicResolution(float budgetMs);
+	~DynamicResolution();
+	DynamicResolution(const DynamicResolution &) = delete;
+	DynamicResolution &operator=(const DynamicResolution &) = delete;
+
+	// Bracket the GPU work that scales with the resolution
+	void BeginFrame();
+	void EndFrame();
+
+	void SetEnabled(bool enabled);
+	bool IsEnabled() const { return m_enabled; }
+	void SetBudget(float budgetMs) { m_budgetMs = budgetMs; }
+
+	float Scale() const { return m_scale; }
+	// size scaled and aligned, at least 1
+	u32 ScaledSize(u32 size) const;
+	// smoothed GPU time of the bracketed work
+	float GpuMs() const { return m_gpuMs; }
+
+private:
+	void CollectResults();
+	void Adjust();
+
+	u32 m_queries[DYNRES_QUERY_FRAMES][2];
+	bool m_issued[DYNRES_QUERY_FRAMES];
+	u32 m_frame;
+	float m_budgetMs;
+	float m_gpuMs;
+	float m_scale;
+	bool m_enabled;
+	bool m_haveTime;
+	// frames to wait before the next adjustment
+	u32 m_cooldown;
+};
+
+DynamicResolution::DynamicResolution(float budgetMs)
+	: m_frame(0)
+	, m_budgetMs(budgetMs)
+	, m_gpuMs(0.0f)
+	, m_scale(DYNRES_MAX_SCALE)
+	, m_enabled(true)
+	, m_haveTime(false)
+	, m_cooldown(0)
+{
+	for (u32 i = 0; i < DYNRES_QUERY_FRAMES; i++)
+	{
+		glGenQueries(2, m_queries[i]);
+		m_issued[i] = false;
+	}
+}
+
+DynamicResolution::~DynamicResolution()
+{
+	for (u32 i = 0; i < DYNRES_QUERY_FRAMES; i++)
+	{
+		glDeleteQueries(2, m_queries[i]);
+	}
+}
+
+void DynamicResolution::SetEnabled(bool enabled)
+{
+	m_enabled = enabled;
+	if (!enabled) m_scale = DYNRES_MAX_SCALE;
+}
+
+u32 DynamicResolution::ScaledSize(u32 size) const
+{
+	u32 scaled = (u32)(size * m_scale + 0.5f);
+	scaled = (scaled + DYNRES_SIZE_ALIGN / 2) / DYNRES_SIZE_ALIGN
+		* DYNRES_SIZE_ALIGN;
+	return std::max(1u, std::min(scaled, size));
+}
+
+void DynamicResolution::BeginFrame()
+{
+	const u32 slot = m_frame % DYNRES_QUERY_FRAMES;
+	// the slot about to be reused is the oldest, give it a last chance
+	CollectResults();
+	m_issued[slot] = false;
+	glQueryCounter(m_queries[slot][0], GL_TIMESTAMP);
+}
+
+void DynamicResolution::EndFrame()
+{
+	const u32 slot = m_frame % DYNRES_QUERY_FRAMES;
+	glQueryCounter(m_queries[slot][1], GL_TIMESTAMP);
+	m_issued[slot] = true;
+	m_frame++;
+	if (m_cooldown > 0) m_cooldown--;
+	if (m_enabled) Adjust();
+}
+
+void DynamicResolution::CollectResults()
+{
+	// oldest first, so the smoothing sees them in order
+	for (u32 i = 0; i < DYNRES_QUERY_FRAMES; i++)
+	{
+		const u32 slot = (m_frame + i) % DYNRES_QUERY_FRAMES;
+		if (!m_issued[slot]) continue;
+		GLint available = 0;
+		glGetQueryObjectiv(m_queries[slot][1], GL_QUERY_RESULT_AVAILABLE,
+						   &available);
+		if (!available) continue;
+		GLuint64 begin = 0, end = 0;
+		glGetQueryObjectui64v(m_queries[slot][0], GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(m_queries[slot][1], GL_QUERY_RESULT, &end);
+		m_issued[slot] = false;
+
+		const float ms = (float)((end - begin) / 1.0e6);
+		m_gpuMs = m_haveTime ? m_gpuMs + (ms - m_gpuMs) * 0.2f : ms;
+		m_haveTime = true;
+	}
+}
+
+void DynamicResolution::Adjust()
+{
+	if (!m_haveTime || m_cooldown > 0 || m_gpuMs <= 0.0f) return;
+
+	float scale = m_scale;
+	if (m_gpuMs > m_budgetMs)
+	{
+		const float ratio = std::sqrt(m_budgetMs / m_gpuMs);
+		scale *= std::max(ratio, 1.0f - DYNRES_MAX_STEP_DOWN);
+	}
+	else if (m_gpuMs < m_budgetMs * DYNRES_HEADROOM)
+	{
+		const float ratio = std::sqrt(m_budgetMs * DYNRES_HEADROOM / m_gpuMs);
+		scale *= std::min(ratio, 1.0f + DYNRES_MAX_STEP_UP);
+	}
+	scale = std::min(std::max(scale, DYNRES_MIN_SCALE), DYNRES_MAX_SCALE);
+	if (scale != m_scale)
+	{
+		m_scale = scale;
+		// wait until the results are from frames at the new scale
+		m_cooldown = DYNRES_QUERY_FRAMES + 1;
+	}
+}
@@ -0,0 +1,357 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+#include "types.h"
+
+// Frames kept for the report
+const u32 FRAME_STATS_HISTORY = 600;
+// Frames of timestamp queries in flight, results are read this many frames
+// late so the CPU never waits for them
+const u32 FRAME_STATS_QUERY_FRAMES = 4;
+// Passes that can be timed
+const u32 FRAME_STATS_MAX_PASSES = 16;
+// A frame taking more than this many times the median is a hitch
+const double FRAME_STATS_HITCH_FACTOR = 2.0;
+
+// Distribution of a time over the recorded frames, in milliseconds
+struct TimingPercentiles
+{
+	double p50 = 0.0;
+	double p95 = 0.0;
+	double p99 = 0.0;
+	double max = 0.0;
+};
+
+struct PassStatsReport
+{
+	std::string name;
+	TimingPercentiles cpu;
+	// over the frames whose GPU results have come back
+	TimingPercentiles gpu;
+};
+
+struct FrameStatsReport
+{
+	u32 frames = 0;
+	TimingPercentiles cpuFrame;
+	// frames over hitchMs, FRAME_STATS_HITCH_FACTOR times the median
+	u32 hitches = 0;
+	double hitchMs = 0.0;
+	std::vector<PassStatsReport> passes;
+	// per frame averages
+	double draws = 0.0;
+	double triangles = 0.0;
+};
+
+// Records what each frame costs: CPU frame time, CPU and GPU time of each
+// pass and the draws and triangles submitted, over the last
+// FRAME_STATS_HISTORY frames. Report gives percentiles and hitch counts.
+//
+// The frame time is taken between successive BeginFrame calls on a steady
+// clock in double precision, so it covers the whole frame including the
+// swap. Passes are bracketed with GL_TIMESTAMP queries, which unlike
+// GL_TIME_ELAPSED can nest with the queries the post chain and occlusion
+// culling already run. The queries cycle through FRAME_STATS_QUERY_FRAMES
+// sets and are only read once available, their results are filed under the
+// frame they came from.
+//
+// Usage per frame: BeginFrame at the top, then BeginPass/EndPass around each
+// pass (in any order, but not nested in themselves) and AddDraws.
+class FrameStats
+{
+public:
+	FrameStats();
+	~FrameStats();
+	FrameStats(const FrameStats &) = delete;
+	FrameStats &operator=(const FrameStats &) = delete;
+
+	// Returns the pass's index, for BeginPass and EndPass
+	u32 AddPass(const std::string &name);
+
+	void BeginFrame();
+	void BeginPass(u32 pass);
+	void EndPass(u32 pass);
+	void AddDraws(u32 draws, u64 triangles);
+	// Forget the frames recorded so far, e.g. warm up frames. The frame in
+	// progress is kept.
+	void Reset();
+
+	// Time between the last two BeginFrame calls, 0 on the first frame
+	double FrameMs() const { return m_frameMs; }
+	FrameStatsReport Report() const;
+	// Report to stdout
+	void Print() const;
+
+	// Of any set of times, sorts values
+	static TimingPercentiles Percentiles(std::vector<double> &values);
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	struct Frame
+	{
+		u64 index;
+		double cpuMs;
+		double cpuPassMs[FRAME_STATS_MAX_PASSES];
+		// negative until the GPU result is in, or if the pass didn't run
+		double gpuPassMs[FRAME_STATS_MAX_PASSES];
+		u32 draws;
+		u64 triangles;
+	};
+
+	struct QuerySet
+	{
+		u32 queries[FRAME_STATS_MAX_PASSES][2];
+		bool issued[FRAME_STATS_MAX_PASSES];
+		u64 frame;
+	};
+
+	void CollectResults();
+
+	std::vector<std::string> m_passes;
+	std::vector<Frame> m_history;
+	QuerySet m_querySets[FRAME_STATS_QUERY_FRAMES];
+	// frames begun so far, the current one is m_frame - 1
+	u64 m_frame;
+	Clock::time_point m_frameStart;
+	Clock::time_point m_passStart[FRAME_STATS_MAX_PASSES];
+	double m_frameMs;
+	Frame m_current;
+};
+
+FrameStats::FrameStats()
+	: m_history(FRAME_STATS_HISTORY)
+	, m_frame(0)
+	, m_frameMs(0.0)
+{
+	for (QuerySet &set : m_querySets)
+	{
+		glGenQueries(2 * FRAME_STATS_MAX_PASSES, &set.queries[0][0]);
+		for (bool &issued : set.issued)
+		{
+			issued = false;
+		}
+		set.frame = 0;
+	}
+	for (Frame &frame : m_history)
+	{
+		// nothing recorded in this entry
+		frame.index = ~0ull;
+	}
+	m_current.index = ~0ull;
+}
+
+FrameStats::~FrameStats()
+{
+	for (QuerySet &set : m_querySets)
+	{
+		glDeleteQueries(2 * FRAME_STATS_MAX_PASSES, &set.queries[0][0]);
+	}
+}
+
+u32 FrameStats::AddPass(const std::string &name)
+{
+	if (m_passes.size() == FRAME_STATS_MAX_PASSES)
+	{
+		std::cout << "ERROR::FRAME_STATS::TOO_MANY_PASSES " << name
+				  << std::endl;
+		return FRAME_STATS_MAX_PASSES - 1;
+	}
+	m_passes.push_back(name);
+	return (u32)m_passes.size() - 1;
+}
+
+void FrameStats::BeginFrame()
+{
+	const Clock::time_point now = Clock::now();
+	if (m_frame > 0)
+	{
+		m_frameMs
+			= std::chrono::duration<double, std::milli>(now - m_frameStart)
+				  .count();
+		// the previous frame is complete now
+		m_current.cpuMs = m_frameMs;
+		m_history[m_current.index % FRAME_STATS_HISTORY] = m_current;
+	}
+	m_frameStart = now;
+
+	// into the history, so after the previous frame went in. The set about
+	// to be reused is the oldest, this is its last chance.
+	CollectResults();
+	QuerySet &set = m_querySets[m_frame % FRAME_STATS_QUERY_FRAMES];
+	for (bool &issued : set.issued)
+	{
+		issued = false;
+	}
+	set.frame = m_frame;
+
+	m_current.index = m_frame;
+	m_current.draws = 0;
+	m_current.triangles = 0;
+	for (u32 i = 0; i < FRAME_STATS_MAX_PASSES; i++)
+	{
+		m_current.cpuPassMs[i] = 0.0;
+		m_current.gpuPassMs[i] = -1.0;
+	}
+	m_frame++;
+}
+
+void FrameStats::BeginPass(u32 pass)
+{
+	QuerySet &set = m_querySets[(m_frame - 1) % FRAME_STATS_QUERY_FRAMES];
+	glQueryCounter(set.queries[pass][0], GL_TIMESTAMP);
+	m_passStart[pass] = Clock::now();
+}
+
+void FrameStats::EndPass(u32 pass)
+{
+	m_current.cpuPassMs[pass] += std::chrono::duration<double, std::milli>(
+									 Clock::now() - m_passStart[pass])
+									 .count();
+	QuerySet &set = m_querySets[(m_frame - 1) % FRAME_STATS_QUERY_FRAMES];
+	glQueryCounter(set.queries[pass][1], GL_TIMESTAMP);
+	set.issued[pass] = true;
+}
+
+void FrameStats::AddDraws(u32 draws, u64 triangles)
+{
+	m_current.draws += draws;
+	m_current.triangles += triangles;
+}
+
+void FrameStats::Reset()
+{
+	// results still in flight for them are dropped when they come in
+	for (Frame &frame : m_history)
+	{
+		frame.index = ~0ull;
+	}
+}
+
+void FrameStats::CollectResults()
+{
+	for (QuerySet &set : m_querySets)
+	{
+		for (u32 pass = 0; pass < m_passes.size(); pass++)
+		{
+			if (!set.issued[pass]) continue;
+			GLint available = 0;
+			glGetQueryObjectiv(set.queries[pass][1], GL_QUERY_RESULT_AVAILABLE,
+							   &available);
+			if (!available) continue;
+			GLuint64 begin = 0, end = 0;
+			glGetQueryObjectui64v(set.queries[pass][0], GL_QUERY_RESULT,
+								  &begin);
+			glGetQueryObjectui64v(set.queries[pass][1], GL_QUERY_RESULT, &end);
+			set.issued[pass] = false;
+
+			const double ms = (end - begin) / 1.0e6;
+			// unless the history has moved on past it
+			Frame &frame = m_history[set.frame % FRAME_STATS_HISTORY];
+			if (frame.index == set.frame) frame.gpuPassMs[pass] = ms;
+		}
+	}
+}
+
+TimingPercentiles FrameStats::Percentiles(std::vector<double> &values)
+{
+	TimingPercentiles result;
+	if (values.empty()) return result;
+	std::sort(values.begin(), values.end());
+	// nearest rank
+	auto rank = [&](double p) {
+		size_t i = (size_t)(p * values.size() + 0.999999);
+		return values[std::min(std::max(i, (size_t)1), values.size()) - 1];
+	};
+	result.p50 = rank(0.50);
+	result.p95 = rank(0.95);
+	result.p99 = rank(0.99);
+	result.max = values.back();
+	return result;
+}
+
+FrameStatsReport FrameStats::Report() const
+{
+	FrameStatsReport report;
+	std::vector<const Frame *> frames;
+	for (const Frame &frame : m_history)
+	{
+		if (frame.index != ~0ull) frames.push_back(&frame);
+	}
+	report.frames = (u32)frames.size();
+	if (frames.empty()) return report;
+
+	std::vector<double> values;
+	for (const Frame *frame : frames)
+	{
+		values.push_back(frame->cpuMs);
+		report.draws += frame->draws;
+		report.triangles += (double)frame->triangles;
+	}
+	report.draws /= frames.size();
+	report.triangles /= frames.size();
+	report.cpuFrame = Percentiles(values);
+	report.hitchMs = report.cpuFrame.p50 * FRAME_STATS_HITCH_FACTOR;
+	for (const Frame *frame : frames)
+	{
+		if (frame->cpuMs > report.hitchMs) report.hitches++;
+	}
+
+	for (u32 pass = 0; pass < m_passes.size(); pass++)
+	{
+		PassStatsReport passReport;
+		passReport.name = m_passes[pass];
+		values.clear();
+		for (const Frame *frame : frames)
+		{
+			values.push_back(frame->cpuPassMs[pass]);
+		}
+		passReport.cpu = Percentiles(values);
+		values.clear();
+		for (const Frame *frame : frames)
+		{
+			if (frame->gpuPassMs[pass] >= 0.0)
+			{
+				values.push_back(frame->gpuPassMs[pass]);
+			}
+		}
+		passReport.gpu = Percentiles(values);
+		report.passes.push_back(passReport);
+	}
+	return report;
+}
+
+void FrameStats::Print() const
+{
+	const FrameStatsReport report = Report();
+	auto line = [](const char *kind, const TimingPercentiles &t) {
+		std::cout << kind << "\t" << t.p50 << "\t" << t.p95 << "\t" << t.p99
+				  << "\t" << t.max << std::endl;
+	};
+	std::cout << "frame stats, last " << report.frames << " frames"
+			  << std::endl;
+	std::cout << "ms\t\tp50\tp95\tp99\tmax" << std::endl;
+	line("frame cpu", report.cpuFrame);
+	for (const PassStatsReport &pass : report.passes)
+	{
+		line((pass.name + " cpu").c_str(), pass.cpu);
+		line((pass.name + " gpu").c_str(), pass.gpu);
+	}
+	std::cout << "hitches (over " << report.hitchMs << " ms)\t"
+			  << report.hitches << std::endl;
+	std::cout << "draws/frame\t" << report.draws << "\ttriangles/frame\t"
+			  << report.triangles << std::endl;
+}
+
+void WriteJsonPercentiles(std::ofstream &out, const TimingPercentiles &t)
+{
+	out << "{\"p50\":" << t.p50 << ",\"p95\":" << t.p95 << ",\"p99\":"
+		<< t.p99 << ",\"max\":" << t.max << "}";
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// View frustum as six inward facing planes (xyz = normal, w = distance), in
+// the order left, right, bottom, top, near, far.
+struct Frustum
+{
+	glm::vec4 planes[6];
+};
+
+// Extract the frustum planes of a view-projection matrix (Gribb/Hartmann).
+// Planes are in the space the matrix transforms from, usually world space.
+Frustum ExtractFrustum(const glm::mat4 &viewProj)
+{
+	// glm is column major, so row i of the matrix is (m[0][i], .., m[3][i])
+	glm::vec4 row0(viewProj[0][0], viewProj[1][0], viewProj[2][0],
+				   viewProj[3][0]);
+	glm::vec4 row1(viewProj[0][1], viewProj[1][1], viewProj[2][1],
+				   viewProj[3][1]);
+	glm::vec4 row2(viewProj[0][2], viewProj[1][2], viewProj[2][2],
+				   viewProj[3][2]);
+	glm::vec4 row3(viewProj[0][3], viewProj[1][3], viewProj[2][3],
+				   viewProj[3][3]);
+
+	Frustum frustum;
+	frustum.planes[0] = row3 + row0;
+	frustum.planes[1] = row3 - row0;
+	frustum.planes[2] = row3 + row1;
+	frustum.planes[3] = row3 - row1;
+	frustum.planes[4] = row3 + row2;
+	frustum.planes[5] = row3 - row2;
+	for (glm::vec4 &plane : frustum.planes)
+	{
+		plane /= glm::length(glm::vec3(plane));
+	}
+	return frustum;
+}
+
+// True if any part of the sphere may be inside the frustum
+bool SphereInFrustum(const Frustum &frustum, const glm::vec3 &center,
+					 float radius)
+{
+	for (const glm::vec4 &plane : frustum.planes)
+	{
+		if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) return false;
+	}
+	return true;
+}
@@ -0,0 +1,405 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <chrono>
+#include <random>
+#include <iostream>
+
+#include "shader.h"
+#include "instancing.h"
+#include "culling.h"
+#include "frustum.h"
+#include "bounds.h"
+#include "types.h"
+
+// Frames of counter copies in flight, the counts are read this many frames
+// late so the CPU never waits for them
+const u32 GPU_CULL_READBACK_FRAMES = 4;
+
+// Layout of a glMultiDrawElementsIndirect command
+struct DrawElementsIndirectCommand
+{
+	u32 count;
+	u32 instanceCount;
+	u32 firstIndex;
+	GLint baseVertex;
+	u32 baseInstance;
+};
+
+// GPU-driven frustum culling and submission for many objects that share one
+// vertex and index buffer, each object a range of indices. Needs GL 4.3, on
+// older contexts use CullingSystem and instancing instead.
+//
+// A compute shader tests the world space boxes, the same test as
+// CullingSystem, and compacts the survivors into an indirect command buffer
+// that is drawn with a single glMultiDrawElementsIndirect, so the CPU never
+// touches individual objects.
+//
+// The culler draws from a VAO of its own over the shared buffers, with the
+// object's model matrix in the instance attribute at INSTANCE_MODEL_LOCATION
+// (see instanced.vs).
+class GpuCuller
+{
+public:
+	// Sets up the vertex attributes, called with the culler's VAO and the
+	// vertex buffer bound
+	using VertexLayout = std::function<void()>;
+
+	static bool IsSupported() { return GLAD_GL_VERSION_4_3 != 0; }
+
+	// vertices and indices stay the caller's, indices are u32
+	GpuCuller(VBO vertices, EBO indices, const VertexLayout &layout);
+	~GpuCuller();
+	GpuCuller(const GpuCuller &) = delete;
+	GpuCuller &operator=(const GpuCuller &) = delete;
+
+	// localBounds are the object space bounds. Returns the object index.
+	u32 AddObject(const glm::mat4 &model, u32 indexCount, u32 firstIndex,
+				  GLint baseVertex, const Bounds &localBounds);
+	void SetTransform(u32 object, const glm::mat4 &model);
+	u32 ObjectCount() const { return (u32)m_objects.size(); }
+
+	// Cull against viewProj, filling the command buffer for Draw
+	void Cull(const glm::mat4 &viewProj);
+	// Draw what the last Cull kept. The caller binds the shader and
+	// textures.
+	void Draw();
+
+	// Number of objects the last Cull kept. Reads the counter back and
+	// stalls, so only use it for testing.
+	u32 ReadbackDrawCount() const;
+	// Objects and triangles kept by the latest Cull whose counters have come
+	// back, up to GPU_CULL_READBACK_FRAMES Culls old. Never waits.
+	u32 LatestDrawCount() const { return m_latestDraws; }
+	u64 LatestTriangleCount() const { return m_latestTriangles; }
+
+private:
+	// std430 layout shared with cull.cs
+	struct ObjectData
+	{
+		glm::vec4 center; // world space box, w unused
+		glm::vec4 extent;
+		u32 indexCount;
+		u32 firstIndex;
+		GLint baseVertex;
+		u32 pad;
+	};
+
+	// std430 layout shared with cull.cs
+	struct Counters
+	{
+		u32 draws;
+		u32 triangles;
+	};
+
+	void UploadObjects();
+	void CollectCounters();
+
+	std::vector<ObjectData> m_objects;
+	std::vector<Bounds> m_localBounds;
+	std::vector<glm::mat4> m_transforms;
+	bool m_dirty;
+
+	VAO m_vao;
+	InstanceBuffer m_instances;
+	Shader m_cullShader;
+	u32 m_objectBuffer, m_commandBuffer, m_counterBuffer;
+	u32 m_bufferCapacity;
+
+	// copies of the counters, one per Cull in flight
+	u32 m_readbackBuffers[GPU_CULL_READBACK_FRAMES];
+	GLsync m_readbackFences[GPU_CULL_READBACK_FRAMES];
+	u32 m_readbackIndex;
+	u32 m_latestDraws;
+	u64 m_latestTriangles;
+};
+
+GpuCuller::GpuCuller(VBO vertices, EBO indices, const VertexLayout &layout)
+	: m_dirty(false)
+	, m_cullShader("shaders/cull.cs")
+	, m_bufferCapacity(0)
+	, m_readbackIndex(0)
+	, m_latestDraws(0)
+	, m_latestTriangles(0)
+{
+	glGenVertexArrays(1, &m_vao);
+	glBindVertexArray(m_vao);
+	glBindBuffer(GL_ARRAY_BUFFER, vertices);
+	layout();
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	m_instances.AttachTo(m_vao);
+
+	glGenBuffers(1, &m_objectBuffer);
+	glGenBuffers(1, &m_commandBuffer);
+	glGenBuffers(1, &m_counterBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_counterBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(Counters), NULL,
+				 GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	glGenBuffers(GPU_CULL_READBACK_FRAMES, m_readbackBuffers);
+	for (u32 i = 0; i < GPU_CULL_READBACK_FRAMES; i++)
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, m_readbackBuffers[i]);
+		glBufferData(GL_COPY_WRITE_BUFFER, sizeof(Counters), NULL,
+					 GL_STREAM_READ);
+		m_readbackFences[i] = 0;
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+GpuCuller::~GpuCuller()
+{
+	glDeleteProgram(m_cullShader.m_programId);
+	glDeleteVertexArrays(1, &m_vao);
+	glDeleteBuffers(1, &m_objectBuffer);
+	glDeleteBuffers(1, &m_commandBuffer);
+	glDeleteBuffers(1, &m_counterBuffer);
+	glDeleteBuffers(GPU_CULL_READBACK_FRAMES, m_readbackBuffers);
+	for (GLsync fence : m_readbackFences)
+	{
+		if (fence) glDeleteSync(fence);
+	}
+}
+
+u32 GpuCuller::AddObject(const glm::mat4 &model, u32 indexCount,
+						 u32 firstIndex, GLint baseVertex,
+						 const Bounds &localBounds)
+{
+	ObjectData object;
+	object.indexCount = indexCount;
+	object.firstIndex = firstIndex;
+	object.baseVertex = baseVertex;
+	object.pad = 0;
+	m_objects.push_back(object);
+	m_localBounds.push_back(localBounds);
+	m_transforms.push_back(model);
+
+	u32 index = (u32)m_objects.size() - 1;
+	SetTransform(index, model);
+	return index;
+}
+
+void GpuCuller::SetTransform(u32 object, const glm::mat4 &model)
+{
+	const Bounds world = TransformBounds(m_localBounds[object], model);
+	m_objects[object].center
+		= glm::vec4((world.aabbMin + world.aabbMax) * 0.5f, 0.0f);
+	m_objects[object].extent
+		= glm::vec4((world.aabbMax - world.aabbMin) * 0.5f, 0.0f);
+	m_transforms[object] = model;
+	m_dirty = true;
+}
+
+void GpuCuller::UploadObjects()
+{
+	m_instances.Upload(m_transforms);
+	u32 n = (u32)m_objects.size();
+	if (n > m_bufferCapacity)
+	{
+		m_bufferCapacity = n;
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER,
+					 n * sizeof(DrawElementsIndirectCommand), NULL,
+					 GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_objectBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, n * sizeof(ObjectData),
+				 m_objects.data(), GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	m_dirty = false;
+}
+
+void GpuCuller::Cull(const glm::mat4 &viewProj)
+{
+	if (m_objects.empty()) return;
+	if (m_dirty) UploadObjects();
+
+	const u32 n = (u32)m_objects.size();
+	Frustum frustum = ExtractFrustum(viewProj);
+
+	CollectCounters();
+
+	// reset the counters. Without GL 4.6 the draw count can't be sourced
+	// from a buffer, so all n commands get submitted and the tail past the
+	// survivors must be zero (count 0 draws are no-ops).
+	const u32 zero = 0;
+	const Counters zeroCounters = {0, 0};
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_counterBuffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(Counters),
+					&zeroCounters);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	if (!GLAD_GL_VERSION_4_6)
+	{
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+		glClearBufferData(GL_DRAW_INDIRECT_BUFFER, GL_R32UI, GL_RED_INTEGER,
+						  GL_UNSIGNED_INT, &zero);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+
+	// keep the caller's draw program bound afterwards
+	GLint drawProgram;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &drawProgram);
+	glUseProgram(m_cullShader.m_programId);
+	glUniform4fv(glGetUniformLocation(m_cullShader.m_programId,
+									  "frustumPlanes"),
+				 6, glm::value_ptr(frustum.planes[0]));
+	glUniform1ui(glGetUniformLocation(m_cullShader.m_programId,
+									  "objectCount"),
+				 n);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_objectBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_commandBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_counterBuffer);
+	glDispatchCompute((n + 63) / 64, 1, 1);
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT
+					| GL_BUFFER_UPDATE_BARRIER_BIT);
+	glUseProgram(drawProgram);
+
+	// copy the counters aside for CollectCounters to read once the GPU is
+	// done. A copy still in flight from GPU_CULL_READBACK_FRAMES Culls ago
+	// is dropped.
+	const u32 slot = m_readbackIndex++ % GPU_CULL_READBACK_FRAMES;
+	if (m_readbackFences[slot]) glDeleteSync(m_readbackFences[slot]);
+	glBindBuffer(GL_COPY_READ_BUFFER, m_counterBuffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, m_readbackBuffers[slot]);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0,
+						sizeof(Counters));
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	m_readbackFences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void GpuCuller::CollectCounters()
+{
+	// oldest first, so the latest copy that has landed wins
+	for (u32 i = 0; i < GPU_CULL_READBACK_FRAMES; i++)
+	{
+		const u32 slot = (m_readbackIndex + i) % GPU_CULL_READBACK_FRAMES;
+		GLsync fence = m_readbackFences[slot];
+		if (!fence) continue;
+		GLenum result = glClientWaitSync(fence, 0, 0);
+		if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+			continue;
+
+		Counters counters;
+		glBindBuffer(GL_COPY_READ_BUFFER, m_readbackBuffers[slot]);
+		glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(Counters),
+						   &counters);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		m_latestDraws = counters.draws;
+		m_latestTriangles = counters.triangles;
+		glDeleteSync(fence);
+		m_readbackFences[slot] = 0;
+	}
+}
+
+void GpuCuller::Draw()
+{
+	if (m_objects.empty()) return;
+
+	const u32 n = (u32)m_objects.size();
+	glBindVertexArray(m_vao);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+	if (GLAD_GL_VERSION_4_6)
+	{
+		glBindBuffer(GL_PARAMETER_BUFFER, m_counterBuffer);
+		glMultiDrawElementsIndirectCount(GL_TRIANGLES, GL_UNSIGNED_INT, 0, 0,
+										 n, 0);
+		glBindBuffer(GL_PARAMETER_BUFFER, 0);
+	}
+	else
+	{
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, 0, n, 0);
+	}
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	glBindVertexArray(0);
+}
+
+u32 GpuCuller::ReadbackDrawCount() const
+{
+	u32 count = 0;
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_counterBuffer);
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(u32), &count);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	return count;
+}
+
+// Cull objectCount random boxes with the compute shader and with
+// CullingSystem from a few viewpoints, checking both keep the same number of
+// objects. vertices, indices and layout are any geometry to give the culler,
+// nothing is drawn. Results go to stdout.
+void BenchmarkGpuCulling(VBO vertices, EBO indices,
+						 const GpuCuller::VertexLayout &layout,
+						 u32 objectCount = 100000)
+{
+	using Clock = std::chrono::high_resolution_clock;
+	const u32 viewCount = 8;
+
+	// the same boxes as BenchmarkCulling, the culler's are in world space
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+	std::uniform_real_distribution<float> size(0.5f, 5.0f);
+	GpuCuller gpuCulling(vertices, indices, layout);
+	CullingSystem culling;
+	for (u32 i = 0; i < objectCount; i++)
+	{
+		Bounds bounds;
+		glm::vec3 center(position(rng), position(rng), position(rng));
+		glm::vec3 extent(size(rng), size(rng), size(rng));
+		bounds.aabbMin = center - extent;
+		bounds.aabbMax = center + extent;
+		bounds.sphere = glm::vec4(center, glm::length(extent));
+		gpuCulling.AddObject(glm::mat4(), 0, 0, 0, bounds);
+		culling.Add(bounds);
+	}
+
+	std::cout << "view\tCullingSystem (ms)\tcompute (ms)\tvisible"
+			  << "\tCullingSystem visible" << std::endl;
+	std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+	std::vector<u32> visible;
+	u32 mismatches = 0;
+	for (u32 v = 0; v < viewCount; v++)
+	{
+		const float yaw = angle(rng);
+		const glm::mat4 viewProj
+			= glm::perspective(glm::radians(55.0f), 16.0f / 9.0f, 0.1f,
+							   400.0f)
+			* glm::lookAt(glm::vec3(0.0f),
+						  glm::vec3(std::cos(yaw), 0.2f, std::sin(yaw)),
+						  glm::vec3(0.0f, 1.0f, 0.0f));
+
+		Clock::time_point start = Clock::now();
+		culling.Cull(ExtractFrustum(viewProj), visible);
+		double cpuMs
+			= std::chrono::duration<double, std::milli>(Clock::now() - start)
+				  .count();
+		// the first view also uploads the objects
+		glFinish();
+		start = Clock::now();
+		gpuCulling.Cull(viewProj);
+		glFinish();
+		double gpuMs
+			= std::chrono::duration<double, std::milli>(Clock::now() - start)
+				  .count();
+
+		const u32 gpuVisible = gpuCulling.ReadbackDrawCount();
+		if (gpuVisible != visible.size()) mismatches++;
+		std::cout << v << "\t" << cpuMs << "\t\t\t" << gpuMs << "\t\t"
+				  << gpuVisible << "\t" << visible.size() << std::endl;
+	}
+	if (mismatches > 0)
+	{
+		std::cout << "ERROR::GPU_CULLING::COUNT_MISMATCH in " << mismatches
+				  << " of " << viewCount << " views" << std::endl;
+	}
+}
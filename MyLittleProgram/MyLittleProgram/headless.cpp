@@ -0,0 +1,282 @@
+// Headless benchmark. Renders the scene through an EGL context with no
+// surface, so it runs on machines without a display or GPU (Mesa llvmpipe),
+// along a scripted camera path at a fixed resolution, then writes the frame
+// stats as JSON. The path is an orbit of the scene, or a camera path
+// recorded in the window with 6.
+//
+// Linux only, built with the Makefile next to it: make headless
+// Run from this directory, the shaders and assets are loaded relative to it.
+//
+// headless [--frames N] [--warmup N] [--size WxH] [--out stats.json]
+//          [--trace trace.json] [--path camera.path] [--gpu-culling]
+// A recorded path sets the number of frames. --gpu-culling culls on the GPU
+// instead of with the occlusion culling, it needs GL 4.3.
+//
+// headless --regress [--golden dir] [--update-golden] [--time-scale x]
+//          [--out regression.json]
+// runs the regression scenes instead (see regression.h), exiting 1 if any is
+// over budget or differs from its golden image, and 2 if the only failures
+// are scenes without a golden image.
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <fstream>
+#include <memory>
+#include <glad/glad.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "scenerenderer.h"
+#include "regression.h"
+#include "camera.h"
+#include "camerapath.h"
+#include "framestats.h"
+#include "profiler.h"
+
+#include <iostream>
+
+// defaults, overridden on the command line
+const u32 HEADLESS_FRAMES = 300;
+const u32 HEADLESS_WARMUP_FRAMES = 30;
+const u32 HEADLESS_WIDTH = 1280;
+const u32 HEADLESS_HEIGHT = 720;
+
+// Surfaceless EGL display and a 3.3 core context current on this thread
+bool CreateHeadlessContext(EGLDisplay &display, EGLContext &context)
+{
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay
+		= (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress(
+			"eglGetPlatformDisplayEXT");
+	display = getPlatformDisplay
+		? getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA,
+							 EGL_DEFAULT_DISPLAY, NULL)
+		: eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	EGLint major, minor;
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+	{
+		std::cout << "ERROR::HEADLESS::EGL_INITIALIZE_FAILED" << std::endl;
+		return false;
+	}
+	eglBindAPI(EGL_OPENGL_API);
+	const EGLint contextAttributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	// nothing is presented, so no config or surface (KHR_no_config_context,
+	// KHR_surfaceless_context)
+	context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT,
+							   contextAttributes);
+	if (context == EGL_NO_CONTEXT
+		|| !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+	{
+		std::cout << "ERROR::HEADLESS::EGL_CONTEXT_FAILED" << std::endl;
+		eglTerminate(display);
+		return false;
+	}
+	return true;
+}
+
+bool WriteStatsJson(const char *path, const FrameStatsReport &report,
+					u32 width, u32 height, u32 warmupFrames)
+{
+	std::ofstream out(path);
+	if (!out)
+	{
+		std::cout << "ERROR::HEADLESS::CANNOT_WRITE " << path << std::endl;
+		return false;
+	}
+	out.setf(std::ios::fixed);
+	out.precision(4);
+	out << "{\n\"renderer\":";
+	WriteJsonString(out, (const char *)glGetString(GL_RENDERER));
+	out << ",\n\"width\":" << width << ",\"height\":" << height
+		<< ",\"frames\":" << report.frames
+		<< ",\"warmupFrames\":" << warmupFrames;
+	out << ",\n\"frameMs\":";
+	WriteJsonPercentiles(out, report.cpuFrame);
+	out << ",\n\"hitches\":" << report.hitches
+		<< ",\"hitchMs\":" << report.hitchMs;
+	out << ",\n\"drawsPerFrame\":" << report.draws
+		<< ",\"trianglesPerFrame\":" << report.triangles;
+	out << ",\n\"passes\":[";
+	for (size_t i = 0; i < report.passes.size(); i++)
+	{
+		const PassStatsReport &pass = report.passes[i];
+		out << (i ? ",\n" : "\n") << "{\"name\":";
+		WriteJsonString(out, pass.name);
+		out << ",\"cpuMs\":";
+		WriteJsonPercentiles(out, pass.cpu);
+		out << ",\"gpuMs\":";
+		WriteJsonPercentiles(out, pass.gpu);
+		out << "}";
+	}
+	out << "\n]\n}\n";
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	u32 frames = HEADLESS_FRAMES;
+	u32 warmupFrames = HEADLESS_WARMUP_FRAMES;
+	u32 width = HEADLESS_WIDTH, height = HEADLESS_HEIGHT;
+	const char *outPath = NULL;
+	const char *tracePath = NULL;
+	const char *cameraPath = NULL;
+	bool regress = false;
+	const char *goldenDir = "golden";
+	bool updateGolden = false;
+	double timeScale = 1.0;
+	bool gpuCulling = false;
+	for (int i = 1; i < argc; i++)
+	{
+		const bool hasValue = i + 1 < argc;
+		if (!strcmp(argv[i], "--frames") && hasValue)
+			frames = (u32)atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--warmup") && hasValue)
+			warmupFrames = (u32)atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--size") && hasValue)
+			sscanf(argv[++i], "%ux%u", &width, &height);
+		else if (!strcmp(argv[i], "--out") && hasValue)
+			outPath = argv[++i];
+		else if (!strcmp(argv[i], "--trace") && hasValue)
+			tracePath = argv[++i];
+		else if (!strcmp(argv[i], "--path") && hasValue)
+			cameraPath = argv[++i];
+		else if (!strcmp(argv[i], "--gpu-culling"))
+			gpuCulling = true;
+		else if (!strcmp(argv[i], "--regress"))
+			regress = true;
+		else if (!strcmp(argv[i], "--golden") && hasValue)
+			goldenDir = argv[++i];
+		else if (!strcmp(argv[i], "--update-golden"))
+			updateGolden = true;
+		else if (!strcmp(argv[i], "--time-scale") && hasValue)
+			timeScale = atof(argv[++i]);
+		else
+		{
+			std::cout << "usage: headless [--frames N] [--warmup N] "
+						 "[--size WxH] [--out stats.json] "
+						 "[--trace trace.json] [--path camera.path] "
+						 "[--gpu-culling]\n"
+						 "       headless --regress [--golden dir] "
+						 "[--update-golden] [--time-scale x] "
+						 "[--out regression.json]"
+					  << std::endl;
+			return -1;
+		}
+	}
+	CameraReplayer replayer;
+	if (cameraPath)
+	{
+		if (!replayer.Load(cameraPath)) return -1;
+		frames = replayer.FrameCount();
+	}
+	if (!outPath) outPath = regress ? "regression.json" : "stats.json";
+	if (frames == 0 || width == 0 || height == 0 || timeScale <= 0.0)
+	{
+		std::cout << "ERROR::HEADLESS::BAD_ARGUMENTS" << std::endl;
+		return -1;
+	}
+	if (frames > FRAME_STATS_HISTORY)
+	{
+		std::cout << "only the last " << FRAME_STATS_HISTORY
+				  << " frames are kept for the stats" << std::endl;
+	}
+
+	Profiler::Instance().SetThreadName("main");
+	EGLDisplay display;
+	EGLContext context;
+	if (!CreateHeadlessContext(display, context)) return -1;
+	if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress))
+	{
+		std::cout << "Failed to initialize GLAD" << std::endl;
+		return -1;
+	}
+	if (regress)
+	{
+		std::cout << "headless: " << glGetString(GL_RENDERER)
+				  << ", regression scenes" << std::endl;
+		bool passed, onlyGoldensMissing;
+		{
+			RegressionSuite suite(goldenDir, updateGolden);
+			suite.SetTimeScale(timeScale);
+			passed = RunRegressionSuite(suite);
+			const bool written = suite.WriteJson(outPath);
+			passed = written && passed;
+			onlyGoldensMissing = written && suite.OnlyGoldensMissing();
+		}
+		if (tracePath) Profiler::Instance().WriteTrace(tracePath);
+		eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+					   EGL_NO_CONTEXT);
+		eglDestroyContext(display, context);
+		eglTerminate(display);
+		if (passed) return 0;
+		return onlyGoldensMissing ? 2 : 1;
+	}
+	std::cout << "headless: " << glGetString(GL_RENDERER) << ", " << frames
+			  << " frames at " << width << "x" << height << std::endl;
+
+	// stands in for the window's back buffer
+	u32 outputFramebuffer, outputColour;
+	glGenFramebuffers(1, &outputFramebuffer);
+	glGenRenderbuffers(1, &outputColour);
+	glBindRenderbuffer(GL_RENDERBUFFER, outputColour);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+							  GL_RENDERBUFFER, outputColour);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	std::unique_ptr<SceneRenderer> renderer(new SceneRenderer(width, height));
+	// the dynamic resolution would change the work between runs
+	renderer->SetDynamicResolution(false);
+	if (renderer->SetGpuCulling(gpuCulling) != gpuCulling)
+	{
+		std::cout << "ERROR::HEADLESS::GPU_CULLING_NOT_SUPPORTED" << std::endl;
+		return -1;
+	}
+	Camera camera;
+	// warm up frames look from where the path starts
+	if (cameraPath) replayer.Start(camera);
+	for (u32 frame = 0; frame < warmupFrames + frames; frame++)
+	{
+		PROFILE_SCOPE("frame");
+		renderer->BeginFrame();
+		if (frame == warmupFrames) renderer->Stats().Reset();
+		if (!cameraPath)
+		{
+			const u32 step = frame < warmupFrames ? 0 : frame - warmupFrames;
+			PlaceOnOrbit(camera, ORBIT_CENTRE, ORBIT_RADIUS, ORBIT_HEIGHT,
+						 (float)step / frames);
+		}
+		else if (frame >= warmupFrames)
+		{
+			replayer.Step(camera);
+		}
+		renderer->Render(camera, outputFramebuffer);
+		// in place of the swap, so the frame time covers the GPU's work
+		PROFILE_BEGIN("finish");
+		glFinish();
+		PROFILE_END();
+	}
+	// closes the last frame
+	renderer->BeginFrame();
+
+	const FrameStatsReport report = renderer->Stats().Report();
+	renderer->Stats().Print();
+	const bool written = WriteStatsJson(outPath, report, width, height,
+										warmupFrames);
+	if (tracePath) Profiler::Instance().WriteTrace(tracePath);
+
+	renderer.reset();
+	glDeleteFramebuffers(1, &outputFramebuffer);
+	glDeleteRenderbuffers(1, &outputColour);
+	eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	eglDestroyContext(display, context);
+	eglTerminate(display);
+	return written ? 0 : -1;
+}
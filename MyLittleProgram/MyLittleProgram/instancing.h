@@ -0,0 +1,191 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+#include "shader.h"
+#include "renderqueue.h"
+#include "types.h"
+
+// First of the four attribute slots used by the per-instance model matrix.
+// Below it a Mesh has position, normal and texture coordinates in slots 0-2
+// (see instancedMesh.vs), the scene's cube and quad arrays position and
+// texture coordinates in 0-1 (see instanced.vs).
+const u32 INSTANCE_MODEL_LOCATION = 3;
+
+// Per-instance model matrices in a vertex buffer, advanced once per instance
+class InstanceBuffer
+{
+public:
+	InstanceBuffer();
+	~InstanceBuffer();
+	InstanceBuffer(const InstanceBuffer &) = delete;
+	InstanceBuffer &operator=(const InstanceBuffer &) = delete;
+
+	// Replace the instance transforms. The buffer keeps its name, so VAOs it
+	// is attached to stay valid.
+	void Upload(const std::vector<glm::mat4> &transforms);
+	// Source the model matrix attribute of vao from this buffer
+	void AttachTo(VAO vao, u32 location = INSTANCE_MODEL_LOCATION) const;
+
+	// Draw every instance of the geometry in vao with a single call
+	void DrawArrays(VAO vao, GLenum mode, u32 first, u32 count) const;
+	void DrawElements(VAO vao, GLenum mode, u32 count,
+					  u32 firstIndex = 0) const;
+
+	u32 Count() const { return m_count; }
+
+private:
+	VBO m_VBO;
+	u32 m_count;
+	u32 m_capacity;
+};
+
+InstanceBuffer::InstanceBuffer() : m_count(0), m_capacity(0)
+{
+	glGenBuffers(1, &m_VBO);
+}
+
+InstanceBuffer::~InstanceBuffer()
+{
+	glDeleteBuffers(1, &m_VBO);
+}
+
+void InstanceBuffer::Upload(const std::vector<glm::mat4> &transforms)
+{
+	m_count = (u32)transforms.size();
+	glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+	if (m_count > m_capacity)
+	{
+		m_capacity = m_count;
+		glBufferData(GL_ARRAY_BUFFER, m_capacity * sizeof(glm::mat4),
+					 transforms.data(), GL_DYNAMIC_DRAW);
+	}
+	else if (m_count > 0)
+	{
+		// orphan the old storage so we don't wait on draws still reading it
+		glBufferData(GL_ARRAY_BUFFER, m_capacity * sizeof(glm::mat4), NULL,
+					 GL_DYNAMIC_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, m_count * sizeof(glm::mat4),
+						transforms.data());
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void InstanceBuffer::AttachTo(VAO vao, u32 location) const
+{
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+	// a mat4 attribute occupies four consecutive vec4 slots
+	for (u32 i = 0; i < 4; i++)
+	{
+		glEnableVertexAttribArray(location + i);
+		glVertexAttribPointer(location + i, 4, GL_FLOAT, GL_FALSE,
+							  sizeof(glm::mat4),
+							  (void *)(i * sizeof(glm::vec4)));
+		glVertexAttribDivisor(location + i, 1);
+	}
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void InstanceBuffer::DrawArrays(VAO vao, GLenum mode, u32 first,
+								u32 count) const
+{
+	if (m_count == 0) return;
+	glBindVertexArray(vao);
+	glDrawArraysInstanced(mode, first, count, m_count);
+	glBindVertexArray(0);
+}
+
+void InstanceBuffer::DrawElements(VAO vao, GLenum mode, u32 count,
+								  u32 firstIndex) const
+{
+	if (m_count == 0) return;
+	glBindVertexArray(vao);
+	glDrawElementsInstanced(mode, count, GL_UNSIGNED_INT,
+							(void *)(firstIndex * sizeof(u32)), m_count);
+	glBindVertexArray(0);
+}
+
+// Compare one glDrawArrays per object against a single instanced draw for
+// 1k, 10k and 100k copies of the geometry in vao. perDrawShader reads its
+// matrices from its PerDraw block, filled through a ring buffer as the
+// render queue does, instancedShader the model matrix from vao's instance
+// attribute. The benchmark attaches its own instance buffer to vao, so
+// attach the real one afterwards. Results go to stdout.
+void BenchmarkInstancing(VAO vao, u32 vertexCount, Shader &perDrawShader,
+						 Shader &instancedShader, const glm::mat4 &view,
+						 const glm::mat4 &projection)
+{
+	using Clock = std::chrono::high_resolution_clock;
+	const u32 instanceCounts[] = { 1000, 10000, 100000 };
+
+	InstanceBuffer instances;
+	instances.AttachTo(vao);
+	const u32 alignment = UniformBufferAlignment();
+	const u32 stride = ((u32)sizeof(PerDrawConstants) + alignment - 1)
+		/ alignment * alignment;
+	instancedShader.use();
+	instancedShader.setMat4("viewProjection", projection * view);
+	RingBuffer perDraw(GL_UNIFORM_BUFFER, stride);
+	std::cout << "instances\tper-draw (ms)\tinstanced (ms)" << std::endl;
+	for (u32 n : instanceCounts)
+	{
+		// lay the copies out on a grid in front of the camera
+		std::vector<glm::mat4> transforms(n);
+		u32 side = (u32)ceil(sqrt((double)n));
+		for (u32 i = 0; i < n; i++)
+		{
+			glm::vec3 pos((float)(i % side) - side * 0.5f,
+						  (float)(i / side) - side * 0.5f, -(float)side);
+			transforms[i] = glm::scale(glm::translate(glm::mat4(), pos),
+									   glm::vec3(0.5f));
+		}
+		instances.Upload(transforms);
+
+		glFinish();
+		Clock::time_point start = Clock::now();
+		perDrawShader.use();
+		glBindVertexArray(vao);
+		perDraw.BeginFrame(n * stride);
+		const PerDrawCamera camera = MakePerDrawCamera(view, projection);
+		std::vector<u32> offsets(n);
+		for (u32 i = 0; i < n; i++)
+		{
+			ComputePerDraw(camera, transforms[i],
+						   (PerDrawConstants *)perDraw.Allocate(
+							   sizeof(PerDrawConstants), stride, offsets[i]));
+		}
+		perDraw.Flush();
+		for (u32 i = 0; i < n; i++)
+		{
+			glBindBufferRange(GL_UNIFORM_BUFFER, PER_DRAW_UBO_BINDING,
+							  perDraw.Buffer(), offsets[i],
+							  sizeof(PerDrawConstants));
+			glDrawArrays(GL_TRIANGLES, 0, vertexCount);
+		}
+		perDraw.EndFrame();
+		glBindVertexArray(0);
+		glFinish();
+		double perDrawMs
+			= std::chrono::duration<double, std::milli>(Clock::now() - start)
+				  .count();
+
+		start = Clock::now();
+		instancedShader.use();
+		instances.DrawArrays(vao, GL_TRIANGLES, 0, vertexCount);
+		glFinish();
+		double instancedMs
+			= std::chrono::duration<double, std::milli>(Clock::now() - start)
+				  .count();
+
+		std::cout << n << "\t\t" << perDrawMs << "\t\t" << instancedMs
+				  << std::endl;
+	}
+}
@@ -0,0 +1,259 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <emmintrin.h>
+
+#include "shader.h"
+#include "lights.h"
+#include "ringbuffer.h"
+#include "types.h"
+
+// Lights the Lights block has room for, as in lighting3.fs. Multiples of 4,
+// positions are transformed four at a time.
+const u32 MAX_POINT_LIGHTS = 128;
+const u32 MAX_SPOT_LIGHTS = 32;
+// Uniform buffer binding of the Lights block
+const u32 LIGHTS_UBO_BINDING = 1;
+
+// std140 layout of lighting3.fs's Lights block, everything view space
+struct LightBlock
+{
+	glm::vec4 dirDirection;
+	glm::vec4 dirAmbient;
+	glm::vec4 dirDiffuse;
+	glm::vec4 dirSpecular;
+	// point lights, spot lights
+	glm::ivec4 lightCounts;
+	glm::vec4 pointPosition[MAX_POINT_LIGHTS];
+	// w is the shadow atlas slot, -1 for none
+	glm::vec4 pointColour[MAX_POINT_LIGHTS];
+	// constant, linear, quadratic
+	glm::vec4 pointAttenuation[MAX_POINT_LIGHTS];
+	// w is the cosine of the inner cut-off
+	glm::vec4 spotPosition[MAX_SPOT_LIGHTS];
+	// w is the cosine of the outer cut-off
+	glm::vec4 spotDirection[MAX_SPOT_LIGHTS];
+	// w is the shadow atlas slot, -1 for none
+	glm::vec4 spotColour[MAX_SPOT_LIGHTS];
+	glm::vec4 spotAttenuation[MAX_SPOT_LIGHTS];
+};
+
+// Keeps the scene's lights and hands them to the shaders as one uniform
+// block, instead of a glUniform call per light member.
+//
+// Positions and directions are kept structure-of-arrays in world space and
+// transformed to view space four lights at a time, straight into the block.
+// Colours and attenuations don't depend on the view and are kept already
+// packed, they're copied in whole. The block goes into a RingBuffer, so a
+// frame costs one write and one glBindBufferRange whatever the light count.
+//
+// Usage per frame: Upload before the lit draws, EndFrame after them.
+class LightManager
+{
+public:
+	LightManager();
+
+	void SetDirectional(const DirectionalLight &light);
+	// Returns the light's index, or -1 when the block is full
+	int AddPointLight(const PointLight &light);
+	int AddSpotLight(const SpotLight &light);
+	void SetPointLight(u32 index, const PointLight &light);
+	void SetSpotLight(u32 index, const SpotLight &light);
+	void Clear();
+
+	u32 PointLightCount() const { return m_pointCount; }
+	u32 SpotLightCount() const { return m_spotCount; }
+
+	// Write the block for this view and bind it to LIGHTS_UBO_BINDING
+	void Upload(const glm::mat4 &view);
+	// After the draws using the block
+	void EndFrame();
+
+private:
+	// out[i].xyz = transform * (x[i], y[i], z[i], w) for count lights,
+	// rounded up to a multiple of 4. out[i].w is written as 0, the spot
+	// lights fill in their cut-off there afterwards.
+	static void TransformBatch(const glm::mat4 &transform, const float *x,
+							   const float *y, const float *z, float w,
+							   u32 count, glm::vec4 *out);
+
+	DirectionalLight m_directional;
+	u32 m_pointCount;
+	u32 m_spotCount;
+	// world space, padded to a multiple of 4
+	std::vector<float> m_pointX, m_pointY, m_pointZ;
+	std::vector<float> m_spotX, m_spotY, m_spotZ;
+	std::vector<float> m_spotDirX, m_spotDirY, m_spotDirZ;
+	std::vector<glm::vec4> m_pointColour, m_pointAttenuation;
+	std::vector<glm::vec4> m_spotColour, m_spotAttenuation;
+	// inner and outer cut-offs, go in the w of position and direction
+	std::vector<float> m_spotInner, m_spotOuter;
+	u32 m_alignment;
+	RingBuffer m_buffer;
+};
+
+LightManager::LightManager()
+	: m_pointCount(0)
+	, m_spotCount(0)
+	, m_pointX(MAX_POINT_LIGHTS)
+	, m_pointY(MAX_POINT_LIGHTS)
+	, m_pointZ(MAX_POINT_LIGHTS)
+	, m_spotX(MAX_SPOT_LIGHTS)
+	, m_spotY(MAX_SPOT_LIGHTS)
+	, m_spotZ(MAX_SPOT_LIGHTS)
+	, m_spotDirX(MAX_SPOT_LIGHTS)
+	, m_spotDirY(MAX_SPOT_LIGHTS)
+	, m_spotDirZ(MAX_SPOT_LIGHTS)
+	, m_pointColour(MAX_POINT_LIGHTS)
+	, m_pointAttenuation(MAX_POINT_LIGHTS)
+	, m_spotColour(MAX_SPOT_LIGHTS)
+	, m_spotAttenuation(MAX_SPOT_LIGHTS)
+	, m_spotInner(MAX_SPOT_LIGHTS)
+	, m_spotOuter(MAX_SPOT_LIGHTS)
+	, m_alignment(UniformBufferAlignment())
+	, m_buffer(GL_UNIFORM_BUFFER,
+			   (sizeof(LightBlock) + m_alignment - 1) / m_alignment
+				   * m_alignment)
+{
+	m_directional.direction = glm::vec3(0.0f, -1.0f, 0.0f);
+	m_directional.ambient = glm::vec3(0.0f);
+	m_directional.diffuse = glm::vec3(0.0f);
+	m_directional.specular = glm::vec3(0.0f);
+}
+
+void LightManager::SetDirectional(const DirectionalLight &light)
+{
+	m_directional = light;
+}
+
+int LightManager::AddPointLight(const PointLight &light)
+{
+	if (m_pointCount == MAX_POINT_LIGHTS) return -1;
+	SetPointLight(m_pointCount, light);
+	return (int)m_pointCount++;
+}
+
+int LightManager::AddSpotLight(const SpotLight &light)
+{
+	if (m_spotCount == MAX_SPOT_LIGHTS) return -1;
+	SetSpotLight(m_spotCount, light);
+	return (int)m_spotCount++;
+}
+
+void LightManager::SetPointLight(u32 index, const PointLight &light)
+{
+	m_pointX[index] = light.position.x;
+	m_pointY[index] = light.position.y;
+	m_pointZ[index] = light.position.z;
+	m_pointColour[index] = glm::vec4(light.colour, (float)light.shadow);
+	m_pointAttenuation[index]
+		= glm::vec4(light.constant, light.linear, light.quadratic, 0.0f);
+}
+
+void LightManager::SetSpotLight(u32 index, const SpotLight &light)
+{
+	const glm::vec3 direction = glm::normalize(light.direction);
+	m_spotX[index] = light.position.x;
+	m_spotY[index] = light.position.y;
+	m_spotZ[index] = light.position.z;
+	m_spotDirX[index] = direction.x;
+	m_spotDirY[index] = direction.y;
+	m_spotDirZ[index] = direction.z;
+	m_spotInner[index] = light.innerCutOff;
+	m_spotOuter[index] = light.outerCutOff;
+	m_spotColour[index] = glm::vec4(light.colour, (float)light.shadow);
+	m_spotAttenuation[index]
+		= glm::vec4(light.constant, light.linear, light.quadratic, 0.0f);
+}
+
+void LightManager::Clear()
+{
+	m_pointCount = 0;
+	m_spotCount = 0;
+}
+
+void LightManager::TransformBatch(const glm::mat4 &transform, const float *x,
+								  const float *y, const float *z, float w,
+								  u32 count, glm::vec4 *out)
+{
+	// glm is column major, transform[c][r]
+	__m128 m[4][3];
+	for (u32 c = 0; c < 4; c++)
+	{
+		for (u32 r = 0; r < 3; r++)
+		{
+			m[c][r] = _mm_set1_ps(c < 3 ? transform[c][r]
+										: transform[c][r] * w);
+		}
+	}
+	for (u32 i = 0; i < count; i += 4)
+	{
+		const __m128 px = _mm_loadu_ps(x + i);
+		const __m128 py = _mm_loadu_ps(y + i);
+		const __m128 pz = _mm_loadu_ps(z + i);
+		__m128 v[4];
+		for (u32 r = 0; r < 3; r++)
+		{
+			v[r] = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(m[0][r], px), _mm_mul_ps(m[1][r], py)),
+				_mm_add_ps(_mm_mul_ps(m[2][r], pz), m[3][r]));
+		}
+		v[3] = _mm_setzero_ps();
+		// four x, four y, four z to four xyz0
+		_MM_TRANSPOSE4_PS(v[0], v[1], v[2], v[3]);
+		for (u32 lane = 0; lane < 4; lane++)
+		{
+			_mm_storeu_ps(&out[i + lane].x, v[lane]);
+		}
+	}
+}
+
+void LightManager::Upload(const glm::mat4 &view)
+{
+	m_buffer.BeginFrame();
+	u32 offset;
+	LightBlock *block = (LightBlock *)m_buffer.Allocate(sizeof(LightBlock),
+														 m_alignment, offset);
+
+	block->dirDirection
+		= glm::vec4(glm::mat3(view) * m_directional.direction, 0.0f);
+	block->dirAmbient = glm::vec4(m_directional.ambient, 0.0f);
+	block->dirDiffuse = glm::vec4(m_directional.diffuse, 0.0f);
+	block->dirSpecular = glm::vec4(m_directional.specular, 0.0f);
+	block->lightCounts = glm::ivec4(m_pointCount, m_spotCount, 0, 0);
+
+	// only the lights in use, the shader doesn't look past the counts
+	TransformBatch(view, m_pointX.data(), m_pointY.data(), m_pointZ.data(),
+				   1.0f, m_pointCount, block->pointPosition);
+	memcpy(block->pointColour, m_pointColour.data(),
+		   m_pointCount * sizeof(glm::vec4));
+	memcpy(block->pointAttenuation, m_pointAttenuation.data(),
+		   m_pointCount * sizeof(glm::vec4));
+
+	TransformBatch(view, m_spotX.data(), m_spotY.data(), m_spotZ.data(),
+				   1.0f, m_spotCount, block->spotPosition);
+	TransformBatch(view, m_spotDirX.data(), m_spotDirY.data(),
+				   m_spotDirZ.data(), 0.0f, m_spotCount, block->spotDirection);
+	for (u32 i = 0; i < m_spotCount; i++)
+	{
+		block->spotPosition[i].w = m_spotInner[i];
+		block->spotDirection[i].w = m_spotOuter[i];
+	}
+	memcpy(block->spotColour, m_spotColour.data(),
+		   m_spotCount * sizeof(glm::vec4));
+	memcpy(block->spotAttenuation, m_spotAttenuation.data(),
+		   m_spotCount * sizeof(glm::vec4));
+
+	m_buffer.Flush();
+	glBindBufferRange(GL_UNIFORM_BUFFER, LIGHTS_UBO_BINDING, m_buffer.Buffer(),
+					  offset, sizeof(LightBlock));
+}
+
+void LightManager::EndFrame()
+{
+	m_buffer.EndFrame();
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+
+// A light's range ends where its attenuated brightness drops below this,
+// about 5/256 of the brightest channel
+const float LIGHT_CUTOFF = 5.0f / 256.0f;
+
+// Light description shared by the lighting paths. Attenuation is the same
+// constant/linear/quadratic falloff as lighting3.fs, colour is used for both
+// diffuse and specular.
+struct PointLight
+{
+	glm::vec3 position;
+	glm::vec3 colour;
+	float constant = 1.0f;
+	float linear = 0.35f;
+	float quadratic = 0.44f;
+	// slot in the shadow atlas, -1 when unshadowed
+	int shadow = -1;
+};
+
+// Cone light, attenuated like PointLight. Cut-offs are cosines of the angles
+// from direction, the light fades out between inner and outer as in
+// lighting3.fs.
+struct SpotLight
+{
+	glm::vec3 position;
+	glm::vec3 direction;
+	glm::vec3 colour;
+	float innerCutOff = 0.95f;
+	float outerCutOff = 0.9f;
+	float constant = 1.0f;
+	float linear = 0.35f;
+	float quadratic = 0.44f;
+	// slot in the shadow atlas, -1 when unshadowed
+	int shadow = -1;
+};
+
+struct DirectionalLight
+{
+	glm::vec3 direction;
+	glm::vec3 ambient;
+	glm::vec3 diffuse;
+	glm::vec3 specular;
+};
+
+// Distance at which the light's contribution falls under LIGHT_CUTOFF, the
+// radius of its light volume
+float AttenuationRadius(const glm::vec3 &colour, float constant, float linear,
+						float quadratic)
+{
+	const float brightest = std::max(std::max(colour.r, colour.g), colour.b);
+	// solve brightest / (c + l*d + q*d^2) = cutoff for d
+	const float c = constant - brightest / LIGHT_CUTOFF;
+	if (quadratic <= 0.0f)
+	{
+		return linear > 0.0f ? -c / linear : 1.0e6f;
+	}
+	return (-linear + std::sqrt(linear * linear - 4.0f * quadratic * c))
+		/ (2.0f * quadratic);
+}
+
+float PointLightRadius(const PointLight &light)
+{
+	return AttenuationRadius(light.colour, light.constant, light.linear,
+							 light.quadratic);
+}
+
+// Smallest sphere around the lit part of a spot light's cone, as centre and
+// radius. Narrow cones get the sphere through the apex and the rim of the
+// cone, wide ones the sphere around the apex.
+glm::vec4 SpotLightBounds(const SpotLight &light)
+{
+	const float range = AttenuationRadius(light.colour, light.constant,
+										  light.linear, light.quadratic);
+	const float cosOuter = std::max(light.outerCutOff, 0.0f);
+	if (cosOuter < 0.70710678f)
+	{
+		return glm::vec4(light.position, range);
+	}
+	const float radius = range / (2.0f * cosOuter);
+	return glm::vec4(light.position + glm::normalize(light.direction) * radius,
+					 radius);
+}
@@ -1,25 +1,22 @@
-#include <vector>
 #include <string>
+#include <memory>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
-#include "stb_image.h"
 
-#include <glm/glm.hpp>
-#include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtc/type_ptr.hpp>
-
-#include "shader.h"
+#include "scenerenderer.h"
 #include "camera.h"
-#include "model.h"
+#include "camerapath.h"
+#include "profiler.h"
 
 #include <iostream>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
+void key_callback(GLFWwindow* window, int key, int scancode, int action,
+				  int mods);
 void processInput(GLFWwindow *window);
-unsigned int loadTexture(const char *path);
-unsigned int loadCubemap(std::vector<std::string> faces);
+void moveCamera(Camera_Movement direction);
 
 // settings
 unsigned int g_windowWidth = 1280;
@@ -36,19 +33,39 @@ float lastX = (float)g_vPortWidth  / 2.0;
 float lastY = (float)g_vPortHeight / 2.0;
 bool firstMouse = true;
 
-// framebuffer
-unsigned int g_framebuffer;
-unsigned int g_framebufferColTex;
-unsigned int g_framebufferDpStRbo;
+// post-processing, toggled with 1 and 2
+bool g_postSharpen = false;
+bool g_postVignette = false;
+
+// dynamic resolution, toggled with 3
+bool g_dynamicResolution = true;
+
+// GPU culling in place of the occlusion culling, toggled with 8, GL 4.3 only
+bool g_gpuCulling = false;
+
+// frame stats, printed with 4
+bool g_printFrameStats = false;
+// profiler trace, written with 5 and on exit
+bool g_writeTrace = false;
+const char *TRACE_PATH = "trace.json";
+
+// camera path, recording toggled with 6 and replayed with 7. The replay
+// takes over the camera, with the frame stats reset to cover just it.
+CameraRecorder g_cameraRecorder;
+CameraReplayer g_cameraReplayer;
+bool g_toggleRecording = false;
+bool g_startReplay = false;
+bool g_replaying = false;
+const char *CAMERA_PATH_FILE = "camera.path";
 
 // timing
 float deltaTime = 0.0f;
-float lastFrame = 0.0f;
 
 int main()
 {
     // glfw: initialize and configure
     // ------------------------------
+	Profiler::Instance().SetThreadName("main");
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -71,6 +88,7 @@ int main()
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
+	glfwSetKeyCallback(window, key_callback);
 
     // tell GLFW to capture our mouse
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
@@ -83,382 +101,104 @@ int main()
         return -1;
     }
 
-	// create secondary framebuffer
+	// the scene, its resources and the passes that render it
 	// -----------------------------
-	glGenFramebuffers(1, &g_framebuffer);
-	glBindFramebuffer(GL_FRAMEBUFFER, g_framebuffer);
-	// add a colour texture attachment
-	glGenTextures(1, &g_framebufferColTex);
-	glBindTexture(GL_TEXTURE_2D, g_framebufferColTex);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, g_vPortWidth, g_vPortHeight, 0,
-				 GL_RGB, GL_UNSIGNED_BYTE, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR); // not optional!
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
-                           g_framebufferColTex, 0);
-	glBindTexture(GL_TEXTURE_2D, 0);
-	// add a depth/stencil renderbuffer attachment
-	glGenRenderbuffers(1, &g_framebufferDpStRbo);
-	glBindRenderbuffer(GL_RENDERBUFFER, g_framebufferDpStRbo);
-	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, g_vPortWidth,
-						  g_vPortHeight);
-	glBindRenderbuffer(GL_RENDERBUFFER, 0);
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
-							  GL_RENDERBUFFER, g_framebufferDpStRbo);
-	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-	{
-		std::cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!"
-				  << std::endl;
-	}
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-
-	// build and compile shaders
-    // -------------------------
-    Shader normalShader("shaders/normal.vs", "shaders/normal.fs");
-	Shader shaderSingleColor("shaders/normal.vs", "shaders/shaderSingleColor.fs");
-	Shader fullScreenQuad("shaders/fullScreenQuad.vs", "shaders/fullScreenQuad.fs");
-	Shader skyboxShader("shaders/skybox.vs", "shaders/skybox.fs");
-
-    // set up vertex data (and buffer(s)) and configure vertex attributes
-    // ------------------------------------------------------------------
-	float cubeVertices[] = {
-		// Back face
-		-0.5f, -0.5f, -0.5f,  0.0f, 0.0f, // Bottom-left
-		0.5f,  0.5f, -0.5f,  1.0f, 1.0f, // top-right
-		0.5f, -0.5f, -0.5f,  1.0f, 0.0f, // bottom-right         
-		0.5f,  0.5f, -0.5f,  1.0f, 1.0f, // top-right
-		-0.5f, -0.5f, -0.5f,  0.0f, 0.0f, // bottom-left
-		-0.5f,  0.5f, -0.5f,  0.0f, 1.0f, // top-left
-										  // Front face
-		-0.5f, -0.5f,  0.5f,  0.0f, 0.0f, // bottom-left
-		0.5f, -0.5f,  0.5f,  1.0f, 0.0f, // bottom-right
-		0.5f,  0.5f,  0.5f,  1.0f, 1.0f, // top-right
-		0.5f,  0.5f,  0.5f,  1.0f, 1.0f, // top-right
-		-0.5f,  0.5f,  0.5f,  0.0f, 1.0f, // top-left
-		-0.5f, -0.5f,  0.5f,  0.0f, 0.0f, // bottom-left
-										  // Left face
-		-0.5f,  0.5f,  0.5f,  1.0f, 0.0f, // top-right
-		-0.5f,  0.5f, -0.5f,  1.0f, 1.0f, // top-left
-		-0.5f, -0.5f, -0.5f,  0.0f, 1.0f, // bottom-left
-		-0.5f, -0.5f, -0.5f,  0.0f, 1.0f, // bottom-left
-		-0.5f, -0.5f,  0.5f,  0.0f, 0.0f, // bottom-right
-		-0.5f,  0.5f,  0.5f,  1.0f, 0.0f, // top-right
-										  // Right face
-		0.5f,  0.5f,  0.5f,  1.0f, 0.0f, // top-left
-		0.5f, -0.5f, -0.5f,  0.0f, 1.0f, // bottom-right
-		0.5f,  0.5f, -0.5f,  1.0f, 1.0f, // top-right         
-		0.5f, -0.5f, -0.5f,  0.0f, 1.0f, // bottom-right
-		0.5f,  0.5f,  0.5f,  1.0f, 0.0f, // top-left
-		0.5f, -0.5f,  0.5f,  0.0f, 0.0f, // bottom-left     
-										 // Bottom face
-		-0.5f, -0.5f, -0.5f,  0.0f, 1.0f, // top-right
-		0.5f, -0.5f, -0.5f,  1.0f, 1.0f, // top-left
-		0.5f, -0.5f,  0.5f,  1.0f, 0.0f, // bottom-left
-		0.5f, -0.5f,  0.5f,  1.0f, 0.0f, // bottom-left
-		-0.5f, -0.5f,  0.5f,  0.0f, 0.0f, // bottom-right
-		-0.5f, -0.5f, -0.5f,  0.0f, 1.0f, // top-right
-										  // Top face
-		-0.5f,  0.5f, -0.5f,  0.0f, 1.0f, // top-left
-		0.5f,  0.5f,  0.5f,  1.0f, 0.0f, // bottom-right
-		0.5f,  0.5f, -0.5f,  1.0f, 1.0f, // top-right     
-		0.5f,  0.5f,  0.5f,  1.0f, 0.0f, // bottom-right
-		-0.5f,  0.5f, -0.5f,  0.0f, 1.0f, // top-left
-		-0.5f,  0.5f,  0.5f,  0.0f, 0.0f  // bottom-left        
-	};
-    float planeVertices[] = {
-        // positions          // texture Coords (note we set these higher than 1 (together with GL_REPEAT as texture wrapping mode). this will cause the floor texture to repeat)
-        -5.0f, -0.5f,  5.0f,  0.0f, 0.0f,
-         5.0f, -0.5f,  5.0f,  2.0f, 0.0f,
-        -5.0f, -0.5f, -5.0f,  0.0f, 2.0f,
-
-        -5.0f, -0.5f, -5.0f,  0.0f, 2.0f,
-         5.0f, -0.5f,  5.0f,  2.0f, 0.0f,
-         5.0f, -0.5f, -5.0f,  2.0f, 2.0f								
-    };
-	float skyboxVertices[] = {
-		// positions          
-		-1.0f,  1.0f, -1.0f,
-		-1.0f, -1.0f, -1.0f,
-		1.0f, -1.0f, -1.0f,
-		1.0f, -1.0f, -1.0f,
-		1.0f,  1.0f, -1.0f,
-		-1.0f,  1.0f, -1.0f,
-
-		-1.0f, -1.0f,  1.0f,
-		-1.0f, -1.0f, -1.0f,
-		-1.0f,  1.0f, -1.0f,
-		-1.0f,  1.0f, -1.0f,
-		-1.0f,  1.0f,  1.0f,
-		-1.0f, -1.0f,  1.0f,
-
-		1.0f, -1.0f, -1.0f,
-		1.0f, -1.0f,  1.0f,
-		1.0f,  1.0f,  1.0f,
-		1.0f,  1.0f,  1.0f,
-		1.0f,  1.0f, -1.0f,
-		1.0f, -1.0f, -1.0f,
-
-		-1.0f, -1.0f,  1.0f,
-		-1.0f,  1.0f,  1.0f,
-		1.0f,  1.0f,  1.0f,
-		1.0f,  1.0f,  1.0f,
-		1.0f, -1.0f,  1.0f,
-		-1.0f, -1.0f,  1.0f,
-
-		-1.0f,  1.0f, -1.0f,
-		1.0f,  1.0f, -1.0f,
-		1.0f,  1.0f,  1.0f,
-		1.0f,  1.0f,  1.0f,
-		-1.0f,  1.0f,  1.0f,
-		-1.0f,  1.0f, -1.0f,
-
-		-1.0f, -1.0f, -1.0f,
-		-1.0f, -1.0f,  1.0f,
-		1.0f, -1.0f, -1.0f,
-		1.0f, -1.0f, -1.0f,
-		-1.0f, -1.0f,  1.0f,
-		1.0f, -1.0f,  1.0f
-	};
-	// Full screen quad in NDC
-	float quadVertices[] = {
-		// positions   // texCoords
-		-1.0f,  1.0f,  0.0f, 1.0f,
-		-1.0f, -1.0f,  0.0f, 0.0f,
-		1.0f, -1.0f,  1.0f, 0.0f,
-
-		-1.0f,  1.0f,  0.0f, 1.0f,
-		1.0f, -1.0f,  1.0f, 0.0f,
-		1.0f,  1.0f,  1.0f, 1.0f
-	};
-    
-    std::vector<glm::vec3> vegetation;
-	vegetation.push_back(glm::vec3(-1.5f, 0.0f, -0.48f));
-	vegetation.push_back(glm::vec3(1.5f, 0.0f, 0.51f));
-	vegetation.push_back(glm::vec3(0.0f, 0.0f, 0.7f));
-	vegetation.push_back(glm::vec3(-0.3f, 0.0f, -2.3f));
-	vegetation.push_back(glm::vec3(0.5f, 0.0f, -0.6f));  
-    
-    // cube VAO
-    unsigned int cubeVAO, cubeVBO;
-    glGenVertexArrays(1, &cubeVAO);
-    glGenBuffers(1, &cubeVBO);
-    glBindVertexArray(cubeVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVertices), &cubeVertices, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-    glBindVertexArray(0);
-    // plane VAO
-    unsigned int planeVAO, planeVBO;
-    glGenVertexArrays(1, &planeVAO);
-    glGenBuffers(1, &planeVBO);
-    glBindVertexArray(planeVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, planeVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(planeVertices), &planeVertices, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-    glBindVertexArray(0);
-	// full screen quad VAO
-	unsigned int quadVAO, quadVBO;
-	glGenVertexArrays(1, &quadVAO);
-	glGenBuffers(1, &quadVBO);
-	glBindVertexArray(quadVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
-	glBindVertexArray(0);
-	// skybox VAO
-	unsigned int skyboxVAO, skyboxVBO;
-	glGenVertexArrays(1, &skyboxVAO);
-	glGenBuffers(1, &skyboxVBO);
-	glBindVertexArray(skyboxVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-	glBindVertexArray(0);
-
-    // load textures
-    // -------------
-    unsigned int cubeTexture  = loadTexture("assets/shrug.jpg");
-    unsigned int floorTexture = loadTexture("assets/container.jpg");
-	std::vector<std::string> skyboxFaces{
-		"assets/skycubemap/right.jpg", "assets/skycubemap/left.jpg",
-		"assets/skycubemap/top.jpg",   "assets/skycubemap/bottom.jpg",
-		"assets/skycubemap/back.jpg",  "assets/skycubemap/front.jpg"
-	};
-	unsigned int cubemapTexture = loadCubemap(skyboxFaces);
-
-	// shader configuration
-    // --------------------
-    normalShader.use();
-    normalShader.setInt("texture1", 0);
-    fullScreenQuad.use();
-    fullScreenQuad.setInt("screenTexture", 0); // optional
-	fullScreenQuad.setFloat("screenWidth", g_vPortWidth);
-	fullScreenQuad.setFloat("screenHeight", g_vPortHeight);
+	std::unique_ptr<SceneRenderer> renderer(
+		new SceneRenderer(g_vPortWidth, g_vPortHeight));
+	// stats in the window title, refreshed once a second
+	double lastTitleTime = 0.0;
 
     // render loop
     // -----------
     while(!glfwWindowShouldClose(window))
     {
+		PROFILE_SCOPE("frame");
         // per-frame time logic
         // --------------------
-        float currentFrame = glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
+		renderer->BeginFrame();
+		deltaTime = (float)(renderer->Stats().FrameMs() / 1000.0);
+		const double currentFrame = glfwGetTime();
+		if (g_printFrameStats)
+		{
+			renderer->Stats().Print();
+			g_printFrameStats = false;
+		}
+		if (g_writeTrace)
+		{
+			Profiler::Instance().WriteTrace(TRACE_PATH);
+			g_writeTrace = false;
+		}
+
+		if (g_toggleRecording)
+		{
+			g_toggleRecording = false;
+			if (g_cameraRecorder.IsRecording())
+			{
+				g_cameraRecorder.End();
+				if (g_cameraRecorder.Save(CAMERA_PATH_FILE))
+				{
+					std::cout << "camera path: " << g_cameraRecorder.FrameCount()
+							  << " frames saved to " << CAMERA_PATH_FILE
+							  << std::endl;
+				}
+			}
+			else if (!g_replaying)
+			{
+				g_cameraRecorder.Begin(camera);
+			}
+		}
+		if (g_startReplay && !g_replaying && !g_cameraRecorder.IsRecording()
+			&& g_cameraReplayer.Load(CAMERA_PATH_FILE))
+		{
+			g_cameraReplayer.Start(camera);
+			renderer->Stats().Reset();
+			g_replaying = true;
+		}
+		g_startReplay = false;
 
         // input
         // -----
         processInput(window);
+		// a replay moves the camera one recorded frame per frame, however
+		// long the frame took
+		if (g_replaying && !g_cameraReplayer.Step(camera))
+		{
+			// the last replayed frame was closed by BeginFrame
+			g_replaying = false;
+			std::cout << "camera path: replayed "
+					  << g_cameraReplayer.FrameCount() << " frames"
+					  << std::endl;
+			renderer->Stats().Print();
+		}
+		g_cameraRecorder.EndFrame(camera, deltaTime);
 
-        // RENDER
+        // render to the window, upscaled from the dynamic resolution
         // ------
-
-		// 1. first pass to off screen buffer
-        // ----------------------------------
-		glBindFramebuffer(GL_FRAMEBUFFER, g_framebuffer);
-        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-		glClearStencil(0);
-		glStencilMask(0xFF);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
-		glStencilMask(0x00);
-
-		glStencilOp(GL_KEEP, GL_REPLACE, GL_REPLACE);
-		glViewport(0, 0, g_vPortWidth, g_vPortHeight);
-
-        // vertex shader uniforms
-        glm::mat4 model;
-        glm::mat4 view = camera.GetViewMatrix();
-        glm::mat4 projection = glm::perspective(
-            glm::radians(camera.Zoom),
-            (float)g_vPortWidth / (float)g_vPortHeight, 0.1f, 100.0f);
-        normalShader.use();
-        normalShader.setMat4("view", view);
-        normalShader.setMat4("projection", projection);
-        shaderSingleColor.use();
-        shaderSingleColor.setMat4("view", view);
-        shaderSingleColor.setMat4("projection", projection);
-        skyboxShader.use();
-		// carve off translation component of the view matrix to center skybox
-		// at eye position always
-		skyboxShader.setMat4("view", glm::mat4(glm::mat3(view))); 
-        skyboxShader.setMat4("projection", projection);
-
-        glEnable(GL_DEPTH_TEST);
-        glEnable(GL_CULL_FACE);
-        // cubes
-        // all fragments are drawn and update stencil buffer to 1
-		glEnable(GL_STENCIL_TEST);
-		glStencilFunc(GL_ALWAYS, 1, 0xFF); 
-		glStencilMask(0xFF); // enable write to the stencil buffer
-		normalShader.use();
-        glBindVertexArray(cubeVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, cubeTexture); 	
-		model = glm::mat4();
-        model = glm::translate(model, glm::vec3(-1.0f, 0.0001f, -1.0f));
-        normalShader.setMat4("model", model);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        model = glm::mat4();
-        model = glm::translate(model, glm::vec3(2.0f, 0.0001f, 0.0f));
-        normalShader.setMat4("model", model);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-		glStencilMask(0x00); // disable write to the stencil buffer
-        
-		// floor
-		glDisable(GL_CULL_FACE);
-		normalShader.use();
-		glBindVertexArray(planeVAO);
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, floorTexture);
-		normalShader.setMat4("model", glm::mat4());
-		glDrawArrays(GL_TRIANGLES, 0, 6);
-		glBindVertexArray(0);
-		glEnable(GL_CULL_FACE);
-
-		// HUD
-		// only fragments "outside" the cube are drawn
-		glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
-		glDepthFunc(GL_ALWAYS);
-
-		// draw two slightly larger cubes
-		shaderSingleColor.use();
-		const float outlineSF = 1.04f;
-		glBindVertexArray(cubeVAO);
-		model = glm::mat4();
-		model = glm::translate(model, glm::vec3(-1.0f, 0.0001f, -1.0f));
-		model = glm::scale(model, glm::vec3(outlineSF, outlineSF, outlineSF));
-		shaderSingleColor.setMat4("model", model);
-		glDrawArrays(GL_TRIANGLES, 0, 36);
-		model = glm::mat4();
-		model = glm::translate(model, glm::vec3(2.0f, 0.0001f, 0.0f));
-		model = glm::scale(model, glm::vec3(outlineSF, outlineSF, outlineSF));
-		shaderSingleColor.setMat4("model", model);
-		glDrawArrays(GL_TRIANGLES, 0, 36);
-		glStencilFunc(GL_ALWAYS, 0, 0xFF);
-		glDepthFunc(GL_LESS);
-
-        // Draw skybox last to optimised fragment discard due to depth testing
-        glDepthFunc(GL_LEQUAL);
-        skyboxShader.use();
-        glBindVertexArray(skyboxVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-
-
-		// 2. second pass to draw full screen quad
-        // ---------------------------------------
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		glClearColor(0.0f, 0.2f, 0.3f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT);
-		glDisable(GL_DEPTH_TEST);
-		glDisable(GL_STENCIL_TEST);
-		glDisable(GL_CULL_FACE);
-		glViewport(VPORT_X_OFFSET, VPORT_Y_OFFSET, g_vPortWidth, g_vPortHeight);
-
-		fullScreenQuad.use();
-		glBindVertexArray(quadVAO);
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, g_framebufferColTex);
-		glDrawArrays(GL_TRIANGLES, 0, 6);
-
+		renderer->SetOutput(VPORT_X_OFFSET, VPORT_Y_OFFSET, g_vPortWidth,
+						   g_vPortHeight);
+		renderer->SetPostEffects(g_postSharpen, g_postVignette);
+		// replays at a fixed resolution, so they render the same frames
+		renderer->SetDynamicResolution(g_dynamicResolution && !g_replaying);
+		renderer->SetGpuCulling(g_gpuCulling);
+		renderer->Render(camera, 0);
+
+		if (currentFrame - lastTitleTime >= 1.0)
+		{
+			lastTitleTime = currentFrame;
+			std::string title = "LearnOpenGL - " + renderer->StatusText();
+			glfwSetWindowTitle(window, title.c_str());
+		}
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
+		PROFILE_BEGIN("swap");
         glfwSwapBuffers(window);
+		PROFILE_END();
         glfwPollEvents();
     }
-
-    // optional: de-allocate all resources once they've outlived their purpose:
-    // ------------------------------------------------------------------------
-    glDeleteVertexArrays(1, &cubeVAO);
-    glDeleteVertexArrays(1, &planeVAO);
-    glDeleteVertexArrays(1, &quadVAO);
-    glDeleteVertexArrays(1, &skyboxVAO);
-
-    glDeleteBuffers(1, &cubeVBO);
-    glDeleteBuffers(1, &planeVBO);
-    glDeleteBuffers(1, &quadVBO);
-    glDeleteBuffers(1, &skyboxVBO);
-
-	glDeleteTextures(1, &cubeTexture);
-	glDeleteTextures(1, &floorTexture);
-
-	glDeleteFramebuffers(1, &g_framebuffer);
-	glDeleteTextures(1, &g_framebufferColTex);
-	glDeleteRenderbuffers(1, &g_framebufferDpStRbo);
+	Profiler::Instance().WriteTrace(TRACE_PATH);
+	// its GL objects go before the context does
+	renderer.reset();
 
     glfwTerminate();
     return 0;
@@ -470,19 +210,53 @@ void processInput(GLFWwindow *window)
 {
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
+	if (g_replaying) return;
 
     if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-        camera.ProcessKeyboard(FORWARD, deltaTime);
+        moveCamera(FORWARD);
     if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-        camera.ProcessKeyboard(BACKWARD, deltaTime);
+        moveCamera(BACKWARD);
     if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-        camera.ProcessKeyboard(LEFT, deltaTime);
+        moveCamera(LEFT);
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-        camera.ProcessKeyboard(RIGHT, deltaTime);
+        moveCamera(RIGHT);
 	if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS)
-		camera.ProcessKeyboard(DOWN, deltaTime);
+		moveCamera(DOWN);
 	if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS)
-		camera.ProcessKeyboard(UP, deltaTime);
+		moveCamera(UP);
+}
+
+// camera input goes through the recorder, which ignores it unless recording
+void moveCamera(Camera_Movement direction)
+{
+	camera.ProcessKeyboard(direction, deltaTime);
+	g_cameraRecorder.AddMove(direction);
+}
+
+// glfw: toggle the post-processing passes, dynamic resolution and GPU
+// culling, print the frame stats, write the profiler trace, record and
+// replay the camera path
+// ---------------------------------------
+void key_callback(GLFWwindow* window, int key, int scancode, int action,
+				  int mods)
+{
+	if (action != GLFW_PRESS) return;
+	if (key == GLFW_KEY_1)
+		g_postSharpen = !g_postSharpen;
+	if (key == GLFW_KEY_2)
+		g_postVignette = !g_postVignette;
+	if (key == GLFW_KEY_3)
+		g_dynamicResolution = !g_dynamicResolution;
+	if (key == GLFW_KEY_4)
+		g_printFrameStats = true;
+	if (key == GLFW_KEY_5)
+		g_writeTrace = true;
+	if (key == GLFW_KEY_6)
+		g_toggleRecording = true;
+	if (key == GLFW_KEY_7)
+		g_startReplay = true;
+	if (key == GLFW_KEY_8)
+		g_gpuCulling = !g_gpuCulling;
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
@@ -495,40 +269,8 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
     g_windowHeight = height;
 	g_vPortWidth = g_windowWidth - VPORT_BORDER*2;
 	g_vPortHeight = g_windowHeight - VPORT_BORDER*2;
-    
-    // recreate secondary framebuffer
-    glBindFramebuffer(GL_FRAMEBUFFER, g_framebuffer);
-
-	// destroy old framebuffer tex and rbo
-	glDeleteTextures(1, &g_framebufferColTex);
-	glDeleteRenderbuffers(1, &g_framebufferDpStRbo);
-
-    // Create new framebuffer tex and rbo with new viewport dimensions
-    glGenTextures(1, &g_framebufferColTex);
-    glBindTexture(GL_TEXTURE_2D, g_framebufferColTex);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, g_vPortWidth, g_vPortHeight, 0,
-                 GL_RGB, GL_UNSIGNED_BYTE, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
-						   g_framebufferColTex, 0);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    // add a depth/stencil renderbuffer attachment
-    glGenRenderbuffers(1, &g_framebufferDpStRbo);
-    glBindRenderbuffer(GL_RENDERBUFFER, g_framebufferDpStRbo);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, g_vPortWidth,
-                          g_vPortHeight);
-    glBindRenderbuffer(GL_RENDERBUFFER, 0);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
-                              GL_RENDERBUFFER, g_framebufferDpStRbo);
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-    {
-        std::cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!"
-                  << std::endl;
-    }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	// the scene target picks the new size up at the start of the next frame,
+	// so a drag that fires many of these only reallocates once, if at all
 }
 
 // glfw: whenever the mouse moves, this callback is called
@@ -548,85 +290,16 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos)
     lastX = xpos;
     lastY = ypos;
 
+	if (g_replaying) return;
     camera.ProcessMouseMovement(xoffset, yoffset);
+	g_cameraRecorder.AddMouse(xoffset, yoffset);
 }
 
 // glfw: whenever the mouse scroll wheel scrolls, this callback is called
 // ----------------------------------------------------------------------
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
+	if (g_replaying) return;
     camera.ProcessMouseScroll(yoffset);
-}
-
-// utility function for loading a 2D texture from file
-// ---------------------------------------------------
-unsigned int loadTexture(char const *path)
-{
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-	stbi_set_flip_vertically_on_load(true);
-    unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
-}
-
-unsigned int loadCubemap(std::vector<std::string> faces)
-{
-	unsigned int textureID;
-	glGenTextures(1, &textureID);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-	int width, height, nrChannels;
-	stbi_set_flip_vertically_on_load(false);
-	for (unsigned int i = 0; i < faces.size(); i++)
-	{
-		unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-		if (data)
-		{
-			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
-						 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data
-						 );
-			stbi_image_free(data);
-		}
-		else
-		{
-			std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-			stbi_image_free(data);
-		}
-	}
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-	return textureID;
+	g_cameraRecorder.AddScroll(yoffset);
 }
@@ -6,6 +6,8 @@
 #include <string>
 
 #include "shader.h"
+#include "instancing.h"
+#include "bounds.h"
 
 struct Vertex
 {
@@ -36,17 +38,35 @@ public:
 	Mesh(const std::vector<Vertex> &vertices, const std::vector<u32> &indices,
 		 const std::vector<Texture> &textures);
 	~Mesh();
+	// meshes own their GL objects, so they can be moved but not copied
+	Mesh(Mesh &&other) noexcept;
+	Mesh(const Mesh &) = delete;
+	Mesh &operator=(const Mesh &) = delete;
 
 	void Draw(Shader shader) const;
+	// Draw one copy of the mesh per transform in instances in a single call.
+	// shader reads the model matrix at INSTANCE_MODEL_LOCATION, as
+	// instancedMesh.vs does.
+	void DrawInstanced(Shader shader, const InstanceBuffer &instances) const;
+	// Positions only, for depth-only passes like shadow maps
+	void DrawDepth() const;
+	// VAO with just the positions at location 0, tightly packed in their own
+	// buffer so depth passes don't fetch normals and texture coordinates
+	u32 DepthVAO() const { return m_depthVAO; }
+	u32 IndexCount() const { return (u32)m_indices.size(); }
 
 	std::vector<Vertex> m_vertices;
 	std::vector<u32> m_indices;
 	std::vector<Texture> m_textures;
+	// object space bounds of m_vertices
+	Bounds m_bounds;
 
 private:
 	void SetupMesh();
+	void BindTextures(Shader &shader) const;
 
 	u32 m_VAO, m_VBO, m_EBO;
+	u32 m_depthVAO, m_positionVBO;
 };
 
 Mesh::Mesh(const std::vector<Vertex> &vertices, const std::vector<u32> &indices,
@@ -55,14 +75,35 @@ Mesh::Mesh(const std::vector<Vertex> &vertices, const std::vector<u32> &indices,
 	, m_indices(indices)
 	, m_textures(textures)
 {
+	m_bounds = ComputeBounds(
+		(const glm::vec3 *)((const char *)m_vertices.data()
+							+ offsetof(Vertex, Position)),
+		m_vertices.size(), sizeof(Vertex));
 	SetupMesh();
 }
 
+Mesh::Mesh(Mesh &&other) noexcept
+	: m_vertices(std::move(other.m_vertices))
+	, m_indices(std::move(other.m_indices))
+	, m_textures(std::move(other.m_textures))
+	, m_bounds(other.m_bounds)
+	, m_VAO(other.m_VAO)
+	, m_VBO(other.m_VBO)
+	, m_EBO(other.m_EBO)
+	, m_depthVAO(other.m_depthVAO)
+	, m_positionVBO(other.m_positionVBO)
+{
+	other.m_VAO = other.m_VBO = other.m_EBO = 0;
+	other.m_depthVAO = other.m_positionVBO = 0;
+}
+
 Mesh::~Mesh()
 {
 	glDeleteVertexArrays(1, &m_VAO);
 	glDeleteBuffers(1, &m_VBO);
 	glDeleteBuffers(1, &m_EBO);
+	glDeleteVertexArrays(1, &m_depthVAO);
+	glDeleteBuffers(1, &m_positionVBO);
 }
 
 void Mesh::SetupMesh()
@@ -90,10 +131,53 @@ void Mesh::SetupMesh()
 	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
 						  (void *)offsetof(Vertex, TexCoords));
 
+	// position-only stream sharing the index buffer
+	std::vector<glm::vec3> positions(m_vertices.size());
+	for (size_t i = 0; i < m_vertices.size(); i++)
+	{
+		positions[i] = m_vertices[i].Position;
+	}
+	glGenVertexArrays(1, &m_depthVAO);
+	glGenBuffers(1, &m_positionVBO);
+	glBindVertexArray(m_depthVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, m_positionVBO);
+	glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3),
+				 positions.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3),
+						  (void *)0);
+
 	glBindVertexArray(0);
 }
 
 void Mesh::Draw(Shader shader) const
+{
+	BindTextures(shader);
+
+	// draw mesh
+	glBindVertexArray(m_VAO);
+	glDrawElements(GL_TRIANGLES, m_indices.size(), GL_UNSIGNED_INT, 0);
+	glBindVertexArray(0);
+}
+
+void Mesh::DrawDepth() const
+{
+	glBindVertexArray(m_depthVAO);
+	glDrawElements(GL_TRIANGLES, m_indices.size(), GL_UNSIGNED_INT, 0);
+	glBindVertexArray(0);
+}
+
+void Mesh::DrawInstanced(Shader shader, const InstanceBuffer &instances) const
+{
+	BindTextures(shader);
+
+	// the instance buffer may be shared between meshes, so (re)attach it
+	instances.AttachTo(m_VAO);
+	instances.DrawElements(m_VAO, GL_TRIANGLES, m_indices.size());
+}
+
+void Mesh::BindTextures(Shader &shader) const
 {
 	unsigned int diffuseNr = 0;
 	unsigned int specularNr = 0;
@@ -120,9 +204,4 @@ void Mesh::Draw(Shader shader) const
 		glBindTexture(GL_TEXTURE_2D, m_textures[i].id);
 	}
 	glActiveTexture(GL_TEXTURE0);
-
-	// draw mesh
-	glBindVertexArray(m_VAO);
-	glDrawElements(GL_TRIANGLES, m_indices.size(), GL_UNSIGNED_INT, 0);
-	glBindVertexArray(0);
 }
\ No newline at end of file
@@ -8,6 +8,7 @@
 
 #include "shader.h"
 #include "mesh.h"
+#include "profiler.h"
 
 u32 TextureFromFile(const char *path, const std::string &directory,
 					bool gamma = false);
@@ -19,6 +20,12 @@ public:
 	~Model();
 
 	void Draw(Shader shader) const;
+	void DrawInstanced(Shader shader, const InstanceBuffer &instances) const;
+	// Draw only the meshes listed in visibleMeshes, e.g. the output of a
+	// CullingSystem holding this model's mesh bounds
+	void Draw(Shader shader, const std::vector<u32> &visibleMeshes) const;
+
+	const std::vector<Mesh> &GetMeshes() const { return m_meshes; }
 
 private:
 	void loadModel(std::string path);
@@ -56,8 +63,26 @@ void Model::Draw(Shader shader) const
 	}
 }
 
+void Model::Draw(Shader shader, const std::vector<u32> &visibleMeshes) const
+{
+	for (u32 mesh : visibleMeshes)
+	{
+		m_meshes[mesh].Draw(shader);
+	}
+}
+
+void Model::DrawInstanced(Shader shader,
+						  const InstanceBuffer &instances) const
+{
+	for (unsigned int i = 0; i < m_meshes.size(); i++)
+	{
+		m_meshes[i].DrawInstanced(shader, instances);
+	}
+}
+
 inline void Model::loadModel(std::string path) 
 {
+	PROFILE_FUNCTION();
 	Assimp::Importer importer;
 	const aiScene *scene
 		= importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
@@ -203,6 +228,7 @@ inline std::vector<Texture> Model::loadMaterialTextures(aiMaterial *mat,
 
 u32 TextureFromFile(const char *path, const std::string &directory, bool gamma)
 {
+	PROFILE_FUNCTION();
 	std::string filename = directory + '/';
 	filename += path;
 
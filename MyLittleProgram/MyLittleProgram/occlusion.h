@@ -0,0 +1,379 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include <emmintrin.h>
+
+#include "threadpool.h"
+#include "bounds.h"
+#include "mesh.h"
+#include "types.h"
+
+// Resolution of the CPU depth buffer. The width must be a multiple of 4 and
+// the height a multiple of OCCLUSION_BAND_COUNT.
+const u32 OCCLUSION_WIDTH = 256;
+const u32 OCCLUSION_HEIGHT = 128;
+// horizontal strips rasterized as separate jobs
+const u32 OCCLUSION_BAND_COUNT = 8;
+
+// Software occlusion culling. Designated occluder meshes are rasterized into a
+// small CPU depth buffer, four pixels at a time with SSE2, in horizontal
+// bands on a ThreadPool. A max-depth mip chain of the result is then used to
+// reject occludee boxes that are entirely behind the occluders.
+//
+// BeginFrame() only kicks off the jobs, so the rasterization overlaps
+// whatever the calling thread does before EndFrame(), including waiting on
+// the previous frame's GPU work.
+class OcclusionCuller
+{
+public:
+	OcclusionCuller();
+
+	// Triangle list in object space. Occluders must not be larger than what
+	// they are drawn as, or they would hide visible objects.
+	u32 AddOccluder(const std::vector<glm::vec3> &positions,
+					const std::vector<u32> &indices, const glm::mat4 &model);
+	u32 AddOccluder(const Mesh &mesh, const glm::mat4 &model);
+	void SetOccluderTransform(u32 occluder, const glm::mat4 &model);
+	void ClearOccluders();
+
+	// Set up the occluder triangles for viewProj and start rasterizing
+	void BeginFrame(const glm::mat4 &viewProj, ThreadPool &pool);
+	// Wait for the rasterization and build the depth hierarchy
+	void EndFrame(ThreadPool &pool);
+
+	// False if the box is certainly hidden. Only valid after EndFrame.
+	bool IsVisible(const Bounds &worldBounds) const;
+	// Drop the hidden objects from visible, which indexes objects. Returns the
+	// number of objects removed.
+	u32 RemoveOccluded(const std::vector<Bounds> &objects,
+					   std::vector<u32> &visible) const;
+
+	// Level 0 of the depth buffer, OCCLUSION_WIDTH x OCCLUSION_HEIGHT,
+	// depth in [0, 1], bottom row first
+	const float *DepthBuffer() const { return m_levels[0].data(); }
+
+private:
+	struct Occluder
+	{
+		std::vector<glm::vec3> positions;
+		std::vector<u32> indices;
+		glm::mat4 model;
+	};
+	// Edge functions and depth plane of a screen space triangle. A pixel
+	// centre is inside when all three edges are >= 0.
+	struct Triangle
+	{
+		float edgeA[3], edgeB[3], edgeC[3];
+		float depthA, depthB, depthC;
+		int minX, maxX, minY, maxY;
+	};
+
+	void SetupTriangle(const glm::vec3 &v0, const glm::vec3 &v1,
+					   const glm::vec3 &v2);
+	void RasterizeBand(u32 band);
+	void BuildHierarchy();
+
+	std::vector<Occluder> m_occluders;
+	std::vector<Triangle> m_triangles;
+	std::vector<glm::vec4> m_clipVerts;
+	glm::mat4 m_viewProj;
+	// m_levels[0] is the depth buffer, each further level holds the
+	// furthest depth of a 2x2 block of the one before
+	std::vector<std::vector<float>> m_levels;
+	std::vector<glm::uvec2> m_levelSizes;
+};
+
+OcclusionCuller::OcclusionCuller()
+{
+	u32 w = OCCLUSION_WIDTH, h = OCCLUSION_HEIGHT;
+	for (;;)
+	{
+		m_levels.push_back(std::vector<float>(w * h, 1.0f));
+		m_levelSizes.push_back(glm::uvec2(w, h));
+		if (w == 1 && h == 1) break;
+		w = std::max(1u, w / 2);
+		h = std::max(1u, h / 2);
+	}
+}
+
+u32 OcclusionCuller::AddOccluder(const std::vector<glm::vec3> &positions,
+								 const std::vector<u32> &indices,
+								 const glm::mat4 &model)
+{
+	Occluder occluder;
+	occluder.positions = positions;
+	occluder.indices = indices;
+	occluder.model = model;
+	m_occluders.push_back(occluder);
+	return (u32)m_occluders.size() - 1;
+}
+
+u32 OcclusionCuller::AddOccluder(const Mesh &mesh, const glm::mat4 &model)
+{
+	std::vector<glm::vec3> positions;
+	positions.reserve(mesh.m_vertices.size());
+	for (const Vertex &vertex : mesh.m_vertices)
+	{
+		positions.push_back(vertex.Position);
+	}
+	return AddOccluder(positions, mesh.m_indices, model);
+}
+
+void OcclusionCuller::SetOccluderTransform(u32 occluder,
+										   const glm::mat4 &model)
+{
+	m_occluders[occluder].model = model;
+}
+
+void OcclusionCuller::ClearOccluders()
+{
+	m_occluders.clear();
+}
+
+void OcclusionCuller::SetupTriangle(const glm::vec3 &v0, const glm::vec3 &v1,
+									const glm::vec3 &v2)
+{
+	Triangle tri;
+	const glm::vec3 *v[3] = { &v0, &v1, &v2 };
+	for (int e = 0; e < 3; e++)
+	{
+		const glm::vec3 &a = *v[e];
+		const glm::vec3 &b = *v[(e + 1) % 3];
+		tri.edgeA[e] = a.y - b.y;
+		tri.edgeB[e] = b.x - a.x;
+		tri.edgeC[e] = a.x * b.y - a.y * b.x;
+	}
+	// twice the signed area, flip clockwise triangles so inside is positive
+	float area = tri.edgeA[0] * v2.x + tri.edgeB[0] * v2.y + tri.edgeC[0];
+	if (fabs(area) < 1e-6f) return;
+	if (area < 0.0f)
+	{
+		area = -area;
+		for (int e = 0; e < 3; e++)
+		{
+			tri.edgeA[e] = -tri.edgeA[e];
+			tri.edgeB[e] = -tri.edgeB[e];
+			tri.edgeC[e] = -tri.edgeC[e];
+		}
+	}
+	// depth is the barycentric blend, each vertex weighted by its opposite edge
+	float invArea = 1.0f / area;
+	tri.depthA = (tri.edgeA[1] * v0.z + tri.edgeA[2] * v1.z
+				  + tri.edgeA[0] * v2.z) * invArea;
+	tri.depthB = (tri.edgeB[1] * v0.z + tri.edgeB[2] * v1.z
+				  + tri.edgeB[0] * v2.z) * invArea;
+	tri.depthC = (tri.edgeC[1] * v0.z + tri.edgeC[2] * v1.z
+				  + tri.edgeC[0] * v2.z) * invArea;
+
+	tri.minX = std::max(0, (int)floor(std::min(v0.x, std::min(v1.x, v2.x))));
+	tri.maxX = std::min((int)OCCLUSION_WIDTH - 1,
+						(int)floor(std::max(v0.x, std::max(v1.x, v2.x))));
+	tri.minY = std::max(0, (int)floor(std::min(v0.y, std::min(v1.y, v2.y))));
+	tri.maxY = std::min((int)OCCLUSION_HEIGHT - 1,
+						(int)floor(std::max(v0.y, std::max(v1.y, v2.y))));
+	if (tri.minX > tri.maxX || tri.minY > tri.maxY) return;
+	// rows are walked in aligned groups of four pixels
+	tri.minX &= ~3;
+	m_triangles.push_back(tri);
+}
+
+void OcclusionCuller::BeginFrame(const glm::mat4 &viewProj, ThreadPool &pool)
+{
+	m_viewProj = viewProj;
+	m_triangles.clear();
+	for (const Occluder &occluder : m_occluders)
+	{
+		glm::mat4 mvp = viewProj * occluder.model;
+		m_clipVerts.resize(occluder.positions.size());
+		for (size_t i = 0; i < occluder.positions.size(); i++)
+		{
+			m_clipVerts[i] = mvp * glm::vec4(occluder.positions[i], 1.0f);
+		}
+		for (size_t i = 0; i + 2 < occluder.indices.size(); i += 3)
+		{
+			glm::vec3 screen[3];
+			bool behind = false;
+			for (int k = 0; k < 3; k++)
+			{
+				const glm::vec4 &clip = m_clipVerts[occluder.indices[i + k]];
+				// no clipping, an occluder triangle crossing the near plane is
+				// simply dropped, which can only make culling less aggressive
+				if (clip.w < 1e-3f)
+				{
+					behind = true;
+					break;
+				}
+				glm::vec3 ndc = glm::vec3(clip) / clip.w;
+				float depth = glm::clamp(ndc.z * 0.5f + 0.5f, 0.0f, 1.0f);
+				screen[k] = glm::vec3((ndc.x * 0.5f + 0.5f) * OCCLUSION_WIDTH,
+									  (ndc.y * 0.5f + 0.5f) * OCCLUSION_HEIGHT,
+									  depth);
+			}
+			if (!behind) SetupTriangle(screen[0], screen[1], screen[2]);
+		}
+	}
+
+	for (u32 band = 0; band < OCCLUSION_BAND_COUNT; band++)
+	{
+		pool.Submit([this, band] { RasterizeBand(band); });
+	}
+}
+
+void OcclusionCuller::RasterizeBand(u32 band)
+{
+	const int bandHeight = OCCLUSION_HEIGHT / OCCLUSION_BAND_COUNT;
+	const int bandMinY = band * bandHeight;
+	const int bandMaxY = bandMinY + bandHeight - 1;
+	float *depth = m_levels[0].data();
+	std::fill(depth + bandMinY * OCCLUSION_WIDTH,
+			  depth + (bandMaxY + 1) * OCCLUSION_WIDTH, 1.0f);
+
+	const __m128 laneOffset = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	const __m128 zero = _mm_setzero_ps();
+	for (const Triangle &tri : m_triangles)
+	{
+		int minY = std::max(tri.minY, bandMinY);
+		int maxY = std::min(tri.maxY, bandMaxY);
+		if (minY > maxY) continue;
+
+		__m128 a0 = _mm_set1_ps(tri.edgeA[0]);
+		__m128 a1 = _mm_set1_ps(tri.edgeA[1]);
+		__m128 a2 = _mm_set1_ps(tri.edgeA[2]);
+		__m128 step0 = _mm_set1_ps(tri.edgeA[0] * 4.0f);
+		__m128 step1 = _mm_set1_ps(tri.edgeA[1] * 4.0f);
+		__m128 step2 = _mm_set1_ps(tri.edgeA[2] * 4.0f);
+		__m128 stepZ = _mm_set1_ps(tri.depthA * 4.0f);
+		__m128 startX = _mm_add_ps(_mm_set1_ps((float)tri.minX), laneOffset);
+		for (int y = minY; y <= maxY; y++)
+		{
+			float py = y + 0.5f;
+			// edge and depth values for the first four pixels of the row
+			__m128 e0 = _mm_add_ps(
+				_mm_mul_ps(a0, startX),
+				_mm_set1_ps(tri.edgeB[0] * py + tri.edgeC[0]));
+			__m128 e1 = _mm_add_ps(
+				_mm_mul_ps(a1, startX),
+				_mm_set1_ps(tri.edgeB[1] * py + tri.edgeC[1]));
+			__m128 e2 = _mm_add_ps(
+				_mm_mul_ps(a2, startX),
+				_mm_set1_ps(tri.edgeB[2] * py + tri.edgeC[2]));
+			__m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(tri.depthA), startX),
+								  _mm_set1_ps(tri.depthB * py + tri.depthC));
+			float *row = depth + y * OCCLUSION_WIDTH;
+			for (int x = tri.minX; x <= tri.maxX; x += 4)
+			{
+				__m128 inside = _mm_and_ps(
+					_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)),
+					_mm_cmpge_ps(e2, zero));
+				__m128 old = _mm_loadu_ps(row + x);
+				__m128 write = _mm_and_ps(inside, _mm_cmplt_ps(z, old));
+				_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(write, z),
+												_mm_andnot_ps(write, old)));
+				e0 = _mm_add_ps(e0, step0);
+				e1 = _mm_add_ps(e1, step1);
+				e2 = _mm_add_ps(e2, step2);
+				z = _mm_add_ps(z, stepZ);
+			}
+		}
+	}
+}
+
+void OcclusionCuller::EndFrame(ThreadPool &pool)
+{
+	pool.Wait();
+	BuildHierarchy();
+}
+
+void OcclusionCuller::BuildHierarchy()
+{
+	for (size_t level = 1; level < m_levels.size(); level++)
+	{
+		const std::vector<float> &src = m_levels[level - 1];
+		std::vector<float> &dst = m_levels[level];
+		glm::uvec2 srcSize = m_levelSizes[level - 1];
+		glm::uvec2 dstSize = m_levelSizes[level];
+		for (u32 y = 0; y < dstSize.y; y++)
+		{
+			u32 y0 = std::min(y * 2, srcSize.y - 1);
+			u32 y1 = std::min(y * 2 + 1, srcSize.y - 1);
+			for (u32 x = 0; x < dstSize.x; x++)
+			{
+				u32 x0 = std::min(x * 2, srcSize.x - 1);
+				u32 x1 = std::min(x * 2 + 1, srcSize.x - 1);
+				const float *row0 = &src[y0 * srcSize.x];
+				const float *row1 = &src[y1 * srcSize.x];
+				dst[y * dstSize.x + x]
+					= std::max(std::max(row0[x0], row0[x1]),
+							   std::max(row1[x0], row1[x1]));
+			}
+		}
+	}
+}
+
+bool OcclusionCuller::IsVisible(const Bounds &worldBounds) const
+{
+	// screen rectangle and nearest depth of the box corners
+	float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+	float nearest = FLT_MAX;
+	for (int c = 0; c < 8; c++)
+	{
+		const glm::vec3 &bmin = worldBounds.aabbMin;
+		const glm::vec3 &bmax = worldBounds.aabbMax;
+		glm::vec3 corner((c & 1) ? bmax.x : bmin.x, (c & 2) ? bmax.y : bmin.y,
+						 (c & 4) ? bmax.z : bmin.z);
+		glm::vec4 clip = m_viewProj * glm::vec4(corner, 1.0f);
+		// touching the near plane, too close to be hidden
+		if (clip.w < 1e-3f) return true;
+		glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		float sx = (ndc.x * 0.5f + 0.5f) * OCCLUSION_WIDTH;
+		float sy = (ndc.y * 0.5f + 0.5f) * OCCLUSION_HEIGHT;
+		minX = std::min(minX, sx);
+		maxX = std::max(maxX, sx);
+		minY = std::min(minY, sy);
+		maxY = std::max(maxY, sy);
+		nearest = std::min(nearest, ndc.z * 0.5f + 0.5f);
+	}
+	int x0 = std::max(0, (int)floor(minX));
+	int y0 = std::max(0, (int)floor(minY));
+	int x1 = std::min((int)OCCLUSION_WIDTH - 1, (int)floor(maxX));
+	int y1 = std::min((int)OCCLUSION_HEIGHT - 1, (int)floor(maxY));
+	// off screen is the frustum culler's business
+	if (x0 > x1 || y0 > y1) return true;
+
+	// pick the level where the rectangle covers at most 2x2 texels, so the
+	// test reads a handful of values regardless of the box's size
+	u32 level = 0;
+	while (level + 1 < m_levels.size()
+		   && ((x1 >> level) - (x0 >> level) > 1
+			   || (y1 >> level) - (y0 >> level) > 1))
+	{
+		level++;
+	}
+	const std::vector<float> &depth = m_levels[level];
+	u32 width = m_levelSizes[level].x;
+	for (int y = y0 >> level; y <= (y1 >> level); y++)
+	{
+		for (int x = x0 >> level; x <= (x1 >> level); x++)
+		{
+			if (nearest <= depth[y * width + x]) return true;
+		}
+	}
+	return false;
+}
+
+u32 OcclusionCuller::RemoveOccluded(const std::vector<Bounds> &objects,
+									std::vector<u32> &visible) const
+{
+	size_t kept = 0;
+	for (size_t i = 0; i < visible.size(); i++)
+	{
+		if (IsVisible(objects[visible[i]])) visible[kept++] = visible[i];
+	}
+	u32 removed = (u32)(visible.size() - kept);
+	visible.resize(kept);
+	return removed;
+}
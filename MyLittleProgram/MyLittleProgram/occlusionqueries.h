@@ -0,0 +1,241 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include <memory>
+
+#include "shader.h"
+#include "bounds.h"
+#include "types.h"
+
+// Re-test objects that were visible only every this many frames. Objects that
+// were hidden are tested every frame so they reappear quickly.
+const u32 OQ_VISIBLE_QUERY_INTERVAL = 4;
+
+// Hardware occlusion culling with temporal coherence, loosely after CHC++.
+//
+// Each frame, after the scene has been drawn, a proxy box per object is
+// rendered against the depth buffer inside an occlusion query. Results are
+// only read once the GPU reports them available, so the CPU never waits:
+//   - last result visible:  draw normally
+//   - last result occluded: skip the object
+//   - result still pending: draw it under glBeginConditionalRender with the
+//     outstanding query, letting the GPU make the call (GL_QUERY_NO_WAIT)
+// Objects that come back into view are drawn one frame late.
+//
+// Conditional single-object draws out of an instance batch need base
+// instance (GL 4.2). Without it pending objects are drawn normally.
+class OcclusionQueries
+{
+public:
+	OcclusionQueries();
+	~OcclusionQueries();
+	OcclusionQueries(const OcclusionQueries &) = delete;
+	OcclusionQueries &operator=(const OcclusionQueries &) = delete;
+
+	u32 AddObject(const Bounds &worldBounds);
+	void SetBounds(u32 object, const Bounds &worldBounds);
+	u32 Count() const { return (u32)m_objects.size(); }
+
+	// Collect the results that have arrived and split candidates (e.g. the
+	// frustum survivors) into objects to draw normally and objects to draw
+	// under ConditionQuery(). The rest are skipped.
+	void Classify(const std::vector<u32> &candidates, std::vector<u32> &draw,
+				  std::vector<u32> &conditional);
+	// Query for object's pending test, for DrawItem::conditionQuery
+	u32 ConditionQuery(u32 object) const { return m_objects[object].query; }
+
+	// Render the proxies of this frame's candidates against the current depth
+	// buffer. Call after the occluders have been drawn. Leaves depth test on,
+	// colour/depth writes on and face culling and stencil test off.
+	void IssueQueries(const std::vector<u32> &candidates,
+					  const glm::mat4 &viewProj, const glm::vec3 &eye);
+
+	// Objects skipped by the last Classify
+	u32 SkippedCount() const { return m_skipped; }
+
+private:
+	struct Object
+	{
+		Bounds bounds;
+		u32 query = 0;
+		bool visible = true;
+		bool pending = false;
+	};
+
+	void CollectResults();
+
+	std::vector<Object> m_objects;
+	std::unique_ptr<Shader> m_proxyShader;
+	VAO m_proxyVAO;
+	VBO m_proxyVBO;
+	u32 m_proxyEBO;
+	GLenum m_queryTarget;
+	bool m_conditionalDraws;
+	u32 m_frame;
+	u32 m_skipped;
+};
+
+OcclusionQueries::OcclusionQueries()
+	: m_frame(0)
+	, m_skipped(0)
+{
+	// the conservative variant may skip exact rasterization and is cheaper
+	m_queryTarget = GLAD_GL_VERSION_4_3 ? GL_ANY_SAMPLES_PASSED_CONSERVATIVE
+										: GL_ANY_SAMPLES_PASSED;
+	m_conditionalDraws = GLAD_GL_VERSION_4_2 != 0;
+	m_proxyShader.reset(new Shader("shaders/proxy.vs", "shaders/proxy.fs"));
+
+	// unit cube, stretched to each object's box in the vertex shader
+	float corners[8 * 3];
+	for (u32 c = 0; c < 8; c++)
+	{
+		corners[c * 3 + 0] = (c & 1) ? 1.0f : 0.0f;
+		corners[c * 3 + 1] = (c & 2) ? 1.0f : 0.0f;
+		corners[c * 3 + 2] = (c & 4) ? 1.0f : 0.0f;
+	}
+	const u32 indices[36] = {
+		0, 2, 1, 1, 2, 3, // -z
+		4, 5, 6, 5, 7, 6, // +z
+		0, 1, 4, 1, 5, 4, // -y
+		2, 6, 3, 3, 6, 7, // +y
+		0, 4, 2, 2, 4, 6, // -x
+		1, 3, 5, 3, 7, 5  // +x
+	};
+	glGenVertexArrays(1, &m_proxyVAO);
+	glGenBuffers(1, &m_proxyVBO);
+	glGenBuffers(1, &m_proxyEBO);
+	glBindVertexArray(m_proxyVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, m_proxyVBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_proxyEBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices,
+				 GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float),
+						  (void *)0);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+OcclusionQueries::~OcclusionQueries()
+{
+	for (Object &object : m_objects)
+	{
+		glDeleteQueries(1, &object.query);
+	}
+	glDeleteVertexArrays(1, &m_proxyVAO);
+	glDeleteBuffers(1, &m_proxyVBO);
+	glDeleteBuffers(1, &m_proxyEBO);
+	glDeleteProgram(m_proxyShader->m_programId);
+}
+
+u32 OcclusionQueries::AddObject(const Bounds &worldBounds)
+{
+	Object object;
+	object.bounds = worldBounds;
+	glGenQueries(1, &object.query);
+	m_objects.push_back(object);
+	return (u32)m_objects.size() - 1;
+}
+
+void OcclusionQueries::SetBounds(u32 object, const Bounds &worldBounds)
+{
+	m_objects[object].bounds = worldBounds;
+}
+
+void OcclusionQueries::CollectResults()
+{
+	for (Object &object : m_objects)
+	{
+		if (!object.pending) continue;
+		GLint available = 0;
+		glGetQueryObjectiv(object.query, GL_QUERY_RESULT_AVAILABLE,
+						   &available);
+		if (!available) continue;
+		GLuint anySamples = 0;
+		glGetQueryObjectuiv(object.query, GL_QUERY_RESULT, &anySamples);
+		object.visible = anySamples != 0;
+		object.pending = false;
+	}
+}
+
+void OcclusionQueries::Classify(const std::vector<u32> &candidates,
+								std::vector<u32> &draw,
+								std::vector<u32> &conditional)
+{
+	m_frame++;
+	CollectResults();
+	draw.clear();
+	conditional.clear();
+	m_skipped = 0;
+	for (u32 o : candidates)
+	{
+		const Object &object = m_objects[o];
+		if (object.pending)
+		{
+			if (m_conditionalDraws)
+				conditional.push_back(o);
+			else
+				draw.push_back(o);
+		}
+		else if (object.visible)
+		{
+			draw.push_back(o);
+		}
+		else
+		{
+			m_skipped++;
+		}
+	}
+}
+
+void OcclusionQueries::IssueQueries(const std::vector<u32> &candidates,
+									const glm::mat4 &viewProj,
+									const glm::vec3 &eye)
+{
+	m_proxyShader->use();
+	m_proxyShader->setMat4("viewProj", viewProj);
+	glBindVertexArray(m_proxyVAO);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glDepthMask(GL_FALSE);
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_LEQUAL);
+	glDisable(GL_STENCIL_TEST);
+	// both sides, so a box that is cut by the near plane still produces
+	// samples from its back faces
+	glDisable(GL_CULL_FACE);
+
+	for (u32 o : candidates)
+	{
+		Object &object = m_objects[o];
+		// still waiting for the last one
+		if (object.pending) continue;
+		// visible objects keep being drawn for a while before the next test,
+		// staggered so the queries are spread over the frames
+		if (object.visible
+			&& (m_frame + o) % OQ_VISIBLE_QUERY_INTERVAL != 0)
+			continue;
+		// inside the box: the proxy would be clipped away, it's visible
+		const Bounds &b = object.bounds;
+		if (glm::all(glm::greaterThanEqual(eye, b.aabbMin))
+			&& glm::all(glm::lessThanEqual(eye, b.aabbMax)))
+		{
+			object.visible = true;
+			continue;
+		}
+
+		m_proxyShader->setVec3("boxMin", b.aabbMin);
+		m_proxyShader->setVec3("boxMax", b.aabbMax);
+		glBeginQuery(m_queryTarget, object.query);
+		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, (void *)0);
+		glEndQuery(m_queryTarget);
+		object.pending = true;
+	}
+
+	glBindVertexArray(0);
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glDepthMask(GL_TRUE);
+	glDepthFunc(GL_LESS);
+}
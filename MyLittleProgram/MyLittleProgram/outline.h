@@ -0,0 +1,188 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <memory>
+#include <cmath>
+#include <iostream>
+
+#include "shader.h"
+#include "types.h"
+
+// Outlines at least this wide (pixels) use the jump flood, thinner ones are
+// found by sampling the mask around each pixel in the composite shader
+const float OUTLINE_JUMP_FLOOD_WIDTH = 3.0f;
+
+// Screen space outlines around the pixels set in a selection mask. Selected
+// objects write 1 to the mask when they are drawn, so nothing is rendered a
+// second time and the cost only depends on the resolution.
+//
+// Wide outlines run a jump flood over the mask: every pixel ends up with the
+// coordinate of its nearest selected pixel after log2(width) passes, and the
+// composite shader turns the distance to it into outline coverage.
+//
+// The composite shader (composite.fs) samples the mask and the seeds, so
+// the outline is drawn as part of the final blit.
+class OutlinePass
+{
+public:
+	OutlinePass();
+	~OutlinePass();
+	OutlinePass(const OutlinePass &) = delete;
+	OutlinePass &operator=(const OutlinePass &) = delete;
+
+	// Run the jump flood over the bottom left viewWidth x viewHeight of
+	// selectionMask if width needs it. Changes the framebuffer binding,
+	// viewport and program.
+	// emptyVAO is any VAO, the passes are bufferless full screen triangles
+	void Prepare(TXO selectionMask, u32 maskWidth, u32 maskHeight,
+				 u32 viewWidth, u32 viewHeight, float width, VAO emptyVAO);
+	// Point the composite shader at the mask and seeds, on texture units 1
+	// and 2
+	void Bind(Shader &composite, const glm::vec3 &colour) const;
+
+private:
+	void Resize(u32 width, u32 height);
+
+	std::unique_ptr<Shader> m_initShader;
+	std::unique_ptr<Shader> m_stepShader;
+	// ping-pong nearest seed coordinates
+	TXO m_seeds[2];
+	u32 m_framebuffers[2];
+	u32 m_result;
+	u32 m_width, m_height;
+	u32 m_viewWidth, m_viewHeight;
+	TXO m_mask;
+	float m_outlineWidth;
+	bool m_jumpFlood;
+};
+
+OutlinePass::OutlinePass()
+	: m_result(0)
+	, m_width(0)
+	, m_height(0)
+	, m_viewWidth(0)
+	, m_viewHeight(0)
+	, m_mask(0)
+	, m_outlineWidth(0.0f)
+	, m_jumpFlood(false)
+{
+	m_initShader.reset(
+		new Shader("shaders/fullScreenTriangle.vs", "shaders/jumpFloodInit.fs"));
+	m_stepShader.reset(
+		new Shader("shaders/fullScreenTriangle.vs", "shaders/jumpFloodStep.fs"));
+	glGenTextures(2, m_seeds);
+	glGenFramebuffers(2, m_framebuffers);
+}
+
+OutlinePass::~OutlinePass()
+{
+	glDeleteTextures(2, m_seeds);
+	glDeleteFramebuffers(2, m_framebuffers);
+	glDeleteProgram(m_initShader->m_programId);
+	glDeleteProgram(m_stepShader->m_programId);
+}
+
+void OutlinePass::Resize(u32 width, u32 height)
+{
+	m_width = width;
+	m_height = height;
+	for (u32 i = 0; i < 2; i++)
+	{
+		// pixel coordinates, 16 bit floats would lose precision above 2048
+		glBindTexture(GL_TEXTURE_2D, m_seeds[i]);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, width, height, 0, GL_RG,
+					 GL_FLOAT, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffers[i]);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+							   GL_TEXTURE_2D, m_seeds[i], 0);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		{
+			std::cout << "ERROR::OUTLINE::FRAMEBUFFER_NOT_COMPLETE"
+					  << std::endl;
+		}
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void OutlinePass::Prepare(TXO selectionMask, u32 maskWidth, u32 maskHeight,
+						  u32 viewWidth, u32 viewHeight, float width,
+						  VAO emptyVAO)
+{
+	m_mask = selectionMask;
+	m_outlineWidth = width;
+	m_jumpFlood = width >= OUTLINE_JUMP_FLOOD_WIDTH;
+	if (!m_jumpFlood) return;
+	if (maskWidth != m_width || maskHeight != m_height)
+	{
+		Resize(maskWidth, maskHeight);
+		m_viewWidth = 0;
+	}
+	if (viewWidth != m_viewWidth || viewHeight != m_viewHeight)
+	{
+		// only the view gets seeded, so clear out seeds left outside it by a
+		// larger one, or the steps near the edge would pick them up
+		m_viewWidth = viewWidth;
+		m_viewHeight = viewHeight;
+		const float noSeed[] = { -1.0f, -1.0f, 0.0f, 0.0f };
+		for (u32 i = 0; i < 2; i++)
+		{
+			glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffers[i]);
+			glClearBufferfv(GL_COLOR, 0, noSeed);
+		}
+	}
+
+	glViewport(0, 0, m_viewWidth, m_viewHeight);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_STENCIL_TEST);
+	glDisable(GL_CULL_FACE);
+	glDisable(GL_BLEND);
+	glBindVertexArray(emptyVAO);
+	glActiveTexture(GL_TEXTURE0);
+
+	// seed the selected pixels with their own coordinate
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffers[0]);
+	m_initShader->use();
+	m_initShader->setInt("selectionMask", 0);
+	glBindTexture(GL_TEXTURE_2D, selectionMask);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+
+	// halve the step from the outline width down to one pixel. Nothing
+	// further away than the outline width matters, so the flood can start
+	// there instead of at half the screen.
+	u32 src = 0;
+	m_stepShader->use();
+	m_stepShader->setInt("seeds", 0);
+	for (int step = 1 << (int)ceil(log2(width)); step >= 1; step /= 2)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffers[1 - src]);
+		glBindTexture(GL_TEXTURE_2D, m_seeds[src]);
+		m_stepShader->setInt("step", step);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		src = 1 - src;
+	}
+	m_result = src;
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glBindVertexArray(0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void OutlinePass::Bind(Shader &composite, const glm::vec3 &colour) const
+{
+	composite.setInt("selectionMask", 1);
+	composite.setInt("outlineSeeds", 2);
+	composite.setFloat("outlineWidth", m_outlineWidth);
+	composite.setBool("outlineJumpFlood", m_jumpFlood);
+	composite.setVec3("outlineColour", colour);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, m_mask);
+	glActiveTexture(GL_TEXTURE2);
+	glBindTexture(GL_TEXTURE_2D, m_jumpFlood ? m_seeds[m_result] : 0);
+	glActiveTexture(GL_TEXTURE0);
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include <string>
+#include <functional>
+
+#include "shader.h"
+#include "rendertarget.h"
+#include "types.h"
+
+// GPU time of one pass, from the previous time it ran
+struct PostPassTiming
+{
+	std::string name;
+	double ms;
+};
+
+// Ordered list of full screen passes. Each pass reads the previous result on
+// texture unit 0 ("screenTexture", sampled at TexCoords) and renders a
+// bufferless triangle (see fullScreenTriangle.vs) into a target from the
+// pool, so the chain ping-pongs between two textures however many passes it
+// has.
+//
+// Every pass is wrapped in a GL_TIME_ELAPSED query. The queries are double
+// buffered and only read once available, so timings lag a frame or two but
+// never stall.
+class PostProcessChain
+{
+public:
+	explicit PostProcessChain(RenderTargetPool &pool);
+	~PostProcessChain();
+	PostProcessChain(const PostProcessChain &) = delete;
+	PostProcessChain &operator=(const PostProcessChain &) = delete;
+
+	// setUniforms runs with the pass's shader bound, before it draws
+	u32 AddPass(const std::string &name, Shader &shader,
+				std::function<void(Shader &)> setUniforms = nullptr,
+				GLenum format = GL_RGBA8);
+	void SetEnabled(u32 pass, bool enabled);
+	bool IsEnabled(u32 pass) const { return m_passes[pass].enabled; }
+
+	// Run the enabled passes over the bottom left width x height of source,
+	// a targetWidth x targetHeight texture, and return the texture holding the
+	// result. It is the same size as source and has the result in the same
+	// sub-rect, or is source itself if nothing is enabled. The result stays
+	// valid until the next Run. Changes the framebuffer binding, viewport and
+	// program.
+	TXO Run(TXO source, u32 width, u32 height, u32 targetWidth,
+			u32 targetHeight, VAO emptyVAO);
+
+	// Latest timings of the enabled passes
+	const std::vector<PostPassTiming> &GetTimings() const { return m_timings; }
+
+private:
+	struct Pass
+	{
+		std::string name;
+		Shader *shader;
+		std::function<void(Shader &)> setUniforms;
+		GLenum format;
+		bool enabled;
+		u32 queries[2];
+		bool queryIssued[2];
+		double ms;
+	};
+
+	void CollectTiming(Pass &pass, u32 slot);
+
+	RenderTargetPool &m_pool;
+	std::vector<Pass> m_passes;
+	std::vector<PostPassTiming> m_timings;
+	RenderTarget *m_result;
+	u32 m_frame;
+};
+
+PostProcessChain::PostProcessChain(RenderTargetPool &pool)
+	: m_pool(pool)
+	, m_result(nullptr)
+	, m_frame(0)
+{
+}
+
+PostProcessChain::~PostProcessChain()
+{
+	for (Pass &pass : m_passes)
+	{
+		glDeleteQueries(2, pass.queries);
+	}
+	if (m_result) m_pool.Release(m_result);
+}
+
+u32 PostProcessChain::AddPass(const std::string &name, Shader &shader,
+							  std::function<void(Shader &)> setUniforms,
+							  GLenum format)
+{
+	Pass pass;
+	pass.name = name;
+	pass.shader = &shader;
+	pass.setUniforms = setUniforms;
+	pass.format = format;
+	pass.enabled = true;
+	glGenQueries(2, pass.queries);
+	pass.queryIssued[0] = pass.queryIssued[1] = false;
+	pass.ms = 0.0;
+	m_passes.push_back(pass);
+	return (u32)m_passes.size() - 1;
+}
+
+void PostProcessChain::SetEnabled(u32 pass, bool enabled)
+{
+	m_passes[pass].enabled = enabled;
+}
+
+void PostProcessChain::CollectTiming(Pass &pass, u32 slot)
+{
+	if (!pass.queryIssued[slot]) return;
+	GLint available = 0;
+	glGetQueryObjectiv(pass.queries[slot], GL_QUERY_RESULT_AVAILABLE,
+					   &available);
+	if (!available) return;
+	GLuint64 ns = 0;
+	glGetQueryObjectui64v(pass.queries[slot], GL_QUERY_RESULT, &ns);
+	pass.ms = ns / 1.0e6;
+	pass.queryIssued[slot] = false;
+}
+
+TXO PostProcessChain::Run(TXO source, u32 width, u32 height, u32 targetWidth,
+						  u32 targetHeight, VAO emptyVAO)
+{
+	if (m_result)
+	{
+		m_pool.Release(m_result);
+		m_result = nullptr;
+	}
+	const u32 slot = m_frame++ & 1;
+	m_timings.clear();
+
+	const glm::vec2 uvScale((float)width / targetWidth,
+							(float)height / targetHeight);
+	TXO input = source;
+	RenderTarget *inputTarget = nullptr;
+	glViewport(0, 0, width, height);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_STENCIL_TEST);
+	glDisable(GL_CULL_FACE);
+	glDisable(GL_BLEND);
+	glBindVertexArray(emptyVAO);
+	glActiveTexture(GL_TEXTURE0);
+	for (Pass &pass : m_passes)
+	{
+		CollectTiming(pass, slot);
+		if (!pass.enabled) continue;
+
+		RenderTarget *output = m_pool.Acquire(pass.format, targetWidth,
+											  targetHeight);
+		glBindFramebuffer(GL_FRAMEBUFFER, output->framebuffer);
+		pass.shader->use();
+		pass.shader->setInt("screenTexture", 0);
+		pass.shader->setVec2("uvScale", uvScale);
+		// the top right of the input's sub-rect, for passes that sample
+		// neighbours to clamp to so they don't read past it
+		pass.shader->setVec2("uvMax", uvScale);
+		if (pass.setUniforms) pass.setUniforms(*pass.shader);
+		glBindTexture(GL_TEXTURE_2D, input);
+
+		glBeginQuery(GL_TIME_ELAPSED, pass.queries[slot]);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		glEndQuery(GL_TIME_ELAPSED);
+		pass.queryIssued[slot] = true;
+
+		// the previous intermediate has been read, it can go back to the pool
+		if (inputTarget) m_pool.Release(inputTarget);
+		inputTarget = output;
+		input = output->texture;
+		m_timings.push_back({ pass.name, pass.ms });
+	}
+	m_result = inputTarget;
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glBindVertexArray(0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	return input;
+}
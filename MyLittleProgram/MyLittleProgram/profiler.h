@@ -0,0 +1,405 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+
+#include "types.h"
+
+// Events per buffer chunk, and chunks a thread may fill before it drops
+// events: 16384 x 64 events of 16 bytes, 16MB per thread
+const u32 PROFILER_CHUNK_EVENTS = 16384;
+const u32 PROFILER_MAX_CHUNKS = 64;
+// GPU timestamp query pairs in flight before GPU scopes are dropped
+const u32 PROFILER_MAX_GPU_QUERIES = 256;
+
+// Scoped CPU and GPU instrumentation, written out as Chrome trace_event JSON
+// (chrome://tracing, or ui.perfetto.dev).
+//
+// PROFILE_SCOPE(name) records a begin event where it's declared and an end
+// event when the scope closes. name must outlive the profiler, a string
+// literal or __FUNCTION__. Each thread writes into its own chunked buffer:
+// a write is a clock read, a store and a release of the event count, no
+// locks. The buffers are only appended to, so WriteTrace can read them while
+// the threads keep recording.
+//
+// PROFILE_GPU_SCOPE(name), on the GL thread, brackets GL commands with
+// GL_TIMESTAMP queries. Their results are picked up by Collect once
+// available, never waited for, and put on the CPU timeline with an offset
+// measured from glGetInteger64v(GL_TIMESTAMP). They show up as their own
+// "GPU" thread.
+//
+// Define NO_PROFILER to compile the scopes out.
+class Profiler
+{
+public:
+	static Profiler &Instance();
+
+	// Name the calling thread in the trace
+	void SetThreadName(const char *name);
+	void Begin(const char *name);
+	void End();
+
+	void BeginGpu(const char *name);
+	void EndGpu();
+	// Read back the finished GPU scopes, once a frame on the GL thread
+	void Collect();
+
+	// Everything recorded so far as trace_event JSON. Collects the GPU scopes
+	// first, so call it from the GL thread.
+	bool WriteTrace(const char *path);
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	struct Event
+	{
+		const char *name;
+		// since the profiler started, end events have no name
+		u64 ns;
+	};
+	struct Chunk
+	{
+		Event events[PROFILER_CHUNK_EVENTS];
+		std::atomic<u32> count{ 0 };
+		std::atomic<Chunk *> next{ nullptr };
+	};
+	struct ThreadBuffer
+	{
+		u32 id;
+		std::string name;
+		std::unique_ptr<Chunk> head;
+		// only touched by the owning thread
+		Chunk *tail;
+		u32 chunks;
+		std::atomic<u64> dropped{ 0 };
+	};
+	struct GpuScope
+	{
+		const char *name;
+		u32 queries[2];
+	};
+	struct GpuEvent
+	{
+		const char *name;
+		u64 beginNs;
+		u64 endNs;
+	};
+
+	Profiler();
+	~Profiler();
+	ThreadBuffer &ThisThread();
+	u64 Now() const;
+	void Record(const char *name);
+
+	Clock::time_point m_start;
+	std::mutex m_threadsMutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> m_threads;
+
+	// GL thread only
+	std::vector<u32> m_freeQueries;
+	std::vector<GpuScope> m_openGpu;
+	std::vector<GpuScope> m_pendingGpu;
+	std::vector<GpuEvent> m_gpuEvents;
+	// CPU ns minus GPU ns, once measured
+	long long m_gpuOffset;
+	bool m_haveGpuOffset;
+};
+
+Profiler &Profiler::Instance()
+{
+	static Profiler profiler;
+	return profiler;
+}
+
+Profiler::Profiler()
+	: m_start(Clock::now())
+	, m_gpuOffset(0)
+	, m_haveGpuOffset(false)
+{
+}
+
+Profiler::~Profiler()
+{
+	// the GL context may be gone by now, the query names just leak
+	for (std::unique_ptr<ThreadBuffer> &thread : m_threads)
+	{
+		Chunk *chunk = thread->head.release();
+		while (chunk)
+		{
+			Chunk *next = chunk->next.load();
+			delete chunk;
+			chunk = next;
+		}
+	}
+}
+
+u64 Profiler::Now() const
+{
+	return (u64)std::chrono::duration_cast<std::chrono::nanoseconds>(
+			   Clock::now() - m_start)
+		.count();
+}
+
+Profiler::ThreadBuffer &Profiler::ThisThread()
+{
+	thread_local ThreadBuffer *buffer = nullptr;
+	if (!buffer)
+	{
+		std::lock_guard<std::mutex> lock(m_threadsMutex);
+		m_threads.emplace_back(new ThreadBuffer());
+		buffer = m_threads.back().get();
+		buffer->id = (u32)m_threads.size();
+		buffer->name = "thread " + std::to_string(buffer->id);
+		buffer->head.reset(new Chunk());
+		buffer->tail = buffer->head.get();
+		buffer->chunks = 1;
+	}
+	return *buffer;
+}
+
+void Profiler::SetThreadName(const char *name)
+{
+	ThreadBuffer &thread = ThisThread();
+	std::lock_guard<std::mutex> lock(m_threadsMutex);
+	thread.name = name;
+}
+
+void Profiler::Record(const char *name)
+{
+	ThreadBuffer &thread = ThisThread();
+	Chunk *chunk = thread.tail;
+	u32 count = chunk->count.load(std::memory_order_relaxed);
+	if (count == PROFILER_CHUNK_EVENTS)
+	{
+		if (thread.chunks == PROFILER_MAX_CHUNKS)
+		{
+			thread.dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		Chunk *next = new Chunk();
+		chunk->next.store(next, std::memory_order_release);
+		thread.tail = chunk = next;
+		thread.chunks++;
+		count = 0;
+	}
+	chunk->events[count].name = name;
+	chunk->events[count].ns = Now();
+	chunk->count.store(count + 1, std::memory_order_release);
+}
+
+void Profiler::Begin(const char *name)
+{
+	Record(name);
+}
+
+void Profiler::End()
+{
+	Record(nullptr);
+}
+
+void Profiler::BeginGpu(const char *name)
+{
+	if (!m_haveGpuOffset)
+	{
+		GLint64 gpuNow = 0;
+		glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+		m_gpuOffset = (long long)Now() - (long long)gpuNow;
+		m_haveGpuOffset = true;
+	}
+	GpuScope scope;
+	scope.name = name;
+	if (m_freeQueries.size() < 2)
+	{
+		const size_t inFlight = m_pendingGpu.size() + m_openGpu.size();
+		if (inFlight >= PROFILER_MAX_GPU_QUERIES)
+		{
+			// too many in flight, an unnamed scope isn't recorded
+			scope.name = nullptr;
+			scope.queries[0] = scope.queries[1] = 0;
+			m_openGpu.push_back(scope);
+			return;
+		}
+		u32 queries[2];
+		glGenQueries(2, queries);
+		m_freeQueries.insert(m_freeQueries.end(), queries, queries + 2);
+	}
+	scope.queries[0] = m_freeQueries.back();
+	m_freeQueries.pop_back();
+	scope.queries[1] = m_freeQueries.back();
+	m_freeQueries.pop_back();
+	glQueryCounter(scope.queries[0], GL_TIMESTAMP);
+	m_openGpu.push_back(scope);
+}
+
+void Profiler::EndGpu()
+{
+	GpuScope scope = m_openGpu.back();
+	m_openGpu.pop_back();
+	if (!scope.name) return;
+	glQueryCounter(scope.queries[1], GL_TIMESTAMP);
+	m_pendingGpu.push_back(scope);
+}
+
+void Profiler::Collect()
+{
+	// in issue order, so stop at the first that isn't done
+	size_t done = 0;
+	for (; done < m_pendingGpu.size(); done++)
+	{
+		const GpuScope &scope = m_pendingGpu[done];
+		GLint available = 0;
+		glGetQueryObjectiv(scope.queries[1], GL_QUERY_RESULT_AVAILABLE,
+						   &available);
+		if (!available) break;
+		GLuint64 begin = 0, end = 0;
+		glGetQueryObjectui64v(scope.queries[0], GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(scope.queries[1], GL_QUERY_RESULT, &end);
+		m_gpuEvents.push_back({ scope.name,
+								(u64)((long long)begin + m_gpuOffset),
+								(u64)((long long)end + m_gpuOffset) });
+		m_freeQueries.push_back(scope.queries[0]);
+		m_freeQueries.push_back(scope.queries[1]);
+	}
+	m_pendingGpu.erase(m_pendingGpu.begin(), m_pendingGpu.begin() + done);
+}
+
+// JSON string contents, names are identifiers and paths but be safe
+void WriteJsonString(std::ofstream &out, const std::string &s)
+{
+	out << '"';
+	for (char c : s)
+	{
+		if (c == '"' || c == '\\') out << '\\';
+		if ((unsigned char)c < 0x20) continue;
+		out << c;
+	}
+	out << '"';
+}
+
+bool Profiler::WriteTrace(const char *path)
+{
+	Collect();
+	std::ofstream out(path);
+	if (!out)
+	{
+		std::cout << "ERROR::PROFILER::CANNOT_WRITE " << path << std::endl;
+		return false;
+	}
+	out.setf(std::ios::fixed);
+	out.precision(3);
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	bool first = true;
+	auto separator = [&]() {
+		if (!first) out << ",\n";
+		first = false;
+	};
+
+	std::lock_guard<std::mutex> lock(m_threadsMutex);
+	u64 dropped = 0;
+	for (const std::unique_ptr<ThreadBuffer> &thread : m_threads)
+	{
+		separator();
+		out << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":"
+			<< thread->id << ",\"args\":{\"name\":";
+		WriteJsonString(out, thread->name);
+		out << "}}";
+		for (const Chunk *chunk = thread->head.get(); chunk;
+			 chunk = chunk->next.load(std::memory_order_acquire))
+		{
+			const u32 count = chunk->count.load(std::memory_order_acquire);
+			for (u32 i = 0; i < count; i++)
+			{
+				const Event &event = chunk->events[i];
+				separator();
+				if (event.name)
+				{
+					out << "{\"ph\":\"B\",\"name\":";
+					WriteJsonString(out, event.name);
+					out << ",";
+				}
+				else
+				{
+					out << "{\"ph\":\"E\",";
+				}
+				out << "\"pid\":1,\"tid\":" << thread->id
+					<< ",\"ts\":" << event.ns / 1000.0 << "}";
+			}
+		}
+		dropped += thread->dropped.load(std::memory_order_relaxed);
+	}
+
+	// GPU scopes as complete events on a thread of their own
+	const u32 gpuTid = 0;
+	separator();
+	out << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":"
+		<< gpuTid << ",\"args\":{\"name\":\"GPU\"}}";
+	for (const GpuEvent &event : m_gpuEvents)
+	{
+		separator();
+		out << "{\"ph\":\"X\",\"name\":";
+		WriteJsonString(out, event.name);
+		out << ",\"pid\":1,\"tid\":" << gpuTid
+			<< ",\"ts\":" << event.beginNs / 1000.0
+			<< ",\"dur\":" << (event.endNs - event.beginNs) / 1000.0 << "}";
+	}
+	out << "\n]}\n";
+	if (dropped > 0)
+	{
+		std::cout << "ERROR::PROFILER::EVENTS_DROPPED " << dropped << std::endl;
+	}
+	return true;
+}
+
+// Records the enclosing scope on this thread
+class ProfileScope
+{
+public:
+	explicit ProfileScope(const char *name) { Profiler::Instance().Begin(name); }
+	~ProfileScope() { Profiler::Instance().End(); }
+	ProfileScope(const ProfileScope &) = delete;
+	ProfileScope &operator=(const ProfileScope &) = delete;
+};
+
+// Times the GL commands issued in the enclosing scope
+class GpuProfileScope
+{
+public:
+	explicit GpuProfileScope(const char *name)
+	{
+		Profiler::Instance().BeginGpu(name);
+	}
+	~GpuProfileScope() { Profiler::Instance().EndGpu(); }
+	GpuProfileScope(const GpuProfileScope &) = delete;
+	GpuProfileScope &operator=(const GpuProfileScope &) = delete;
+};
+
+// Ranges that aren't a C++ scope use the BEGIN/END pairs, which must nest
+// with everything else on the thread
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#ifndef NO_PROFILER
+#define PROFILE_SCOPE(name) \
+	ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__FUNCTION__)
+#define PROFILE_GPU_SCOPE(name) \
+	GpuProfileScope PROFILE_CONCAT(gpuProfileScope, __LINE__)(name)
+#define PROFILE_BEGIN(name) Profiler::Instance().Begin(name)
+#define PROFILE_END() Profiler::Instance().End()
+#define PROFILE_GPU_BEGIN(name) Profiler::Instance().BeginGpu(name)
+#define PROFILE_GPU_END() Profiler::Instance().EndGpu()
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_FUNCTION() ((void)0)
+#define PROFILE_GPU_SCOPE(name) ((void)0)
+#define PROFILE_BEGIN(name) ((void)0)
+#define PROFILE_END() ((void)0)
+#define PROFILE_GPU_BEGIN(name) ((void)0)
+#define PROFILE_GPU_END() ((void)0)
+#endif
@@ -0,0 +1,862 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <vector>
+#include <string>
+#include <functional>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+#include "scenerenderer.h"
+#include "camera.h"
+#include "camerapath.h"
+#include "framestats.h"
+#include "profiler.h"
+#include "types.h"
+
+// Every scene renders at this size, and so every golden image is
+const u32 REGRESSION_WIDTH = 640;
+const u32 REGRESSION_HEIGHT = 360;
+// Measured frames a scene, after the warm up frames that fill the caches,
+// pools and shadow maps
+const u32 REGRESSION_FRAMES = 30;
+const u32 REGRESSION_WARMUP_FRAMES = 5;
+
+// A scene fails if it takes longer or draws more than this
+struct RegressionBudget
+{
+	// 95th percentile of the CPU frame time, through glFinish
+	double frameMs;
+	// most draws in a frame
+	u32 draws;
+};
+
+// How far the last frame may be from the golden image. Pixels are compared by
+// their CIE76 colour difference, the distance between them in CIELAB, which
+// follows what the eye notices far better than RGB does. About 2.3 is just
+// noticeable.
+struct ImageTolerance
+{
+	float deltaE = 2.3f;
+	// fraction of the pixels allowed over deltaE
+	float pixelFraction = 0.001f;
+};
+
+// Budgets, measured on llvmpipe with room to spare. Frame times scale with
+// the machine, see RegressionSuite::SetTimeScale. Draws should only change
+// with the scenes.
+const RegressionBudget SCENE_BUDGET = { 50.0, 8 };
+// every caster redrawn for the four cascades and a full tile budget
+const RegressionBudget NANOSUIT_BUDGET = { 80.0, 160 };
+const RegressionBudget STRESS_DRAWS_BUDGET = { 30.0, 4096 };
+const RegressionBudget STRESS_LIGHTS_BUDGET = { 300.0, 2 };
+const RegressionBudget INSTANCED_MESH_BUDGET = { 20.0, 1 };
+
+struct RegressionResult
+{
+	std::string name;
+	u32 frames = 0;
+	// scaled by the time scale
+	RegressionBudget budget = {};
+	TimingPercentiles frameMs;
+	u32 maxDraws = 0;
+	// fraction of pixels over the tolerance, the largest difference
+	float differentPixels = 0.0f;
+	float maxDeltaE = 0.0f;
+	bool goldenMissing = false;
+	// the scene couldn't be set up, nothing was drawn or recorded
+	bool setupFailed = false;
+	bool goldenUpdated = false;
+	bool imagePassed = false;
+	bool timePassed = false;
+	bool drawsPassed = false;
+
+	bool Passed() const { return imagePassed && timePassed && drawsPassed; }
+};
+
+// Renders scenes offscreen and checks each against its budget and a golden
+// image of its last frame.
+//
+// Golden images are binary PPMs in goldenDir named after their scene, the
+// ones in golden/ recorded on llvmpipe. With updateGolden the last frames are
+// written there instead of compared, on the reference machine, and the
+// directory must exist (make golden records them). A scene failing the image
+// check leaves name.actual.ppm and name.diff.ppm next to its golden, the diff
+// showing the pixels over tolerance in red on the golden in grey.
+class RegressionSuite
+{
+public:
+	RegressionSuite(const std::string &goldenDir, bool updateGolden);
+	~RegressionSuite();
+	RegressionSuite(const RegressionSuite &) = delete;
+	RegressionSuite &operator=(const RegressionSuite &) = delete;
+
+	// Frame time budgets are multiplied by scale, for slower or faster
+	// machines than the budgets were set on
+	void SetTimeScale(double scale) { m_timeScale = scale; }
+	// Draw into this, REGRESSION_WIDTH by REGRESSION_HEIGHT colour and
+	// depth/stencil
+	u32 Framebuffer() const { return m_framebuffer; }
+
+	// Render frames of a scene after the warm up frames, which draw frame 0.
+	// drawFrame draws frame into Framebuffer() and returns its draw count.
+	// Returns whether the scene passed.
+	bool Run(const std::string &name, u32 frames,
+			 const RegressionBudget &budget, const ImageTolerance &tolerance,
+			 const std::function<u32(u32 frame)> &drawFrame);
+	// Record a scene that couldn't be set up, such as for missing assets, as
+	// failed without drawing it or touching its golden
+	void Fail(const std::string &name, const RegressionBudget &budget);
+
+	const std::vector<RegressionResult> &Results() const { return m_results; }
+	bool Passed() const;
+	// Whether the scenes that failed did so only for want of a golden image
+	bool OnlyGoldensMissing() const;
+	void Print() const;
+	bool WriteJson(const char *path) const;
+
+private:
+	void CheckImage(const ImageTolerance &tolerance, RegressionResult &result);
+
+	std::string m_goldenDir;
+	bool m_updateGolden;
+	double m_timeScale;
+	u32 m_framebuffer;
+	u32 m_colour;
+	u32 m_depthStencil;
+	std::vector<RegressionResult> m_results;
+};
+
+// 8-bit RGB rows from the top
+bool WritePPM(const std::string &path, u32 width, u32 height,
+			  const std::vector<u8> &rgb)
+{
+	std::ofstream out(path, std::ios::binary);
+	if (!out)
+	{
+		std::cout << "ERROR::REGRESSION::CANNOT_WRITE " << path << std::endl;
+		return false;
+	}
+	out << "P6\n" << width << " " << height << "\n255\n";
+	out.write((const char *)rgb.data(), rgb.size());
+	return (bool)out;
+}
+
+// Only reads what WritePPM writes, false if there's no such file
+bool ReadPPM(const std::string &path, u32 &width, u32 &height,
+			 std::vector<u8> &rgb)
+{
+	std::ifstream in(path, std::ios::binary);
+	std::string magic;
+	u32 maxValue = 0;
+	in >> magic >> width >> height >> maxValue;
+	// the single whitespace ending the header
+	in.get();
+	if (!in || magic != "P6" || maxValue != 255) return false;
+	rgb.resize(width * height * 3);
+	in.read((char *)rgb.data(), rgb.size());
+	return (bool)in;
+}
+
+// The framebuffer's colour as 8-bit RGB rows from the top, as in a PPM
+std::vector<u8> ReadFramebufferRGB(u32 framebuffer, u32 width, u32 height)
+{
+	const u32 rowSize = width * 3;
+	std::vector<u8> pixels(rowSize * height);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+	std::vector<u8> rows(pixels.size());
+	for (u32 y = 0; y < height; y++)
+	{
+		std::copy(pixels.begin() + (height - 1 - y) * rowSize,
+				  pixels.begin() + (height - y) * rowSize,
+				  rows.begin() + y * rowSize);
+	}
+	return rows;
+}
+
+std::vector<float> MakeSRGBToLinearTable()
+{
+	std::vector<float> table(256);
+	for (u32 i = 0; i < 256; i++)
+	{
+		const float c = i / 255.0f;
+		table[i] = c <= 0.04045f ? c / 12.92f
+								 : std::pow((c + 0.055f) / 1.055f, 2.4f);
+	}
+	return table;
+}
+
+// CIELAB of an 8-bit sRGB colour, for a D65 white
+glm::vec3 SRGBToLab(const u8 *rgb)
+{
+	static const std::vector<float> linear = MakeSRGBToLinearTable();
+	const float r = linear[rgb[0]], g = linear[rgb[1]], b = linear[rgb[2]];
+	// XYZ over the white point's
+	const glm::vec3 xyz((0.4124f * r + 0.3576f * g + 0.1805f * b) / 0.95047f,
+						0.2126f * r + 0.7152f * g + 0.0722f * b,
+						(0.0193f * r + 0.1192f * g + 0.9505f * b) / 1.08883f);
+	glm::vec3 f;
+	for (u32 i = 0; i < 3; i++)
+	{
+		f[i] = xyz[i] > 0.008856f ? std::cbrt(xyz[i])
+								  : 7.787f * xyz[i] + 16.0f / 116.0f;
+	}
+	return glm::vec3(116.0f * f.y - 16.0f, 500.0f * (f.x - f.y),
+					 200.0f * (f.y - f.z));
+}
+
+RegressionSuite::RegressionSuite(const std::string &goldenDir,
+								 bool updateGolden)
+	: m_goldenDir(goldenDir)
+	, m_updateGolden(updateGolden)
+	, m_timeScale(1.0)
+{
+	glGenRenderbuffers(1, &m_colour);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_colour);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, REGRESSION_WIDTH,
+						  REGRESSION_HEIGHT);
+	glGenRenderbuffers(1, &m_depthStencil);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_depthStencil);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8,
+						  REGRESSION_WIDTH, REGRESSION_HEIGHT);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	glGenFramebuffers(1, &m_framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+							  GL_RENDERBUFFER, m_colour);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+							  GL_RENDERBUFFER, m_depthStencil);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+RegressionSuite::~RegressionSuite()
+{
+	glDeleteFramebuffers(1, &m_framebuffer);
+	glDeleteRenderbuffers(1, &m_colour);
+	glDeleteRenderbuffers(1, &m_depthStencil);
+}
+
+bool RegressionSuite::Run(const std::string &name, u32 frames,
+						  const RegressionBudget &budget,
+						  const ImageTolerance &tolerance,
+						  const std::function<u32(u32 frame)> &drawFrame)
+{
+	using Clock = std::chrono::steady_clock;
+	PROFILE_SCOPE("regression scene");
+	RegressionResult result;
+	result.name = name;
+	result.frames = frames;
+	result.budget = budget;
+	result.budget.frameMs *= m_timeScale;
+	std::vector<double> frameMs;
+	for (u32 frame = 0; frame < REGRESSION_WARMUP_FRAMES + frames; frame++)
+	{
+		const bool warmup = frame < REGRESSION_WARMUP_FRAMES;
+		const Clock::time_point start = Clock::now();
+		const u32 draws
+			= drawFrame(warmup ? 0 : frame - REGRESSION_WARMUP_FRAMES);
+		// in place of the swap, so the time covers the GPU's work
+		glFinish();
+		if (warmup) continue;
+		frameMs.push_back(std::chrono::duration<double, std::milli>(
+							  Clock::now() - start)
+							  .count());
+		result.maxDraws = std::max(result.maxDraws, draws);
+	}
+	result.frameMs = FrameStats::Percentiles(frameMs);
+	result.timePassed = result.frameMs.p95 <= result.budget.frameMs;
+	result.drawsPassed = result.maxDraws <= result.budget.draws;
+	CheckImage(tolerance, result);
+	m_results.push_back(result);
+	return result.Passed();
+}
+
+void RegressionSuite::Fail(const std::string &name,
+						   const RegressionBudget &budget)
+{
+	RegressionResult result;
+	result.name = name;
+	result.budget = budget;
+	result.budget.frameMs *= m_timeScale;
+	result.setupFailed = true;
+	m_results.push_back(result);
+}
+
+void RegressionSuite::CheckImage(const ImageTolerance &tolerance,
+								 RegressionResult &result)
+{
+	const std::vector<u8> actual = ReadFramebufferRGB(
+		m_framebuffer, REGRESSION_WIDTH, REGRESSION_HEIGHT);
+	const std::string path = m_goldenDir + "/" + result.name;
+	if (m_updateGolden)
+	{
+		result.goldenUpdated = WritePPM(path + ".ppm", REGRESSION_WIDTH,
+										REGRESSION_HEIGHT, actual);
+		result.imagePassed = result.goldenUpdated;
+		return;
+	}
+	u32 width = 0, height = 0;
+	std::vector<u8> golden;
+	if (!ReadPPM(path + ".ppm", width, height, golden)
+		|| width != REGRESSION_WIDTH || height != REGRESSION_HEIGHT)
+	{
+		result.goldenMissing = true;
+		WritePPM(path + ".actual.ppm", REGRESSION_WIDTH, REGRESSION_HEIGHT,
+				 actual);
+		return;
+	}
+
+	std::vector<u8> diff(actual.size());
+	u32 different = 0;
+	for (size_t p = 0; p < actual.size(); p += 3)
+	{
+		const float deltaE
+			= glm::length(SRGBToLab(&actual[p]) - SRGBToLab(&golden[p]));
+		result.maxDeltaE = std::max(result.maxDeltaE, deltaE);
+		const bool over = deltaE > tolerance.deltaE;
+		if (over) different++;
+		const u8 grey = (u8)((golden[p] + golden[p + 1] + golden[p + 2]) / 6);
+		diff[p] = over ? 255 : grey;
+		diff[p + 1] = over ? 0 : grey;
+		diff[p + 2] = over ? 0 : grey;
+	}
+	result.differentPixels
+		= (float)different / (REGRESSION_WIDTH * REGRESSION_HEIGHT);
+	result.imagePassed = result.differentPixels <= tolerance.pixelFraction;
+	if (!result.imagePassed)
+	{
+		WritePPM(path + ".actual.ppm", REGRESSION_WIDTH, REGRESSION_HEIGHT,
+				 actual);
+		WritePPM(path + ".diff.ppm", REGRESSION_WIDTH, REGRESSION_HEIGHT,
+				 diff);
+	}
+}
+
+bool RegressionSuite::Passed() const
+{
+	return std::all_of(m_results.begin(), m_results.end(),
+					   [](const RegressionResult &r) { return r.Passed(); });
+}
+
+bool RegressionSuite::OnlyGoldensMissing() const
+{
+	bool missing = false;
+	for (const RegressionResult &r : m_results)
+	{
+		if (r.Passed()) continue;
+		if (!r.goldenMissing || !r.timePassed || !r.drawsPassed) return false;
+		missing = true;
+	}
+	return missing;
+}
+
+void RegressionSuite::Print() const
+{
+	std::cout << "regression\tp95 ms\tbudget\tdraws\tbudget\tpixels over"
+			  << "\tmax dE" << std::endl;
+	for (const RegressionResult &r : m_results)
+	{
+		std::cout << r.name << "\t" << r.frameMs.p95 << "\t"
+				  << r.budget.frameMs << "\t" << r.maxDraws << "\t"
+				  << r.budget.draws << "\t" << r.differentPixels * 100.0f
+				  << "%\t\t" << r.maxDeltaE << "\t";
+		if (r.Passed())
+			std::cout << (r.goldenUpdated ? "UPDATED" : "PASS");
+		else
+		{
+			std::cout << "FAIL";
+			if (r.setupFailed)
+			{
+				std::cout << " setup" << std::endl;
+				continue;
+			}
+			if (!r.timePassed) std::cout << " time";
+			if (!r.drawsPassed) std::cout << " draws";
+			if (r.goldenMissing) std::cout << " no golden";
+			else if (!r.imagePassed) std::cout << " image";
+		}
+		std::cout << std::endl;
+	}
+	if (std::any_of(m_results.begin(), m_results.end(),
+					[](const RegressionResult &r) { return r.goldenMissing; }))
+	{
+		std::cout << "no golden image in " << m_goldenDir
+				  << " for some scenes, run make golden first" << std::endl;
+	}
+}
+
+bool RegressionSuite::WriteJson(const char *path) const
+{
+	std::ofstream out(path);
+	if (!out)
+	{
+		std::cout << "ERROR::REGRESSION::CANNOT_WRITE " << path << std::endl;
+		return false;
+	}
+	out.setf(std::ios::fixed);
+	out.precision(4);
+	out << "{\n\"renderer\":";
+	WriteJsonString(out, (const char *)glGetString(GL_RENDERER));
+	out << ",\n\"width\":" << REGRESSION_WIDTH << ",\"height\":"
+		<< REGRESSION_HEIGHT << ",\"passed\":"
+		<< (Passed() ? "true" : "false");
+	out << ",\n\"scenes\":[";
+	for (size_t i = 0; i < m_results.size(); i++)
+	{
+		const RegressionResult &r = m_results[i];
+		out << (i ? ",\n" : "\n") << "{\"name\":";
+		WriteJsonString(out, r.name);
+		out << ",\"passed\":" << (r.Passed() ? "true" : "false")
+			<< ",\"frames\":" << r.frames << ",\"frameMs\":";
+		WriteJsonPercentiles(out, r.frameMs);
+		out << ",\"frameBudgetMs\":" << r.budget.frameMs
+			<< ",\"draws\":" << r.maxDraws
+			<< ",\"drawBudget\":" << r.budget.draws
+			<< ",\"differentPixels\":" << r.differentPixels
+			<< ",\"maxDeltaE\":" << r.maxDeltaE
+			<< ",\"goldenMissing\":" << (r.goldenMissing ? "true" : "false")
+			<< ",\"setupFailed\":" << (r.setupFailed ? "true" : "false")
+			<< "}";
+	}
+	out << "\n]\n}\n";
+	return true;
+}
+
+// The window's scene, cubes, floor, grass, skybox and selection outline
+// through the post chain, along a quarter of the orbit. gpuCulling runs it
+// as "scene_gpu_culling" with the cubes and grass culled on the GPU, which
+// needs GL 4.3.
+void RegressDemoScene(RegressionSuite &suite, bool gpuCulling)
+{
+	const std::string name = gpuCulling ? "scene_gpu_culling" : "scene";
+	SceneRenderer renderer(REGRESSION_WIDTH, REGRESSION_HEIGHT);
+	if (renderer.SetGpuCulling(gpuCulling) != gpuCulling)
+	{
+		suite.Fail(name, SCENE_BUDGET);
+		return;
+	}
+	// the dynamic resolution would change the image with the frame time
+	renderer.SetDynamicResolution(false);
+	Camera camera;
+	suite.Run(name, REGRESSION_FRAMES, SCENE_BUDGET, ImageTolerance(),
+			  [&](u32 frame) {
+				  renderer.BeginFrame();
+				  PlaceOnOrbit(camera, ORBIT_CENTRE, ORBIT_RADIUS,
+							   ORBIT_HEIGHT,
+							   0.25f * frame / REGRESSION_FRAMES);
+				  return renderer.Render(camera, suite.Framebuffer());
+			  });
+}
+
+// Square on the y = 0 plane, facing up, textured with texture
+Mesh MakeRegressionFloor(float halfSize, TXO texture)
+{
+	std::vector<Vertex> vertices(4);
+	for (u32 i = 0; i < 4; i++)
+	{
+		const glm::vec2 corner((i & 1) ? 1.0f : -1.0f,
+							   (i & 2) ? 1.0f : -1.0f);
+		vertices[i].Position
+			= glm::vec3(corner.x, 0.0f, corner.y) * halfSize;
+		vertices[i].Normal = glm::vec3(0.0f, 1.0f, 0.0f);
+		vertices[i].TexCoords = corner * halfSize;
+	}
+	return Mesh(vertices, { 0, 2, 1, 1, 2, 3 },
+				{ { texture, Texture::Type::Diffuse, "" },
+				  { texture, Texture::Type::Specular, "" } });
+}
+
+// The nanosuit on a floor lit by lighting3.fs: the sun with cascaded
+// shadows, and point and spot lights shadowed from the atlas, the camera
+// circling it
+void RegressNanosuit(RegressionSuite &suite)
+{
+	const float fovY = glm::radians(45.0f);
+	const float aspect = (float)REGRESSION_WIDTH / REGRESSION_HEIGHT;
+	const float zNear = 0.1f, zFar = 100.0f;
+
+	Model nanosuit("assets/nanosuit/nanosuit.obj");
+	// a floor alone would pass against a golden recorded without the model
+	if (nanosuit.GetMeshes().empty())
+	{
+		std::cout << "ERROR::REGRESSION::NANOSUIT_NOT_LOADED" << std::endl;
+		suite.Fail("nanosuit", NANOSUIT_BUDGET);
+		return;
+	}
+	const TXO white = MakeWhiteTexture();
+	const Mesh ground = MakeRegressionFloor(8.0f, white);
+	// the model is about 15 units tall
+	const glm::mat4 suitModel = glm::scale(glm::mat4(), glm::vec3(0.2f));
+	std::vector<std::pair<const Mesh *, glm::mat4>> draws;
+	draws.push_back({ &ground, glm::mat4() });
+	for (const Mesh &mesh : nanosuit.GetMeshes())
+	{
+		draws.push_back({ &mesh, suitModel });
+	}
+
+	Shader litShader("shaders/lighting3.vs", "shaders/lighting3.fs");
+	litShader.use();
+	litShader.bindUniformBlock("PerDraw", PER_DRAW_UBO_BINDING);
+	litShader.bindUniformBlock("Lights", LIGHTS_UBO_BINDING);
+	litShader.bindUniformBlock("Shadows", SHADOWS_UBO_BINDING);
+	litShader.setFloat("material.shininess", 32.0f);
+	Shader depthShader("shaders/shadowDepth.vs", "shaders/shadowDepth.fs");
+	depthShader.bindUniformBlock("PerDraw", PER_DRAW_UBO_BINDING);
+
+	DirectionalLight sun;
+	sun.direction = glm::vec3(-0.3f, -1.0f, -0.4f);
+	sun.ambient = glm::vec3(0.08f);
+	sun.diffuse = glm::vec3(0.4f);
+	sun.specular = glm::vec3(0.3f);
+	std::vector<PointLight> startPoints(2);
+	startPoints[0].position = glm::vec3(1.5f, 2.0f, 1.0f);
+	startPoints[0].colour = glm::vec3(1.0f, 0.7f, 0.4f);
+	startPoints[1].position = glm::vec3(-1.5f, 1.0f, -1.0f);
+	startPoints[1].colour = glm::vec3(0.3f, 0.5f, 1.0f);
+	std::vector<SpotLight> startSpots(1);
+	startSpots[0].position = glm::vec3(0.0f, 5.0f, 3.0f);
+	startSpots[0].direction
+		= glm::normalize(glm::vec3(0.0f, 1.5f, 0.0f) - startSpots[0].position);
+	startSpots[0].colour = glm::vec3(1.0f);
+
+	CascadedShadows cascades;
+	cascades.SetLightDirection(sun.direction);
+	ShadowAtlas atlas;
+	LightManager lights;
+	RenderQueue casterQueue;
+	const u32 alignment = UniformBufferAlignment();
+	RingBuffer perDraw(GL_UNIFORM_BUFFER, (u32)draws.size()
+						   * (sizeof(PerDrawConstants) + alignment));
+	std::vector<u32> offsets(draws.size());
+
+	u32 drawCount = 0;
+	const ShadowAtlas::DrawCasters drawCasters
+		= [&](Shader &shader, const glm::mat4 &view,
+			  const glm::mat4 &projection) {
+			  casterQueue.Clear();
+			  for (const auto &draw : draws)
+			  {
+				  DrawItem item;
+				  item.shader = &shader;
+				  item.vao = draw.first->DepthVAO();
+				  item.count = draw.first->IndexCount();
+				  item.indexed = true;
+				  item.model = draw.second;
+				  casterQueue.Push(RenderQueue::MakeKey(0, false, 0, 0, 0,
+														0.0f),
+								   item);
+			  }
+			  casterQueue.Sort();
+			  casterQueue.SetCamera(view, projection);
+			  casterQueue.Execute(nullptr);
+			  drawCount += casterQueue.GetStats().draws;
+		  };
+
+	Camera camera;
+	suite.Run(
+		"nanosuit", REGRESSION_FRAMES, NANOSUIT_BUDGET, ImageTolerance(),
+		[&](u32 frame) {
+			drawCount = 0;
+			PlaceOnOrbit(camera, glm::vec3(0.0f, 1.5f, 0.0f), 5.0f, 0.5f,
+						 0.1f + 0.25f * frame / REGRESSION_FRAMES);
+			const glm::mat4 view = camera.GetViewMatrix();
+			const glm::mat4 projection
+				= glm::perspective(fovY, aspect, zNear, zFar);
+
+			cascades.SetCamera(view, fovY, aspect, zNear, zFar);
+			cascades.Render([&](const glm::mat4 &lightView,
+								const glm::mat4 &lightProjection) {
+				drawCasters(depthShader, lightView, lightProjection);
+			});
+			std::vector<PointLight> points = startPoints;
+			std::vector<SpotLight> spots = startSpots;
+			atlas.Update(view, fovY, REGRESSION_HEIGHT, points, spots,
+						 drawCasters);
+			lights.Clear();
+			lights.SetDirectional(sun);
+			for (const PointLight &light : points) lights.AddPointLight(light);
+			for (const SpotLight &light : spots) lights.AddSpotLight(light);
+			lights.Upload(view);
+
+			perDraw.BeginFrame();
+			const PerDrawCamera perDrawCamera
+				= MakePerDrawCamera(view, projection);
+			for (size_t i = 0; i < draws.size(); i++)
+			{
+				ComputePerDraw(perDrawCamera, draws[i].second,
+							   (PerDrawConstants *)perDraw.Allocate(
+								   sizeof(PerDrawConstants), alignment,
+								   offsets[i]));
+			}
+			perDraw.Flush();
+
+			glBindFramebuffer(GL_FRAMEBUFFER, suite.Framebuffer());
+			glViewport(0, 0, REGRESSION_WIDTH, REGRESSION_HEIGHT);
+			glEnable(GL_DEPTH_TEST);
+			glDepthFunc(GL_LESS);
+			glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			// above the units the meshes bind their textures to
+			cascades.Bind(litShader, 6);
+			atlas.Bind(litShader, 7);
+			litShader.use();
+			for (size_t i = 0; i < draws.size(); i++)
+			{
+				glBindBufferRange(GL_UNIFORM_BUFFER, PER_DRAW_UBO_BINDING,
+								  perDraw.Buffer(), offsets[i],
+								  sizeof(PerDrawConstants));
+				draws[i].first->Draw(litShader);
+			}
+			drawCount += (u32)draws.size();
+			perDraw.EndFrame();
+			lights.EndFrame();
+			atlas.EndFrame();
+			return drawCount;
+		});
+
+	glDeleteProgram(litShader.m_programId);
+	glDeleteProgram(depthShader.m_programId);
+	glDeleteTextures(1, &white);
+}
+
+// A draw per cube for a 64 by 64 field of them, recorded on a thread pool
+// through the render queue, the camera sliding over it
+void RegressDrawStress(RegressionSuite &suite)
+{
+	const u32 side = 64;
+	Shader shader("shaders/normal.vs", "shaders/normal.fs");
+	shader.use();
+	shader.setInt("texture1", 0);
+	shader.bindUniformBlock("PerDraw", PER_DRAW_UBO_BINDING);
+	const TXO texture = loadTexture("assets/container.jpg");
+	VAO cubeVAO;
+	u32 cubeVBO;
+	glGenVertexArrays(1, &cubeVAO);
+	glGenBuffers(1, &cubeVBO);
+	glBindVertexArray(cubeVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(CUBE_VERTICES), CUBE_VERTICES,
+				 GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float),
+						  (void *)0);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float),
+						  (void *)(3 * sizeof(float)));
+	glBindVertexArray(0);
+
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<float> turn(0.0f, 3.14f);
+	std::vector<glm::mat4> models;
+	for (u32 i = 0; i < side * side; i++)
+	{
+		const glm::vec3 position((float)(i % side) - side * 0.5f, 0.0f,
+								 (float)(i / side) - side * 0.5f);
+		models.push_back(glm::rotate(
+			glm::scale(glm::translate(glm::mat4(), position),
+					   glm::vec3(0.6f)),
+			turn(rng), glm::normalize(glm::vec3(1.0f, 2.0f, 0.5f))));
+	}
+
+	ThreadPool pool;
+	RenderQueue queue;
+	queue.SetThreadPool(&pool);
+	const glm::mat4 projection = glm::perspective(
+		glm::radians(60.0f), (float)REGRESSION_WIDTH / REGRESSION_HEIGHT,
+		0.1f, 100.0f);
+	suite.Run("stress_draws", REGRESSION_FRAMES, STRESS_DRAWS_BUDGET,
+			  ImageTolerance(), [&](u32 frame) {
+				  const glm::vec3 eye(frame * 0.2f - 3.0f, 25.0f, 30.0f);
+				  const glm::mat4 view = glm::lookAt(
+					  eye, eye + glm::vec3(0.0f, -0.8f, -1.0f),
+					  glm::vec3(0.0f, 1.0f, 0.0f));
+				  queue.Clear();
+				  queue.Record((u32)models.size(), [&](DrawList &list,
+													  u32 begin, u32 end) {
+					  for (u32 i = begin; i < end; i++)
+					  {
+						  DrawItem item;
+						  item.shader = &shader;
+						  item.vao = cubeVAO;
+						  item.texture = texture;
+						  item.count = 36;
+						  item.model = models[i];
+						  const float depth = glm::length(
+							  glm::vec3(models[i][3]) - eye) / 100.0f;
+						  list.Push(RenderQueue::MakeKey(0, false,
+														 shader.m_programId,
+														 texture, cubeVAO,
+														 depth),
+									item);
+					  }
+				  });
+				  queue.Sort();
+				  queue.SetCamera(view, projection);
+				  glBindFramebuffer(GL_FRAMEBUFFER, suite.Framebuffer());
+				  glViewport(0, 0, REGRESSION_WIDTH, REGRESSION_HEIGHT);
+				  glEnable(GL_DEPTH_TEST);
+				  glDepthFunc(GL_LESS);
+				  glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+				  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				  queue.Execute(nullptr);
+				  return queue.GetStats().draws;
+			  });
+
+	glDeleteProgram(shader.m_programId);
+	glDeleteTextures(1, &texture);
+	glDeleteVertexArrays(1, &cubeVAO);
+	glDeleteBuffers(1, &cubeVBO);
+}
+
+// Clustered shading of 1024 lights, a quarter of them spot lights, over the
+// lighting benchmark's layered terrain
+void RegressLightStress(RegressionSuite &suite)
+{
+	const u32 layerCount = 2;
+	const u32 lightCount = 1024;
+	LightingBenchmarkScene scene(REGRESSION_WIDTH, REGRESSION_HEIGHT,
+								 layerCount);
+	const glm::mat4 &view = scene.View();
+	Shader shader("shaders/deferredGeometry.vs", "shaders/clusteredLights.fs");
+	scene.Prepare(shader);
+	shader.setVec3("dirLight.vDirection",
+				   glm::mat3(view) * glm::vec3(-0.2f, -1.0f, -0.3f));
+	shader.setVec3("dirLight.ambient", glm::vec3(0.05f));
+	shader.setVec3("dirLight.diffuse", glm::vec3(0.2f));
+	shader.setVec3("dirLight.specular", glm::vec3(0.2f));
+	shader.setBool("bruteForce", false);
+	ClusteredLights clusters;
+	clusters.SetProjection(scene.Projection(), 0.1f, 100.0f, REGRESSION_WIDTH,
+						   REGRESSION_HEIGHT);
+
+	// as BenchmarkClustered lights them
+	std::mt19937 rng(42);
+	std::vector<PointLight> points = scene.MakeLights(lightCount, rng);
+	std::vector<SpotLight> spots;
+	for (PointLight &light : points)
+	{
+		light.linear = 0.7f;
+		light.quadratic = 2.8f;
+	}
+	for (u32 i = 0; i < lightCount / 4; i++)
+	{
+		const PointLight &light = points.back();
+		SpotLight spot;
+		spot.position = light.position + glm::vec3(0.0f, 1.0f, 0.0f);
+		spot.direction = glm::vec3(0.0f, -1.0f, 0.2f);
+		spot.colour = light.colour;
+		spot.linear = light.linear;
+		spot.quadratic = light.quadratic;
+		spots.push_back(spot);
+		points.pop_back();
+	}
+
+	// the lights circle their start positions, so each frame bins them into
+	// different clusters
+	const std::vector<PointLight> startPoints = points;
+	const std::vector<SpotLight> startSpots = spots;
+	const auto circle = [](u32 frame, size_t light) {
+		const float angle = 0.2f * frame + (float)light;
+		return 0.5f * glm::vec3(std::cos(angle), 0.0f, std::sin(angle));
+	};
+	suite.Run("stress_lights", REGRESSION_FRAMES, STRESS_LIGHTS_BUDGET,
+			  ImageTolerance(), [&](u32 frame) {
+				  for (size_t i = 0; i < points.size(); i++)
+				  {
+					  points[i].position
+						  = startPoints[i].position + circle(frame, i);
+				  }
+				  for (size_t i = 0; i < spots.size(); i++)
+				  {
+					  spots[i].position = startSpots[i].position
+										  + circle(frame, points.size() + i);
+				  }
+				  clusters.Build(view, points, spots);
+				  glBindFramebuffer(GL_FRAMEBUFFER, suite.Framebuffer());
+				  glViewport(0, 0, REGRESSION_WIDTH, REGRESSION_HEIGHT);
+				  glEnable(GL_DEPTH_TEST);
+				  glDepthFunc(GL_LESS);
+				  glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+				  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				  clusters.Bind(shader, 2);
+				  scene.Draw(shader);
+				  return layerCount;
+			  });
+
+	glDeleteProgram(shader.m_programId);
+}
+
+// A 16 by 16 field of tiles tilted every which way, one Mesh drawn
+// instanced, so its normals and texture coordinates both show
+void RegressInstancedMesh(RegressionSuite &suite)
+{
+	const u32 side = 16;
+	const TXO texture = loadTexture("assets/container.jpg");
+	const Mesh tile = MakeRegressionFloor(0.45f, texture);
+	Shader shader("shaders/instancedMesh.vs", "shaders/instancedMesh.fs");
+	shader.use();
+	shader.setVec3("lightDirection",
+				   glm::normalize(glm::vec3(0.3f, 1.0f, 0.5f)));
+
+	std::mt19937 rng(11);
+	std::uniform_real_distribution<float> tilt(-0.6f, 0.6f);
+	std::vector<glm::mat4> transforms;
+	for (u32 i = 0; i < side * side; i++)
+	{
+		const glm::vec3 position((float)(i % side) - side * 0.5f, 0.0f,
+								 (float)(i / side) - side * 0.5f);
+		glm::mat4 model = glm::translate(glm::mat4(), position);
+		model = glm::rotate(model, tilt(rng), glm::vec3(1.0f, 0.0f, 0.0f));
+		transforms.push_back(
+			glm::rotate(model, tilt(rng), glm::vec3(0.0f, 0.0f, 1.0f)));
+	}
+	InstanceBuffer instances;
+	instances.Upload(transforms);
+
+	const glm::mat4 projection = glm::perspective(
+		glm::radians(50.0f), (float)REGRESSION_WIDTH / REGRESSION_HEIGHT,
+		0.1f, 100.0f);
+	Camera camera;
+	suite.Run("instanced_mesh", REGRESSION_FRAMES, INSTANCED_MESH_BUDGET,
+			  ImageTolerance(), [&](u32 frame) {
+				  PlaceOnOrbit(camera, glm::vec3(0.0f), 12.0f, 8.0f,
+							   0.25f * frame / REGRESSION_FRAMES);
+				  glBindFramebuffer(GL_FRAMEBUFFER, suite.Framebuffer());
+				  glViewport(0, 0, REGRESSION_WIDTH, REGRESSION_HEIGHT);
+				  glEnable(GL_DEPTH_TEST);
+				  glDepthFunc(GL_LESS);
+				  glDisable(GL_CULL_FACE);
+				  glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+				  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				  shader.use();
+				  shader.setMat4("viewProjection",
+								 projection * camera.GetViewMatrix());
+				  tile.DrawInstanced(shader, instances);
+				  return 1u;
+			  });
+
+	glDeleteProgram(shader.m_programId);
+	glDeleteTextures(1, &texture);
+}
+
+// The canonical scenes, returns whether they all passed
+bool RunRegressionSuite(RegressionSuite &suite)
+{
+	RegressDemoScene(suite, false);
+	RegressDemoScene(suite, true);
+	RegressNanosuit(suite);
+	RegressDrawStress(suite);
+	RegressLightStress(suite);
+	RegressInstancedMesh(suite);
+	suite.Print();
+	return suite.Passed();
+}
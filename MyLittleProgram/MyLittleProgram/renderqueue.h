@@ -0,0 +1,572 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <cmath>
+#include <iostream>
+
+#include "shader.h"
+#include "ringbuffer.h"
+#include "transforms.h"
+#include "threadpool.h"
+#include "types.h"
+
+// Sort key layout (most significant bits first)
+//   opaque:      pass:4 | 0:1 | shader:8 | material:12 | vao:12 | depth:24
+//   translucent: pass:4 | 1:1 | ~depth:24 | shader:8 | material:12 | vao:12
+// Opaque draws are grouped by state and then sorted front to back so early-Z
+// rejects as much as possible; translucent draws are sorted back to front.
+const u32 RQ_PASS_BITS = 4;
+const u32 RQ_SHADER_BITS = 8;
+const u32 RQ_MATERIAL_BITS = 12;
+const u32 RQ_VAO_BITS = 12;
+const u32 RQ_DEPTH_BITS = 24;
+
+// Per-draw blocks the ring starts out with room for, it grows as needed
+const u32 RQ_INITIAL_PER_DRAW = 1024;
+// Fewest draws worth a job of their own when recording, sorting and
+// computing the per-draw constants on the thread pool. Below it the jobs
+// cost more than they save.
+const u32 RQ_DRAWS_PER_JOB = 2048;
+
+// Everything needed to issue one draw call
+struct DrawItem
+{
+	Shader *shader = nullptr;
+	VAO vao = 0;
+	TXO texture = 0;
+	GLenum textureTarget = GL_TEXTURE_2D;
+	GLenum primitive = GL_TRIANGLES;
+	u32 first = 0;
+	u32 count = 0;
+	// > 0 draws that many instances, the model matrices come from the
+	// instance buffer attached to the VAO starting at baseInstance (GL 4.2)
+	u32 instanceCount = 0;
+	u32 baseInstance = 0;
+	// non-zero: only draw if this occlusion query passed, without waiting for
+	// its result
+	u32 conditionQuery = 0;
+	bool indexed = false;
+	// model goes to the shader's PerDraw block
+	bool hasModel = true;
+	glm::mat4 model;
+};
+
+struct RenderQueueStats
+{
+	u32 draws = 0;
+	u64 triangles = 0;
+	u32 programSwitches = 0;
+	u32 textureSwitches = 0;
+	u32 vaoSwitches = 0;
+};
+
+// Draws recorded by one thread, merged into a RenderQueue after. Only keys,
+// handles and matrices, so recording doesn't touch GL.
+class DrawList
+{
+public:
+	void Clear();
+	void Push(u64 key, const DrawItem &item);
+	u32 Size() const { return (u32)m_keys.size(); }
+
+private:
+	friend class RenderQueue;
+	std::vector<u64> m_keys;
+	std::vector<DrawItem> m_items;
+};
+
+// Per-draw constants are written to a ring buffer in one go before the draws
+// and each draw binds its range of it, instead of a glUniform call per draw.
+// The model-view-projection and normal matrices are worked out there once
+// per draw, rather than per vertex in the shaders.
+//
+// With a thread pool, big queues are recorded, sorted and have their
+// constants worked out on every core, leaving the GL thread only the
+// replay. The result is the same as doing it all on one thread.
+class RenderQueue
+{
+public:
+	RenderQueue();
+
+	// Build a sort key. depth is the normalised view distance in [0, 1].
+	static u64 MakeKey(u32 pass, bool translucent, u32 shaderId,
+					   u32 materialId, u32 vaoId, float depth);
+
+	// Workers for Record, Sort and Execute's per-draw constants, nullptr
+	// to do it all on the calling thread. They wait for the whole pool, so
+	// for any other jobs on it as well.
+	void SetThreadPool(ThreadPool *pool) { m_pool = pool; }
+
+	void Clear();
+	void Push(u64 key, const DrawItem &item);
+	// Called on the pool's threads with a list to push the draws of objects
+	// [begin, end) to. Mustn't touch GL.
+	using RecordRange
+		= std::function<void(DrawList &list, u32 begin, u32 end)>;
+	// Record the draws of objects [0, count) across the pool, then append
+	// the lists in object order, as if they were pushed on this thread
+	void Record(u32 count, const RecordRange &record);
+	void Append(const DrawList &list);
+	void Sort();
+	// Camera the per-draw matrices are computed with, before Execute
+	void SetCamera(const glm::mat4 &view, const glm::mat4 &projection);
+	// Replay the sorted draws, only touching GL state that actually changes.
+	// onPassBegin is called whenever the pass field of the key changes so the
+	// caller can set up depth/stencil/cull state for that pass.
+	void Execute(const std::function<void(u32 pass)> &onPassBegin);
+
+	const RenderQueueStats &GetStats() const { return m_stats; }
+	u32 Size() const { return (u32)m_keys.size(); }
+
+private:
+	// How many jobs to split count draws into, 1 without a pool
+	u32 JobCount(u32 count) const;
+	// job(index, begin, end) over count draws split into jobCount ranges,
+	// submitted to the pool, or run on this thread when there's only one.
+	// Returns once they're all done.
+	void ForEachRange(u32 count, u32 jobCount,
+					  const std::function<void(u32 job, u32 begin,
+											   u32 end)> &job);
+
+	ThreadPool *m_pool;
+	std::vector<u64> m_keys;
+	std::vector<DrawItem> m_items;
+	// sorted order, indices into m_items
+	std::vector<u32> m_order;
+	// radix sort scratch
+	std::vector<u64> m_sortedKeys;
+	std::vector<u64> m_keysTmp;
+	std::vector<u32> m_orderTmp;
+	// a 256 bucket radix histogram per sort job
+	std::vector<u32> m_histograms;
+	// a list per record job
+	std::vector<DrawList> m_lists;
+	RenderQueueStats m_stats;
+	glm::mat4 m_view;
+	glm::mat4 m_projection;
+	// per-draw constants, and where each item's are
+	static u32 PerDrawStride();
+	u32 m_perDrawStride;
+	RingBuffer m_perDraw;
+	std::vector<u32> m_perDrawOffsets;
+};
+
+void DrawList::Clear()
+{
+	m_keys.clear();
+	m_items.clear();
+}
+
+void DrawList::Push(u64 key, const DrawItem &item)
+{
+	m_keys.push_back(key);
+	m_items.push_back(item);
+}
+
+RenderQueue::RenderQueue()
+	: m_pool(nullptr)
+	, m_perDrawStride(PerDrawStride())
+	, m_perDraw(GL_UNIFORM_BUFFER, RQ_INITIAL_PER_DRAW * m_perDrawStride)
+{
+}
+
+u32 RenderQueue::PerDrawStride()
+{
+	// bound ranges have to start on this alignment
+	const u32 alignment = UniformBufferAlignment();
+	return ((u32)sizeof(PerDrawConstants) + alignment - 1) / alignment
+		* alignment;
+}
+
+void RenderQueue::SetCamera(const glm::mat4 &view,
+							const glm::mat4 &projection)
+{
+	m_view = view;
+	m_projection = projection;
+}
+
+inline u64 RenderQueue::MakeKey(u32 pass, bool translucent, u32 shaderId,
+								u32 materialId, u32 vaoId, float depth)
+{
+	const u64 depthMax = (1ull << RQ_DEPTH_BITS) - 1;
+	depth = glm::clamp(depth, 0.0f, 1.0f);
+	u64 qDepth = (u64)(depth * (float)depthMax);
+
+	u64 shader = shaderId & ((1u << RQ_SHADER_BITS) - 1);
+	u64 material = materialId & ((1u << RQ_MATERIAL_BITS) - 1);
+	u64 vao = vaoId & ((1u << RQ_VAO_BITS) - 1);
+
+	u64 key = (u64)(pass & ((1u << RQ_PASS_BITS) - 1)) << 60;
+	if (!translucent)
+	{
+		key |= shader << 51;
+		key |= material << 39;
+		key |= vao << 27;
+		key |= qDepth << 3;
+	}
+	else
+	{
+		key |= 1ull << 59;
+		key |= (depthMax - qDepth) << 35;
+		key |= shader << 27;
+		key |= material << 15;
+		key |= vao << 3;
+	}
+	return key;
+}
+
+void RenderQueue::Clear()
+{
+	m_keys.clear();
+	m_items.clear();
+	m_order.clear();
+}
+
+void RenderQueue::Push(u64 key, const DrawItem &item)
+{
+	m_keys.push_back(key);
+	m_items.push_back(item);
+}
+
+u32 RenderQueue::JobCount(u32 count) const
+{
+	if (!m_pool) return 1;
+	return std::max(1u, std::min(m_pool->Concurrency(),
+								 count / RQ_DRAWS_PER_JOB));
+}
+
+void RenderQueue::ForEachRange(
+	u32 count, u32 jobCount,
+	const std::function<void(u32 job, u32 begin, u32 end)> &job)
+{
+	if (jobCount == 1)
+	{
+		job(0, 0, count);
+		return;
+	}
+	for (u32 j = 0; j < jobCount; j++)
+	{
+		const u32 begin = (u32)((u64)count * j / jobCount);
+		const u32 end = (u32)((u64)count * (j + 1) / jobCount);
+		m_pool->Submit([&job, j, begin, end]() { job(j, begin, end); });
+	}
+	m_pool->Wait();
+}
+
+void RenderQueue::Record(u32 count, const RecordRange &record)
+{
+	const u32 jobCount = JobCount(count);
+	if (m_lists.size() < jobCount) m_lists.resize(jobCount);
+	ForEachRange(count, jobCount, [&](u32 job, u32 begin, u32 end) {
+		m_lists[job].Clear();
+		record(m_lists[job], begin, end);
+	});
+
+	// then each list is copied to its place in the queue
+	const u32 first = (u32)m_keys.size();
+	std::vector<u32> starts(jobCount);
+	u32 total = first;
+	for (u32 j = 0; j < jobCount; j++)
+	{
+		starts[j] = total;
+		total += m_lists[j].Size();
+	}
+	m_keys.resize(total);
+	m_items.resize(total);
+	ForEachRange(jobCount, jobCount, [&](u32, u32 begin, u32 end) {
+		for (u32 j = begin; j < end; j++)
+		{
+			const DrawList &list = m_lists[j];
+			std::copy(list.m_keys.begin(), list.m_keys.end(),
+					  m_keys.begin() + starts[j]);
+			std::copy(list.m_items.begin(), list.m_items.end(),
+					  m_items.begin() + starts[j]);
+		}
+	});
+}
+
+void RenderQueue::Append(const DrawList &list)
+{
+	m_keys.insert(m_keys.end(), list.m_keys.begin(), list.m_keys.end());
+	m_items.insert(m_items.end(), list.m_items.begin(), list.m_items.end());
+}
+
+void RenderQueue::Sort()
+{
+	const u32 n = (u32)m_keys.size();
+	m_order.resize(n);
+	for (u32 i = 0; i < n; i++)
+	{
+		m_order[i] = i;
+	}
+	m_keysTmp.resize(n);
+	m_orderTmp.resize(n);
+
+	// LSD radix sort, one byte per pass. Bytes that are identical for every
+	// key (common for the high bits of small queues) are skipped.
+	//
+	// Split across jobs, each pass counts each job's range of keys, then
+	// scatters them with each job's buckets starting after the buckets of
+	// the jobs before it, so the sort stays stable.
+	const u32 jobCount = JobCount(n);
+	m_histograms.resize(jobCount * 256);
+	m_sortedKeys = m_keys;
+	std::vector<u64> &keys = m_sortedKeys;
+	for (u32 shift = 0; shift < 64; shift += 8)
+	{
+		ForEachRange(n, jobCount, [&](u32 job, u32 begin, u32 end) {
+			u32 *histogram = &m_histograms[job * 256];
+			std::fill(histogram, histogram + 256, 0);
+			for (u32 i = begin; i < end; i++)
+			{
+				histogram[(keys[i] >> shift) & 0xFF]++;
+			}
+		});
+		if (n == 0) continue;
+		const u32 firstBucket = (keys[0] >> shift) & 0xFF;
+		u32 inFirstBucket = 0;
+		for (u32 job = 0; job < jobCount; job++)
+		{
+			inFirstBucket += m_histograms[job * 256 + firstBucket];
+		}
+		if (inFirstBucket == n) continue;
+
+		u32 offset = 0;
+		for (u32 b = 0; b < 256; b++)
+		{
+			for (u32 job = 0; job < jobCount; job++)
+			{
+				u32 &bucket = m_histograms[job * 256 + b];
+				const u32 count = bucket;
+				bucket = offset;
+				offset += count;
+			}
+		}
+		ForEachRange(n, jobCount, [&](u32 job, u32 begin, u32 end) {
+			u32 *histogram = &m_histograms[job * 256];
+			for (u32 i = begin; i < end; i++)
+			{
+				u32 dst = histogram[(keys[i] >> shift) & 0xFF]++;
+				m_keysTmp[dst] = keys[i];
+				m_orderTmp[dst] = m_order[i];
+			}
+		});
+		keys.swap(m_keysTmp);
+		m_order.swap(m_orderTmp);
+	}
+}
+
+void RenderQueue::Execute(const std::function<void(u32 pass)> &onPassBegin)
+{
+	m_stats = RenderQueueStats();
+
+	// write every draw's constants up front, in draw order. Each draw has
+	// its place in the ring whether it uses it or not, so the jobs know
+	// where to write without counting.
+	const u32 n = (u32)m_order.size();
+	m_perDrawOffsets.resize(m_items.size());
+	m_perDraw.BeginFrame(n * m_perDrawStride);
+	u32 base = 0;
+	char *perDraw = n > 0 ? (char *)m_perDraw.Allocate(n * m_perDrawStride,
+													   m_perDrawStride, base)
+						  : nullptr;
+	const PerDrawCamera camera = MakePerDrawCamera(m_view, m_projection);
+	ForEachRange(n, JobCount(n), [&](u32, u32 begin, u32 end) {
+		for (u32 i = begin; i < end; i++)
+		{
+			const u32 idx = m_order[i];
+			m_perDrawOffsets[idx] = base + i * m_perDrawStride;
+			if (!m_items[idx].hasModel) continue;
+			ComputePerDraw(camera, m_items[idx].model,
+						   (PerDrawConstants *)(perDraw
+												+ i * m_perDrawStride));
+		}
+	});
+	m_perDraw.Flush();
+
+	const u32 noPass = 0xFFFFFFFF;
+	u32 currentPass = noPass;
+	u32 currentProgram = 0;
+	VAO currentVAO = 0;
+	TXO currentTexture = 0;
+	GLenum currentTarget = GL_NONE;
+
+	glActiveTexture(GL_TEXTURE0);
+	for (u32 idx : m_order)
+	{
+		const DrawItem &item = m_items[idx];
+		u32 pass = (u32)(m_keys[idx] >> 60);
+		if (pass != currentPass)
+		{
+			currentPass = pass;
+			if (onPassBegin) onPassBegin(pass);
+		}
+
+		if (item.shader->m_programId != currentProgram)
+		{
+			item.shader->use();
+			currentProgram = item.shader->m_programId;
+			m_stats.programSwitches++;
+		}
+		if (item.vao != currentVAO)
+		{
+			glBindVertexArray(item.vao);
+			currentVAO = item.vao;
+			m_stats.vaoSwitches++;
+		}
+		if (item.texture != currentTexture || item.textureTarget != currentTarget)
+		{
+			glBindTexture(item.textureTarget, item.texture);
+			currentTexture = item.texture;
+			currentTarget = item.textureTarget;
+			m_stats.textureSwitches++;
+		}
+		if (item.hasModel)
+		{
+			glBindBufferRange(GL_UNIFORM_BUFFER, PER_DRAW_UBO_BINDING,
+							  m_perDraw.Buffer(), m_perDrawOffsets[idx],
+							  sizeof(PerDrawConstants));
+		}
+
+		if (item.conditionQuery != 0)
+		{
+			glBeginConditionalRender(item.conditionQuery, GL_QUERY_NO_WAIT);
+		}
+		if (item.instanceCount > 0 && item.baseInstance > 0)
+		{
+			if (item.indexed)
+			{
+				glDrawElementsInstancedBaseInstance(
+					item.primitive, item.count, GL_UNSIGNED_INT,
+					(void *)(item.first * sizeof(u32)), item.instanceCount,
+					item.baseInstance);
+			}
+			else
+			{
+				glDrawArraysInstancedBaseInstance(item.primitive, item.first,
+												  item.count,
+												  item.instanceCount,
+												  item.baseInstance);
+			}
+		}
+		else if (item.instanceCount > 0)
+		{
+			if (item.indexed)
+			{
+				glDrawElementsInstanced(item.primitive, item.count,
+										GL_UNSIGNED_INT,
+										(void *)(item.first * sizeof(u32)),
+										item.instanceCount);
+			}
+			else
+			{
+				glDrawArraysInstanced(item.primitive, item.first, item.count,
+									  item.instanceCount);
+			}
+		}
+		else if (item.indexed)
+		{
+			glDrawElements(item.primitive, item.count, GL_UNSIGNED_INT,
+						   (void *)(item.first * sizeof(u32)));
+		}
+		else
+		{
+			glDrawArrays(item.primitive, item.first, item.count);
+		}
+		if (item.conditionQuery != 0)
+		{
+			glEndConditionalRender();
+		}
+		m_stats.draws++;
+		if (item.primitive == GL_TRIANGLES)
+		{
+			m_stats.triangles
+				+= item.count / 3 * std::max(item.instanceCount, 1u);
+		}
+	}
+	glBindVertexArray(0);
+	m_perDraw.EndFrame();
+}
+
+// CPU time of drawCount draws of vao through the render queue, recorded,
+// sorted and given their constants on this thread alone, then on thread
+// pools of more and more threads. Each object's matrix is worked out as it's
+// recorded, as a scene would. Execute's time includes the GL replay, which
+// stays on this thread. Results go to stdout.
+void BenchmarkParallelRecording(VAO vao, u32 vertexCount, Shader &shader,
+								const glm::mat4 &view,
+								const glm::mat4 &projection,
+								u32 drawCount = 50000)
+{
+	using Clock = std::chrono::high_resolution_clock;
+	const u32 frames = 10;
+	auto ms = [](Clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - start)
+			.count();
+	};
+
+	// a grid of spinning objects in front of the camera
+	const u32 side = (u32)std::ceil(std::sqrt((double)drawCount));
+	const glm::vec3 eye = glm::vec3(glm::inverse(view)[3]);
+	u32 frame = 0;
+	const RenderQueue::RecordRange record = [&](DrawList &list, u32 begin,
+												u32 end) {
+		for (u32 i = begin; i < end; i++)
+		{
+			const glm::vec3 position((float)(i % side) - side * 0.5f,
+									 (float)(i / side) - side * 0.5f,
+									 -(float)side);
+			DrawItem item;
+			item.shader = &shader;
+			item.vao = vao;
+			item.count = vertexCount;
+			item.model = glm::scale(
+				glm::rotate(glm::translate(glm::mat4(), position),
+							0.01f * (frame + i), glm::vec3(0.0f, 1.0f, 0.0f)),
+				glm::vec3(0.5f));
+			const float depth = glm::length(position - eye) / (2.0f * side);
+			list.Push(RenderQueue::MakeKey(0, false, shader.m_programId, 0,
+										   vao, depth),
+					  item);
+		}
+	};
+
+	std::vector<u32> threadCounts = { 1, 2, 4 };
+	const u32 hardwareThreads = std::thread::hardware_concurrency();
+	if (hardwareThreads > 4) threadCounts.push_back(hardwareThreads);
+	std::cout << drawCount << " draws\trecord (ms)\tsort (ms)\texecute (ms)"
+			  << std::endl;
+	for (u32 threads : threadCounts)
+	{
+		// the calling thread works too, it's one of the threads
+		std::unique_ptr<ThreadPool> pool(
+			threads > 1 ? new ThreadPool(threads - 1) : nullptr);
+		RenderQueue queue;
+		queue.SetThreadPool(pool.get());
+		queue.SetCamera(view, projection);
+		double recordMs = 0.0, sortMs = 0.0, executeMs = 0.0;
+		for (frame = 0; frame < frames; frame++)
+		{
+			glFinish();
+			Clock::time_point start = Clock::now();
+			queue.Clear();
+			queue.Record(drawCount, record);
+			recordMs += ms(start);
+			start = Clock::now();
+			queue.Sort();
+			sortMs += ms(start);
+			start = Clock::now();
+			queue.Execute(nullptr);
+			executeMs += ms(start);
+		}
+		std::cout << threads << " threads\t" << recordMs / frames << "\t\t"
+				  << sortMs / frames << "\t\t" << executeMs / frames
+				  << std::endl;
+	}
+}
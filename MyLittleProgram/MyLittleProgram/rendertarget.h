@@ -0,0 +1,302 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include <memory>
+#include <iostream>
+
+#include "types.h"
+
+// Free targets that haven't been acquired for this many frames are deleted,
+// e.g. the old size after a resize
+const u32 RT_POOL_MAX_IDLE_FRAMES = 60;
+// Targets that follow the window are allocated in multiples of this and
+// rendered into a sub-rect, so most resizes don't reallocate anything
+const u32 RT_SIZE_BUCKET = 256;
+
+u32 RoundUpToBucket(u32 size)
+{
+	if (size == 0) size = 1;
+	return (size + RT_SIZE_BUCKET - 1) / RT_SIZE_BUCKET * RT_SIZE_BUCKET;
+}
+
+// Colour texture with a framebuffer to render into it
+struct RenderTarget
+{
+	TXO texture;
+	u32 framebuffer;
+	GLenum format;
+	u32 width, height;
+};
+
+// Pool of render targets keyed by format and size. Passes acquire a target,
+// render into it and release it once the next pass has read it, so a chain of
+// any length only ever needs a couple of textures per format and size.
+class RenderTargetPool
+{
+public:
+	RenderTargetPool() : m_frame(0) {}
+	~RenderTargetPool();
+	RenderTargetPool(const RenderTargetPool &) = delete;
+	RenderTargetPool &operator=(const RenderTargetPool &) = delete;
+
+	// A free target with this format and size, created if there is none.
+	// format is a sized internal format, e.g. GL_RGBA8 or GL_RGBA16F.
+	RenderTarget *Acquire(GLenum format, u32 width, u32 height);
+	void Release(RenderTarget *target);
+
+	// Call once per frame, deletes targets that have sat unused too long
+	void NextFrame();
+	u32 Count() const { return (u32)m_entries.size(); }
+
+private:
+	struct Entry
+	{
+		std::unique_ptr<RenderTarget> target;
+		bool inUse;
+		u32 lastUsedFrame;
+	};
+
+	static void Destroy(RenderTarget &target);
+
+	std::vector<Entry> m_entries;
+	u32 m_frame;
+};
+
+RenderTargetPool::~RenderTargetPool()
+{
+	for (Entry &entry : m_entries)
+	{
+		Destroy(*entry.target);
+	}
+}
+
+void RenderTargetPool::Destroy(RenderTarget &target)
+{
+	glDeleteFramebuffers(1, &target.framebuffer);
+	glDeleteTextures(1, &target.texture);
+}
+
+RenderTarget *RenderTargetPool::Acquire(GLenum format, u32 width, u32 height)
+{
+	for (Entry &entry : m_entries)
+	{
+		const RenderTarget &target = *entry.target;
+		if (!entry.inUse && target.format == format && target.width == width
+			&& target.height == height)
+		{
+			entry.inUse = true;
+			entry.lastUsedFrame = m_frame;
+			return entry.target.get();
+		}
+	}
+
+	Entry entry;
+	entry.target.reset(new RenderTarget());
+	entry.inUse = true;
+	entry.lastUsedFrame = m_frame;
+	RenderTarget &target = *entry.target;
+	target.format = format;
+	target.width = width;
+	target.height = height;
+	glGenTextures(1, &target.texture);
+	glBindTexture(GL_TEXTURE_2D, target.texture);
+	// the pixel transfer type doesn't matter, there is no data
+	glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, GL_RGBA,
+				 GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glGenFramebuffers(1, &target.framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+						   target.texture, 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "ERROR::RENDER_TARGET::FRAMEBUFFER_NOT_COMPLETE"
+				  << std::endl;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	m_entries.push_back(std::move(entry));
+	return m_entries.back().target.get();
+}
+
+void RenderTargetPool::Release(RenderTarget *target)
+{
+	for (Entry &entry : m_entries)
+	{
+		if (entry.target.get() == target)
+		{
+			entry.inUse = false;
+			return;
+		}
+	}
+}
+
+void RenderTargetPool::NextFrame()
+{
+	m_frame++;
+	for (size_t i = 0; i < m_entries.size();)
+	{
+		Entry &entry = m_entries[i];
+		if (!entry.inUse
+			&& m_frame - entry.lastUsedFrame > RT_POOL_MAX_IDLE_FRAMES)
+		{
+			Destroy(*entry.target);
+			m_entries.erase(m_entries.begin() + i);
+		}
+		else
+		{
+			i++;
+		}
+	}
+}
+
+// The offscreen framebuffer the scene is drawn into: colour, the outline's
+// selection mask and depth/stencil.
+//
+// Resize only records the new size, Apply() reallocates once per frame if it
+// has to. The attachments are rounded up to RT_SIZE_BUCKET and the scene is
+// rendered into the bottom left Width() x Height() of them, so a window
+// drag reallocates only when crossing a bucket, and shrinking keeps the
+// larger attachments until they are more than twice the size needed.
+// Anything sampling the attachments with normalized coordinates has to
+// scale them by UVScale().
+class SceneTarget
+{
+public:
+	SceneTarget(u32 width, u32 height);
+	~SceneTarget();
+	SceneTarget(const SceneTarget &) = delete;
+	SceneTarget &operator=(const SceneTarget &) = delete;
+
+	void Resize(u32 width, u32 height);
+	// Apply the last Resize, returns true if the attachments were reallocated
+	bool Apply();
+
+	u32 Framebuffer() const { return m_framebuffer; }
+	TXO ColourTexture() const { return m_colour; }
+	TXO MaskTexture() const { return m_mask; }
+	// the part being rendered to
+	u32 Width() const { return m_width; }
+	u32 Height() const { return m_height; }
+	// the size of the attachments
+	u32 TargetWidth() const { return m_targetWidth; }
+	u32 TargetHeight() const { return m_targetHeight; }
+	glm::vec2 UVScale() const;
+
+private:
+	void Allocate(u32 width, u32 height);
+	void Free();
+
+	u32 m_framebuffer;
+	TXO m_colour;
+	TXO m_mask;
+	u32 m_depthStencil;
+	u32 m_width, m_height;
+	u32 m_targetWidth, m_targetHeight;
+	u32 m_requestedWidth, m_requestedHeight;
+};
+
+SceneTarget::SceneTarget(u32 width, u32 height)
+	: m_colour(0)
+	, m_mask(0)
+	, m_depthStencil(0)
+	, m_width(0)
+	, m_height(0)
+	, m_targetWidth(0)
+	, m_targetHeight(0)
+{
+	glGenFramebuffers(1, &m_framebuffer);
+	Resize(width, height);
+	Apply();
+}
+
+SceneTarget::~SceneTarget()
+{
+	Free();
+	glDeleteFramebuffers(1, &m_framebuffer);
+}
+
+void SceneTarget::Resize(u32 width, u32 height)
+{
+	// a minimised window reports 0 x 0
+	m_requestedWidth = width > 0 ? width : 1;
+	m_requestedHeight = height > 0 ? height : 1;
+}
+
+bool SceneTarget::Apply()
+{
+	m_width = m_requestedWidth;
+	m_height = m_requestedHeight;
+	const u32 bucketWidth = RoundUpToBucket(m_width);
+	const u32 bucketHeight = RoundUpToBucket(m_height);
+	const bool tooSmall = bucketWidth > m_targetWidth
+		|| bucketHeight > m_targetHeight;
+	const bool tooBig = bucketWidth * 2 < m_targetWidth
+		&& bucketHeight * 2 < m_targetHeight;
+	if (!tooSmall && !tooBig) return false;
+
+	Free();
+	Allocate(bucketWidth, bucketHeight);
+	return true;
+}
+
+glm::vec2 SceneTarget::UVScale() const
+{
+	return glm::vec2((float)m_width / m_targetWidth,
+					 (float)m_height / m_targetHeight);
+}
+
+void SceneTarget::Allocate(u32 width, u32 height)
+{
+	m_targetWidth = width;
+	m_targetHeight = height;
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	// add a colour texture attachment
+	glGenTextures(1, &m_colour);
+	glBindTexture(GL_TEXTURE_2D, m_colour);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB,
+				 GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+						   m_colour, 0);
+	// and the selection mask
+	glGenTextures(1, &m_mask);
+	glBindTexture(GL_TEXTURE_2D, m_mask);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, height, 0, GL_RED,
+				 GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D,
+						   m_mask, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	// add a depth/stencil renderbuffer attachment
+	glGenRenderbuffers(1, &m_depthStencil);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_depthStencil);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+							  GL_RENDERBUFFER, m_depthStencil);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!"
+				  << std::endl;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void SceneTarget::Free()
+{
+	glDeleteTextures(1, &m_colour);
+	glDeleteTextures(1, &m_mask);
+	glDeleteRenderbuffers(1, &m_depthStencil);
+	m_colour = m_mask = m_depthStencil = 0;
+}
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+
+#include "types.h"
+
+// Regions in the ring, one per frame in flight
+const u32 RING_FRAMES = 3;
+
+// Buffer for data that is rewritten every frame (per-draw constants and the
+// like), split into RING_FRAMES regions used in turn. A fence is placed after
+// each frame's draws, and the region is only written again once the GPU has
+// passed it, so the CPU never overwrites data that is still being read and
+// the driver never has to sync or rename the buffer.
+//
+// With GL 4.4 the buffer is created with glBufferStorage and stays mapped,
+// writes go straight to it. Without it writes go to a copy in system memory
+// and Flush() uploads the frame's region with one glBufferSubData, which
+// doesn't stall either because of the fences.
+//
+// Usage per frame: BeginFrame, Allocate/Write, Flush, draw with the returned
+// offsets, EndFrame.
+class RingBuffer
+{
+public:
+	// frameCapacity is the size of each region in bytes
+	RingBuffer(GLenum target, u32 frameCapacity);
+	~RingBuffer();
+	RingBuffer(const RingBuffer &) = delete;
+	RingBuffer &operator=(const RingBuffer &) = delete;
+
+	// Move to the next region, waiting for the GPU if it is still reading it.
+	// If minCapacity doesn't fit in a region the buffer is recreated bigger,
+	// after waiting for every frame in flight.
+	void BeginFrame(u32 minCapacity = 0);
+	// Reserve size bytes aligned to alignment. Returns the offset in the
+	// buffer, to bind with, and the address to write to, or nullptr if the
+	// region is full.
+	void *Allocate(u32 size, u32 alignment, u32 &offset);
+	// Copy size bytes in, returns the offset or RING_FULL
+	u32 Write(const void *data, u32 size, u32 alignment);
+	// Make this frame's writes visible to the GL, before drawing with them
+	void Flush();
+	// Fence the region after the frame's draws have been submitted
+	void EndFrame();
+
+	u32 Buffer() const { return m_buffer; }
+	GLenum Target() const { return m_target; }
+	u32 FrameCapacity() const { return m_frameCapacity; }
+	bool IsPersistent() const { return m_persistent; }
+
+	static const u32 RING_FULL = 0xFFFFFFFF;
+
+private:
+	void Create(u32 frameCapacity);
+	void Destroy();
+	void Wait(u32 region);
+
+	GLenum m_target;
+	u32 m_buffer;
+	u32 m_frameCapacity;
+	bool m_persistent;
+	// persistent mapping of the whole buffer, or the system memory copy
+	char *m_mapped;
+	std::vector<char> m_shadow;
+	GLsync m_fences[RING_FRAMES];
+	u32 m_region;
+	u32 m_offset;
+	u32 m_flushed;
+};
+
+// Alignment of ranges bound from a uniform buffer, at least 16 so std140
+// blocks can go back to back
+u32 UniformBufferAlignment()
+{
+	GLint alignment = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	return (u32)std::max(alignment, 16);
+}
+
+RingBuffer::RingBuffer(GLenum target, u32 frameCapacity)
+	: m_target(target)
+	, m_buffer(0)
+	, m_frameCapacity(0)
+	, m_mapped(nullptr)
+	, m_region(RING_FRAMES - 1)
+	, m_offset(0)
+	, m_flushed(0)
+{
+	m_persistent = GLAD_GL_VERSION_4_4 != 0;
+	for (u32 i = 0; i < RING_FRAMES; i++)
+	{
+		m_fences[i] = 0;
+	}
+	Create(frameCapacity);
+}
+
+RingBuffer::~RingBuffer()
+{
+	Destroy();
+}
+
+void RingBuffer::Create(u32 frameCapacity)
+{
+	m_frameCapacity = frameCapacity;
+	const GLsizeiptr size = (GLsizeiptr)frameCapacity * RING_FRAMES;
+	glGenBuffers(1, &m_buffer);
+	glBindBuffer(m_target, m_buffer);
+	if (m_persistent)
+	{
+		// coherent, so there's nothing to flush and no barrier needed
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT
+			| GL_MAP_COHERENT_BIT;
+		glBufferStorage(m_target, size, NULL, flags);
+		m_mapped = (char *)glMapBufferRange(m_target, 0, size, flags);
+		if (!m_mapped)
+		{
+			// storage is immutable, start over without it
+			std::cout << "ERROR::RING_BUFFER::MAP_FAILED" << std::endl;
+			glBindBuffer(m_target, 0);
+			glDeleteBuffers(1, &m_buffer);
+			m_persistent = false;
+			Create(frameCapacity);
+			return;
+		}
+	}
+	else
+	{
+		glBufferData(m_target, size, NULL, GL_DYNAMIC_DRAW);
+		m_shadow.resize(frameCapacity);
+		m_mapped = m_shadow.data();
+	}
+	glBindBuffer(m_target, 0);
+}
+
+void RingBuffer::Destroy()
+{
+	for (u32 i = 0; i < RING_FRAMES; i++)
+	{
+		if (m_fences[i]) glDeleteSync(m_fences[i]);
+		m_fences[i] = 0;
+	}
+	if (m_persistent && m_mapped)
+	{
+		glBindBuffer(m_target, m_buffer);
+		glUnmapBuffer(m_target);
+		glBindBuffer(m_target, 0);
+	}
+	m_mapped = nullptr;
+	glDeleteBuffers(1, &m_buffer);
+	m_buffer = 0;
+}
+
+void RingBuffer::Wait(u32 region)
+{
+	GLsync fence = m_fences[region];
+	if (!fence) return;
+	// flush on the first try so the fence is guaranteed to signal
+	GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+	for (;;)
+	{
+		GLenum result = glClientWaitSync(fence, flags, 1000000);
+		if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED)
+			break;
+		if (result == GL_WAIT_FAILED)
+		{
+			std::cout << "ERROR::RING_BUFFER::WAIT_FAILED" << std::endl;
+			break;
+		}
+		flags = 0;
+	}
+	glDeleteSync(fence);
+	m_fences[region] = 0;
+}
+
+void RingBuffer::BeginFrame(u32 minCapacity)
+{
+	if (minCapacity > m_frameCapacity)
+	{
+		for (u32 i = 0; i < RING_FRAMES; i++)
+		{
+			Wait(i);
+		}
+		Destroy();
+		Create(std::max(minCapacity, m_frameCapacity * 2));
+	}
+	m_region = (m_region + 1) % RING_FRAMES;
+	Wait(m_region);
+	m_offset = 0;
+	m_flushed = 0;
+}
+
+void *RingBuffer::Allocate(u32 size, u32 alignment, u32 &offset)
+{
+	const u32 aligned = (m_offset + alignment - 1) / alignment * alignment;
+	if (aligned + size > m_frameCapacity) return nullptr;
+	m_offset = aligned + size;
+	offset = m_region * m_frameCapacity + aligned;
+	// the shadow copy only holds the current region
+	return m_persistent ? m_mapped + offset : m_mapped + aligned;
+}
+
+u32 RingBuffer::Write(const void *data, u32 size, u32 alignment)
+{
+	u32 offset;
+	void *dst = Allocate(size, alignment, offset);
+	if (!dst) return RING_FULL;
+	memcpy(dst, data, size);
+	return offset;
+}
+
+void RingBuffer::Flush()
+{
+	if (m_persistent || m_offset == m_flushed) return;
+	glBindBuffer(m_target, m_buffer);
+	glBufferSubData(m_target, m_region * m_frameCapacity + m_flushed,
+					m_offset - m_flushed, m_shadow.data() + m_flushed);
+	glBindBuffer(m_target, 0);
+	m_flushed = m_offset;
+}
+
+void RingBuffer::EndFrame()
+{
+	Flush();
+	m_fences[m_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
@@ -0,0 +1,963 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <numeric>
+#include <algorithm>
+#include <iostream>
+#include <glad/glad.h>
+#include "stb_image.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "shader.h"
+#include "camera.h"
+#include "model.h"
+#include "renderqueue.h"
+#include "instancing.h"
+#include "culling.h"
+#include "gpuculling.h"
+#include "bvh.h"
+#include "occlusion.h"
+#include "occlusionqueries.h"
+#include "outline.h"
+#include "postprocess.h"
+#include "dynamicresolution.h"
+#include "deferred.h"
+#include "clustered.h"
+#include "lightmanager.h"
+#include "shadows.h"
+#include "shadowatlas.h"
+#include "framestats.h"
+#include "profiler.h"
+#include "types.h"
+
+unsigned int loadTexture(const char *path);
+unsigned int loadCubemap(std::vector<std::string> faces);
+
+// render passes, in submission order
+enum RenderPass : u32
+{
+	PASS_SELECTED, // opaque, also written to the selection mask
+	PASS_OPAQUE,
+	PASS_SKYBOX
+};
+
+// selection outline
+const float OUTLINE_WIDTH = 4.0f; // pixels
+const glm::vec3 OUTLINE_COLOUR(0.94f, 0.55f, 0.0f);
+
+// unit cube, position and texture coordinates, 36 vertices
+const float CUBE_VERTICES[] = {
+	// Back face
+	-0.5f, -0.5f, -0.5f,  0.0f, 0.0f, // Bottom-left
+	0.5f,  0.5f, -0.5f,  1.0f, 1.0f, // top-right
+	0.5f, -0.5f, -0.5f,  1.0f, 0.0f, // bottom-right
+	0.5f,  0.5f, -0.5f,  1.0f, 1.0f, // top-right
+	-0.5f, -0.5f, -0.5f,  0.0f, 0.0f, // bottom-left
+	-0.5f,  0.5f, -0.5f,  0.0f, 1.0f, // top-left
+									  // Front face
+	-0.5f, -0.5f,  0.5f,  0.0f, 0.0f, // bottom-left
+	0.5f, -0.5f,  0.5f,  1.0f, 0.0f, // bottom-right
+	0.5f,  0.5f,  0.5f,  1.0f, 1.0f, // top-right
+	0.5f,  0.5f,  0.5f,  1.0f, 1.0f, // top-right
+	-0.5f,  0.5f,  0.5f,  0.0f, 1.0f, // top-left
+	-0.5f, -0.5f,  0.5f,  0.0f, 0.0f, // bottom-left
+									  // Left face
+	-0.5f,  0.5f,  0.5f,  1.0f, 0.0f, // top-right
+	-0.5f,  0.5f, -0.5f,  1.0f, 1.0f, // top-left
+	-0.5f, -0.5f, -0.5f,  0.0f, 1.0f, // bottom-left
+	-0.5f, -0.5f, -0.5f,  0.0f, 1.0f, // bottom-left
+	-0.5f, -0.5f,  0.5f,  0.0f, 0.0f, // bottom-right
+	-0.5f,  0.5f,  0.5f,  1.0f, 0.0f, // top-right
+									  // Right face
+	0.5f,  0.5f,  0.5f,  1.0f, 0.0f, // top-left
+	0.5f, -0.5f, -0.5f,  0.0f, 1.0f, // bottom-right
+	0.5f,  0.5f, -0.5f,  1.0f, 1.0f, // top-right
+	0.5f, -0.5f, -0.5f,  0.0f, 1.0f, // bottom-right
+	0.5f,  0.5f,  0.5f,  1.0f, 0.0f, // top-left
+	0.5f, -0.5f,  0.5f,  0.0f, 0.0f, // bottom-left
+									 // Bottom face
+	-0.5f, -0.5f, -0.5f,  0.0f, 1.0f, // top-right
+	0.5f, -0.5f, -0.5f,  1.0f, 1.0f, // top-left
+	0.5f, -0.5f,  0.5f,  1.0f, 0.0f, // bottom-left
+	0.5f, -0.5f,  0.5f,  1.0f, 0.0f, // bottom-left
+	-0.5f, -0.5f,  0.5f,  0.0f, 0.0f, // bottom-right
+	-0.5f, -0.5f, -0.5f,  0.0f, 1.0f, // top-right
+									  // Top face
+	-0.5f,  0.5f, -0.5f,  0.0f, 1.0f, // top-left
+	0.5f,  0.5f,  0.5f,  1.0f, 0.0f, // bottom-right
+	0.5f,  0.5f, -0.5f,  1.0f, 1.0f, // top-right
+	0.5f,  0.5f,  0.5f,  1.0f, 0.0f, // bottom-right
+	-0.5f,  0.5f, -0.5f,  0.0f, 1.0f, // top-left
+	-0.5f,  0.5f,  0.5f,  0.0f, 0.0f  // bottom-left
+};
+
+// Vertex attributes of CUBE_VERTICES and the other position and texture
+// coordinate arrays, for the bound vertex array and buffer
+void SetPositionTexCoordLayout()
+{
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float),
+						  (void *)0);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float),
+						  (void *)(3 * sizeof(float)));
+}
+
+// GPU time for the scene and post-processing, leaving room in a 60Hz frame
+const float FRAME_BUDGET_MS = 14.0f;
+// sharpening of the upscale when rendering below the output resolution
+const float UPSCALE_SHARPNESS = 0.5f;
+// scripted camera paths circle this, taking in the whole scene
+const glm::vec3 ORBIT_CENTRE(0.25f, 0.0f, -0.5f);
+const float ORBIT_RADIUS = 4.0f;
+const float ORBIT_HEIGHT = 1.5f;
+
+// The demo scene and everything that goes into a frame of it, independent of
+// where the frame ends up. The GLFW window loop in main.cpp and the headless
+// benchmark both drive it.
+//
+// The scene is rendered off screen at the dynamic resolution, outlined and
+// post-processed, then composited into the output rectangle of whichever
+// framebuffer Render is given. Presenting it is up to the front end.
+//
+// Usage per frame: BeginFrame, then Render. The frame stats time from one
+// BeginFrame to the next, so they include the front end's swap or finish.
+class SceneRenderer
+{
+public:
+	// The output size, the off screen target starts at it. Needs a current
+	// GL 3.3 context, SetGpuCulling needs 4.3.
+	SceneRenderer(u32 width, u32 height);
+	~SceneRenderer();
+	SceneRenderer(const SceneRenderer &) = delete;
+	SceneRenderer &operator=(const SceneRenderer &) = delete;
+
+	// Where the composite goes in the framebuffer, picked up by the next
+	// Render so a drag resizing the window only reallocates once
+	void SetOutput(u32 x, u32 y, u32 width, u32 height);
+	void SetPostEffects(bool sharpen, bool vignette);
+	void SetDynamicResolution(bool enabled);
+	// Cull and draw the cubes and vegetation on the GPU, which skips the
+	// occlusion culling. Off by default. Returns whether it's on, it needs
+	// GL 4.3.
+	bool SetGpuCulling(bool enabled);
+
+	void BeginFrame();
+	// Returns the draws submitted, as counted in the frame stats
+	u32 Render(Camera &camera, u32 framebuffer);
+
+	// e.g. to Reset after warming up
+	FrameStats &Stats() { return m_frameStats; }
+	// Occlusion, resolution and post timings, for the window title
+	std::string StatusText() const;
+
+private:
+	static void SetPassState(u32 pass);
+
+	// shaders
+	Shader m_normalShader;
+	Shader m_compositeShader;
+	Shader m_skyboxShader;
+	Shader m_instancedShader;
+	Shader m_instancedSelected;
+	Shader m_grassShader;
+	Shader m_sharpenShader;
+	Shader m_vignetteShader;
+
+	// off screen target, resized at the start of each frame
+	SceneTarget m_sceneTarget;
+	u32 m_outputX, m_outputY;
+	u32 m_outputWidth, m_outputHeight;
+
+	// geometry and textures
+	VAO m_cubeVAO, m_grassVAO, m_planeVAO, m_emptyVAO;
+	VBO m_cubeVBO, m_grassVBO, m_planeVBO;
+	TXO m_cubeTexture, m_floorTexture, m_cubemapTexture, m_grassTexture;
+
+	// instance data, all copies of a primitive are drawn with a single
+	// instanced call
+	std::vector<glm::mat4> m_cubeTransforms;
+	std::vector<glm::mat4> m_grassTransforms;
+	glm::vec3 m_cubeCentroid, m_grassCentroid;
+	InstanceBuffer m_cubeInstances, m_grassInstances;
+
+	// culling, cubes are objects [0, m_grassFirstObject), vegetation the rest
+	CullingSystem m_sceneCulling;
+	std::vector<Bounds> m_sceneBounds;
+	u32 m_grassFirstObject;
+	ThreadPool m_workerPool;
+	OcclusionCuller m_occlusion;
+	OcclusionQueries m_hwOcclusion;
+	std::vector<u32> m_visibleObjects;
+	std::vector<u32> m_drawObjects, m_conditionalObjects;
+	std::vector<glm::mat4> m_visibleCubes, m_visibleGrass;
+	// with SetGpuCulling the cubes and vegetation are culled and drawn on
+	// the GPU instead, without the occlusion culling. The culled objects are
+	// only created on GL 4.3+. The indices are 0, 1, 2, ..., as the geometry
+	// isn't indexed.
+	bool m_gpuCulling;
+	EBO m_sequenceEBO;
+	std::unique_ptr<GpuCuller> m_gpuCubes, m_gpuGrass;
+
+	// submission and the passes after the scene
+	RenderQueue m_renderQueue;
+	OutlinePass m_outlinePass;
+	RenderTargetPool m_renderTargets;
+	PostProcessChain m_postChain;
+	u32 m_sharpenPass, m_vignettePass;
+	DynamicResolution m_dynamicRes;
+
+	// frame and per-pass timings
+	FrameStats m_frameStats;
+	u32 m_scenePassStats;
+	u32 m_outlinePassStats;
+	u32 m_postPassStats;
+	u32 m_compositePassStats;
+};
+
+SceneRenderer::SceneRenderer(u32 width, u32 height)
+	: m_normalShader("shaders/normal.vs", "shaders/normal.fs")
+	, m_compositeShader("shaders/fullScreenTriangle.vs", "shaders/composite.fs")
+	, m_skyboxShader("shaders/skybox.vs", "shaders/skybox.fs")
+	, m_instancedShader("shaders/instanced.vs", "shaders/normal.fs")
+	, m_instancedSelected("shaders/instanced.vs", "shaders/selected.fs")
+	, m_grassShader("shaders/instanced.vs", "shaders/grass.fs")
+	, m_sharpenShader("shaders/fullScreenTriangle.vs",
+					  "shaders/postSharpen.fs")
+	, m_vignetteShader("shaders/fullScreenTriangle.vs",
+					   "shaders/postVignette.fs")
+	, m_sceneTarget(width, height)
+	, m_outputX(0)
+	, m_outputY(0)
+	, m_outputWidth(width)
+	, m_outputHeight(height)
+	, m_gpuCulling(false)
+	, m_sequenceEBO(0)
+	, m_postChain(m_renderTargets)
+	, m_dynamicRes(FRAME_BUDGET_MS)
+{
+	// set up vertex data (and buffer(s)) and configure vertex attributes
+	// ------------------------------------------------------------------
+	float planeVertices[] = {
+		// positions          // texture Coords (note we set these higher than 1 (together with GL_REPEAT as texture wrapping mode). this will cause the floor texture to repeat)
+		-5.0f, -0.5f,  5.0f,  0.0f, 0.0f,
+		 5.0f, -0.5f,  5.0f,  2.0f, 0.0f,
+		-5.0f, -0.5f, -5.0f,  0.0f, 2.0f,
+
+		-5.0f, -0.5f, -5.0f,  0.0f, 2.0f,
+		 5.0f, -0.5f,  5.0f,  2.0f, 0.0f,
+		 5.0f, -0.5f, -5.0f,  2.0f, 2.0f
+	};
+	// vegetation quad, standing on its bottom edge
+	float transparentVertices[] = {
+		// positions         // texture Coords
+		0.0f,  0.5f,  0.0f,  0.0f,  1.0f,
+		0.0f, -0.5f,  0.0f,  0.0f,  0.0f,
+		1.0f, -0.5f,  0.0f,  1.0f,  0.0f,
+
+		0.0f,  0.5f,  0.0f,  0.0f,  1.0f,
+		1.0f, -0.5f,  0.0f,  1.0f,  0.0f,
+		1.0f,  0.5f,  0.0f,  1.0f,  1.0f
+	};
+
+	std::vector<glm::vec3> vegetation;
+	vegetation.push_back(glm::vec3(-1.5f, 0.0f, -0.48f));
+	vegetation.push_back(glm::vec3(1.5f, 0.0f, 0.51f));
+	vegetation.push_back(glm::vec3(0.0f, 0.0f, 0.7f));
+	vegetation.push_back(glm::vec3(-0.3f, 0.0f, -2.3f));
+	vegetation.push_back(glm::vec3(0.5f, 0.0f, -0.6f));
+
+	// cube VAO
+	glGenVertexArrays(1, &m_cubeVAO);
+	glGenBuffers(1, &m_cubeVBO);
+	glBindVertexArray(m_cubeVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, m_cubeVBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(CUBE_VERTICES), CUBE_VERTICES, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+	glBindVertexArray(0);
+	// vegetation VAO
+	glGenVertexArrays(1, &m_grassVAO);
+	glGenBuffers(1, &m_grassVBO);
+	glBindVertexArray(m_grassVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, m_grassVBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(transparentVertices), &transparentVertices, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+	glBindVertexArray(0);
+	// plane VAO
+	glGenVertexArrays(1, &m_planeVAO);
+	glGenBuffers(1, &m_planeVBO);
+	glBindVertexArray(m_planeVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, m_planeVBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(planeVertices), &planeVertices, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+	glBindVertexArray(0);
+	// the full screen triangle and skybox have no vertex buffers, but core
+	// profile still wants a VAO bound to draw
+	glGenVertexArrays(1, &m_emptyVAO);
+
+	// load textures
+	// -------------
+	m_cubeTexture  = loadTexture("assets/shrug.jpg");
+	m_floorTexture = loadTexture("assets/container.jpg");
+	std::vector<std::string> skyboxFaces{
+		"assets/skycubemap/right.jpg", "assets/skycubemap/left.jpg",
+		"assets/skycubemap/top.jpg",   "assets/skycubemap/bottom.jpg",
+		"assets/skycubemap/back.jpg",  "assets/skycubemap/front.jpg"
+	};
+	m_cubemapTexture = loadCubemap(skyboxFaces);
+	m_grassTexture = loadTexture("assets/grass.png");
+	// clamp so the transparent border doesn't bleed in from the other side
+	glBindTexture(GL_TEXTURE_2D, m_grassTexture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	// shader configuration
+	// --------------------
+	m_normalShader.use();
+	m_normalShader.setInt("texture1", 0);
+	m_normalShader.bindUniformBlock("PerDraw", PER_DRAW_UBO_BINDING);
+	m_instancedShader.use();
+	m_instancedShader.setInt("texture1", 0);
+	m_instancedSelected.use();
+	m_instancedSelected.setInt("texture1", 0);
+	m_grassShader.use();
+	m_grassShader.setInt("texture1", 0);
+	m_compositeShader.use();
+	m_compositeShader.setInt("screenTexture", 0); // optional
+
+	// compiled in benchmarks, run once by whichever front end starts up
+#ifdef BENCHMARK_INSTANCING
+	// per-draw vs instanced submission, before the scene's instance buffers
+	// get attached to the cube VAO
+	{
+		Camera benchCamera(glm::vec3(0.0f, 0.0f, 3.0f));
+		glm::mat4 benchProjection = glm::perspective(
+			glm::radians(benchCamera.Zoom),
+			(float)width / (float)height, 0.1f, 1000.0f);
+		glBindFramebuffer(GL_FRAMEBUFFER, m_sceneTarget.Framebuffer());
+		glViewport(0, 0, width, height);
+		glEnable(GL_DEPTH_TEST);
+		BenchmarkInstancing(m_cubeVAO, 36, m_normalShader, m_instancedShader,
+							benchCamera.GetViewMatrix(), benchProjection);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+#endif
+#ifdef BENCHMARK_RENDER_QUEUE
+	// serial against parallel recording, same setup as above
+	{
+		Camera benchCamera(glm::vec3(0.0f, 0.0f, 3.0f));
+		glm::mat4 benchProjection = glm::perspective(
+			glm::radians(benchCamera.Zoom),
+			(float)width / (float)height, 0.1f, 1000.0f);
+		glBindFramebuffer(GL_FRAMEBUFFER, m_sceneTarget.Framebuffer());
+		glViewport(0, 0, width, height);
+		glEnable(GL_DEPTH_TEST);
+		BenchmarkParallelRecording(m_cubeVAO, 36, m_normalShader,
+								   benchCamera.GetViewMatrix(),
+								   benchProjection);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+#endif
+#ifdef BENCHMARK_CULLING
+	BenchmarkCulling();
+#endif
+#ifdef BENCHMARK_GPU_CULLING
+	// compute shader against CullingSystem, nothing is drawn so no indices
+	if (GpuCuller::IsSupported())
+	{
+		BenchmarkGpuCulling(m_cubeVBO, 0, SetPositionTexCoordLayout);
+	}
+#endif
+#ifdef BENCHMARK_BVH
+	{
+		ThreadPool benchPool;
+		Model nanosuit("assets/nanosuit/nanosuit.obj");
+		BenchmarkBVH(nanosuit, benchPool);
+	}
+#endif
+#ifdef BENCHMARK_DEFERRED
+	BenchmarkDeferred(width, height);
+#endif
+#ifdef BENCHMARK_TRANSFORMS
+	BenchmarkPerDrawMatrices();
+#endif
+#ifdef BENCHMARK_CLUSTERED
+	BenchmarkClustered(width, height);
+#endif
+#ifdef BENCHMARK_SHADOWS
+	BenchmarkShadows();
+#endif
+#ifdef BENCHMARK_SHADOW_ATLAS
+	BenchmarkShadowAtlas();
+#endif
+
+	// instance data
+	// -------------
+	const glm::vec3 cubePositions[] = { glm::vec3(-1.0f, 0.0001f, -1.0f),
+										glm::vec3(2.0f, 0.0001f, 0.0f) };
+	for (const glm::vec3 &pos : cubePositions)
+	{
+		m_cubeTransforms.push_back(glm::translate(glm::mat4(), pos));
+		m_cubeCentroid += pos;
+	}
+	m_cubeCentroid /= (float)m_cubeTransforms.size();
+	for (const glm::vec3 &pos : vegetation)
+	{
+		m_grassTransforms.push_back(glm::translate(glm::mat4(), pos));
+		m_grassCentroid += pos;
+	}
+	m_grassCentroid /= (float)m_grassTransforms.size();
+	m_cubeInstances.AttachTo(m_cubeVAO);
+	m_grassInstances.AttachTo(m_grassVAO);
+
+	// frustum culling
+	// ---------------
+	// only the instances that survive are uploaded each frame
+	Bounds cubeBounds;
+	cubeBounds.aabbMin = glm::vec3(-0.5f, -0.5f, -0.5f);
+	cubeBounds.aabbMax = glm::vec3(0.5f, 0.5f, 0.5f);
+	cubeBounds.sphere = glm::vec4(0.0f, 0.0f, 0.0f, 0.8660254f);
+	Bounds grassBounds;
+	grassBounds.aabbMin = glm::vec3(0.0f, -0.5f, 0.0f);
+	grassBounds.aabbMax = glm::vec3(1.0f, 0.5f, 0.0f);
+	grassBounds.sphere = glm::vec4(0.5f, 0.0f, 0.0f, 0.7071068f);
+	for (const glm::mat4 &transform : m_cubeTransforms)
+	{
+		m_sceneBounds.push_back(TransformBounds(cubeBounds, transform));
+	}
+	m_grassFirstObject = (u32)m_sceneBounds.size();
+	for (const glm::mat4 &transform : m_grassTransforms)
+	{
+		m_sceneBounds.push_back(TransformBounds(grassBounds, transform));
+	}
+	for (const Bounds &bounds : m_sceneBounds)
+	{
+		m_sceneCulling.Add(bounds);
+	}
+	if (GpuCuller::IsSupported())
+	{
+		std::vector<u32> sequence(36);
+		std::iota(sequence.begin(), sequence.end(), 0u);
+		glGenBuffers(1, &m_sequenceEBO);
+		// element array bindings belong to a VAO, so upload through another
+		// target
+		glBindBuffer(GL_ARRAY_BUFFER, m_sequenceEBO);
+		glBufferData(GL_ARRAY_BUFFER, sequence.size() * sizeof(u32),
+					 sequence.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		m_gpuCubes.reset(new GpuCuller(m_cubeVBO, m_sequenceEBO,
+									   SetPositionTexCoordLayout));
+		for (const glm::mat4 &transform : m_cubeTransforms)
+		{
+			m_gpuCubes->AddObject(transform, 36, 0, 0, cubeBounds);
+		}
+		m_gpuGrass.reset(new GpuCuller(m_grassVBO, m_sequenceEBO,
+									   SetPositionTexCoordLayout));
+		for (const glm::mat4 &transform : m_grassTransforms)
+		{
+			m_gpuGrass->AddObject(transform, 6, 0, 0, grassBounds);
+		}
+	}
+
+	// occlusion culling
+	// -----------------
+	// the cubes hide whatever is behind them. Everything that survives the
+	// frustum is then tested against their CPU depth buffer.
+	std::vector<glm::vec3> cubeOccluderPositions;
+	std::vector<u32> cubeOccluderIndices;
+	for (u32 v = 0; v < 36; v++)
+	{
+		cubeOccluderPositions.push_back(glm::make_vec3(&CUBE_VERTICES[v * 5]));
+		cubeOccluderIndices.push_back(v);
+	}
+	for (const glm::mat4 &transform : m_cubeTransforms)
+	{
+		m_occlusion.AddOccluder(cubeOccluderPositions, cubeOccluderIndices,
+								transform);
+	}
+	// GPU occlusion queries on top, using the depth of what was drawn
+	for (const Bounds &bounds : m_sceneBounds)
+	{
+		m_hwOcclusion.AddObject(bounds);
+	}
+
+	// sorting and the per-draw constants go wide once there are enough
+	// draws, the occlusion rasterization is done with the pool by then
+	m_renderQueue.SetThreadPool(&m_workerPool);
+
+	// post-processing between the scene and the composite
+	m_sharpenPass = m_postChain.AddPass("sharpen", m_sharpenShader,
+		[](Shader &shader) { shader.setFloat("strength", 0.6f); });
+	m_vignettePass = m_postChain.AddPass("vignette", m_vignetteShader,
+		[](Shader &shader) {
+			shader.setFloat("radius", 0.45f);
+			shader.setFloat("softness", 0.35f);
+		});
+	m_postChain.SetEnabled(m_sharpenPass, false);
+	m_postChain.SetEnabled(m_vignettePass, false);
+
+	m_scenePassStats = m_frameStats.AddPass("scene");
+	m_outlinePassStats = m_frameStats.AddPass("outline");
+	m_postPassStats = m_frameStats.AddPass("post");
+	m_compositePassStats = m_frameStats.AddPass("composite");
+}
+
+SceneRenderer::~SceneRenderer()
+{
+	glDeleteVertexArrays(1, &m_cubeVAO);
+	glDeleteVertexArrays(1, &m_grassVAO);
+	glDeleteVertexArrays(1, &m_planeVAO);
+	glDeleteVertexArrays(1, &m_emptyVAO);
+
+	glDeleteBuffers(1, &m_cubeVBO);
+	glDeleteBuffers(1, &m_grassVBO);
+	glDeleteBuffers(1, &m_planeVBO);
+	glDeleteBuffers(1, &m_sequenceEBO);
+
+	glDeleteTextures(1, &m_cubeTexture);
+	glDeleteTextures(1, &m_floorTexture);
+	glDeleteTextures(1, &m_cubemapTexture);
+	glDeleteTextures(1, &m_grassTexture);
+}
+
+void SceneRenderer::SetOutput(u32 x, u32 y, u32 width, u32 height)
+{
+	m_outputX = x;
+	m_outputY = y;
+	m_outputWidth = width;
+	m_outputHeight = height;
+}
+
+void SceneRenderer::SetPostEffects(bool sharpen, bool vignette)
+{
+	m_postChain.SetEnabled(m_sharpenPass, sharpen);
+	m_postChain.SetEnabled(m_vignettePass, vignette);
+}
+
+void SceneRenderer::SetDynamicResolution(bool enabled)
+{
+	m_dynamicRes.SetEnabled(enabled);
+}
+
+bool SceneRenderer::SetGpuCulling(bool enabled)
+{
+	m_gpuCulling = enabled && m_gpuCubes;
+	return m_gpuCulling;
+}
+
+// fixed function state for each pass of the offscreen render. Selected
+// objects also write the outline's selection mask, the rest only colour, so
+// the mask is also kept where the selection is hidden.
+void SceneRenderer::SetPassState(u32 pass)
+{
+	static const GLenum sceneAndMask[] = { GL_COLOR_ATTACHMENT0,
+										   GL_COLOR_ATTACHMENT1 };
+	switch (pass)
+	{
+	case PASS_SELECTED:
+		glDrawBuffers(2, sceneAndMask);
+		glEnable(GL_DEPTH_TEST);
+		glDepthFunc(GL_LESS);
+		glEnable(GL_CULL_FACE);
+		break;
+	case PASS_OPAQUE:
+		glDrawBuffers(1, sceneAndMask);
+		glEnable(GL_DEPTH_TEST);
+		glDepthFunc(GL_LESS);
+		glDisable(GL_CULL_FACE);
+		break;
+	case PASS_SKYBOX:
+		glDrawBuffers(1, sceneAndMask);
+		glEnable(GL_CULL_FACE);
+		glEnable(GL_DEPTH_TEST);
+		glDepthFunc(GL_LEQUAL);
+		break;
+	}
+}
+
+void SceneRenderer::BeginFrame()
+{
+	m_frameStats.BeginFrame();
+	Profiler::Instance().Collect();
+}
+
+u32 SceneRenderer::Render(Camera &camera, u32 framebuffer)
+{
+	// apply the resizes since the last frame and the render scale, in one
+	// go. The composite upscales to the output.
+	m_sceneTarget.Resize(m_dynamicRes.ScaledSize(m_outputWidth),
+						 m_dynamicRes.ScaledSize(m_outputHeight));
+	m_sceneTarget.Apply();
+
+	// start the occlusion rasterization on the workers, it runs while
+	// this thread sets up the frame
+	glm::mat4 model;
+	glm::mat4 view = camera.GetViewMatrix();
+	glm::mat4 projection = glm::perspective(
+		glm::radians(camera.Zoom),
+		(float)m_outputWidth / (float)std::max(m_outputHeight, 1u), 0.1f,
+		100.0f);
+	if (!m_gpuCulling) m_occlusion.BeginFrame(projection * view, m_workerPool);
+
+	// 1. first pass to off screen buffer
+	// ----------------------------------
+	glBindFramebuffer(GL_FRAMEBUFFER, m_sceneTarget.Framebuffer());
+	// both draw buffers, the mask clear is a no-op on one that isn't
+	SetPassState(PASS_SELECTED);
+	const float background[] = { 0.1f, 0.1f, 0.1f, 1.0f };
+	const float unselected[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	glClearBufferfv(GL_COLOR, 0, background);
+	glClearBufferfv(GL_COLOR, 1, unselected);
+	glClear(GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+	// the scene only covers part of the target if it was rounded up
+	glViewport(0, 0, m_sceneTarget.Width(), m_sceneTarget.Height());
+
+	// vertex shader uniforms, the render queue works out the per-draw
+	// matrices
+	m_renderQueue.SetCamera(view, projection);
+	m_skyboxShader.use();
+	// carve off translation component of the view matrix to center skybox
+	// at eye position always, then go from screen back to a direction
+	glm::mat4 skyboxViewProj = projection * glm::mat4(glm::mat3(view));
+	m_skyboxShader.setMat4("invViewProj", glm::inverse(skyboxViewProj));
+	const glm::mat4 viewProjection = projection * view;
+	m_instancedShader.use();
+	m_instancedShader.setMat4("viewProjection", viewProjection);
+	m_instancedSelected.use();
+	m_instancedSelected.setMat4("viewProjection", viewProjection);
+	m_grassShader.use();
+	m_grassShader.setMat4("viewProjection", viewProjection);
+
+	// cull, then refill the instance buffers with what's left. The GPU
+	// path leaves them empty and culls as it draws.
+	PROFILE_BEGIN("cull");
+	if (m_gpuCulling)
+	{
+		m_drawObjects.clear();
+		m_conditionalObjects.clear();
+	}
+	else
+	{
+		m_sceneCulling.Cull(ExtractFrustum(viewProjection), m_visibleObjects);
+		m_occlusion.EndFrame(m_workerPool);
+		m_occlusion.RemoveOccluded(m_sceneBounds, m_visibleObjects);
+		m_hwOcclusion.Classify(m_visibleObjects, m_drawObjects,
+							   m_conditionalObjects);
+	}
+	m_visibleCubes.clear();
+	m_visibleGrass.clear();
+	auto addInstance = [&](u32 object) {
+		if (object < m_grassFirstObject)
+		{
+			m_visibleCubes.push_back(m_cubeTransforms[object]);
+		}
+		else
+		{
+			m_visibleGrass.push_back(
+				m_grassTransforms[object - m_grassFirstObject]);
+		}
+	};
+	for (u32 object : m_drawObjects)
+	{
+		addInstance(object);
+	}
+	// objects waiting on a query go after the batch, one instance each
+	const u32 cubeBatchCount = (u32)m_visibleCubes.size();
+	const u32 grassBatchCount = (u32)m_visibleGrass.size();
+	for (u32 object : m_conditionalObjects)
+	{
+		addInstance(object);
+	}
+	m_cubeInstances.Upload(m_visibleCubes);
+	m_grassInstances.Upload(m_visibleGrass);
+	PROFILE_END();
+
+	// build the draw list for this frame
+	PROFILE_BEGIN("draw list");
+	m_renderQueue.Clear();
+	const float farPlane = 100.0f;
+	auto pushDraw = [&](u32 pass, Shader &shader, VAO vao, TXO texture,
+						GLenum textureTarget, u32 count,
+						const glm::mat4 &model, u32 instanceCount = 0,
+						u32 baseInstance = 0, u32 conditionQuery = 0) {
+		DrawItem item;
+		item.shader = &shader;
+		item.vao = vao;
+		item.texture = texture;
+		item.textureTarget = textureTarget;
+		item.count = count;
+		item.model = model;
+		// instanced draws take their transforms from the instance buffer,
+		// model then only positions the batch for depth sorting
+		item.instanceCount = instanceCount;
+		item.baseInstance = baseInstance;
+		item.conditionQuery = conditionQuery;
+		item.hasModel = instanceCount == 0;
+		float depth = glm::length(glm::vec3(model[3]) - camera.wPosition)
+			/ farPlane;
+		m_renderQueue.Push(RenderQueue::MakeKey(pass, false,
+												shader.m_programId, texture,
+												vao, depth),
+						   item);
+	};
+	if (cubeBatchCount > 0)
+	{
+		model = glm::translate(glm::mat4(), m_cubeCentroid);
+		pushDraw(PASS_SELECTED, m_instancedSelected, m_cubeVAO, m_cubeTexture,
+				 GL_TEXTURE_2D, 36, model, cubeBatchCount);
+	}
+	pushDraw(PASS_OPAQUE, m_normalShader, m_planeVAO, m_floorTexture,
+			 GL_TEXTURE_2D, 6, glm::mat4());
+	if (grassBatchCount > 0)
+	{
+		model = glm::translate(glm::mat4(), m_grassCentroid);
+		pushDraw(PASS_OPAQUE, m_grassShader, m_grassVAO, m_grassTexture,
+				 GL_TEXTURE_2D, 6, model, grassBatchCount);
+	}
+	// the GPU decides whether these get drawn
+	u32 nextCube = cubeBatchCount, nextGrass = grassBatchCount;
+	for (u32 object : m_conditionalObjects)
+	{
+		u32 query = m_hwOcclusion.ConditionQuery(object);
+		if (object < m_grassFirstObject)
+		{
+			model = m_cubeTransforms[object];
+			pushDraw(PASS_SELECTED, m_instancedSelected, m_cubeVAO,
+					 m_cubeTexture, GL_TEXTURE_2D, 36, model, 1, nextCube,
+					 query);
+			nextCube++;
+		}
+		else
+		{
+			model = m_grassTransforms[object - m_grassFirstObject];
+			pushDraw(PASS_OPAQUE, m_grassShader, m_grassVAO, m_grassTexture,
+					 GL_TEXTURE_2D, 6, model, 1, nextGrass, query);
+			nextGrass++;
+		}
+	}
+	// skybox goes last so depth testing discards everything hidden
+	DrawItem skybox;
+	skybox.shader = &m_skyboxShader;
+	skybox.vao = m_emptyVAO;
+	skybox.texture = m_cubemapTexture;
+	skybox.textureTarget = GL_TEXTURE_CUBE_MAP;
+	skybox.count = 3;
+	skybox.hasModel = false;
+	m_renderQueue.Push(RenderQueue::MakeKey(PASS_SKYBOX, false,
+											m_skyboxShader.m_programId,
+											m_cubemapTexture, m_emptyVAO,
+											1.0f),
+					   skybox);
+
+	m_renderQueue.Sort();
+	PROFILE_END();
+	m_dynamicRes.BeginFrame();
+	m_frameStats.BeginPass(m_scenePassStats);
+	PROFILE_BEGIN("scene");
+	PROFILE_GPU_BEGIN("scene");
+	u32 draws = 0;
+	if (m_gpuCulling)
+	{
+		// ahead of the queue, in its pass order
+		glActiveTexture(GL_TEXTURE0);
+		SetPassState(PASS_SELECTED);
+		m_instancedSelected.use();
+		glBindTexture(GL_TEXTURE_2D, m_cubeTexture);
+		m_gpuCubes->Cull(viewProjection);
+		m_gpuCubes->Draw();
+		SetPassState(PASS_OPAQUE);
+		m_grassShader.use();
+		glBindTexture(GL_TEXTURE_2D, m_grassTexture);
+		m_gpuGrass->Cull(viewProjection);
+		m_gpuGrass->Draw();
+		// a multi-draw each. The triangles are counted on the GPU and come
+		// back a few frames late.
+		draws += 2;
+		m_frameStats.AddDraws(2, m_gpuCubes->LatestTriangleCount()
+								   + m_gpuGrass->LatestTriangleCount());
+	}
+	m_renderQueue.Execute(SetPassState);
+	draws += m_renderQueue.GetStats().draws;
+	m_frameStats.AddDraws(m_renderQueue.GetStats().draws,
+						  m_renderQueue.GetStats().triangles);
+
+	// occlusion queries against this frame's depth, used next frame
+	if (!m_gpuCulling)
+	{
+		m_hwOcclusion.IssueQueries(m_visibleObjects, viewProjection,
+								   camera.wPosition);
+	}
+	PROFILE_GPU_END();
+	PROFILE_END();
+	m_frameStats.EndPass(m_scenePassStats);
+
+	// jump flood for the outline, if it's wide enough to need one. The
+	// width is in render pixels, keep it the same on screen.
+	const float outlineWidth = OUTLINE_WIDTH * m_sceneTarget.Width()
+		/ (float)m_outputWidth;
+	m_frameStats.BeginPass(m_outlinePassStats);
+	PROFILE_BEGIN("outline");
+	PROFILE_GPU_BEGIN("outline");
+	m_outlinePass.Prepare(m_sceneTarget.MaskTexture(),
+						  m_sceneTarget.TargetWidth(),
+						  m_sceneTarget.TargetHeight(), m_sceneTarget.Width(),
+						  m_sceneTarget.Height(), outlineWidth, m_emptyVAO);
+	PROFILE_GPU_END();
+	PROFILE_END();
+	m_frameStats.EndPass(m_outlinePassStats);
+
+	// post-processing, ping-ponging between pooled targets
+	m_frameStats.BeginPass(m_postPassStats);
+	PROFILE_BEGIN("post");
+	PROFILE_GPU_BEGIN("post");
+	const TXO postResult = m_postChain.Run(m_sceneTarget.ColourTexture(),
+		m_sceneTarget.Width(), m_sceneTarget.Height(),
+		m_sceneTarget.TargetWidth(), m_sceneTarget.TargetHeight(),
+		m_emptyVAO);
+	PROFILE_GPU_END();
+	PROFILE_END();
+	m_frameStats.EndPass(m_postPassStats);
+	// a full screen triangle per pass
+	const u32 postPasses = (u32)m_postChain.GetTimings().size();
+	m_frameStats.AddDraws(postPasses, postPasses);
+	draws += postPasses;
+	m_renderTargets.NextFrame();
+	m_dynamicRes.EndFrame();
+
+	// 2. second pass to draw full screen triangle, with the outline
+	// ---------------------------------------
+	m_frameStats.BeginPass(m_compositePassStats);
+	PROFILE_BEGIN("composite");
+	PROFILE_GPU_BEGIN("composite");
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glClearColor(0.0f, 0.2f, 0.3f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_STENCIL_TEST);
+	glDisable(GL_CULL_FACE);
+	glViewport(m_outputX, m_outputY, m_outputWidth, m_outputHeight);
+
+	m_compositeShader.use();
+	m_compositeShader.setVec2("uvScale", m_sceneTarget.UVScale());
+	m_compositeShader.setFloat("upscaleSharpness",
+		m_sceneTarget.Width() < m_outputWidth ? UPSCALE_SHARPNESS : 0.0f);
+	m_outlinePass.Bind(m_compositeShader, OUTLINE_COLOUR);
+	glBindVertexArray(m_emptyVAO);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, postResult);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	m_frameStats.AddDraws(1, 1);
+	PROFILE_GPU_END();
+	PROFILE_END();
+	m_frameStats.EndPass(m_compositePassStats);
+	return draws + 1;
+}
+
+std::string SceneRenderer::StatusText() const
+{
+	std::string text = m_gpuCulling
+		? "gpu culling drew "
+			+ std::to_string(m_gpuCubes->LatestDrawCount()
+							 + m_gpuGrass->LatestDrawCount())
+		: "occlusion queries skipped "
+			+ std::to_string(m_hwOcclusion.SkippedCount());
+	text += " | render " + std::to_string(m_sceneTarget.Width()) + "x"
+		+ std::to_string(m_sceneTarget.Height()) + " gpu "
+		+ std::to_string(m_dynamicRes.GpuMs()) + " ms";
+	for (const PostPassTiming &timing : m_postChain.GetTimings())
+	{
+		text += " | " + timing.name + " " + std::to_string(timing.ms) + " ms";
+	}
+	return text;
+}
+
+// utility function for loading a 2D texture from file
+// ---------------------------------------------------
+unsigned int loadTexture(char const *path)
+{
+	PROFILE_FUNCTION();
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+
+    int width, height, nrComponents;
+	stbi_set_flip_vertically_on_load(true);
+    unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
+    if (data)
+    {
+        GLenum format;
+        if (nrComponents == 1)
+            format = GL_RED;
+        else if (nrComponents == 3)
+            format = GL_RGB;
+        else if (nrComponents == 4)
+            format = GL_RGBA;
+
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+        glGenerateMipmap(GL_TEXTURE_2D);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        stbi_image_free(data);
+    }
+    else
+    {
+        std::cout << "Texture failed to load at path: " << path << std::endl;
+        stbi_image_free(data);
+    }
+
+    return textureID;
+}
+
+unsigned int loadCubemap(std::vector<std::string> faces)
+{
+	PROFILE_FUNCTION();
+	unsigned int textureID;
+	glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+
+	int width, height, nrChannels;
+	stbi_set_flip_vertically_on_load(false);
+	for (unsigned int i = 0; i < faces.size(); i++)
+	{
+		unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
+		if (data)
+		{
+			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
+						 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data
+						 );
+			stbi_image_free(data);
+		}
+		else
+		{
+			std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
+			stbi_image_free(data);
+		}
+	}
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+	return textureID;
+}
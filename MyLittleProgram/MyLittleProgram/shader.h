@@ -9,6 +9,8 @@
 #include <sstream>
 #include <iostream>
 
+#include "profiler.h"
+
 using u32 = unsigned int;
 
 class Shader
@@ -17,6 +19,11 @@ public:
 	u32 m_programId;
 
 	Shader(const char *vertexPath, const char *fragmentPath);
+	// with a geometry shader between the two, geometryPath may be NULL
+	Shader(const char *vertexPath, const char *geometryPath,
+		   const char *fragmentPath);
+	// compute shader program (GL 4.3+)
+	explicit Shader(const char *computePath);
 
 	// use/activate the shader
 	void use();
@@ -25,22 +32,36 @@ public:
 	void setBool(const std::string &name, bool value) const;
 	void setInt(const std::string &name, int value) const;
 	void setFloat(const std::string &name, float value) const;
+	void setVec2(const std::string &name, const glm::vec2 &v) const;
 	void setVec3(const std::string &name, float f0, float f1, float f2) const;
     void setVec3(const std::string & name, const glm::vec3 &v) const;
 	void setVec4(const std::string &name, float f0, float f1, float f2,
 	             float f3) const;
 	void setMat4(const std::string &name, const glm::mat4 &matrix);
+	// point a uniform block at a buffer binding point (no layout(binding) in
+	// GLSL 330)
+	void bindUniformBlock(const std::string &name, u32 binding) const;
 };
 
 Shader::Shader(const char *vertexPath, const char *fragmentPath)
+	: Shader(vertexPath, NULL, fragmentPath)
+{
+}
+
+Shader::Shader(const char *vertexPath, const char *geometryPath,
+			   const char *fragmentPath)
 {
-	// 1. retrieve the vertex/fragment source code from filePath
+	PROFILE_SCOPE("Shader compile");
+	// 1. retrieve the vertex/geometry/fragment source code from filePath
 	std::string vertexCode;
+	std::string geometryCode;
 	std::string fragmentCode;
 	std::ifstream vShaderFile;
+	std::ifstream gShaderFile;
 	std::ifstream fShaderFile;
 	// ensure ifstream objects can throw exceptions:
 	vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+	gShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
 	fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
 	try
 	{
@@ -57,16 +78,25 @@ Shader::Shader(const char *vertexPath, const char *fragmentPath)
 		// convert stream into string
 		vertexCode = vShaderStream.str();
 		fragmentCode = fShaderStream.str();
+		if (geometryPath)
+		{
+			gShaderFile.open(geometryPath);
+			std::stringstream gShaderStream;
+			gShaderStream << gShaderFile.rdbuf();
+			gShaderFile.close();
+			geometryCode = gShaderStream.str();
+		}
 	}
 	catch (std::ifstream::failure e)
 	{
 		std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
 	}
 	const char *vShaderCode = vertexCode.c_str();
+	const char *gShaderCode = geometryCode.c_str();
 	const char *fShaderCode = fragmentCode.c_str();
 
 	// 2. compile shaders
-	unsigned int vertex, fragment;
+	unsigned int vertex, geometry = 0, fragment;
 	int success;
 	char infoLog[512];
 
@@ -83,6 +113,21 @@ Shader::Shader(const char *vertexPath, const char *fragmentPath)
 		          << infoLog << std::endl;
 	};
 
+	// geometry shader
+	if (geometryPath)
+	{
+		geometry = glCreateShader(GL_GEOMETRY_SHADER);
+		glShaderSource(geometry, 1, &gShaderCode, NULL);
+		glCompileShader(geometry);
+		glGetShaderiv(geometry, GL_COMPILE_STATUS, &success);
+		if (!success)
+		{
+			glGetShaderInfoLog(geometry, 512, NULL, infoLog);
+			std::cout << "ERROR::SHADER::GEOMETRY::COMPILATION_FAILED\n"
+			          << infoLog << std::endl;
+		}
+	}
+
 	// fragment shader
 	fragment = glCreateShader(GL_FRAGMENT_SHADER);
 	glShaderSource(fragment, 1, &fShaderCode, NULL);
@@ -99,6 +144,7 @@ Shader::Shader(const char *vertexPath, const char *fragmentPath)
 	// shader Program
 	m_programId = glCreateProgram();
 	glAttachShader(m_programId, vertex);
+	if (geometry) glAttachShader(m_programId, geometry);
 	glAttachShader(m_programId, fragment);
 	glLinkProgram(m_programId);
 	// print linking errors if any
@@ -113,9 +159,58 @@ Shader::Shader(const char *vertexPath, const char *fragmentPath)
 	// delete the shaders as they're linked into our program now and no longer
 	// necessery
 	glDeleteShader(vertex);
+	if (geometry) glDeleteShader(geometry);
 	glDeleteShader(fragment);
 }
 
+Shader::Shader(const char *computePath)
+{
+	PROFILE_SCOPE("Shader compile");
+	std::string computeCode;
+	std::ifstream cShaderFile;
+	cShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+	try
+	{
+		cShaderFile.open(computePath);
+		std::stringstream cShaderStream;
+		cShaderStream << cShaderFile.rdbuf();
+		cShaderFile.close();
+		computeCode = cShaderStream.str();
+	}
+	catch (std::ifstream::failure e)
+	{
+		std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+	}
+	const char *cShaderCode = computeCode.c_str();
+
+	unsigned int compute;
+	int success;
+	char infoLog[512];
+
+	compute = glCreateShader(GL_COMPUTE_SHADER);
+	glShaderSource(compute, 1, &cShaderCode, NULL);
+	glCompileShader(compute);
+	glGetShaderiv(compute, GL_COMPILE_STATUS, &success);
+	if (!success)
+	{
+		glGetShaderInfoLog(compute, 512, NULL, infoLog);
+		std::cout << "ERROR::SHADER::COMPUTE::COMPILATION_FAILED\n"
+		          << infoLog << std::endl;
+	}
+
+	m_programId = glCreateProgram();
+	glAttachShader(m_programId, compute);
+	glLinkProgram(m_programId);
+	glGetProgramiv(m_programId, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		glGetProgramInfoLog(m_programId, 512, NULL, infoLog);
+		std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n"
+		          << infoLog << std::endl;
+	}
+	glDeleteShader(compute);
+}
+
 void Shader::use()
 {
 	glUseProgram(m_programId);
@@ -133,6 +228,10 @@ void Shader::setFloat(const std::string &name, float value) const
 {
 	glUniform1f(glGetUniformLocation(m_programId, name.c_str()), value);
 }
+void Shader::setVec2(const std::string &name, const glm::vec2 &v) const
+{
+	glUniform2f(glGetUniformLocation(m_programId, name.c_str()), v.x, v.y);
+}
 void Shader::setVec3(const std::string & name, float f0, float f1, float f2) const
 {
     glUniform3f(glGetUniformLocation(m_programId, name.c_str()), f0, f1, f2);
@@ -151,4 +250,16 @@ void Shader::setVec4(const std::string &name, float f0, float f1, float f2,
 void Shader::setMat4(const std::string &name, const glm::mat4 &matrix)
 {
 	glUniformMatrix4fv(glGetUniformLocation(m_programId, name.c_str()), 1, GL_FALSE, glm::value_ptr(matrix));
+}
+
+void Shader::bindUniformBlock(const std::string &name, u32 binding) const
+{
+	GLuint index = glGetUniformBlockIndex(m_programId, name.c_str());
+	if (index == GL_INVALID_INDEX)
+	{
+		std::cout << "ERROR::SHADER::UNIFORM_BLOCK_NOT_FOUND " << name
+				  << std::endl;
+		return;
+	}
+	glUniformBlockBinding(m_programId, index, binding);
 }
\ No newline at end of file
@@ -0,0 +1,111 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec3 vFragPos;
+in vec3 vNormal;
+in vec2 TexCoords;
+
+struct Material
+{
+    sampler2D texture_diffuse0;
+    sampler2D texture_specular0;
+    float shininess;
+};
+uniform Material material;
+
+struct DirLight
+{
+    vec3 vDirection;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+uniform DirLight dirLight;
+
+// froxel grid, the same as clustered.h
+#define CLUSTER_X 16
+#define CLUSTER_Y 9
+#define CLUSTER_Z 24
+
+// 4 texels per light, view space:
+//   position, range
+//   colour, cos inner cut-off
+//   constant, linear, quadratic, cos outer cut-off
+//   spot direction
+uniform samplerBuffer lightData;
+// the clusters' light lists back to back
+uniform usamplerBuffer lightIndices;
+// offset into lightIndices and count per cluster
+uniform usamplerBuffer lightGrid;
+uniform int lightCount;
+// cluster from window position and view depth
+uniform vec2 tileScale;
+uniform float zScale;
+uniform float zBias;
+// walk every light instead of the cluster's, for comparison
+uniform bool bruteForce = false;
+
+vec3 CalcLight(int light, vec3 albedo, float specular, vec3 vNorm,
+               vec3 vViewDir)
+{
+    vec4 positionRange = texelFetch(lightData, light * 4);
+    vec3 toLight = positionRange.xyz - vFragPos;
+    float distance = length(toLight);
+    if (distance >= positionRange.w) return vec3(0.0);
+    vec4 colourInner = texelFetch(lightData, light * 4 + 1);
+    vec4 attenuationOuter = texelFetch(lightData, light * 4 + 2);
+    vec3 spotDirection = texelFetch(lightData, light * 4 + 3).xyz;
+
+    vec3 vLightDir = toLight / distance;
+    // point lights have cut-offs that always give 1
+    float theta = dot(vLightDir, -spotDirection);
+    float intensity = clamp((theta - attenuationOuter.w)
+                            / (colourInner.w - attenuationOuter.w), 0.0, 1.0);
+    float diff = max(dot(vNorm, vLightDir), 0.0);
+    vec3 vReflectDir = reflect(-vLightDir, vNorm);
+    float spec = pow(max(dot(vViewDir, vReflectDir), 0.0), material.shininess);
+    float attenuation = 1.0
+        / (attenuationOuter.x + attenuationOuter.y * distance
+           + attenuationOuter.z * distance * distance);
+    return colourInner.rgb * (diff * albedo + spec * specular) * attenuation
+        * intensity;
+}
+
+void main()
+{
+    vec3 albedo = texture(material.texture_diffuse0, TexCoords).rgb;
+    float specular = texture(material.texture_specular0, TexCoords).r;
+    vec3 vNorm = normalize(vNormal);
+    vec3 vViewDir = normalize(-vFragPos);
+
+    vec3 vLightDir = normalize(-dirLight.vDirection);
+    float diff = max(dot(vNorm, vLightDir), 0.0);
+    vec3 vReflectDir = reflect(-vLightDir, vNorm);
+    float spec = pow(max(dot(vViewDir, vReflectDir), 0.0), material.shininess);
+    vec3 result = dirLight.ambient * albedo + dirLight.diffuse * diff * albedo
+        + dirLight.specular * spec * specular;
+
+    if (bruteForce)
+    {
+        for (int i = 0; i < lightCount; i++)
+        {
+            result += CalcLight(i, albedo, specular, vNorm, vViewDir);
+        }
+    }
+    else
+    {
+        ivec2 tile = min(ivec2(gl_FragCoord.xy * tileScale),
+                         ivec2(CLUSTER_X - 1, CLUSTER_Y - 1));
+        int slice = clamp(int(log(-vFragPos.z) * zScale + zBias), 0,
+                          CLUSTER_Z - 1);
+        int cluster = tile.x + CLUSTER_X * (tile.y + CLUSTER_Y * slice);
+        uvec2 range = texelFetch(lightGrid, cluster).xy;
+        for (int i = 0; i < int(range.y); i++)
+        {
+            int light = int(texelFetch(lightIndices, int(range.x) + i).r);
+            result += CalcLight(light, albedo, specular, vNorm, vViewDir);
+        }
+    }
+    FragColor = vec4(result, 1.0);
+}
\ No newline at end of file
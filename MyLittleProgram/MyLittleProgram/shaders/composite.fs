@@ -0,0 +1,77 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D screenTexture;
+// part of screenTexture that was rendered to, as in fullScreenTriangle.vs
+uniform vec2 uvScale = vec2(1.0);
+// sharpening applied when upscaling a lower resolution render, 0 for none
+uniform float upscaleSharpness;
+// outline, see outline.h
+uniform sampler2D selectionMask;
+uniform sampler2D outlineSeeds;
+uniform float outlineWidth;
+uniform bool outlineJumpFlood;
+uniform vec3 outlineColour;
+
+float OutlineCoverage()
+{
+    ivec2 size = textureSize(selectionMask, 0);
+    ivec2 pixel = ivec2(TexCoords * vec2(size));
+    if (texelFetch(selectionMask, pixel, 0).r > 0.5)
+        return 0.0;
+
+    if (outlineJumpFlood)
+    {
+        vec2 seed = texelFetch(outlineSeeds, pixel, 0).xy;
+        if (seed.x < 0.0)
+            return 0.0;
+        float dist = distance(seed, vec2(pixel) + 0.5);
+        return clamp(outlineWidth + 0.5 - dist, 0.0, 1.0);
+    }
+
+    // thin outline, look for a selected pixel within the width
+    int radius = int(ceil(outlineWidth));
+    for (int y = -radius; y <= radius; y++)
+    {
+        for (int x = -radius; x <= radius; x++)
+        {
+            ivec2 p = clamp(pixel + ivec2(x, y), ivec2(0), size - 1);
+            if (length(vec2(x, y)) <= outlineWidth + 0.5
+                && texelFetch(selectionMask, p, 0).r > 0.5)
+                return 1.0;
+        }
+    }
+    return 0.0;
+}
+
+// Bilinear upscale, sharpened by the difference to the four neighbours
+// (one source texel away). The result is clamped to the range of the
+// neighbourhood so edges don't ring.
+vec3 Upscale()
+{
+    vec2 texel = 1.0 / vec2(textureSize(screenTexture, 0));
+    // keep the filter inside the rendered part
+    vec2 uvMax = uvScale - 0.5 * texel;
+    vec2 uv = min(TexCoords, uvMax);
+    vec3 centre = texture(screenTexture, uv).rgb;
+    if (upscaleSharpness <= 0.0)
+        return centre;
+
+    vec3 n0 = texture(screenTexture, min(uv + vec2(texel.x, 0.0), uvMax)).rgb;
+    vec3 n1 = texture(screenTexture, max(uv - vec2(texel.x, 0.0), 0.0)).rgb;
+    vec3 n2 = texture(screenTexture, min(uv + vec2(0.0, texel.y), uvMax)).rgb;
+    vec3 n3 = texture(screenTexture, max(uv - vec2(0.0, texel.y), 0.0)).rgb;
+    vec3 lo = min(centre, min(min(n0, n1), min(n2, n3)));
+    vec3 hi = max(centre, max(max(n0, n1), max(n2, n3)));
+    vec3 sharpened = centre
+        + upscaleSharpness * (centre - 0.25 * (n0 + n1 + n2 + n3));
+    return clamp(sharpened, lo, hi);
+}
+
+void main()
+{
+    vec3 colour = Upscale();
+    FragColor = vec4(mix(colour, outlineColour, OutlineCoverage()), 1.0);
+}
\ No newline at end of file
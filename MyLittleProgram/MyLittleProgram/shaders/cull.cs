@@ -0,0 +1,70 @@
+#version 430 core
+layout (local_size_x = 64) in;
+
+// one entry per object, world space box plus its index range
+struct ObjectData
+{
+	vec4 center;
+	vec4 extent;
+	uint indexCount;
+	uint firstIndex;
+	int baseVertex;
+	uint pad;
+};
+layout (std430, binding = 0) readonly buffer Objects
+{
+	ObjectData objects[];
+};
+
+// matches DrawElementsIndirectCommand
+struct DrawCommand
+{
+	uint count;
+	uint instanceCount;
+	uint firstIndex;
+	int baseVertex;
+	uint baseInstance;
+};
+layout (std430, binding = 1) writeonly buffer Commands
+{
+	DrawCommand commands[];
+};
+
+layout (std430, binding = 2) buffer Counters
+{
+	uint drawCount;
+	uint triangleCount;
+};
+
+uniform vec4 frustumPlanes[6];
+uniform uint objectCount;
+
+void main()
+{
+	uint id = gl_GlobalInvocationID.x;
+	if (id >= objectCount)
+		return;
+
+	// outside a plane when the centre is further behind it than the box's
+	// projected radius, summed in the same order as CullingSystem
+	vec3 c = objects[id].center.xyz;
+	vec3 e = objects[id].extent.xyz;
+	for (int i = 0; i < 6; i++)
+	{
+		vec4 p = frustumPlanes[i];
+		float dist = (p.x * c.x + p.y * c.y) + (p.z * c.z + p.w);
+		float radius = (abs(p.x) * e.x + abs(p.y) * e.y) + abs(p.z) * e.z;
+		if (dist + radius < 0.0)
+			return;
+	}
+
+	// survivors are compacted to the front of the command buffer
+	uint slot = atomicAdd(drawCount, 1u);
+	atomicAdd(triangleCount, objects[id].indexCount / 3u);
+	commands[slot].count = objects[id].indexCount;
+	commands[slot].instanceCount = 1u;
+	commands[slot].firstIndex = objects[id].firstIndex;
+	commands[slot].baseVertex = objects[id].baseVertex;
+	// baseInstance selects the object's model matrix in the instance buffer
+	commands[slot].baseInstance = id;
+}
\ No newline at end of file
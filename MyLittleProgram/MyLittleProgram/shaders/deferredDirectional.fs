@@ -0,0 +1,57 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+struct DirLight
+{
+    vec3 vDirection;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+uniform DirLight dirLight;
+
+uniform sampler2D gAlbedoSpec;
+uniform sampler2D gNormalShininess;
+uniform sampler2D gDepth;
+uniform mat4 invProjection;
+
+vec3 DecodeNormal(vec2 e)
+{
+    e = e * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0,
+                                        n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gDepth, pixel, 0).r;
+    // nothing was drawn here
+    if (depth == 1.0)
+        discard;
+    vec4 viewPos = invProjection * vec4(TexCoords * 2.0 - 1.0,
+                                        depth * 2.0 - 1.0, 1.0);
+    vec3 vFragPos = viewPos.xyz / viewPos.w;
+
+    vec4 albedoSpec = texelFetch(gAlbedoSpec, pixel, 0);
+    vec4 normalShininess = texelFetch(gNormalShininess, pixel, 0);
+    vec3 vNormal = DecodeNormal(normalShininess.xy);
+    float shininess = normalShininess.z * 256.0;
+
+    // as CalcDirLight in lighting3.fs
+    vec3 vLightDir = normalize(-dirLight.vDirection);
+    vec3 vViewDir = normalize(-vFragPos);
+    float diff = max(dot(vNormal, vLightDir), 0.0);
+    vec3 vReflectDir = reflect(-vLightDir, vNormal);
+    float spec = pow(max(dot(vViewDir, vReflectDir), 0.0), shininess);
+    vec3 colour = dirLight.ambient * albedoSpec.rgb
+        + dirLight.diffuse * diff * albedoSpec.rgb
+        + dirLight.specular * spec * albedoSpec.a;
+    FragColor = vec4(colour, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,25 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+
+// view space, for lighting
+out vec3 vFragPos;
+out vec3 vNormal;
+out vec2 TexCoords;
+
+// written per draw by the render queue, see transforms.h
+layout (std140) uniform PerDraw
+{
+    mat4 mvp;
+    mat4 modelView;
+    mat3 normalMatrix;
+};
+
+void main()
+{
+    vFragPos = vec3(modelView * vec4(aPos, 1.0));
+    vNormal = normalMatrix * aNormal;
+    TexCoords = aTexCoords;
+    gl_Position = mvp * vec4(aPos, 1.0);
+}
\ No newline at end of file
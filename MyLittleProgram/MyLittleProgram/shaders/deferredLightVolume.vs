@@ -0,0 +1,23 @@
+#version 330 core
+// unit sphere, scaled to each light's radius
+layout (location = 0) in vec3 aPos;
+// per light
+layout (location = 1) in vec4 aPositionRadius; // world space
+layout (location = 2) in vec3 aColour;
+layout (location = 3) in vec3 aAttenuation;    // constant, linear, quadratic
+
+flat out vec3 vLightPos;
+flat out vec3 LightColour;
+flat out vec4 LightAttenuation; // constant, linear, quadratic, radius
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    vLightPos = vec3(view * vec4(aPositionRadius.xyz, 1.0));
+    LightColour = aColour;
+    LightAttenuation = vec4(aAttenuation, aPositionRadius.w);
+    vec3 worldPos = aPositionRadius.xyz + aPos * aPositionRadius.w;
+    gl_Position = projection * view * vec4(worldPos, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+#version 330 core
+out vec4 FragColor;
+
+flat in vec3 vLightPos;
+flat in vec3 LightColour;
+flat in vec4 LightAttenuation;
+
+uniform sampler2D gAlbedoSpec;
+uniform sampler2D gNormalShininess;
+uniform sampler2D gDepth;
+uniform mat4 invProjection;
+
+vec3 DecodeNormal(vec2 e)
+{
+    e = e * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0,
+                                        n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gDepth, pixel, 0).r;
+    vec2 ndc = (gl_FragCoord.xy / vec2(textureSize(gDepth, 0))) * 2.0 - 1.0;
+    vec4 viewPos = invProjection * vec4(ndc, depth * 2.0 - 1.0, 1.0);
+    vec3 vFragPos = viewPos.xyz / viewPos.w;
+
+    // the volume covers more than the sphere of influence
+    float distance = length(vLightPos - vFragPos);
+    if (distance > LightAttenuation.w)
+        discard;
+
+    vec4 albedoSpec = texelFetch(gAlbedoSpec, pixel, 0);
+    vec4 normalShininess = texelFetch(gNormalShininess, pixel, 0);
+    vec3 vNormal = DecodeNormal(normalShininess.xy);
+    float shininess = normalShininess.z * 256.0;
+
+    // as CalcPointLight in lighting3.fs
+    vec3 vLightDir = normalize(vLightPos - vFragPos);
+    vec3 vViewDir = normalize(-vFragPos);
+    float diff = max(dot(vNormal, vLightDir), 0.0);
+    vec3 vReflectDir = reflect(-vLightDir, vNormal);
+    float spec = pow(max(dot(vViewDir, vReflectDir), 0.0), shininess);
+    float attenuation = 1.0
+        / (LightAttenuation.x + LightAttenuation.y * distance
+           + LightAttenuation.z * distance * distance);
+    vec3 colour = LightColour * (diff * albedoSpec.rgb + spec * albedoSpec.a);
+    FragColor = vec4(colour * attenuation, 1.0);
+}
\ No newline at end of file
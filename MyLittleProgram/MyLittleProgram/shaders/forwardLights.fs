@@ -0,0 +1,66 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec3 vFragPos;
+in vec3 vNormal;
+in vec2 TexCoords;
+
+struct Material
+{
+    sampler2D texture_diffuse0;
+    sampler2D texture_specular0;
+    float shininess;
+};
+uniform Material material;
+
+struct DirLight
+{
+    vec3 vDirection;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+uniform DirLight dirLight;
+
+// every point light is evaluated for every fragment, see
+// BenchmarkDeferred in deferred.h
+#define MAX_FORWARD_LIGHTS 256
+layout (std140) uniform ForwardLights
+{
+    vec4 lightPosition[MAX_FORWARD_LIGHTS];    // view space
+    vec4 lightColour[MAX_FORWARD_LIGHTS];
+    vec4 lightAttenuation[MAX_FORWARD_LIGHTS]; // constant, linear, quadratic
+};
+uniform int lightCount;
+
+void main()
+{
+    vec3 albedo = texture(material.texture_diffuse0, TexCoords).rgb;
+    float specular = texture(material.texture_specular0, TexCoords).r;
+    vec3 vNorm = normalize(vNormal);
+    vec3 vViewDir = normalize(-vFragPos);
+
+    vec3 vLightDir = normalize(-dirLight.vDirection);
+    float diff = max(dot(vNorm, vLightDir), 0.0);
+    vec3 vReflectDir = reflect(-vLightDir, vNorm);
+    float spec = pow(max(dot(vViewDir, vReflectDir), 0.0), material.shininess);
+    vec3 result = dirLight.ambient * albedo + dirLight.diffuse * diff * albedo
+        + dirLight.specular * spec * specular;
+
+    for (int i = 0; i < lightCount; i++)
+    {
+        vec3 toLight = lightPosition[i].xyz - vFragPos;
+        float distance = length(toLight);
+        vLightDir = toLight / distance;
+        diff = max(dot(vNorm, vLightDir), 0.0);
+        vReflectDir = reflect(-vLightDir, vNorm);
+        spec = pow(max(dot(vViewDir, vReflectDir), 0.0), material.shininess);
+        float attenuation = 1.0
+            / (lightAttenuation[i].x + lightAttenuation[i].y * distance
+               + lightAttenuation[i].z * distance * distance);
+        result += lightColour[i].rgb * (diff * albedo + spec * specular)
+            * attenuation;
+    }
+    FragColor = vec4(result, 1.0);
+}
\ No newline at end of file
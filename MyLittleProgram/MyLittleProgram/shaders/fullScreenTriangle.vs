@@ -0,0 +1,20 @@
+#version 330 core
+// One triangle that covers the screen, drawn with glDrawArrays(GL_TRIANGLES,
+// 0, 3) and no vertex buffers. Unlike a two-triangle quad there is no
+// diagonal seam where pixels get shaded twice.
+
+out vec2 TexCoords;    // for sampling the input, scaled by uvScale
+out vec2 ScreenCoords; // 0 to 1 across the viewport
+
+// size of the viewport relative to the input texture, when rendering into
+// part of a larger target (see SceneTarget in rendertarget.h)
+uniform vec2 uvScale = vec2(1.0);
+
+void main()
+{
+    // (-1,-1), (3,-1), (-1,3)
+    vec2 pos = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    TexCoords = pos * uvScale;
+    ScreenCoords = pos;
+    gl_Position = vec4(pos * 2.0 - 1.0, 0.0, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,36 @@
+#version 330 core
+// G-buffer layout, see deferred.h
+layout (location = 0) out vec4 AlbedoSpec;      // RGBA8
+layout (location = 1) out vec4 NormalShininess; // RGB10_A2
+
+in vec3 vFragPos;
+in vec3 vNormal;
+in vec2 TexCoords;
+
+struct Material
+{
+    sampler2D texture_diffuse0;
+    sampler2D texture_specular0;
+    float shininess;
+};
+uniform Material material;
+
+// octahedral normal encoding, two channels in [0, 1]
+vec2 EncodeNormal(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 e = n.z >= 0.0 ? n.xy
+        : (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0,
+                                   n.y >= 0.0 ? 1.0 : -1.0);
+    return e * 0.5 + 0.5;
+}
+
+void main()
+{
+    AlbedoSpec.rgb = texture(material.texture_diffuse0, TexCoords).rgb;
+    AlbedoSpec.a = texture(material.texture_specular0, TexCoords).r;
+    NormalShininess.xy = EncodeNormal(normalize(vNormal));
+    // exponents up to 256
+    NormalShininess.z = material.shininess / 256.0;
+    NormalShininess.w = 1.0;
+}
\ No newline at end of file
@@ -0,0 +1,15 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoords;
+layout (location = 3) in mat4 aModel; // per instance
+
+out vec2 TexCoords;
+
+// projection * view, once per frame on the CPU
+uniform mat4 viewProjection;
+
+void main()
+{
+    TexCoords = aTexCoords;
+    gl_Position = viewProjection * (aModel * vec4(aPos, 1.0));
+}
\ No newline at end of file
@@ -0,0 +1,21 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec3 Normal;
+in vec2 TexCoords;
+
+struct Material
+{
+    sampler2D texture_diffuse0;
+};
+uniform Material material;
+// world space, towards the light
+uniform vec3 lightDirection;
+
+// the diffuse texture under one directional light and some ambient
+void main()
+{
+    float diffuse = max(dot(normalize(Normal), lightDirection), 0.0);
+    vec3 albedo = texture(material.texture_diffuse0, TexCoords).rgb;
+    FragColor = vec4(albedo * (0.25 + 0.75 * diffuse), 1.0);
+}
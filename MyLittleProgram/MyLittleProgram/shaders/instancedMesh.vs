@@ -0,0 +1,21 @@
+#version 330 core
+// Mesh vertex layout (see mesh.h) with a model matrix per instance, for
+// Mesh::DrawInstanced and Model::DrawInstanced
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in mat4 aModel; // per instance
+
+out vec3 Normal; // world space
+out vec2 TexCoords;
+
+// projection * view, once per frame on the CPU
+uniform mat4 viewProjection;
+
+void main()
+{
+    // no non-uniform scales, so the model matrix can turn the normal
+    Normal = mat3(aModel) * aNormal;
+    TexCoords = aTexCoords;
+    gl_Position = viewProjection * (aModel * vec4(aPos, 1.0));
+}
@@ -0,0 +1,11 @@
+#version 330 core
+out vec2 Seed;
+
+uniform sampler2D selectionMask;
+
+void main()
+{
+    // selected pixels are their own nearest seed, the rest have none yet
+    float selected = texelFetch(selectionMask, ivec2(gl_FragCoord.xy), 0).r;
+    Seed = selected > 0.5 ? gl_FragCoord.xy : vec2(-1.0);
+}
\ No newline at end of file
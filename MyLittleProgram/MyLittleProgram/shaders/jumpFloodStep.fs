@@ -0,0 +1,34 @@
+#version 330 core
+out vec2 Seed;
+
+uniform sampler2D seeds;
+uniform int step;
+
+void main()
+{
+    // keep the nearest of the seeds found by this pixel and its neighbours
+    // step pixels away
+    ivec2 size = textureSize(seeds, 0);
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec2 best = vec2(-1.0);
+    float bestDist = 1e20;
+    for (int y = -1; y <= 1; y++)
+    {
+        for (int x = -1; x <= 1; x++)
+        {
+            ivec2 p = pixel + ivec2(x, y) * step;
+            if (any(lessThan(p, ivec2(0))) || any(greaterThanEqual(p, size)))
+                continue;
+            vec2 seed = texelFetch(seeds, p, 0).xy;
+            if (seed.x < 0.0)
+                continue;
+            float dist = distance(seed, gl_FragCoord.xy);
+            if (dist < bestDist)
+            {
+                bestDist = dist;
+                best = seed;
+            }
+        }
+    }
+    Seed = best;
+}
\ No newline at end of file
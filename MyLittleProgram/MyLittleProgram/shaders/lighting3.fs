@@ -17,57 +17,58 @@ struct Material
 uniform Material material;
 
 // LIGHTS
-struct DirLight
+// Written once a frame by LightManager, see lightmanager.h. View space.
+#define MAX_POINT_LIGHTS 128
+#define MAX_SPOT_LIGHTS 32
+layout (std140) uniform Lights
 {
-	vec3 vDirection;
-
-	vec3 ambient;
-	vec3 diffuse;
-	vec3 specular;
+	vec4 dirDirection;
+	vec4 dirAmbient;
+	vec4 dirDiffuse;
+	vec4 dirSpecular;
+	ivec4 lightCounts; // point, spot
+
+	vec4 pointPosition[MAX_POINT_LIGHTS];
+	vec4 pointColour[MAX_POINT_LIGHTS];
+	vec4 pointAttenuation[MAX_POINT_LIGHTS]; // constant, linear, quadratic
+
+	vec4 spotPosition[MAX_SPOT_LIGHTS];  // w: cos inner cut-off
+	vec4 spotDirection[MAX_SPOT_LIGHTS]; // w: cos outer cut-off
+	vec4 spotColour[MAX_SPOT_LIGHTS];
+	vec4 spotAttenuation[MAX_SPOT_LIGHTS];
 };
-uniform DirLight dirLight;
 
-struct PointLight
+// SHADOWS
+// Directional light cascades, see shadows.h. The matrices take view space to
+// shadow map coordinates, cascade i covers view depths up to cascadeSplits[i].
+#define CSM_CASCADES 4
+uniform sampler2DArrayShadow shadowMap;
+uniform mat4 cascadeMatrices[CSM_CASCADES];
+uniform vec4 cascadeSplits;
+
+// Local light shadows, see shadowatlas.h. A light's colour.w is its slot, -1
+// for none. The matrices take world space to atlas coordinates and depth.
+#define MAX_SHADOWED_POINT_LIGHTS 16
+#define MAX_SHADOWED_SPOT_LIGHTS 16
+layout (std140) uniform Shadows
 {
-	vec3 vPosition;
-
-	float constant;
-	float linear;
-	float quadratic;
-
-	vec3 ambient;
-	vec3 diffuse;
-	vec3 specular;
+	mat4 viewToWorld;
+	// six per light, +x -x +y -y +z -z
+	mat4 pointShadowMatrices[MAX_SHADOWED_POINT_LIGHTS * 6];
+	mat4 spotShadowMatrices[MAX_SHADOWED_SPOT_LIGHTS];
+	vec4 pointShadowPositions[MAX_SHADOWED_POINT_LIGHTS];
 };
-#define NR_POINT_LIGHTS 4
-uniform PointLight pointLights[NR_POINT_LIGHTS];
-
-// Spotlight
-struct SpotLight
-{
-	vec3 vPosition;
-	vec3 vDirection;
-
-	float innerCutOff;
-	float outerCutOff;
-
-	vec3 ambient;
-	vec3 diffuse;
-	vec3 specular;
-
-	float constant;
-	float linear;
-	float quadratic;
-};
-uniform SpotLight spotLight;
+uniform sampler2DShadow shadowAtlas;
 
 //______________________________________________________________________________
 // FWD DECLARATIONS
-vec3 CalcDirLight(DirLight dirLight, vec3 vNormal, vec3 vViewDir);
-vec3 CalcPointLight(PointLight pointLight, vec3 vNormal, vec3 vFragPos,
-					vec3 vViewDir);
-vec3 CalcSpotLight(SpotLight spotLight, vec3 vNormal, vec3 vFragPos,
-				   vec3 vViewDir);
+vec3 CalcDirLight(vec3 vNormal, vec3 vViewDir);
+vec3 CalcPointLight(int light, vec3 vNormal, vec3 vFragPos, vec3 vViewDir);
+vec3 CalcSpotLight(int light, vec3 vNormal, vec3 vFragPos, vec3 vViewDir);
+float Attenuation(vec4 attenuation, float distance);
+float DirShadow(vec3 vFragPos);
+float PointShadow(int shadow, vec3 vFragPos);
+float AtlasShadow(mat4 shadowMatrix, vec4 worldPos);
 //______________________________________________________________________________
 // MAIN
 void main()
@@ -76,20 +77,23 @@ void main()
 	vec3 vViewDir = normalize(-vFragPos);
 
 	vec3 result = vec3(0.0, 0.0, 0.0);
-	result += CalcDirLight(dirLight, vNorm, vViewDir);
-	for (int i = 0; i < 4; i++)
+	result += CalcDirLight(vNorm, vViewDir);
+	for (int i = 0; i < lightCounts.x; i++)
+	{
+		result += CalcPointLight(i, vNorm, vFragPos, vViewDir);
+	}
+	for (int i = 0; i < lightCounts.y; i++)
 	{
-		result += CalcPointLight(pointLights[i], vNorm, vFragPos, vViewDir);
+		result += CalcSpotLight(i, vNorm, vFragPos, vViewDir);
 	}
-	result += CalcSpotLight(spotLight, vNorm, vFragPos, vViewDir);
 
 	FragColor = vec4(result, 1.0);
 //	FragColor = vec4(vNorm, 1.0);
 }
 
-vec3 CalcDirLight(DirLight dirLight, vec3 vNormal, vec3 vViewDir)
+vec3 CalcDirLight(vec3 vNormal, vec3 vViewDir)
 {
-	vec3 vLightDir = normalize(-dirLight.vDirection);
+	vec3 vLightDir = normalize(-dirDirection.xyz);
 	// diffuse shading
 	float diff = max(dot(vNormal, vLightDir), 0.0);
 	// specular shading
@@ -97,84 +101,138 @@ vec3 CalcDirLight(DirLight dirLight, vec3 vNormal, vec3 vViewDir)
 	float spec = pow(max(dot(vViewDir, vReflectDir), 0.0), material.shininess);
 	// combine results
 	vec3 ambient
-		= dirLight.ambient * vec3(texture(material.texture_diffuse0, texCoords));
-	vec3 diffuse
-		= dirLight.diffuse * diff * vec3(texture(material.texture_diffuse0, texCoords));
-	vec3 specular = dirLight.specular * spec
+		= dirAmbient.rgb * vec3(texture(material.texture_diffuse0, texCoords));
+	vec3 diffuse = dirDiffuse.rgb * diff
+		* vec3(texture(material.texture_diffuse0, texCoords));
+	vec3 specular = dirSpecular.rgb * spec
 		* vec3(texture(material.texture_specular0, texCoords));
-	return (ambient + diffuse + specular);
+	float lit = 1.0 - DirShadow(vFragPos);
+	return (ambient + (diffuse + specular) * lit);
 }
 
-vec3 CalcPointLight(PointLight pointLight, vec3 vNormal, vec3 vFragPos,
-					vec3 vViewDir)
+// colour is used for both diffuse and specular, the ambient term is the
+// directional light's
+vec3 CalcPointLight(int light, vec3 vNormal, vec3 vFragPos, vec3 vViewDir)
 {
-	vec3 vLightDir = normalize(pointLight.vPosition - vFragPos);
+	vec3 vLightDir = normalize(pointPosition[light].xyz - vFragPos);
 	// diffuse shading
 	float diff = max(dot(vNormal, vLightDir), 0.0);
 	// specular shading
 	vec3 vReflectDir = reflect(-vLightDir, vNormal);
 	float spec = pow(max(dot(vViewDir, vReflectDir), 0.0), material.shininess);
 	// attenuation
-	float distance = length(pointLight.vPosition - vFragPos);
-	float attenuation = 1.0
-		/ (pointLight.constant + pointLight.linear * distance
-		   + pointLight.quadratic * (distance * distance));
+	float distance = length(pointPosition[light].xyz - vFragPos);
+	float attenuation = Attenuation(pointAttenuation[light], distance);
 	// combine results
-	vec3 ambient
-		= pointLight.ambient * vec3(texture(material.texture_diffuse0, texCoords));
-	vec3 diffuse = pointLight.diffuse * diff
+	vec3 diffuse = pointColour[light].rgb * diff
 		* vec3(texture(material.texture_diffuse0, texCoords));
-	vec3 specular = pointLight.specular * spec
+	vec3 specular = pointColour[light].rgb * spec
 		* vec3(texture(material.texture_specular0, texCoords));
-	ambient *= attenuation;
-	diffuse *= attenuation;
-	specular *= attenuation;
-	return (ambient + diffuse + specular);
+	int shadow = int(pointColour[light].w);
+	if (shadow >= 0)
+	{
+		attenuation *= 1.0 - PointShadow(shadow, vFragPos);
+	}
+	return (diffuse + specular) * attenuation;
 }
 
-vec3 CalcSpotLight(SpotLight spotLight, vec3 vNormal, vec3 vFragPos,
-				   vec3 vViewDir)
+vec3 CalcSpotLight(int light, vec3 vNormal, vec3 vFragPos, vec3 vViewDir)
 {
-	vec3 result;
-	float distance = length(spotLight.vPosition - vFragPos);
-	float attenuation = 1.0
-		/ (spotLight.constant + spotLight.linear * distance
-		   + spotLight.quadratic * (distance * distance));
+	vec3 vLightDirN = normalize(spotPosition[light].xyz - vFragPos);
+	float theta = dot(vLightDirN, normalize(-spotDirection[light].xyz));
+	float outerCutOff = spotDirection[light].w;
+	if (theta <= outerCutOff)
+	{
+		return vec3(0.0);
+	}
+	float distance = length(spotPosition[light].xyz - vFragPos);
+	float attenuation = Attenuation(spotAttenuation[light], distance);
 
-	vec3 ambient
-		= spotLight.ambient * vec3(texture(material.texture_diffuse0, texCoords));
+	// Diffuse
+	float diff = max(dot(vNormal, vLightDirN), 0.0);
+	vec3 diffuse = spotColour[light].rgb * diff
+		* vec3(texture(material.texture_diffuse0, texCoords));
+
+	// Specular
+	vec3 reflectDirN = reflect(-vLightDirN, vNormal);
+	float spec = pow(max(dot(vViewDir, reflectDirN), 0.0), material.shininess);
+	vec3 specular = spotColour[light].rgb * spec
+		* vec3(texture(material.texture_specular0, texCoords));
 
-	vec3 vLightDirN = normalize(spotLight.vPosition - vFragPos);
-	float theta = dot(vLightDirN, normalize(-spotLight.vDirection));
-	if (theta > spotLight.outerCutOff)
+	// Rim fade
+	float epsilon = spotPosition[light].w - outerCutOff;
+	float intensity = clamp((theta - outerCutOff) / epsilon, 0.0, 1.0);
+	int shadow = int(spotColour[light].w);
+	if (shadow >= 0)
 	{
-		// Diffuse
-		vec3 vNormalN = normalize(vNormal);
-		float diff = max(dot(vNormalN, vLightDirN), 0.0);
-		vec3 diffuse = spotLight.diffuse * diff * vec3(texture(material.texture_diffuse0, texCoords));
-
-		// Specular
-		vec3 vViewDirN = normalize(-vFragPos);
-		vec3 reflectDirN = reflect(-vLightDirN, vNormalN);
-		float spec
-			= pow(max(dot(vViewDirN, reflectDirN), 0.0), material.shininess);
-		vec3 specular = spotLight.specular * spec
-			* vec3(texture(material.texture_specular0, texCoords));
-
-		// Rim fade
-		float epsilon = spotLight.innerCutOff - spotLight.outerCutOff;
-		float intensity
-			= clamp((theta - spotLight.outerCutOff) / epsilon, 0.0, 1.0);
-
-		ambient *= attenuation;
-		diffuse *= attenuation * intensity;
-		specular *= attenuation * intensity;
-
-		result = ambient + diffuse + specular;
+		intensity *= 1.0 - AtlasShadow(spotShadowMatrices[shadow],
+									   viewToWorld * vec4(vFragPos, 1.0));
+	}
+
+	return (diffuse + specular) * attenuation * intensity;
+}
+
+float Attenuation(vec4 attenuation, float distance)
+{
+	return 1.0
+		/ (attenuation.x + attenuation.y * distance
+		   + attenuation.z * (distance * distance));
+}
+
+// Fraction of the directional light that's blocked, 3x3 PCF on top of the
+// hardware's 2x2
+float DirShadow(vec3 vFragPos)
+{
+	float depth = -vFragPos.z;
+	// beyond the last cascade nothing is shadowed
+	int cascade = int(dot(vec4(lessThan(cascadeSplits, vec4(depth))),
+						  vec4(1.0)));
+	if (cascade >= CSM_CASCADES)
+	{
+		return 0.0;
+	}
+	vec4 coords = cascadeMatrices[cascade] * vec4(vFragPos, 1.0);
+	vec2 texel = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+	float lit = 0.0;
+	for (int x = -1; x <= 1; x++)
+	{
+		for (int y = -1; y <= 1; y++)
+		{
+			lit += texture(shadowMap,
+						   vec4(coords.xy + vec2(x, y) * texel, float(cascade),
+								coords.z));
+		}
+	}
+	return 1.0 - lit / 9.0;
+}
+
+// Fraction of a point light that's blocked, from the cube face the fragment
+// is on
+float PointShadow(int shadow, vec3 vFragPos)
+{
+	vec4 worldPos = viewToWorld * vec4(vFragPos, 1.0);
+	vec3 d = worldPos.xyz - pointShadowPositions[shadow].xyz;
+	vec3 a = abs(d);
+	int face;
+	if (a.x >= a.y && a.x >= a.z)
+	{
+		face = d.x > 0.0 ? 0 : 1;
+	}
+	else if (a.y >= a.z)
+	{
+		face = d.y > 0.0 ? 2 : 3;
 	}
 	else
 	{
-		result = ambient * attenuation;
+		face = d.z > 0.0 ? 4 : 5;
 	}
-	return result;
+	return AtlasShadow(pointShadowMatrices[shadow * 6 + face], worldPos);
+}
+
+// Fraction blocked in one atlas tile, with the hardware's 2x2 PCF. Tiles
+// have a cleared border, so the filter doesn't reach into the neighbours.
+float AtlasShadow(mat4 shadowMatrix, vec4 worldPos)
+{
+	vec4 coords = shadowMatrix * worldPos;
+	return 1.0 - texture(shadowAtlas, coords.xyz / coords.w);
 }
\ No newline at end of file
@@ -8,14 +8,18 @@ out vec3 vNormal;
 out vec3 vFragPos;
 out vec2 texCoords;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// written per draw by the render queue, see transforms.h
+layout (std140) uniform PerDraw
+{
+	mat4 mvp;
+	mat4 modelView;
+	mat3 normalMatrix;
+};
 
 void main()
 {
-	gl_Position = projection * view * model * vec4(mPos, 1.0); // clip space
-	vFragPos = vec3(view * model * vec4(mPos, 1.0)); // view space
-	vNormal = mat3(transpose(inverse(view * model))) * mNormal; // #HACK expensive
+	gl_Position = mvp * vec4(mPos, 1.0); // clip space
+	vFragPos = vec3(modelView * vec4(mPos, 1.0)); // view space
+	vNormal = normalMatrix * mNormal;
 	texCoords = aTexCoords;
 }
\ No newline at end of file
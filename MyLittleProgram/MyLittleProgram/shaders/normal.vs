@@ -4,12 +4,16 @@ layout (location = 1) in vec2 aTexCoords;
 
 out vec2 TexCoords;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// written per draw by the render queue, see transforms.h
+layout (std140) uniform PerDraw
+{
+    mat4 mvp;
+    mat4 modelView;
+    mat3 normalMatrix;
+};
 
 void main()
 {
     TexCoords = aTexCoords;    
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    gl_Position = mvp * vec4(aPos, 1.0);
 }
\ No newline at end of file
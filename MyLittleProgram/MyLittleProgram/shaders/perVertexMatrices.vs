@@ -0,0 +1,22 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+
+// deferredGeometry.vs with every matrix built per vertex, the way
+// lighting3.vs used to, for BenchmarkPerDrawMatrices in transforms.h
+out vec3 vFragPos;
+out vec3 vNormal;
+out vec2 TexCoords;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    vFragPos = vec3(view * model * vec4(aPos, 1.0));
+    vNormal = mat3(transpose(inverse(view * model))) * aNormal;
+    TexCoords = aTexCoords;
+}
\ No newline at end of file
@@ -0,0 +1,24 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D screenTexture;
+uniform float strength;
+// top right of the sub-rect being processed, the rest of the texture is stale
+uniform vec2 uvMax;
+
+// 3x3 sharpen kernel: the centre minus the average of its four neighbours,
+// scaled by strength
+void main()
+{
+    vec2 texel = 1.0 / vec2(textureSize(screenTexture, 0));
+    vec2 edge = uvMax - 0.5 * texel;
+    vec3 centre = texture(screenTexture, TexCoords).rgb;
+    vec3 neighbours = texture(screenTexture, min(TexCoords + vec2(texel.x, 0.0), edge)).rgb
+                    + texture(screenTexture, TexCoords - vec2(texel.x, 0.0)).rgb
+                    + texture(screenTexture, min(TexCoords + vec2(0.0, texel.y), edge)).rgb
+                    + texture(screenTexture, TexCoords - vec2(0.0, texel.y)).rgb;
+    vec3 colour = centre + strength * (centre - 0.25 * neighbours);
+    FragColor = vec4(clamp(colour, 0.0, 1.0), 1.0);
+}
\ No newline at end of file
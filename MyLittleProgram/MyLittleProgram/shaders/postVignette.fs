@@ -0,0 +1,17 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+in vec2 ScreenCoords;
+
+uniform sampler2D screenTexture;
+uniform float radius;    // where the darkening starts, 0.5 is the edge centres
+uniform float softness;
+
+void main()
+{
+    vec3 colour = texture(screenTexture, TexCoords).rgb;
+    float d = length(ScreenCoords - vec2(0.5));
+    colour *= 1.0 - smoothstep(radius, radius + softness, d);
+    FragColor = vec4(colour, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,6 @@
+#version 330 core
+// occlusion query proxy, only the depth test matters
+
+void main()
+{
+}
\ No newline at end of file
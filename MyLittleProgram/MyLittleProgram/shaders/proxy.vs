@@ -0,0 +1,11 @@
+#version 330 core
+layout (location = 0) in vec3 aPos; // unit cube corner
+
+uniform vec3 boxMin;
+uniform vec3 boxMax;
+uniform mat4 viewProj;
+
+void main()
+{
+    gl_Position = viewProj * vec4(mix(boxMin, boxMax, aPos), 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,13 @@
+#version 330 core
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out float Selection; // outline mask
+
+in vec2 TexCoords;
+
+uniform sampler2D texture1;
+
+void main()
+{
+    FragColor = texture(texture1, TexCoords);
+    Selection = 1.0;
+}
\ No newline at end of file
@@ -0,0 +1,36 @@
+#version 410 core
+// All six faces of a point light's shadow in one pass, one invocation per
+// face, each going to its own atlas tile through gl_ViewportIndex. The render
+// queue's camera is the identity, so gl_Position comes in world space.
+layout (triangles, invocations = 6) in;
+layout (triangle_strip, max_vertices = 3) out;
+
+// world to clip space per cube face
+uniform mat4 faceMatrices[6];
+
+void main()
+{
+	vec4 p[3];
+	for (int i = 0; i < 3; i++)
+	{
+		p[i] = faceMatrices[gl_InvocationID] * gl_in[i].gl_Position;
+	}
+	// skip faces the triangle is wholly outside of
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if ((p[0][axis] < -p[0].w && p[1][axis] < -p[1].w
+			 && p[2][axis] < -p[2].w)
+			|| (p[0][axis] > p[0].w && p[1][axis] > p[1].w
+				&& p[2][axis] > p[2].w))
+		{
+			return;
+		}
+	}
+	for (int i = 0; i < 3; i++)
+	{
+		gl_Position = p[i];
+		gl_ViewportIndex = gl_InvocationID;
+		EmitVertex();
+	}
+	EndPrimitive();
+}
\ No newline at end of file
@@ -0,0 +1,16 @@
+#version 330 core
+// position only, see Mesh::DepthVAO
+layout (location = 0) in vec3 aPos;
+
+// written per draw by the render queue, see transforms.h
+layout (std140) uniform PerDraw
+{
+    mat4 mvp;
+    mat4 modelView;
+    mat3 normalMatrix;
+};
+
+void main()
+{
+    gl_Position = mvp * vec4(aPos, 1.0);
+}
\ No newline at end of file
@@ -1,11 +1,11 @@
 #version 330 core
 out vec4 FragColor;
 
-in vec3 TexCoords;
+in vec4 Direction;
 
 uniform samplerCube skybox;
 
 void main()
 {
-	FragColor = texture(skybox, TexCoords);
+	FragColor = texture(skybox, Direction.xyz / Direction.w);
 }
\ No newline at end of file
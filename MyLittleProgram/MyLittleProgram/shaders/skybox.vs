@@ -1,14 +1,15 @@
 #version 330 core
-layout (location = 0) in vec3 aPos;
+// Full screen triangle on the far plane, see fullScreenTriangle.vs
 
-out vec3 TexCoords;
+out vec4 Direction;
 
-uniform mat4 view;
-uniform mat4 projection;
+// inverse of projection * view without the view's translation
+uniform mat4 invViewProj;
 
 void main()
 {
-	gl_Position = projection * view * vec4(aPos, 1.0);
-	gl_Position.z = gl_Position.w; // force depth to 1.0
-	TexCoords = aPos;
+	vec2 pos = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2) * 2.0 - 1.0;
+	gl_Position = vec4(pos, 1.0, 1.0); // depth 1.0
+	// homogeneous, divided per fragment
+	Direction = invViewProj * gl_Position;
 }
\ No newline at end of file
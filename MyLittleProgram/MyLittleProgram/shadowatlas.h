@@ -0,0 +1,774 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <iostream>
+#include <cmath>
+
+#include "shader.h"
+#include "lights.h"
+#include "bounds.h"
+#include "ringbuffer.h"
+#include "shadows.h"
+#include "types.h"
+
+// Width and height of the atlas texture
+const u32 SHADOW_ATLAS_SIZE = 4096;
+// Tile sizes, powers of two. Point lights get six tiles of up to
+// SHADOW_CUBE_TILE_MAX, one per cube face.
+const u32 SHADOW_TILE_MIN = 64;
+const u32 SHADOW_TILE_MAX = 1024;
+const u32 SHADOW_CUBE_TILE_MAX = 512;
+// Lights that can have a shadow at once, as in lighting3.fs
+const u32 MAX_SHADOWED_POINT_LIGHTS = 16;
+const u32 MAX_SHADOWED_SPOT_LIGHTS = 16;
+// Tiles redrawn per frame, a point light counts six
+const u32 SHADOW_TILES_PER_FRAME = 12;
+// Uniform buffer binding of the Shadows block
+const u32 SHADOWS_UBO_BINDING = 2;
+// Near plane of the lights' shadow projections
+const float SHADOW_NEAR = 0.05f;
+
+// std140 layout of lighting3.fs's Shadows block. Matrices take world space
+// to atlas coordinates and depth.
+struct ShadowBlock
+{
+	glm::mat4 viewToWorld;
+	// six per light, +x -x +y -y +z -z
+	glm::mat4 pointMatrices[MAX_SHADOWED_POINT_LIGHTS * 6];
+	glm::mat4 spotMatrices[MAX_SHADOWED_SPOT_LIGHTS];
+	// world space, to pick the cube face
+	glm::vec4 pointPositions[MAX_SHADOWED_POINT_LIGHTS];
+};
+
+// Shadows for point and spot lights, all in tiles of one depth texture.
+//
+// The lights covering the most of the screen get a shadow slot. Each one's
+// tile size follows its projected size, in powers of two from a quadtree
+// allocator, and only changes when the size is off by more than a factor of
+// two. A slot's tiles are redrawn when its light moves, a caster near it is
+// invalidated or its size changes, otherwise they're reused.
+//
+// Redraws are time sliced: at most SHADOW_TILES_PER_FRAME tiles a frame,
+// lights without a shadow yet first, then by screen coverage times the
+// frames they've waited. A resized light keeps its old tiles until the new
+// ones are drawn, so shadows never blink out, they just lag.
+//
+// Where viewport arrays are supported (GL 4.1) a point light's six faces
+// are drawn in one pass through shadowCube.gs, otherwise one pass a face.
+class ShadowAtlas
+{
+public:
+	// Called to draw the shadow casters position-only with shader (see
+	// Mesh::DepthVAO), which has the PerDraw block, using view and
+	// projection for the render queue's camera. The viewport is set.
+	using DrawCasters
+		= std::function<void(Shader &shader, const glm::mat4 &view,
+							 const glm::mat4 &projection)>;
+
+	explicit ShadowAtlas(u32 size = SHADOW_ATLAS_SIZE,
+						 u32 tilesPerFrame = SHADOW_TILES_PER_FRAME);
+	~ShadowAtlas();
+	ShadowAtlas(const ShadowAtlas &) = delete;
+	ShadowAtlas &operator=(const ShadowAtlas &) = delete;
+
+	// Pick the shadowed lights for this view, redraw the tiles due and write
+	// the Shadows block. Sets each light's shadow slot, so hand them to the
+	// LightManager afterwards. Leaves the default framebuffer bound.
+	// Returns the number of tiles drawn.
+	u32 Update(const glm::mat4 &view, float fovY, u32 viewportHeight,
+			   std::vector<PointLight> &points, std::vector<SpotLight> &spots,
+			   const DrawCasters &drawCasters);
+	// A caster in worldBounds moved, appeared or went away. Call with both
+	// the old and the new bounds of a moving caster.
+	void Invalidate(const Bounds &worldBounds);
+	// Bind the atlas to unit and set lighting3.fs's sampler
+	void Bind(Shader &shader, u32 unit) const;
+	// After the draws using the Shadows block
+	void EndFrame();
+
+	// With caching off every shadowed light is redrawn every frame, without
+	// a tile budget
+	void SetCaching(bool enabled) { m_caching = enabled; }
+	// Off draws cube faces a pass each even where the layered pass works
+	void SetLayered(bool enabled) { m_layered = enabled && m_cubeShader; }
+	bool Layered() const { return m_layered; }
+	TXO Texture() const { return m_texture; }
+
+private:
+	struct Slot
+	{
+		// index into the point or spot lights, -1 when free
+		int light = -1;
+		// projected diameter in pixels
+		float coverage = 0.0f;
+		// tile size, 0 when the slot has no tiles yet
+		u32 size = 0;
+		u32 wantedSize = 0;
+		glm::uvec2 tiles[6];
+		glm::mat4 matrices[6];
+		// the light as drawn
+		glm::vec3 position;
+		glm::vec3 direction;
+		float radius = 0.0f;
+		float outerCutOff = 0.0f;
+		bool valid = false;
+		bool dirty = false;
+		// frames since it was due a redraw
+		u32 waiting = 0;
+	};
+
+	// Give the lights covering the most screen slots, free the others
+	void AssignSlots(std::vector<Slot> &slots,
+					 const std::vector<float> &coverage);
+	void UpdateSlot(Slot &slot, u32 maxSize,
+					const glm::vec3 &position, const glm::vec3 &direction,
+					float radius, float outerCutOff);
+	void RenderSlot(Slot &slot, bool point, const DrawCasters &drawCasters);
+	u32 TileSize(float coverage, u32 maxSize) const;
+
+	// quadtree allocation of square power of two tiles
+	bool AllocateTile(u32 size, glm::uvec2 &tile);
+	void FreeTile(u32 size, const glm::uvec2 &tile);
+	void FreeSlot(Slot &slot, u32 faceCount);
+	u32 Level(u32 size) const;
+
+	u32 m_size;
+	u32 m_tilesPerFrame;
+	TXO m_texture;
+	u32 m_framebuffer;
+	Shader m_depthShader;
+	std::unique_ptr<Shader> m_cubeShader;
+	bool m_layered;
+	bool m_caching;
+	// free tiles per level, level 0 is the whole atlas
+	std::vector<std::vector<glm::uvec2>> m_free;
+	std::vector<Slot> m_points;
+	std::vector<Slot> m_spots;
+	u32 m_alignment;
+	RingBuffer m_buffer;
+};
+
+ShadowAtlas::ShadowAtlas(u32 size, u32 tilesPerFrame)
+	: m_size(size)
+	, m_tilesPerFrame(tilesPerFrame)
+	, m_depthShader("shaders/shadowDepth.vs", "shaders/shadowDepth.fs")
+	, m_layered(false)
+	, m_caching(true)
+	, m_points(MAX_SHADOWED_POINT_LIGHTS)
+	, m_spots(MAX_SHADOWED_SPOT_LIGHTS)
+	, m_alignment(UniformBufferAlignment())
+	, m_buffer(GL_UNIFORM_BUFFER,
+			   (sizeof(ShadowBlock) + m_alignment - 1) / m_alignment
+				   * m_alignment)
+{
+	glGenTextures(1, &m_texture);
+	glBindTexture(GL_TEXTURE_2D, m_texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, size, size, 0,
+				 GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+	// hardware 2x2 PCF through sampler2DShadow, tiles have a one texel
+	// border so it doesn't pick up the neighbours
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE,
+					GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenFramebuffers(1, &m_framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D,
+						   m_texture, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "ERROR::SHADOW_ATLAS::FRAMEBUFFER_NOT_COMPLETE"
+				  << std::endl;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	m_depthShader.bindUniformBlock("PerDraw", PER_DRAW_UBO_BINDING);
+	// gl_ViewportIndex and geometry shader invocations
+	if (GLAD_GL_VERSION_4_1)
+	{
+		m_cubeShader.reset(new Shader("shaders/shadowDepth.vs",
+									  "shaders/shadowCube.gs",
+									  "shaders/shadowDepth.fs"));
+		m_cubeShader->bindUniformBlock("PerDraw", PER_DRAW_UBO_BINDING);
+		m_layered = true;
+	}
+
+	m_free.resize(Level(SHADOW_TILE_MIN) + 1);
+	m_free[0].push_back(glm::uvec2(0, 0));
+}
+
+ShadowAtlas::~ShadowAtlas()
+{
+	glDeleteFramebuffers(1, &m_framebuffer);
+	glDeleteTextures(1, &m_texture);
+	glDeleteProgram(m_depthShader.m_programId);
+	if (m_cubeShader) glDeleteProgram(m_cubeShader->m_programId);
+}
+
+u32 ShadowAtlas::Level(u32 size) const
+{
+	u32 level = 0;
+	while ((m_size >> level) > size)
+	{
+		level++;
+	}
+	return level;
+}
+
+bool ShadowAtlas::AllocateTile(u32 size, glm::uvec2 &tile)
+{
+	const u32 level = Level(size);
+	// smallest free tile that's big enough
+	int from = (int)level;
+	while (from >= 0 && m_free[from].empty())
+	{
+		from--;
+	}
+	if (from < 0) return false;
+	tile = m_free[from].back();
+	m_free[from].pop_back();
+	// split it down, keeping the first quarter each time
+	for (u32 l = from + 1; l <= level; l++)
+	{
+		const u32 half = m_size >> l;
+		m_free[l].push_back(tile + glm::uvec2(half, 0));
+		m_free[l].push_back(tile + glm::uvec2(0, half));
+		m_free[l].push_back(tile + glm::uvec2(half, half));
+	}
+	return true;
+}
+
+void ShadowAtlas::FreeTile(u32 size, const glm::uvec2 &tile)
+{
+	u32 level = Level(size);
+	glm::uvec2 freed = tile;
+	// merge with the other three quarters while they're all free
+	while (level > 0)
+	{
+		const u32 parentSize = m_size >> (level - 1);
+		const glm::uvec2 parent = freed / parentSize * parentSize;
+		std::vector<glm::uvec2> &list = m_free[level];
+		u32 siblings = 0;
+		for (const glm::uvec2 &t : list)
+		{
+			if (t != freed && t / parentSize * parentSize == parent) siblings++;
+		}
+		if (siblings < 3) break;
+		list.erase(std::remove_if(list.begin(), list.end(),
+								  [&](const glm::uvec2 &t) {
+									  return t / parentSize * parentSize
+										  == parent;
+								  }),
+				   list.end());
+		freed = parent;
+		level--;
+	}
+	m_free[level].push_back(freed);
+}
+
+void ShadowAtlas::FreeSlot(Slot &slot, u32 faceCount)
+{
+	if (slot.size > 0)
+	{
+		for (u32 f = 0; f < faceCount; f++)
+		{
+			FreeTile(slot.size, slot.tiles[f]);
+		}
+	}
+	slot = Slot();
+}
+
+u32 ShadowAtlas::TileSize(float coverage, u32 maxSize) const
+{
+	u32 size = SHADOW_TILE_MIN;
+	while (size < maxSize && (float)size < coverage)
+	{
+		size *= 2;
+	}
+	return size;
+}
+
+void ShadowAtlas::AssignSlots(std::vector<Slot> &slots,
+							  const std::vector<float> &coverage)
+{
+	const u32 lightCount = (u32)coverage.size();
+	std::vector<u32> order(lightCount);
+	for (u32 i = 0; i < lightCount; i++)
+	{
+		order[i] = i;
+	}
+	const u32 shadowed = std::min(lightCount, (u32)slots.size());
+	std::partial_sort(order.begin(), order.begin() + shadowed, order.end(),
+					  [&](u32 a, u32 b) { return coverage[a] > coverage[b]; });
+	std::vector<char> chosen(lightCount, 0);
+	for (u32 i = 0; i < shadowed; i++)
+	{
+		chosen[order[i]] = 1;
+	}
+
+	const u32 faceCount = &slots == &m_points ? 6 : 1;
+	for (Slot &slot : slots)
+	{
+		if (slot.light < 0) continue;
+		if (slot.light >= (int)lightCount || !chosen[slot.light])
+		{
+			FreeSlot(slot, faceCount);
+		}
+		else
+		{
+			// already has one
+			chosen[slot.light] = 0;
+		}
+	}
+	u32 next = 0;
+	for (u32 i = 0; i < shadowed; i++)
+	{
+		if (!chosen[order[i]]) continue;
+		while (slots[next].light >= 0)
+		{
+			next++;
+		}
+		slots[next].light = (int)order[i];
+	}
+	for (Slot &slot : slots)
+	{
+		if (slot.light >= 0) slot.coverage = coverage[slot.light];
+	}
+}
+
+void ShadowAtlas::UpdateSlot(Slot &slot, u32 maxSize,
+							 const glm::vec3 &position,
+							 const glm::vec3 &direction, float radius,
+							 float outerCutOff)
+{
+	const u32 wanted = TileSize(slot.coverage, maxSize);
+	// only resize when it's off by more than a factor of two either way
+	if (slot.size == 0 || wanted > slot.size || wanted * 2 < slot.size)
+	{
+		slot.wantedSize = wanted;
+	}
+	else
+	{
+		slot.wantedSize = slot.size;
+	}
+	if (position != slot.position || direction != slot.direction
+		|| radius != slot.radius || outerCutOff != slot.outerCutOff)
+	{
+		slot.dirty = true;
+	}
+	slot.position = position;
+	slot.direction = direction;
+	slot.radius = radius;
+	slot.outerCutOff = outerCutOff;
+}
+
+void ShadowAtlas::RenderSlot(Slot &slot, bool point,
+							 const DrawCasters &drawCasters)
+{
+	const u32 faceCount = point ? 6 : 1;
+	// new tiles first, the old ones stay in use if there's no room
+	if (slot.wantedSize != slot.size)
+	{
+		glm::uvec2 tiles[6];
+		u32 size = slot.wantedSize;
+		u32 allocated = 0;
+		while (size >= SHADOW_TILE_MIN && allocated < faceCount)
+		{
+			for (allocated = 0; allocated < faceCount; allocated++)
+			{
+				if (!AllocateTile(size, tiles[allocated])) break;
+			}
+			if (allocated < faceCount)
+			{
+				for (u32 f = 0; f < allocated; f++)
+				{
+					FreeTile(size, tiles[f]);
+				}
+				size /= 2;
+				// smaller is only worth it over having none
+				if (slot.size > 0) break;
+			}
+		}
+		if (allocated == faceCount)
+		{
+			if (slot.size > 0)
+			{
+				for (u32 f = 0; f < faceCount; f++)
+				{
+					FreeTile(slot.size, slot.tiles[f]);
+				}
+			}
+			slot.size = size;
+			for (u32 f = 0; f < faceCount; f++)
+			{
+				slot.tiles[f] = tiles[f];
+			}
+		}
+		if (slot.size == 0) return;
+	}
+
+	// cube faces as in the GL cube map convention
+	static const glm::vec3 faceDirections[6]
+		= { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 },
+			{ 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+	static const glm::vec3 faceUps[6]
+		= { { 0, -1, 0 }, { 0, -1, 0 }, { 0, 0, 1 },
+			{ 0, 0, -1 }, { 0, -1, 0 }, { 0, -1, 0 } };
+	glm::mat4 views[6], projection;
+	if (point)
+	{
+		projection = glm::perspective(glm::radians(90.0f), 1.0f, SHADOW_NEAR,
+									  slot.radius);
+		for (u32 f = 0; f < 6; f++)
+		{
+			views[f] = glm::lookAt(slot.position,
+								   slot.position + faceDirections[f],
+								   faceUps[f]);
+		}
+	}
+	else
+	{
+		const float halfAngle = std::acos(glm::clamp(slot.outerCutOff, 0.1f,
+													  1.0f));
+		projection = glm::perspective(std::min(2.0f * halfAngle + 0.05f,
+											   glm::radians(170.0f)),
+									  1.0f, SHADOW_NEAR, slot.radius);
+		const glm::vec3 up = std::abs(slot.direction.y) > 0.99f
+			? glm::vec3(1.0f, 0.0f, 0.0f)
+			: glm::vec3(0.0f, 1.0f, 0.0f);
+		views[0] = glm::lookAt(slot.position, slot.position + slot.direction,
+							   up);
+	}
+
+	// clear whole tiles, draw inside a one texel border
+	glEnable(GL_SCISSOR_TEST);
+	for (u32 f = 0; f < faceCount; f++)
+	{
+		const glm::uvec2 &tile = slot.tiles[f];
+		glScissor(tile.x, tile.y, slot.size, slot.size);
+		glClear(GL_DEPTH_BUFFER_BIT);
+		// NDC to the inner part of the tile
+		const float inner = (float)(slot.size - 2) / m_size;
+		const glm::vec3 origin((tile.x + 1.0f) / m_size,
+							   (tile.y + 1.0f) / m_size, 0.0f);
+		const glm::mat4 toTile
+			= glm::translate(glm::mat4(),
+							 origin + glm::vec3(inner * 0.5f, inner * 0.5f,
+												0.5f))
+			* glm::scale(glm::mat4(), glm::vec3(inner * 0.5f, inner * 0.5f,
+												0.5f));
+		slot.matrices[f] = toTile * projection * views[f];
+	}
+	glDisable(GL_SCISSOR_TEST);
+
+	if (point && m_layered)
+	{
+		for (u32 f = 0; f < 6; f++)
+		{
+			glViewportIndexedf(f, slot.tiles[f].x + 1.0f,
+							   slot.tiles[f].y + 1.0f, slot.size - 2.0f,
+							   slot.size - 2.0f);
+		}
+		m_cubeShader->use();
+		for (u32 f = 0; f < 6; f++)
+		{
+			m_cubeShader->setMat4("faceMatrices[" + std::to_string(f) + "]",
+								  projection * views[f]);
+		}
+		// positions come out of the vertex shader in world space
+		drawCasters(*m_cubeShader, glm::mat4(), glm::mat4());
+	}
+	else
+	{
+		for (u32 f = 0; f < faceCount; f++)
+		{
+			glViewport(slot.tiles[f].x + 1, slot.tiles[f].y + 1,
+					   slot.size - 2, slot.size - 2);
+			drawCasters(m_depthShader, views[f], projection);
+		}
+	}
+	slot.valid = true;
+	slot.dirty = false;
+	slot.waiting = 0;
+}
+
+u32 ShadowAtlas::Update(const glm::mat4 &view, float fovY,
+						u32 viewportHeight, std::vector<PointLight> &points,
+						std::vector<SpotLight> &spots,
+						const DrawCasters &drawCasters)
+{
+	// projected diameter of each light's bounding sphere
+	const glm::mat4 invView = glm::inverse(view);
+	const glm::vec3 eye(invView[3]);
+	const float pixelsPerUnit = viewportHeight / (2.0f * std::tan(fovY * 0.5f));
+	auto coverage = [&](const glm::vec3 &centre, float radius) {
+		const float distance = glm::length(centre - eye);
+		if (distance <= radius) return 1.0e6f;
+		return 2.0f * radius * pixelsPerUnit / distance;
+	};
+	std::vector<float> pointCoverage(points.size());
+	for (size_t i = 0; i < points.size(); i++)
+	{
+		pointCoverage[i] = coverage(points[i].position,
+									PointLightRadius(points[i]));
+	}
+	std::vector<float> spotCoverage(spots.size());
+	for (size_t i = 0; i < spots.size(); i++)
+	{
+		const glm::vec4 bounds = SpotLightBounds(spots[i]);
+		spotCoverage[i] = coverage(glm::vec3(bounds), bounds.w);
+	}
+	AssignSlots(m_points, pointCoverage);
+	AssignSlots(m_spots, spotCoverage);
+
+	// what's due a redraw
+	struct Candidate
+	{
+		Slot *slot;
+		bool point;
+		float priority;
+	};
+	std::vector<Candidate> due;
+	for (Slot &slot : m_points)
+	{
+		if (slot.light < 0) continue;
+		const PointLight &light = points[slot.light];
+		UpdateSlot(slot, SHADOW_CUBE_TILE_MAX, light.position,
+				   glm::vec3(0.0f), PointLightRadius(light), 0.0f);
+	}
+	for (Slot &slot : m_spots)
+	{
+		if (slot.light < 0) continue;
+		const SpotLight &light = spots[slot.light];
+		UpdateSlot(slot, SHADOW_TILE_MAX, light.position,
+				   glm::normalize(light.direction),
+				   AttenuationRadius(light.colour, light.constant,
+									 light.linear, light.quadratic),
+				   light.outerCutOff);
+	}
+	for (u32 kind = 0; kind < 2; kind++)
+	{
+		for (Slot &slot : kind == 0 ? m_points : m_spots)
+		{
+			if (slot.light < 0) continue;
+			if (m_caching && slot.valid && !slot.dirty
+				&& slot.wantedSize == slot.size)
+			{
+				continue;
+			}
+			slot.waiting++;
+			// lights without any shadow go first
+			const float priority = slot.valid
+				? slot.coverage * slot.waiting
+				: 1.0e9f + slot.coverage;
+			due.push_back({ &slot, kind == 0, priority });
+		}
+	}
+	std::sort(due.begin(), due.end(),
+			  [](const Candidate &a, const Candidate &b) {
+				  return a.priority > b.priority;
+			  });
+
+	u32 tilesDrawn = 0;
+	bool bound = false;
+	for (const Candidate &candidate : due)
+	{
+		const u32 faceCount = candidate.point ? 6 : 1;
+		// always make some progress, even on a light over budget
+		if (m_caching && tilesDrawn > 0
+			&& tilesDrawn + faceCount > m_tilesPerFrame)
+		{
+			continue;
+		}
+		if (!bound)
+		{
+			glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+			glEnable(GL_DEPTH_TEST);
+			glDepthFunc(GL_LESS);
+			glDepthMask(GL_TRUE);
+			glEnable(GL_POLYGON_OFFSET_FILL);
+			glPolygonOffset(2.0f, 4.0f);
+			bound = true;
+		}
+		RenderSlot(*candidate.slot, candidate.point, drawCasters);
+		if (candidate.slot->valid) tilesDrawn += faceCount;
+	}
+	if (bound)
+	{
+		glDisable(GL_POLYGON_OFFSET_FILL);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	// hand out the slots and write the block
+	for (PointLight &light : points)
+	{
+		light.shadow = -1;
+	}
+	for (SpotLight &light : spots)
+	{
+		light.shadow = -1;
+	}
+	m_buffer.BeginFrame();
+	u32 offset;
+	ShadowBlock *block = (ShadowBlock *)m_buffer.Allocate(sizeof(ShadowBlock),
+														   m_alignment, offset);
+	block->viewToWorld = invView;
+	for (u32 s = 0; s < MAX_SHADOWED_POINT_LIGHTS; s++)
+	{
+		const Slot &slot = m_points[s];
+		if (slot.light < 0 || !slot.valid) continue;
+		points[slot.light].shadow = (int)s;
+		for (u32 f = 0; f < 6; f++)
+		{
+			block->pointMatrices[s * 6 + f] = slot.matrices[f];
+		}
+		block->pointPositions[s] = glm::vec4(slot.position, 1.0f);
+	}
+	for (u32 s = 0; s < MAX_SHADOWED_SPOT_LIGHTS; s++)
+	{
+		const Slot &slot = m_spots[s];
+		if (slot.light < 0 || !slot.valid) continue;
+		spots[slot.light].shadow = (int)s;
+		block->spotMatrices[s] = slot.matrices[0];
+	}
+	m_buffer.Flush();
+	glBindBufferRange(GL_UNIFORM_BUFFER, SHADOWS_UBO_BINDING,
+					  m_buffer.Buffer(), offset, sizeof(ShadowBlock));
+	return tilesDrawn;
+}
+
+void ShadowAtlas::Invalidate(const Bounds &worldBounds)
+{
+	for (u32 kind = 0; kind < 2; kind++)
+	{
+		for (Slot &slot : kind == 0 ? m_points : m_spots)
+		{
+			if (slot.light < 0 || !slot.valid) continue;
+			// sphere against box
+			const glm::vec3 closest = glm::clamp(
+				slot.position, worldBounds.aabbMin, worldBounds.aabbMax);
+			const glm::vec3 d = closest - slot.position;
+			if (glm::dot(d, d) <= slot.radius * slot.radius)
+			{
+				slot.dirty = true;
+			}
+		}
+	}
+}
+
+void ShadowAtlas::Bind(Shader &shader, u32 unit) const
+{
+	glActiveTexture(GL_TEXTURE0 + unit);
+	glBindTexture(GL_TEXTURE_2D, m_texture);
+	glActiveTexture(GL_TEXTURE0);
+	shader.use();
+	shader.setInt("shadowAtlas", unit);
+}
+
+void ShadowAtlas::EndFrame()
+{
+	m_buffer.EndFrame();
+}
+
+// Cost of local light shadows over frameCount frames of a camera moving over
+// a field of walls lit by pointCount point and spotCount spot lights, two of
+// which move every frame. Redrawing every shadowed light every frame against
+// the time sliced, cached atlas, and where supported the layered cube pass
+// against a pass per face. Results go to stdout.
+void BenchmarkShadowAtlas(u32 pointCount = 48, u32 spotCount = 16,
+						  u32 frameCount = 60)
+{
+	using Clock = std::chrono::high_resolution_clock;
+	const u32 viewportHeight = 720;
+	const float fovY = glm::radians(45.0f);
+
+	ShadowBenchmarkScene scene(400);
+	const ShadowAtlas::DrawCasters drawCasters
+		= [&](Shader &shader, const glm::mat4 &view,
+			  const glm::mat4 &projection) {
+			  scene.Draw(shader, view, projection);
+		  };
+
+	std::mt19937 rng(5);
+	const float extent = scene.Extent();
+	std::uniform_real_distribution<float> across(-extent, extent);
+	std::vector<PointLight> startPoints(pointCount);
+	for (PointLight &light : startPoints)
+	{
+		light.position = glm::vec3(across(rng), 3.0f, across(rng));
+		light.colour = glm::vec3(1.0f);
+	}
+	std::vector<SpotLight> startSpots(spotCount);
+	for (SpotLight &light : startSpots)
+	{
+		light.position = glm::vec3(across(rng), 6.0f, across(rng));
+		light.direction = glm::vec3(0.2f, -1.0f, 0.1f);
+		light.colour = glm::vec3(1.0f);
+	}
+
+	struct Mode
+	{
+		const char *name;
+		bool caching;
+		bool layered;
+	};
+	std::vector<Mode> modes = { { "every frame", false, false },
+								{ "time sliced", true, false } };
+	if (GLAD_GL_VERSION_4_1)
+	{
+		modes.push_back({ "every frame, layered", false, true });
+		modes.push_back({ "time sliced, layered", true, true });
+	}
+	std::cout << "shadow atlas		ms/frame	worst ms	tiles drawn/frame"
+			  << std::endl;
+	for (const Mode &mode : modes)
+	{
+		ShadowAtlas atlas;
+		atlas.SetCaching(mode.caching);
+		atlas.SetLayered(mode.layered);
+		std::vector<PointLight> points = startPoints;
+		std::vector<SpotLight> spots = startSpots;
+		u32 tilesDrawn = 0;
+		double totalMs = 0.0, worstMs = 0.0;
+		for (u32 frame = 0; frame < frameCount; frame++)
+		{
+			const glm::vec3 eye(frame * 0.1f - 3.0f, 8.0f, 20.0f);
+			const glm::mat4 view = glm::lookAt(
+				eye, eye + glm::vec3(0.0f, -0.5f, -1.0f),
+				glm::vec3(0.0f, 1.0f, 0.0f));
+			points[0].position.x += 0.05f;
+			spots[0].position.z += 0.05f;
+			glFinish();
+			Clock::time_point start = Clock::now();
+			tilesDrawn += atlas.Update(view, fovY, viewportHeight, points,
+									   spots, drawCasters);
+			glFinish();
+			const double ms = std::chrono::duration<double, std::milli>(
+								  Clock::now() - start)
+								  .count();
+			atlas.EndFrame();
+			// the first frame draws everything either way
+			if (frame == 0) continue;
+			totalMs += ms;
+			worstMs = std::max(worstMs, ms);
+		}
+		std::cout << mode.name << "\t" << totalMs / (frameCount - 1) << "\t\t"
+				  << worstMs << "\t\t" << (float)tilesDrawn / frameCount
+				  << std::endl;
+	}
+}
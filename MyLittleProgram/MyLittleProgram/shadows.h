@@ -0,0 +1,467 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <vector>
+#include <functional>
+#include <chrono>
+#include <random>
+#include <iostream>
+#include <cmath>
+
+#include "shader.h"
+#include "mesh.h"
+#include "bounds.h"
+#include "renderqueue.h"
+#include "bvh.h"
+#include "types.h"
+
+// Cascades, as in lighting3.fs
+const u32 CSM_CASCADES = 4;
+const u32 CSM_RESOLUTION = 2048;
+// Shadows end this far from the camera, or at the far plane if closer
+const float CSM_MAX_DISTANCE = 100.0f;
+// Blend between logarithmic (1) and uniform (0) cascade splits
+const float CSM_SPLIT_LAMBDA = 0.75f;
+// How far towards the light casters outside a cascade's box are picked up
+const float CSM_CASTER_DISTANCE = 100.0f;
+
+// Cascaded shadow maps for the directional light, one layer of a depth
+// texture array per cascade.
+//
+// Each cascade covers the bounding sphere of its slice of the view frustum,
+// which has the same size however the camera turns, and its position is
+// snapped to whole texels in light space. So a cascade's projection only
+// changes when the camera has moved a texel, and shadow edges don't crawl.
+//
+// The cascades are cached: one is only redrawn when its projection changes
+// or a caster inside it has been invalidated. With a still or slowly moving
+// camera and a static scene most frames draw no shadow casters at all.
+class CascadedShadows
+{
+public:
+	explicit CascadedShadows(u32 resolution = CSM_RESOLUTION);
+	~CascadedShadows();
+	CascadedShadows(const CascadedShadows &) = delete;
+	CascadedShadows &operator=(const CascadedShadows &) = delete;
+
+	// Fit the cascades to the camera, once a frame before Render
+	void SetCamera(const glm::mat4 &view, float fovY, float aspect,
+				   float zNear, float zFar);
+	// World space direction the light shines in, redraws everything if it
+	// changed
+	void SetLightDirection(const glm::vec3 &direction);
+	// A caster in worldBounds moved, appeared or went away. Call with both
+	// the old and the new bounds of a moving caster.
+	void Invalidate(const Bounds &worldBounds);
+	void InvalidateAll();
+	// With caching off every cascade is redrawn every frame
+	void SetCaching(bool enabled) { m_caching = enabled; }
+
+	// Redraw the cascades that need it. drawCasters is called once per
+	// cascade with the depth layer bound and should draw the casters
+	// position-only (shadowDepth.vs, Mesh::DepthVAO) with the light's
+	// matrices. Leaves the default framebuffer bound. Returns the number of
+	// cascades drawn.
+	u32 Render(const std::function<void(const glm::mat4 &lightView,
+										const glm::mat4 &lightProjection)>
+				   &drawCasters);
+
+	// Bind the shadow map to unit and set lighting3.fs's shadow uniforms
+	void Bind(Shader &shader, u32 unit) const;
+
+	TXO Texture() const { return m_texture; }
+	float SplitDistance(u32 cascade) const { return m_cascades[cascade].splitFar; }
+
+private:
+	struct Cascade
+	{
+		glm::mat4 lightProjection;
+		// light space centre, snapped to texels
+		glm::vec3 centre;
+		float radius;
+		float splitFar;
+		// the layer holds the casters for centre and radius
+		bool valid;
+		bool dirty;
+	};
+
+	void FitCascade(Cascade &cascade, float splitNear, float splitFar,
+					float tanX, float tanY) const;
+
+	u32 m_resolution;
+	TXO m_texture;
+	u32 m_framebuffer;
+	Cascade m_cascades[CSM_CASCADES];
+	glm::mat4 m_view;
+	glm::mat4 m_lightView;
+	glm::vec3 m_lightDirection;
+	bool m_caching;
+};
+
+CascadedShadows::CascadedShadows(u32 resolution)
+	: m_resolution(resolution)
+	, m_lightDirection(0.0f, -1.0f, 0.0f)
+	, m_caching(true)
+{
+	glGenTextures(1, &m_texture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, m_texture);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, resolution,
+				 resolution, CSM_CASCADES, 0, GL_DEPTH_COMPONENT, GL_FLOAT,
+				 NULL);
+	// hardware 2x2 PCF through sampler2DArrayShadow
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE,
+					GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	glGenFramebuffers(1, &m_framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_texture, 0,
+							  0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "ERROR::SHADOWS::FRAMEBUFFER_NOT_COMPLETE" << std::endl;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	for (Cascade &cascade : m_cascades)
+	{
+		cascade.radius = 0.0f;
+		cascade.splitFar = 0.0f;
+		cascade.valid = false;
+		cascade.dirty = true;
+	}
+	SetLightDirection(m_lightDirection);
+}
+
+CascadedShadows::~CascadedShadows()
+{
+	glDeleteFramebuffers(1, &m_framebuffer);
+	glDeleteTextures(1, &m_texture);
+}
+
+void CascadedShadows::SetLightDirection(const glm::vec3 &direction)
+{
+	const glm::vec3 d = glm::normalize(direction);
+	if (d == m_lightDirection && m_cascades[0].valid) return;
+	m_lightDirection = d;
+	const glm::vec3 up = std::abs(d.y) > 0.99f ? glm::vec3(1.0f, 0.0f, 0.0f)
+											   : glm::vec3(0.0f, 1.0f, 0.0f);
+	// rotation only, the cascades place themselves in light space
+	m_lightView = glm::lookAt(glm::vec3(0.0f), d, up);
+	InvalidateAll();
+}
+
+void CascadedShadows::InvalidateAll()
+{
+	for (Cascade &cascade : m_cascades)
+	{
+		cascade.valid = false;
+	}
+}
+
+void CascadedShadows::Invalidate(const Bounds &worldBounds)
+{
+	// the bounds' box in light space
+	glm::vec3 lsMin(1.0e30f), lsMax(-1.0e30f);
+	for (u32 c = 0; c < 8; c++)
+	{
+		glm::vec3 corner((c & 1) ? worldBounds.aabbMax.x : worldBounds.aabbMin.x,
+						 (c & 2) ? worldBounds.aabbMax.y : worldBounds.aabbMin.y,
+						 (c & 4) ? worldBounds.aabbMax.z : worldBounds.aabbMin.z);
+		glm::vec3 ls = glm::vec3(m_lightView * glm::vec4(corner, 1.0f));
+		lsMin = glm::min(lsMin, ls);
+		lsMax = glm::max(lsMax, ls);
+	}
+	for (Cascade &cascade : m_cascades)
+	{
+		if (!cascade.valid) continue;
+		// the cascade's box reaches CSM_CASTER_DISTANCE towards the light,
+		// which is +z in light space
+		const glm::vec3 boxMin = cascade.centre - glm::vec3(cascade.radius);
+		const glm::vec3 boxMax = cascade.centre
+			+ glm::vec3(cascade.radius, cascade.radius,
+						cascade.radius + CSM_CASTER_DISTANCE);
+		if (glm::all(glm::lessThanEqual(lsMin, boxMax))
+			&& glm::all(glm::lessThanEqual(boxMin, lsMax)))
+		{
+			cascade.dirty = true;
+		}
+	}
+}
+
+void CascadedShadows::FitCascade(Cascade &cascade, float splitNear,
+								 float splitFar, float tanX, float tanY) const
+{
+	// Smallest sphere around the slice, centred on the view axis. Its size
+	// only depends on the split, so turning the camera doesn't change it.
+	const float k2 = tanX * tanX + tanY * tanY;
+	const float nearR2 = k2 * splitNear * splitNear;
+	const float farR2 = k2 * splitFar * splitFar;
+	float centreDepth = (splitFar * splitFar - splitNear * splitNear + farR2
+						 - nearR2)
+		/ (2.0f * (splitFar - splitNear));
+	centreDepth = std::min(centreDepth, splitFar);
+	float radius = std::sqrt(farR2 + (splitFar - centreDepth)
+									   * (splitFar - centreDepth));
+	// rounded up so float noise can't change it
+	radius = std::ceil(radius * 16.0f) / 16.0f;
+
+	const glm::vec3 worldCentre
+		= glm::vec3(glm::inverse(m_view)
+					* glm::vec4(0.0f, 0.0f, -centreDepth, 1.0f));
+	const glm::vec3 lsCentre
+		= glm::vec3(m_lightView * glm::vec4(worldCentre, 1.0f));
+	const float texel = 2.0f * radius / m_resolution;
+	const glm::vec3 snapped = glm::floor(lsCentre / texel + 0.5f) * texel;
+
+	if (cascade.valid
+		&& (snapped != cascade.centre || radius != cascade.radius))
+	{
+		cascade.valid = false;
+	}
+	cascade.centre = snapped;
+	cascade.radius = radius;
+	cascade.splitFar = splitFar;
+	// light space looks down -z, the near plane is pulled back towards the
+	// light to catch casters outside the sphere
+	cascade.lightProjection
+		= glm::ortho(snapped.x - radius, snapped.x + radius,
+					 snapped.y - radius, snapped.y + radius,
+					 -snapped.z - radius - CSM_CASTER_DISTANCE,
+					 -snapped.z + radius);
+}
+
+void CascadedShadows::SetCamera(const glm::mat4 &view, float fovY,
+								float aspect, float zNear, float zFar)
+{
+	m_view = view;
+	const float tanY = std::tan(fovY * 0.5f);
+	const float tanX = tanY * aspect;
+	const float shadowFar = std::min(zFar, CSM_MAX_DISTANCE);
+	float splitNear = zNear;
+	for (u32 i = 0; i < CSM_CASCADES; i++)
+	{
+		const float t = (float)(i + 1) / CSM_CASCADES;
+		const float logSplit = zNear * std::pow(shadowFar / zNear, t);
+		const float uniformSplit = zNear + (shadowFar - zNear) * t;
+		const float splitFar = CSM_SPLIT_LAMBDA * logSplit
+			+ (1.0f - CSM_SPLIT_LAMBDA) * uniformSplit;
+		FitCascade(m_cascades[i], splitNear, splitFar, tanX, tanY);
+		splitNear = splitFar;
+	}
+}
+
+u32 CascadedShadows::Render(
+	const std::function<void(const glm::mat4 &lightView,
+							 const glm::mat4 &lightProjection)> &drawCasters)
+{
+	u32 drawn = 0;
+	for (u32 i = 0; i < CSM_CASCADES; i++)
+	{
+		Cascade &cascade = m_cascades[i];
+		if (m_caching && cascade.valid && !cascade.dirty) continue;
+		if (drawn == 0)
+		{
+			glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+			glViewport(0, 0, m_resolution, m_resolution);
+			glEnable(GL_DEPTH_TEST);
+			glDepthFunc(GL_LESS);
+			glDepthMask(GL_TRUE);
+			// slope scaled bias against acne
+			glEnable(GL_POLYGON_OFFSET_FILL);
+			glPolygonOffset(2.0f, 4.0f);
+		}
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+								  m_texture, 0, i);
+		glClear(GL_DEPTH_BUFFER_BIT);
+		drawCasters(m_lightView, cascade.lightProjection);
+		cascade.valid = true;
+		cascade.dirty = false;
+		drawn++;
+	}
+	if (drawn > 0)
+	{
+		glDisable(GL_POLYGON_OFFSET_FILL);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+	return drawn;
+}
+
+void CascadedShadows::Bind(Shader &shader, u32 unit) const
+{
+	glActiveTexture(GL_TEXTURE0 + unit);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, m_texture);
+	glActiveTexture(GL_TEXTURE0);
+	shader.use();
+	shader.setInt("shadowMap", unit);
+	// from the camera's view space, which the lighting is done in, to
+	// shadow map texture coordinates and depth
+	const glm::mat4 toTexture
+		= glm::translate(glm::mat4(), glm::vec3(0.5f))
+		* glm::scale(glm::mat4(), glm::vec3(0.5f));
+	const glm::mat4 invView = glm::inverse(m_view);
+	glm::vec4 splits;
+	for (u32 i = 0; i < CSM_CASCADES; i++)
+	{
+		const Cascade &cascade = m_cascades[i];
+		shader.setMat4("cascadeMatrices[" + std::to_string(i) + "]",
+					   toTexture * cascade.lightProjection * m_lightView
+						   * invView);
+		splits[i] = cascade.splitFar;
+	}
+	shader.setVec4("cascadeSplits", splits.x, splits.y, splits.z, splits.w);
+}
+
+// Shadow casters for the shadow benchmarks: a field of walls of a couple of
+// thousand triangles each, on a grid around the origin
+class ShadowBenchmarkScene
+{
+public:
+	explicit ShadowBenchmarkScene(u32 casterCount);
+	~ShadowBenchmarkScene();
+
+	// Draw every caster position-only with shader, through a render queue
+	void Draw(Shader &shader, const glm::mat4 &view,
+			  const glm::mat4 &projection);
+	// Put caster i back on its grid position plus offset, with a new turn
+	void Place(u32 i, const glm::vec3 &offset);
+	const Bounds &CasterBounds(u32 i) const { return m_bounds[i]; }
+	u32 CasterCount() const { return (u32)m_models.size(); }
+	// Half the width of the field
+	float Extent() const { return m_side * 3.0f; }
+
+	// depth-only shader for the casters
+	Shader depthShader;
+
+private:
+	Mesh m_wall;
+	u32 m_side;
+	std::mt19937 m_rng;
+	std::vector<glm::mat4> m_models;
+	std::vector<Bounds> m_bounds;
+	RenderQueue m_queue;
+};
+
+Mesh MakeBenchmarkWall()
+{
+	std::vector<glm::vec3> positions;
+	std::vector<u32> indices;
+	MakeBenchmarkMesh(2000, positions, indices);
+	std::vector<Vertex> vertices(positions.size());
+	for (size_t i = 0; i < positions.size(); i++)
+	{
+		vertices[i].Position = glm::vec3(positions[i].x, positions[i].z,
+										 positions[i].y)
+			* 0.04f;
+	}
+	return Mesh(vertices, indices, {});
+}
+
+ShadowBenchmarkScene::ShadowBenchmarkScene(u32 casterCount)
+	: depthShader("shaders/shadowDepth.vs", "shaders/shadowDepth.fs")
+	, m_wall(MakeBenchmarkWall())
+	, m_side((u32)std::ceil(std::sqrt((double)casterCount)))
+	, m_rng(3)
+	, m_models(casterCount)
+	, m_bounds(casterCount)
+{
+	depthShader.bindUniformBlock("PerDraw", PER_DRAW_UBO_BINDING);
+	for (u32 i = 0; i < casterCount; i++)
+	{
+		Place(i, glm::vec3(0.0f));
+	}
+}
+
+ShadowBenchmarkScene::~ShadowBenchmarkScene()
+{
+	glDeleteProgram(depthShader.m_programId);
+}
+
+void ShadowBenchmarkScene::Place(u32 i, const glm::vec3 &offset)
+{
+	std::uniform_real_distribution<float> turn(0.0f, 3.14f);
+	glm::vec3 position((float)(i % m_side) * 6.0f - m_side * 3.0f, 0.0f,
+					   (float)(i / m_side) * 6.0f - m_side * 3.0f);
+	m_models[i] = glm::rotate(glm::translate(glm::mat4(), position + offset),
+							  turn(m_rng), glm::vec3(0.0f, 1.0f, 0.0f));
+	m_bounds[i] = TransformBounds(m_wall.m_bounds, m_models[i]);
+}
+
+void ShadowBenchmarkScene::Draw(Shader &shader, const glm::mat4 &view,
+								const glm::mat4 &projection)
+{
+	m_queue.Clear();
+	for (const glm::mat4 &model : m_models)
+	{
+		DrawItem item;
+		item.shader = &shader;
+		item.vao = m_wall.DepthVAO();
+		item.count = m_wall.IndexCount();
+		item.indexed = true;
+		item.model = model;
+		m_queue.Push(RenderQueue::MakeKey(0, false, 0, 0, 0, 0.0f), item);
+	}
+	m_queue.Sort();
+	m_queue.SetCamera(view, projection);
+	m_queue.Execute(nullptr);
+}
+
+// Cost of the shadow passes, redrawing every cascade every frame against
+// caching them, over frameCount frames of a slowly moving camera above a
+// field of casterCount walls, one of which moves now and then. Results go
+// to stdout.
+void BenchmarkShadows(u32 casterCount = 400, u32 frameCount = 120)
+{
+	using Clock = std::chrono::high_resolution_clock;
+	const u32 moveEvery = 30;
+
+	ShadowBenchmarkScene scene(casterCount);
+	auto drawCasters = [&](const glm::mat4 &lightView,
+						   const glm::mat4 &lightProjection) {
+		scene.Draw(scene.depthShader, lightView, lightProjection);
+	};
+
+	std::cout << "shadows\t\tms/frame\tcascades drawn/frame" << std::endl;
+	for (bool caching : { false, true })
+	{
+		CascadedShadows shadows;
+		shadows.SetLightDirection(glm::vec3(-0.3f, -1.0f, -0.4f));
+		shadows.SetCaching(caching);
+		u32 cascadesDrawn = 0;
+		glFinish();
+		Clock::time_point start = Clock::now();
+		for (u32 frame = 0; frame < frameCount; frame++)
+		{
+			const glm::vec3 eye(frame * 0.01f, 10.0f, 20.0f);
+			shadows.SetCamera(glm::lookAt(eye, eye + glm::vec3(0.0f, -0.4f,
+															   -1.0f),
+										  glm::vec3(0.0f, 1.0f, 0.0f)),
+							  glm::radians(45.0f), 16.0f / 9.0f, 0.1f,
+							  1000.0f);
+			if (frame % moveEvery == moveEvery - 1)
+			{
+				const u32 moved = frame % casterCount;
+				shadows.Invalidate(scene.CasterBounds(moved));
+				scene.Place(moved, glm::vec3(0.5f, 0.0f, 0.0f));
+				shadows.Invalidate(scene.CasterBounds(moved));
+			}
+			cascadesDrawn += shadows.Render(drawCasters);
+		}
+		glFinish();
+		double ms
+			= std::chrono::duration<double, std::milli>(Clock::now() - start)
+				  .count()
+			/ frameCount;
+		std::cout << (caching ? "cached" : "every frame") << "\t" << ms
+				  << "\t\t" << (float)cascadesDrawn / frameCount << std::endl;
+	}
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#include <vector>
+#include <atomic>
+
+#include "profiler.h"
+#include "types.h"
+
+// Fixed set of worker threads pulling jobs off a shared queue. Jobs may
+// submit more jobs. Wait() blocks until every submitted job has finished and
+// runs queued jobs on the calling thread in the meantime, so it is fine to
+// call from the main thread while the workers are busy.
+class ThreadPool
+{
+public:
+	// 0 = one worker per hardware thread, minus the calling thread
+	explicit ThreadPool(u32 threadCount = 0);
+	~ThreadPool();
+	ThreadPool(const ThreadPool &) = delete;
+	ThreadPool &operator=(const ThreadPool &) = delete;
+
+	void Submit(std::function<void()> job);
+	void Wait();
+
+	// workers plus the thread that calls Wait()
+	u32 Concurrency() const { return (u32)m_workers.size() + 1; }
+
+private:
+	void WorkerLoop();
+	bool RunOne();
+
+	std::vector<std::thread> m_workers;
+	std::deque<std::function<void()>> m_jobs;
+	std::mutex m_mutex;
+	std::condition_variable m_jobAvailable;
+	std::condition_variable m_allDone;
+	std::atomic<u32> m_pending;
+	bool m_quit;
+};
+
+ThreadPool::ThreadPool(u32 threadCount) : m_pending(0), m_quit(false)
+{
+	if (threadCount == 0)
+	{
+		u32 hw = std::thread::hardware_concurrency();
+		threadCount = hw > 1 ? hw - 1 : 1;
+	}
+	for (u32 i = 0; i < threadCount; i++)
+	{
+		m_workers.emplace_back(&ThreadPool::WorkerLoop, this);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+	}
+	m_jobAvailable.notify_all();
+	for (std::thread &worker : m_workers)
+	{
+		worker.join();
+	}
+}
+
+void ThreadPool::Submit(std::function<void()> job)
+{
+	m_pending++;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_jobs.push_back(std::move(job));
+	}
+	m_jobAvailable.notify_one();
+}
+
+void ThreadPool::Wait()
+{
+	while (m_pending > 0)
+	{
+		if (!RunOne())
+		{
+			// nothing queued, the remaining jobs are running on workers
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_allDone.wait(lock,
+						   [this] { return m_pending == 0 || !m_jobs.empty(); });
+		}
+	}
+}
+
+bool ThreadPool::RunOne()
+{
+	std::function<void()> job;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_jobs.empty()) return false;
+		job = std::move(m_jobs.front());
+		m_jobs.pop_front();
+	}
+	{
+		PROFILE_SCOPE("job");
+		job();
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_pending--;
+	}
+	m_allDone.notify_all();
+	return true;
+}
+
+void ThreadPool::WorkerLoop()
+{
+	Profiler::Instance().SetThreadName("worker");
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_jobAvailable.wait(lock,
+								[this] { return m_quit || !m_jobs.empty(); });
+			if (m_quit && m_jobs.empty()) return;
+		}
+		RunOne();
+	}
+}
@@ -0,0 +1,319 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <iostream>
+#include <emmintrin.h>
+
+#include "shader.h"
+#include "ringbuffer.h"
+#include "types.h"
+
+// Uniform buffer binding of the per-draw block, declared in shaders as
+//   layout (std140) uniform PerDraw
+//   {
+//       mat4 mvp;
+//       mat4 modelView;
+//       mat3 normalMatrix;
+//   };
+// and filled per draw by the render queue, so vertex shaders only have
+// matrix-vector products left to do
+const u32 PER_DRAW_UBO_BINDING = 0;
+
+// std140 layout of the PerDraw block
+struct PerDrawConstants
+{
+	glm::mat4 mvp;
+	glm::mat4 modelView;
+	// inverse transpose of modelView's upper 3x3, std140 pads each column
+	// to a vec4
+	glm::vec4 normalMatrix[3];
+};
+
+// The camera's matrices, loaded once for a batch of ComputePerDraw calls
+struct PerDrawCamera
+{
+	__m128 view[4];
+	__m128 viewProjection[4];
+};
+
+PerDrawCamera MakePerDrawCamera(const glm::mat4 &view,
+								const glm::mat4 &projection)
+{
+	PerDrawCamera camera;
+	const glm::mat4 viewProjection = projection * view;
+	for (u32 c = 0; c < 4; c++)
+	{
+		camera.view[c] = _mm_loadu_ps(&view[c][0]);
+		camera.viewProjection[c] = _mm_loadu_ps(&viewProjection[c][0]);
+	}
+	return camera;
+}
+
+// out = a * b, columns of a already loaded
+inline void MultiplySSE(const __m128 a[4], const glm::mat4 &b, __m128 out[4])
+{
+	for (u32 c = 0; c < 4; c++)
+	{
+		out[c] = _mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(a[0], _mm_set1_ps(b[c][0])),
+					   _mm_mul_ps(a[1], _mm_set1_ps(b[c][1]))),
+			_mm_add_ps(_mm_mul_ps(a[2], _mm_set1_ps(b[c][2])),
+					   _mm_mul_ps(a[3], _mm_set1_ps(b[c][3]))));
+	}
+}
+
+inline __m128 CrossSSE(__m128 a, __m128 b)
+{
+	// (a * b.yzx - a.yzx * b).yzx, w comes out 0
+	const __m128 aYZX = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+	const __m128 bYZX = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+	const __m128 c = _mm_sub_ps(_mm_mul_ps(a, bYZX), _mm_mul_ps(aYZX, b));
+	return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+}
+
+// Fill out with model's constants. The normal matrix comes from cross
+// products of the model-view columns (the cofactors) over the determinant,
+// which is the inverse transpose without a general inverse.
+void ComputePerDraw(const PerDrawCamera &camera, const glm::mat4 &model,
+					PerDrawConstants *out)
+{
+	__m128 mvp[4], modelView[4];
+	MultiplySSE(camera.viewProjection, model, mvp);
+	MultiplySSE(camera.view, model, modelView);
+
+	__m128 n0 = CrossSSE(modelView[1], modelView[2]);
+	__m128 n1 = CrossSSE(modelView[2], modelView[0]);
+	__m128 n2 = CrossSSE(modelView[0], modelView[1]);
+	// determinant = dot(column 0, n0), w of n0 is 0
+	__m128 d = _mm_mul_ps(modelView[0], n0);
+	d = _mm_add_ps(d, _mm_shuffle_ps(d, d, _MM_SHUFFLE(2, 3, 0, 1)));
+	d = _mm_add_ps(d, _mm_shuffle_ps(d, d, _MM_SHUFFLE(1, 0, 3, 2)));
+	const __m128 invDet = _mm_div_ps(_mm_set1_ps(1.0f), d);
+
+	float *dst = &out->mvp[0][0];
+	for (u32 c = 0; c < 4; c++)
+	{
+		_mm_storeu_ps(dst + c * 4, mvp[c]);
+		_mm_storeu_ps(dst + 16 + c * 4, modelView[c]);
+	}
+	_mm_storeu_ps(&out->normalMatrix[0].x, _mm_mul_ps(n0, invDet));
+	_mm_storeu_ps(&out->normalMatrix[1].x, _mm_mul_ps(n1, invDet));
+	_mm_storeu_ps(&out->normalMatrix[2].x, _mm_mul_ps(n2, invDet));
+}
+
+// ComputePerDraw with glm, for reference
+void ComputePerDrawScalar(const glm::mat4 &view, const glm::mat4 &projection,
+						  const glm::mat4 &model, PerDrawConstants *out)
+{
+	out->modelView = view * model;
+	out->mvp = projection * out->modelView;
+	glm::mat3 normal = glm::inverseTranspose(glm::mat3(out->modelView));
+	for (u32 c = 0; c < 3; c++)
+	{
+		out->normalMatrix[c] = glm::vec4(normal[c], 0.0f);
+	}
+}
+
+// Vertex cost of building the matrices per vertex (perVertexMatrices.vs,
+// model/view/projection products and an inverse, as lighting3.vs used to)
+// against per-draw constants (deferredGeometry.vs). A dense grid is drawn as
+// points behind the camera, so there's next to nothing to rasterise and the
+// time is vertex work. Also times
+// computing drawCount draws' constants with glm and with SSE. Results go to
+// stdout.
+void BenchmarkPerDrawMatrices(u32 drawCount = 100000)
+{
+	using Clock = std::chrono::high_resolution_clock;
+	const u32 gridSide = 512;
+	const u32 gridDraws = 16;
+	const u32 viewportSize = 16;
+	const u32 iterations = 10;
+
+	// CPU side
+	std::mt19937 rng(5);
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> angle(0.0f, 6.28f);
+	std::vector<glm::mat4> models(drawCount);
+	for (glm::mat4 &model : models)
+	{
+		model = glm::rotate(
+			glm::translate(glm::mat4(),
+						   glm::vec3(position(rng), position(rng),
+									 position(rng))),
+			angle(rng), glm::normalize(glm::vec3(1.0f, 2.0f, 3.0f)));
+	}
+	const glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 3.0f),
+									   glm::vec3(0.0f),
+									   glm::vec3(0.0f, 1.0f, 0.0f));
+	const glm::mat4 projection
+		= glm::perspective(glm::radians(60.0f), 1.0f, 0.1f, 100.0f);
+	std::vector<PerDrawConstants> constants(drawCount);
+	Clock::time_point start = Clock::now();
+	for (u32 it = 0; it < iterations; it++)
+	{
+		for (u32 i = 0; i < drawCount; i++)
+		{
+			ComputePerDrawScalar(view, projection, models[i], &constants[i]);
+		}
+	}
+	double scalarMs
+		= std::chrono::duration<double, std::milli>(Clock::now() - start)
+			  .count()
+		/ iterations;
+	start = Clock::now();
+	for (u32 it = 0; it < iterations; it++)
+	{
+		const PerDrawCamera camera = MakePerDrawCamera(view, projection);
+		for (u32 i = 0; i < drawCount; i++)
+		{
+			ComputePerDraw(camera, models[i], &constants[i]);
+		}
+	}
+	double simdMs
+		= std::chrono::duration<double, std::milli>(Clock::now() - start)
+			  .count()
+		/ iterations;
+	std::cout << "per-draw constants for " << drawCount << " draws: glm "
+			  << scalarMs << " ms, SSE " << simdMs << " ms" << std::endl;
+
+	// GPU side, a wavy grid
+	std::vector<float> vertices;
+	vertices.reserve(gridSide * gridSide * 8);
+	for (u32 y = 0; y < gridSide; y++)
+	{
+		for (u32 x = 0; x < gridSide; x++)
+		{
+			const float u = (float)x / (gridSide - 1);
+			const float v = (float)y / (gridSide - 1);
+			vertices.insert(vertices.end(),
+				{ u * 2.0f - 1.0f, v * 2.0f - 1.0f,
+				  0.1f * std::sin(u * 40.0f), 0.0f, 0.0f, 1.0f, u, v });
+		}
+	}
+	VAO vao;
+	VBO vbo;
+	glGenVertexArrays(1, &vao);
+	glGenBuffers(1, &vbo);
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float),
+				 vertices.data(), GL_STATIC_DRAW);
+	for (u32 a = 0; a < 3; a++)
+	{
+		const GLint sizes[] = { 3, 3, 2 };
+		const u32 offsets[] = { 0, 3, 6 };
+		glEnableVertexAttribArray(a);
+		glVertexAttribPointer(a, sizes[a], GL_FLOAT, GL_FALSE,
+							  8 * sizeof(float),
+							  (void *)(offsets[a] * sizeof(float)));
+	}
+	glBindVertexArray(0);
+
+	u32 fbo, colour, depth;
+	glGenFramebuffers(1, &fbo);
+	glGenTextures(1, &colour);
+	glBindTexture(GL_TEXTURE_2D, colour);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, viewportSize, viewportSize, 0,
+				 GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glGenRenderbuffers(1, &depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, viewportSize,
+						  viewportSize);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+						   colour, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+							  GL_RENDERBUFFER, depth);
+	glViewport(0, 0, viewportSize, viewportSize);
+	glEnable(GL_DEPTH_TEST);
+
+	// both write the G-buffer outputs, only the first one lands
+	Shader perVertex("shaders/perVertexMatrices.vs", "shaders/gbuffer.fs");
+	Shader perDraw("shaders/deferredGeometry.vs", "shaders/gbuffer.fs");
+	perVertex.use();
+	perVertex.setMat4("view", view);
+	perVertex.setMat4("projection", projection);
+	perDraw.bindUniformBlock("PerDraw", PER_DRAW_UBO_BINDING);
+	const u32 alignment = UniformBufferAlignment();
+	const u32 stride = ((u32)sizeof(PerDrawConstants) + alignment - 1)
+		/ alignment * alignment;
+	RingBuffer perDrawBuffer(GL_UNIFORM_BUFFER, gridDraws * stride);
+
+	auto timeDraws = [&](bool precomputed) {
+		double total = 0.0;
+		for (u32 it = 0; it < iterations + 1; it++)
+		{
+			std::vector<u32> offsets(gridDraws);
+			if (precomputed)
+			{
+				const PerDrawCamera camera = MakePerDrawCamera(view,
+															   projection);
+				perDrawBuffer.BeginFrame();
+				for (u32 i = 0; i < gridDraws; i++)
+				{
+					PerDrawConstants *dst
+						= (PerDrawConstants *)perDrawBuffer.Allocate(
+							sizeof(PerDrawConstants), alignment, offsets[i]);
+					ComputePerDraw(camera, models[i], dst);
+				}
+				perDrawBuffer.Flush();
+			}
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			// wall clock, some drivers run vertex shading outside what a
+			// GL_TIME_ELAPSED query covers
+			glFinish();
+			Clock::time_point drawStart = Clock::now();
+			Shader &shader = precomputed ? perDraw : perVertex;
+			shader.use();
+			glBindVertexArray(vao);
+			for (u32 i = 0; i < gridDraws; i++)
+			{
+				if (precomputed)
+					glBindBufferRange(GL_UNIFORM_BUFFER, PER_DRAW_UBO_BINDING,
+									  perDrawBuffer.Buffer(), offsets[i],
+									  sizeof(PerDrawConstants));
+				else
+					shader.setMat4("model", models[i]);
+				glDrawArrays(GL_POINTS, 0, gridSide * gridSide);
+			}
+			if (precomputed) perDrawBuffer.EndFrame();
+			glFinish();
+			// the first run warms up
+			if (it > 0)
+				total += std::chrono::duration<double, std::milli>(
+							 Clock::now() - drawStart)
+							 .count();
+		}
+		return total / iterations;
+	};
+	// behind the camera, every vertex is shaded and then clipped
+	for (u32 i = 0; i < gridDraws; i++)
+	{
+		models[i] = glm::rotate(
+			glm::translate(glm::mat4(), glm::vec3(0.0f, 0.0f, 10.0f)),
+			0.1f * i, glm::vec3(0.0f, 0.0f, 1.0f));
+	}
+	double perVertexMs = timeDraws(false);
+	double perDrawMs = timeDraws(true);
+	std::cout << gridDraws << " draws of " << gridSide * gridSide
+			  << " vertices: per-vertex matrices " << perVertexMs
+			  << " ms, per-draw " << perDrawMs << " ms" << std::endl;
+
+	glBindVertexArray(0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(1, &fbo);
+	glDeleteTextures(1, &colour);
+	glDeleteRenderbuffers(1, &depth);
+	glDeleteVertexArrays(1, &vao);
+	glDeleteBuffers(1, &vbo);
+	glDeleteProgram(perVertex.m_programId);
+	glDeleteProgram(perDraw.m_programId);
+}
@@ -1,6 +1,8 @@
 #pragma once
 
+using u64 = unsigned long long;
 using u32 = unsigned int;
+using u16 = unsigned short;
 using u8 = unsigned char;
 using VAO = u32;
 using VBO = u32;